@@ -0,0 +1,491 @@
+#include "BatchDistance.h"
+#include "JobSystem.h"
+#include "SimdMath.h"
+
+DistanceBatch::DistanceBatch()
+{
+	proxiesA = NULL;
+	proxiesB = NULL;
+	transformsA = NULL;
+	transformsB = NULL;
+	count = 0;
+	useRadii = false;
+}
+
+// Same as in b2Distance.cpp.
+static const int32 k_maxIters = 20;
+
+// Groups of pairs per job in ComputeDistances.
+static const int32 k_groupsPerJob = 16;
+
+// b2Distance's treatment of the radii, applied after the core shapes' GJK.
+static void ApplyRadii(b2DistanceOutput* output, float32 rA, float32 rB)
+{
+	if (output->distance > rA + rB && output->distance > b2_epsilon)
+	{
+		// Shapes are still no overlapped.
+		// Move the witness points to the outer surface.
+		output->distance -= rA + rB;
+		b2Vec2 normal = output->pointB - output->pointA;
+		normal.Normalize();
+		output->pointA += rA * normal;
+		output->pointB -= rB * normal;
+	}
+	else
+	{
+		// Shapes are overlapped when radii are considered.
+		// Move the witness points to the middle.
+		b2Vec2 p = 0.5f * (output->pointA + output->pointB);
+		output->pointA = p;
+		output->pointB = p;
+		output->distance = 0.0f;
+	}
+}
+
+void ComputeDistancesScalar(b2DistanceOutput* outputs, const DistanceBatch& batch, int32 begin, int32 end)
+{
+	b2DistanceInput input;
+	input.useRadii = batch.useRadii;
+	for (int32 i = begin; i < end; ++i)
+	{
+		input.proxyA = batch.proxiesA[i];
+		input.proxyB = batch.proxiesB[i];
+		input.transformA = batch.transformsA[i];
+		input.transformB = batch.transformsB[i];
+
+		b2SimplexCache cache;
+		cache.count = 0;
+		b2Distance(outputs + i, &cache, &input);
+	}
+}
+
+// The vertices of one proxy per lane, transposed so that vertex j of all
+// lanes is one load. Lanes past a proxy's last vertex repeat it, which
+// never wins the strict comparison in the support search.
+struct WideProxy
+{
+	float32 x[b2_maxPolygonVertices][k_simdWidth];
+	float32 y[b2_maxPolygonVertices][k_simdWidth];
+	int32 maxCount;
+};
+
+struct WideTransform
+{
+	FloatW px, py, qs, qc;
+};
+
+// b2Simplex with one simplex per lane. Vertex indices are kept as floats
+// so they can go through SimdSelect.
+struct WideSimplex
+{
+	FloatW wAx[3], wAy[3];
+	FloatW wBx[3], wBy[3];
+	FloatW wx[3], wy[3];
+	FloatW a[3];
+	FloatW indexA[3], indexB[3];
+	FloatW count;
+};
+
+static inline FloatW AndNot(FloatW a, FloatW b)
+{
+	return SimdSelect(b, SimdZero(), a);
+}
+
+static void GatherProxies(WideProxy* proxy, const b2DistanceProxy* proxies, const int32 pairs[k_simdWidth])
+{
+	proxy->maxCount = 0;
+	for (int32 lane = 0; lane < k_simdWidth; ++lane)
+	{
+		proxy->maxCount = b2Max(proxy->maxCount, proxies[pairs[lane]].m_count);
+	}
+
+	for (int32 lane = 0; lane < k_simdWidth; ++lane)
+	{
+		const b2DistanceProxy& p = proxies[pairs[lane]];
+		for (int32 j = 0; j < proxy->maxCount; ++j)
+		{
+			const b2Vec2& v = p.m_vertices[b2Min(j, p.m_count - 1)];
+			proxy->x[j][lane] = v.x;
+			proxy->y[j][lane] = v.y;
+		}
+	}
+}
+
+static void GatherTransforms(WideTransform* transform, const b2Transform* transforms, const int32 pairs[k_simdWidth])
+{
+	float32 px[k_simdWidth], py[k_simdWidth], qs[k_simdWidth], qc[k_simdWidth];
+	for (int32 lane = 0; lane < k_simdWidth; ++lane)
+	{
+		const b2Transform& xf = transforms[pairs[lane]];
+		px[lane] = xf.p.x;
+		py[lane] = xf.p.y;
+		qs[lane] = xf.q.s;
+		qc[lane] = xf.q.c;
+	}
+	transform->px = SimdLoad(px);
+	transform->py = SimdLoad(py);
+	transform->qs = SimdLoad(qs);
+	transform->qc = SimdLoad(qc);
+}
+
+// b2Mul(xf, v)
+static inline void Transform(FloatW* x, FloatW* y, const WideTransform& xf, FloatW vx, FloatW vy)
+{
+	*x = (xf.qc * vx - xf.qs * vy) + xf.px;
+	*y = (xf.qs * vx + xf.qc * vy) + xf.py;
+}
+
+// b2DistanceProxy::GetSupport, also returning the vertex. d is in the
+// proxy's frame.
+static void GetSupport(FloatW* index, FloatW* vx, FloatW* vy, const WideProxy& proxy, FloatW dx, FloatW dy)
+{
+	FloatW bestX = SimdLoad(proxy.x[0]);
+	FloatW bestY = SimdLoad(proxy.y[0]);
+	FloatW bestValue = bestX * dx + bestY * dy;
+	FloatW bestIndex = SimdZero();
+	for (int32 j = 1; j < proxy.maxCount; ++j)
+	{
+		FloatW x = SimdLoad(proxy.x[j]);
+		FloatW y = SimdLoad(proxy.y[j]);
+		FloatW value = x * dx + y * dy;
+		FloatW better = value > bestValue;
+		bestValue = SimdSelect(better, value, bestValue);
+		bestIndex = SimdSelect(better, SimdSet((float32)j), bestIndex);
+		bestX = SimdSelect(better, x, bestX);
+		bestY = SimdSelect(better, y, bestY);
+	}
+	*index = bestIndex;
+	*vx = bestX;
+	*vy = bestY;
+}
+
+// Vertex dst = vertex src in the lanes of mask.
+static void CopyVertex(WideSimplex* s, FloatW mask, int32 dst, int32 src)
+{
+	s->wAx[dst] = SimdSelect(mask, s->wAx[src], s->wAx[dst]);
+	s->wAy[dst] = SimdSelect(mask, s->wAy[src], s->wAy[dst]);
+	s->wBx[dst] = SimdSelect(mask, s->wBx[src], s->wBx[dst]);
+	s->wBy[dst] = SimdSelect(mask, s->wBy[src], s->wBy[dst]);
+	s->wx[dst] = SimdSelect(mask, s->wx[src], s->wx[dst]);
+	s->wy[dst] = SimdSelect(mask, s->wy[src], s->wy[dst]);
+	s->a[dst] = SimdSelect(mask, s->a[src], s->a[dst]);
+	s->indexA[dst] = SimdSelect(mask, s->indexA[src], s->indexA[dst]);
+	s->indexB[dst] = SimdSelect(mask, s->indexB[src], s->indexB[dst]);
+}
+
+// b2Simplex::Solve2 in the lanes of mask. Each of its early returns is a
+// region mask; later regions exclude the earlier ones.
+static void Solve2(WideSimplex* s, FloatW mask)
+{
+	const FloatW zero = SimdZero();
+	const FloatW one = SimdSet(1.0f);
+
+	FloatW e12x = s->wx[1] - s->wx[0];
+	FloatW e12y = s->wy[1] - s->wy[0];
+
+	// w1 region
+	FloatW d12_2 = -(s->wx[0] * e12x + s->wy[0] * e12y);
+	FloatW region1 = mask & (zero >= d12_2);
+
+	// w2 region
+	FloatW d12_1 = s->wx[1] * e12x + s->wy[1] * e12y;
+	FloatW region2 = AndNot(mask & (zero >= d12_1), region1);
+
+	// Must be in e12 region.
+	FloatW edge = AndNot(AndNot(mask, region1), region2);
+	FloatW inv_d12 = one / (d12_1 + d12_2);
+
+	CopyVertex(s, region2, 0, 1);
+	s->a[0] = SimdSelect(region1 | region2, one, SimdSelect(edge, d12_1 * inv_d12, s->a[0]));
+	s->a[1] = SimdSelect(edge, d12_2 * inv_d12, s->a[1]);
+	s->count = SimdSelect(region1 | region2, one, s->count);
+}
+
+// b2Simplex::Solve3 in the lanes of mask, structured like Solve2.
+static void Solve3(WideSimplex* s, FloatW mask)
+{
+	const FloatW zero = SimdZero();
+	const FloatW one = SimdSet(1.0f);
+	const FloatW two = SimdSet(2.0f);
+
+	FloatW w1x = s->wx[0], w1y = s->wy[0];
+	FloatW w2x = s->wx[1], w2y = s->wy[1];
+	FloatW w3x = s->wx[2], w3y = s->wy[2];
+
+	// Edge12
+	FloatW e12x = w2x - w1x, e12y = w2y - w1y;
+	FloatW w1e12 = w1x * e12x + w1y * e12y;
+	FloatW w2e12 = w2x * e12x + w2y * e12y;
+	FloatW d12_1 = w2e12;
+	FloatW d12_2 = -w1e12;
+
+	// Edge13
+	FloatW e13x = w3x - w1x, e13y = w3y - w1y;
+	FloatW w1e13 = w1x * e13x + w1y * e13y;
+	FloatW w3e13 = w3x * e13x + w3y * e13y;
+	FloatW d13_1 = w3e13;
+	FloatW d13_2 = -w1e13;
+
+	// Edge23
+	FloatW e23x = w3x - w2x, e23y = w3y - w2y;
+	FloatW w2e23 = w2x * e23x + w2y * e23y;
+	FloatW w3e23 = w3x * e23x + w3y * e23y;
+	FloatW d23_1 = w3e23;
+	FloatW d23_2 = -w2e23;
+
+	// Triangle123
+	FloatW n123 = e12x * e13y - e12y * e13x;
+	FloatW d123_1 = n123 * (w2x * w3y - w2y * w3x);
+	FloatW d123_2 = n123 * (w3x * w1y - w3y * w1x);
+	FloatW d123_3 = n123 * (w1x * w2y - w1y * w2x);
+
+	FloatW left = mask;
+
+	// w1 region
+	FloatW region1 = left & (zero >= d12_2) & (zero >= d13_2);
+	left = AndNot(left, region1);
+
+	// e12
+	FloatW edge12 = left & (d12_1 > zero) & (d12_2 > zero) & (zero >= d123_3);
+	left = AndNot(left, edge12);
+
+	// e13
+	FloatW edge13 = left & (d13_1 > zero) & (d13_2 > zero) & (zero >= d123_2);
+	left = AndNot(left, edge13);
+
+	// w2 region
+	FloatW region2 = left & (zero >= d12_1) & (zero >= d23_2);
+	left = AndNot(left, region2);
+
+	// w3 region
+	FloatW region3 = left & (zero >= d13_1) & (zero >= d23_1);
+	left = AndNot(left, region3);
+
+	// e23
+	FloatW edge23 = left & (d23_1 > zero) & (d23_2 > zero) & (zero >= d123_1);
+	left = AndNot(left, edge23);
+
+	// Must be in triangle123
+	FloatW triangle = left;
+
+	FloatW inv_d12 = one / (d12_1 + d12_2);
+	FloatW inv_d13 = one / (d13_1 + d13_2);
+	FloatW inv_d23 = one / (d23_1 + d23_2);
+	FloatW inv_d123 = one / (d123_1 + d123_2 + d123_3);
+
+	s->a[0] = SimdSelect(region1, one,
+		SimdSelect(edge12, d12_1 * inv_d12,
+		SimdSelect(edge13, d13_1 * inv_d13,
+		SimdSelect(triangle, d123_1 * inv_d123, s->a[0]))));
+	s->a[1] = SimdSelect(region2, one,
+		SimdSelect(edge12, d12_2 * inv_d12,
+		SimdSelect(edge23, d23_1 * inv_d23,
+		SimdSelect(triangle, d123_2 * inv_d123, s->a[1]))));
+	s->a[2] = SimdSelect(region3, one,
+		SimdSelect(edge13, d13_2 * inv_d13,
+		SimdSelect(edge23, d23_2 * inv_d23,
+		SimdSelect(triangle, d123_3 * inv_d123, s->a[2]))));
+
+	// The regions are disjoint, so the order of the copies does not matter.
+	CopyVertex(s, edge13, 1, 2);
+	CopyVertex(s, region2, 0, 1);
+	CopyVertex(s, region3 | edge23, 0, 2);
+
+	s->count = SimdSelect(region1 | region2 | region3, one, SimdSelect(edge12 | edge13 | edge23, two, s->count));
+}
+
+// b2Simplex::GetSearchDirection for simplices of one or two vertices.
+static void GetSearchDirection(FloatW* dx, FloatW* dy, const WideSimplex& s)
+{
+	FloatW e12x = s.wx[1] - s.wx[0];
+	FloatW e12y = s.wy[1] - s.wy[0];
+	FloatW sgn = e12x * -s.wy[0] - e12y * -s.wx[0];
+	FloatW left = sgn > SimdZero();
+
+	// Origin is left of e12: b2Cross(1.0f, e12), else b2Cross(e12, 1.0f).
+	FloatW edgeX = SimdSelect(left, -e12y, e12y);
+	FloatW edgeY = SimdSelect(left, e12x, -e12x);
+
+	FloatW single = s.count == SimdSet(1.0f);
+	*dx = SimdSelect(single, -s.wx[0], edgeX);
+	*dy = SimdSelect(single, -s.wy[0], edgeY);
+}
+
+// b2Distance for up to k_simdWidth pairs starting at 'first'.
+static void ComputeGroup(b2DistanceOutput* outputs, const DistanceBatch& batch, int32 first, int32 laneCount)
+{
+	// Unused lanes repeat the last pair and are not written back.
+	int32 pairs[k_simdWidth];
+	for (int32 lane = 0; lane < k_simdWidth; ++lane)
+	{
+		pairs[lane] = first + b2Min(lane, laneCount - 1);
+	}
+
+	WideProxy proxyA, proxyB;
+	GatherProxies(&proxyA, batch.proxiesA, pairs);
+	GatherProxies(&proxyB, batch.proxiesB, pairs);
+
+	WideTransform transformA, transformB;
+	GatherTransforms(&transformA, batch.transformsA, pairs);
+	GatherTransforms(&transformB, batch.transformsB, pairs);
+
+	const FloatW zero = SimdZero();
+	const FloatW one = SimdSet(1.0f);
+
+	// b2Simplex::ReadCache with an empty cache: the first vertex of each.
+	WideSimplex s;
+	for (int32 i = 0; i < 3; ++i)
+	{
+		s.wAx[i] = s.wAy[i] = s.wBx[i] = s.wBy[i] = zero;
+		s.wx[i] = s.wy[i] = s.a[i] = zero;
+		s.indexA[i] = s.indexB[i] = zero;
+	}
+	Transform(&s.wAx[0], &s.wAy[0], transformA, SimdLoad(proxyA.x[0]), SimdLoad(proxyA.y[0]));
+	Transform(&s.wBx[0], &s.wBy[0], transformB, SimdLoad(proxyB.x[0]), SimdLoad(proxyB.y[0]));
+	s.wx[0] = s.wBx[0] - s.wAx[0];
+	s.wy[0] = s.wBy[0] - s.wAy[0];
+	s.a[0] = one;
+	s.count = one;
+
+	// Lanes still in the main loop. All of them have done the same number
+	// of iterations, so 'iter' is shared.
+	FloatW active = zero == zero;
+	FloatW iterations = zero;
+	const FloatW epsilonSqr = SimdSet(b2_epsilon * b2_epsilon);
+
+	for (int32 iter = 0; iter < k_maxIters; ++iter)
+	{
+		// Copy simplex so we can identify duplicates.
+		FloatW saveCount = s.count;
+		FloatW saveA[3], saveB[3];
+		for (int32 i = 0; i < 3; ++i)
+		{
+			saveA[i] = s.indexA[i];
+			saveB[i] = s.indexB[i];
+		}
+
+		FloatW solve2 = active & (s.count == SimdSet(2.0f));
+		if (SimdAnyTrue(solve2))
+		{
+			Solve2(&s, solve2);
+		}
+
+		FloatW solve3 = active & (s.count == SimdSet(3.0f));
+		if (SimdAnyTrue(solve3))
+		{
+			Solve3(&s, solve3);
+		}
+
+		// If we have 3 points, then the origin is in the corresponding triangle.
+		active = AndNot(active, s.count == SimdSet(3.0f));
+
+		// Ensure the search direction is numerically fit.
+		FloatW dx, dy;
+		GetSearchDirection(&dx, &dy, s);
+		active = AndNot(active, (dx * dx + dy * dy) < epsilonSqr);
+
+		if (SimdAnyTrue(active) == false)
+		{
+			break;
+		}
+
+		// Compute a tentative new simplex vertex using support points.
+		FloatW indexA, vAx, vAy;
+		FloatW mdx = -dx, mdy = -dy;
+		GetSupport(&indexA, &vAx, &vAy, proxyA,
+			transformA.qc * mdx + transformA.qs * mdy, -transformA.qs * mdx + transformA.qc * mdy);
+		FloatW wAx, wAy;
+		Transform(&wAx, &wAy, transformA, vAx, vAy);
+
+		FloatW indexB, vBx, vBy;
+		GetSupport(&indexB, &vBx, &vBy, proxyB,
+			transformB.qc * dx + transformB.qs * dy, -transformB.qs * dx + transformB.qc * dy);
+		FloatW wBx, wBy;
+		Transform(&wBx, &wBy, transformB, vBx, vBy);
+
+		iterations = SimdSelect(active, iterations + one, iterations);
+
+		// Check for duplicate support points. This is the main termination criteria.
+		FloatW duplicate = zero;
+		for (int32 i = 0; i < 3; ++i)
+		{
+			FloatW saved = SimdSet((float32)i) < saveCount;
+			duplicate = duplicate | (saved & (indexA == saveA[i]) & (indexB == saveB[i]));
+		}
+		active = AndNot(active, duplicate);
+
+		// New vertex is ok and needed.
+		for (int32 i = 1; i < 3; ++i)
+		{
+			FloatW slot = active & (s.count == SimdSet((float32)i));
+			s.wAx[i] = SimdSelect(slot, wAx, s.wAx[i]);
+			s.wAy[i] = SimdSelect(slot, wAy, s.wAy[i]);
+			s.wBx[i] = SimdSelect(slot, wBx, s.wBx[i]);
+			s.wBy[i] = SimdSelect(slot, wBy, s.wBy[i]);
+			s.wx[i] = SimdSelect(slot, wBx - wAx, s.wx[i]);
+			s.wy[i] = SimdSelect(slot, wBy - wAy, s.wy[i]);
+			s.indexA[i] = SimdSelect(slot, indexA, s.indexA[i]);
+			s.indexB[i] = SimdSelect(slot, indexB, s.indexB[i]);
+		}
+		s.count = SimdSelect(active, s.count + one, s.count);
+	}
+
+	// b2Simplex::GetWitnessPoints
+	FloatW pAx2 = s.a[0] * s.wAx[0] + s.a[1] * s.wAx[1];
+	FloatW pAy2 = s.a[0] * s.wAy[0] + s.a[1] * s.wAy[1];
+	FloatW pBx2 = s.a[0] * s.wBx[0] + s.a[1] * s.wBx[1];
+	FloatW pBy2 = s.a[0] * s.wBy[0] + s.a[1] * s.wBy[1];
+	FloatW pAx3 = pAx2 + s.a[2] * s.wAx[2];
+	FloatW pAy3 = pAy2 + s.a[2] * s.wAy[2];
+
+	FloatW single = s.count == one;
+	FloatW triangle = s.count == SimdSet(3.0f);
+	FloatW pAx = SimdSelect(single, s.wAx[0], SimdSelect(triangle, pAx3, pAx2));
+	FloatW pAy = SimdSelect(single, s.wAy[0], SimdSelect(triangle, pAy3, pAy2));
+	FloatW pBx = SimdSelect(single, s.wBx[0], SimdSelect(triangle, pAx3, pBx2));
+	FloatW pBy = SimdSelect(single, s.wBy[0], SimdSelect(triangle, pAy3, pBy2));
+
+	FloatW cx = pAx - pBx;
+	FloatW cy = pAy - pBy;
+	FloatW distance = SimdSqrt(cx * cx + cy * cy);
+
+	float32 lanes[6][k_simdWidth];
+	SimdStore(lanes[0], pAx);
+	SimdStore(lanes[1], pAy);
+	SimdStore(lanes[2], pBx);
+	SimdStore(lanes[3], pBy);
+	SimdStore(lanes[4], distance);
+	SimdStore(lanes[5], iterations);
+
+	for (int32 lane = 0; lane < laneCount; ++lane)
+	{
+		b2DistanceOutput* output = outputs + first + lane;
+		output->pointA.Set(lanes[0][lane], lanes[1][lane]);
+		output->pointB.Set(lanes[2][lane], lanes[3][lane]);
+		output->distance = lanes[4][lane];
+		output->iterations = (int32)lanes[5][lane];
+
+		if (batch.useRadii)
+		{
+			ApplyRadii(output, batch.proxiesA[first + lane].m_radius, batch.proxiesB[first + lane].m_radius);
+		}
+	}
+}
+
+void ComputeDistancesWide(b2DistanceOutput* outputs, const DistanceBatch& batch, int32 begin, int32 end)
+{
+	for (int32 first = begin; first < end; first += k_simdWidth)
+	{
+		ComputeGroup(outputs, batch, first, b2Min((int32)k_simdWidth, end - first));
+	}
+}
+
+void ComputeDistances(b2DistanceOutput* outputs, const DistanceBatch& batch)
+{
+	// Ranges are whole groups so only the last one has idle lanes.
+	int32 groupCount = (batch.count + k_simdWidth - 1) / k_simdWidth;
+	g_jobSystem.ParallelFor(groupCount, k_groupsPerJob, [outputs, &batch](int32 begin, int32 end)
+	{
+		ComputeDistancesWide(outputs, batch, begin * k_simdWidth, b2Min(end * k_simdWidth, batch.count));
+	});
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+// Many b2Distance queries at once, given as parallel arrays: pair i is
+// proxiesA[i] at transformsA[i] against proxiesB[i] at transformsB[i].
+// Every query starts from an empty simplex cache, like a lone b2Distance
+// call with cache.count = 0.
+struct DistanceBatch
+{
+	DistanceBatch();
+
+	const b2DistanceProxy* proxiesA;
+	const b2DistanceProxy* proxiesB;
+	const b2Transform* transformsA;
+	const b2Transform* transformsB;
+	int32 count;
+	bool useRadii;
+};
+
+// Pairs [begin, end) through b2Distance one at a time. This is the
+// reference the other two are measured against.
+void ComputeDistancesScalar(b2DistanceOutput* outputs, const DistanceBatch& batch, int32 begin, int32 end);
+
+// Pairs [begin, end) in groups of k_simdWidth, one pair per SIMD lane.
+// Each lane runs b2Distance's GJK loop with the same float operations in
+// the same order; a lane that terminates is masked off while the others
+// keep iterating. The outputs match b2Distance exactly unless the compiler
+// contracts one of the two into FMA.
+void ComputeDistancesWide(b2DistanceOutput* outputs, const DistanceBatch& batch, int32 begin, int32 end);
+
+// ComputeDistancesWide over the whole batch, split across g_jobSystem.
+void ComputeDistances(b2DistanceOutput* outputs, const DistanceBatch& batch);
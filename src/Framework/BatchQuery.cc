@@ -0,0 +1,493 @@
+#include "BatchQuery.h"
+#include "JobSystem.h"
+#include "SimdMath.h"
+
+RayBatch::RayBatch()
+{
+	points1 = NULL;
+	points2 = NULL;
+	filters = NULL;
+	count = 0;
+	mode = e_rayClosest;
+	maxHits = 1;
+	includeSensors = true;
+}
+
+AABBBatch::AABBBatch()
+{
+	aabbs = NULL;
+	filters = NULL;
+	count = 0;
+	maxResults = 1;
+	includeSensors = true;
+}
+
+// Rays or boxes that walk the tree together.
+static const int32 k_packetSize = 4;
+
+// Packets per job in RayCastBatch and QueryAABBBatch.
+static const int32 k_packetsPerJob = 8;
+
+// Same bound as WorldSnapshot's own queries.
+#define BATCH_STACK_SIZE 64
+
+bool ShouldQueryProxy(const b2Filter& filter, bool includeSensors, const SnapshotProxy& proxy)
+{
+	if (proxy.isSensor && includeSensors == false)
+	{
+		return false;
+	}
+
+	if (filter.groupIndex == proxy.filter.groupIndex && filter.groupIndex != 0)
+	{
+		return filter.groupIndex > 0;
+	}
+
+	return (filter.maskBits & proxy.filter.categoryBits) != 0 && (filter.categoryBits & proxy.filter.maskBits) != 0;
+}
+
+static int32 GetRayStride(const RayBatch& batch)
+{
+	return batch.mode == e_rayMultiple ? batch.maxHits : 1;
+}
+
+// Keeps hits the way the RayCast test's three callbacks do.
+class RayBatchCallback : public SnapshotRayCastCallback
+{
+public:
+	RayBatchCallback(const RayBatch& batch, const b2Filter& filter, RayBatchHit* hits) : m_batch(batch), m_filter(filter), m_hits(hits)
+	{
+		m_count = 0;
+	}
+
+	float32 ReportProxy(const SnapshotProxy& proxy, const b2Vec2& point, const b2Vec2& normal, float32 fraction) override
+	{
+		if (ShouldQueryProxy(m_filter, m_batch.includeSensors, proxy) == false)
+		{
+			return -1.0f;
+		}
+
+		RayBatchHit* hit = m_hits + (m_batch.mode == e_rayMultiple ? m_count : 0);
+		hit->proxy = &proxy;
+		hit->point = point;
+		hit->normal = normal;
+		hit->fraction = fraction;
+
+		switch (m_batch.mode)
+		{
+		case e_rayClosest:
+			m_count = 1;
+			return fraction;
+
+		case e_rayAny:
+			m_count = 1;
+			return 0.0f;
+
+		default:
+			++m_count;
+			return m_count == m_batch.maxHits ? 0.0f : 1.0f;
+		}
+	}
+
+	const RayBatch& m_batch;
+	const b2Filter& m_filter;
+	RayBatchHit* m_hits;
+	int32 m_count;
+};
+
+void RayCastScalar(RayBatchHit* hits, int32* hitCounts, const WorldSnapshot& snapshot, const RayBatch& batch, int32 begin, int32 end)
+{
+	b2Assert(batch.mode != e_rayMultiple || batch.maxHits > 0);
+
+	int32 stride = GetRayStride(batch);
+	for (int32 i = begin; i < end; ++i)
+	{
+		const b2Filter& filter = batch.filters != NULL ? batch.filters[i] : batch.filter;
+		RayBatchCallback callback(batch, filter, hits + i * stride);
+		snapshot.RayCast(&callback, batch.points1[i], batch.points2[i]);
+		hitCounts[i] = callback.m_count;
+	}
+}
+
+// Lanes whose segment [0, maxFraction] overlaps the box, as bits. The slab
+// test on the inverse direction is exact for a segment, so it also rejects
+// boxes next to the ray that the segment's own bounding box would overlap.
+static int32 TestRays(const b2AABB& aabb, Float4 originX, Float4 originY, Float4 inverseX, Float4 inverseY, Float4 maxFraction)
+{
+	Float4 x1 = (Simd4Set(aabb.lowerBound.x) - originX) * inverseX;
+	Float4 x2 = (Simd4Set(aabb.upperBound.x) - originX) * inverseX;
+	Float4 y1 = (Simd4Set(aabb.lowerBound.y) - originY) * inverseY;
+	Float4 y2 = (Simd4Set(aabb.upperBound.y) - originY) * inverseY;
+
+	Float4 enter = Simd4Max(Simd4Min(x1, x2), Simd4Min(y1, y2));
+	Float4 exit = Simd4Min(Simd4Max(x1, x2), Simd4Max(y1, y2));
+	Float4 miss = (enter > exit) | (enter > maxFraction) | (Simd4Set(0.0f) > exit);
+	return ~Simd4MaskBits(miss) & 0xF;
+}
+
+// A zero component would give 0 * inf = NaN for a box face through the
+// origin, so tiny components get a large finite inverse instead.
+static float32 SafeInverse(float32 x)
+{
+	if (b2Abs(x) > 1.0e-20f)
+	{
+		return 1.0f / x;
+	}
+	return x < 0.0f ? -b2_maxFloat : b2_maxFloat;
+}
+
+void RayCastPackets(RayBatchHit* hits, int32* hitCounts, const WorldSnapshot& snapshot, const RayBatch& batch, int32 begin, int32 end)
+{
+	b2Assert(batch.mode != e_rayMultiple || batch.maxHits > 0);
+
+	int32 stride = GetRayStride(batch);
+	int32 root = snapshot.GetRoot();
+
+	for (int32 first = begin; first < end; first += k_packetSize)
+	{
+		int32 laneCount = b2Min(k_packetSize, end - first);
+
+		float32 originX[k_packetSize];
+		float32 originY[k_packetSize];
+		float32 inverseX[k_packetSize];
+		float32 inverseY[k_packetSize];
+		float32 maxFractions[k_packetSize];
+		int32 active = 0;
+
+		for (int32 lane = 0; lane < k_packetSize; ++lane)
+		{
+			originX[lane] = 0.0f;
+			originY[lane] = 0.0f;
+			inverseX[lane] = 0.0f;
+			inverseY[lane] = 0.0f;
+			maxFractions[lane] = 1.0f;
+
+			if (lane >= laneCount)
+			{
+				continue;
+			}
+
+			int32 i = first + lane;
+			hitCounts[i] = 0;
+
+			// Like WorldSnapshot::RayCast, a zero length ray hits nothing.
+			b2Vec2 d = batch.points2[i] - batch.points1[i];
+			if (d.LengthSquared() <= 0.0f)
+			{
+				continue;
+			}
+
+			originX[lane] = batch.points1[i].x;
+			originY[lane] = batch.points1[i].y;
+			inverseX[lane] = SafeInverse(d.x);
+			inverseY[lane] = SafeInverse(d.y);
+			active |= 1 << lane;
+		}
+
+		if (active == 0 || root == b2_nullNode)
+		{
+			continue;
+		}
+
+		Float4 ox = Simd4Load(originX);
+		Float4 oy = Simd4Load(originY);
+		Float4 ix = Simd4Load(inverseX);
+		Float4 iy = Simd4Load(inverseY);
+
+		// Each entry carries the lanes that reached the node.
+		int32 stackNodes[BATCH_STACK_SIZE];
+		int32 stackLanes[BATCH_STACK_SIZE];
+		int32 count = 0;
+		stackNodes[count] = root;
+		stackLanes[count] = active;
+		++count;
+
+		while (count > 0 && active != 0)
+		{
+			--count;
+			const WorldSnapshot::Node& node = snapshot.GetNode(stackNodes[count]);
+
+			// Closest hits clip the rays, so retest with the current fractions.
+			int32 lanes = stackLanes[count] & active;
+			if (lanes == 0)
+			{
+				continue;
+			}
+
+			Float4 maxFraction = Simd4Load(maxFractions);
+			lanes &= TestRays(node.aabb, ox, oy, ix, iy, maxFraction);
+			if (lanes == 0)
+			{
+				continue;
+			}
+
+			if (node.child1 != b2_nullNode)
+			{
+				// Visit the child nearer the packet's origin first, so the
+				// closest hit is found early and clips the rest of the walk.
+				int32 lane = 0;
+				while ((lanes & (1 << lane)) == 0)
+				{
+					++lane;
+				}
+				b2Vec2 origin(originX[lane], originY[lane]);
+				int32 nearChild = node.child1;
+				int32 farChild = node.child2;
+				b2Vec2 c1 = snapshot.GetNode(nearChild).aabb.GetCenter();
+				b2Vec2 c2 = snapshot.GetNode(farChild).aabb.GetCenter();
+				if (b2DistanceSquared(origin, c2) < b2DistanceSquared(origin, c1))
+				{
+					b2Swap(nearChild, farChild);
+				}
+
+				b2Assert(count + 2 <= BATCH_STACK_SIZE);
+				stackNodes[count] = farChild;
+				stackLanes[count] = lanes;
+				++count;
+				stackNodes[count] = nearChild;
+				stackLanes[count] = lanes;
+				++count;
+				continue;
+			}
+
+			for (int32 j = node.start; j < node.start + node.count; ++j)
+			{
+				const SnapshotProxy& proxy = snapshot.GetProxy(j);
+				int32 proxyLanes = lanes & active;
+				if (proxyLanes == 0)
+				{
+					break;
+				}
+
+				proxyLanes &= TestRays(proxy.aabb, ox, oy, ix, iy, Simd4Load(maxFractions));
+
+				for (int32 lane = 0; lane < k_packetSize; ++lane)
+				{
+					if ((proxyLanes & (1 << lane)) == 0)
+					{
+						continue;
+					}
+
+					// The filter goes first so filtered proxies never pay for a
+					// shape ray cast.
+					int32 i = first + lane;
+					const b2Filter& filter = batch.filters != NULL ? batch.filters[i] : batch.filter;
+					if (ShouldQueryProxy(filter, batch.includeSensors, proxy) == false)
+					{
+						continue;
+					}
+
+					b2RayCastInput input;
+					input.p1 = batch.points1[i];
+					input.p2 = batch.points2[i];
+					input.maxFraction = maxFractions[lane];
+
+					b2RayCastOutput output;
+					if (snapshot.GetShape(proxy)->RayCast(&output, input, proxy.xf, 0) == false)
+					{
+						continue;
+					}
+
+					float32 fraction = output.fraction;
+					RayBatchHit* hit = hits + i * stride + (batch.mode == e_rayMultiple ? hitCounts[i] : 0);
+					hit->proxy = &proxy;
+					hit->point = (1.0f - fraction) * input.p1 + fraction * input.p2;
+					hit->normal = output.normal;
+					hit->fraction = fraction;
+
+					switch (batch.mode)
+					{
+					case e_rayClosest:
+						hitCounts[i] = 1;
+						maxFractions[lane] = fraction;
+						break;
+
+					case e_rayAny:
+						hitCounts[i] = 1;
+						active &= ~(1 << lane);
+						break;
+
+					default:
+						++hitCounts[i];
+						if (hitCounts[i] == batch.maxHits)
+						{
+							active &= ~(1 << lane);
+						}
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+void RayCastBatch(RayBatchHit* hits, int32* hitCounts, const WorldSnapshot& snapshot, const RayBatch& batch)
+{
+	// Ranges are whole packets so only the last one has idle lanes.
+	int32 packetCount = (batch.count + k_packetSize - 1) / k_packetSize;
+	g_jobSystem.ParallelFor(packetCount, k_packetsPerJob, [hits, hitCounts, &snapshot, &batch](int32 begin, int32 end)
+	{
+		RayCastPackets(hits, hitCounts, snapshot, batch, begin * k_packetSize, b2Min(end * k_packetSize, batch.count));
+	});
+}
+
+// Collects the first maxResults proxies that pass the filter.
+class AABBBatchCallback : public SnapshotQueryCallback
+{
+public:
+	AABBBatchCallback(const AABBBatch& batch, const b2Filter& filter, const SnapshotProxy** results) : m_batch(batch), m_filter(filter), m_results(results)
+	{
+		m_count = 0;
+	}
+
+	bool ReportProxy(const SnapshotProxy& proxy) override
+	{
+		if (ShouldQueryProxy(m_filter, m_batch.includeSensors, proxy) == false)
+		{
+			return true;
+		}
+
+		m_results[m_count++] = &proxy;
+		return m_count < m_batch.maxResults;
+	}
+
+	const AABBBatch& m_batch;
+	const b2Filter& m_filter;
+	const SnapshotProxy** m_results;
+	int32 m_count;
+};
+
+void QueryAABBScalar(const SnapshotProxy** results, int32* resultCounts, const WorldSnapshot& snapshot, const AABBBatch& batch, int32 begin, int32 end)
+{
+	b2Assert(batch.maxResults > 0);
+
+	for (int32 i = begin; i < end; ++i)
+	{
+		const b2Filter& filter = batch.filters != NULL ? batch.filters[i] : batch.filter;
+		AABBBatchCallback callback(batch, filter, results + i * batch.maxResults);
+		snapshot.QueryAABB(&callback, batch.aabbs[i]);
+		resultCounts[i] = callback.m_count;
+	}
+}
+
+// Lanes whose box overlaps aabb, as bits.
+static int32 TestBoxes(const b2AABB& aabb, Float4 lowerX, Float4 lowerY, Float4 upperX, Float4 upperY)
+{
+	Float4 miss = (Simd4Set(aabb.lowerBound.x) > upperX) | (lowerX > Simd4Set(aabb.upperBound.x))
+		| (Simd4Set(aabb.lowerBound.y) > upperY) | (lowerY > Simd4Set(aabb.upperBound.y));
+	return ~Simd4MaskBits(miss) & 0xF;
+}
+
+void QueryAABBPackets(const SnapshotProxy** results, int32* resultCounts, const WorldSnapshot& snapshot, const AABBBatch& batch, int32 begin, int32 end)
+{
+	b2Assert(batch.maxResults > 0);
+
+	int32 root = snapshot.GetRoot();
+
+	for (int32 first = begin; first < end; first += k_packetSize)
+	{
+		int32 laneCount = b2Min(k_packetSize, end - first);
+
+		// Idle lanes get an inverted box that overlaps nothing.
+		float32 lowerX[k_packetSize];
+		float32 lowerY[k_packetSize];
+		float32 upperX[k_packetSize];
+		float32 upperY[k_packetSize];
+		int32 active = 0;
+
+		for (int32 lane = 0; lane < k_packetSize; ++lane)
+		{
+			if (lane >= laneCount)
+			{
+				lowerX[lane] = lowerY[lane] = b2_maxFloat;
+				upperX[lane] = upperY[lane] = -b2_maxFloat;
+				continue;
+			}
+
+			const b2AABB& aabb = batch.aabbs[first + lane];
+			lowerX[lane] = aabb.lowerBound.x;
+			lowerY[lane] = aabb.lowerBound.y;
+			upperX[lane] = aabb.upperBound.x;
+			upperY[lane] = aabb.upperBound.y;
+			resultCounts[first + lane] = 0;
+			active |= 1 << lane;
+		}
+
+		if (root == b2_nullNode)
+		{
+			continue;
+		}
+
+		Float4 lx = Simd4Load(lowerX);
+		Float4 ly = Simd4Load(lowerY);
+		Float4 ux = Simd4Load(upperX);
+		Float4 uy = Simd4Load(upperY);
+
+		int32 stackNodes[BATCH_STACK_SIZE];
+		int32 stackLanes[BATCH_STACK_SIZE];
+		int32 count = 0;
+		stackNodes[count] = root;
+		stackLanes[count] = active;
+		++count;
+
+		while (count > 0 && active != 0)
+		{
+			--count;
+			const WorldSnapshot::Node& node = snapshot.GetNode(stackNodes[count]);
+			int32 lanes = stackLanes[count] & active & TestBoxes(node.aabb, lx, ly, ux, uy);
+			if (lanes == 0)
+			{
+				continue;
+			}
+
+			if (node.child1 != b2_nullNode)
+			{
+				b2Assert(count + 2 <= BATCH_STACK_SIZE);
+				stackNodes[count] = node.child1;
+				stackLanes[count] = lanes;
+				++count;
+				stackNodes[count] = node.child2;
+				stackLanes[count] = lanes;
+				++count;
+				continue;
+			}
+
+			for (int32 j = node.start; j < node.start + node.count; ++j)
+			{
+				const SnapshotProxy& proxy = snapshot.GetProxy(j);
+				int32 proxyLanes = lanes & active & TestBoxes(proxy.aabb, lx, ly, ux, uy);
+
+				for (int32 lane = 0; lane < k_packetSize; ++lane)
+				{
+					if ((proxyLanes & (1 << lane)) == 0)
+					{
+						continue;
+					}
+
+					int32 i = first + lane;
+					const b2Filter& filter = batch.filters != NULL ? batch.filters[i] : batch.filter;
+					if (ShouldQueryProxy(filter, batch.includeSensors, proxy) == false)
+					{
+						continue;
+					}
+
+					results[i * batch.maxResults + resultCounts[i]] = &proxy;
+					++resultCounts[i];
+					if (resultCounts[i] == batch.maxResults)
+					{
+						active &= ~(1 << lane);
+					}
+				}
+			}
+		}
+	}
+}
+
+void QueryAABBBatch(const SnapshotProxy** results, int32* resultCounts, const WorldSnapshot& snapshot, const AABBBatch& batch)
+{
+	int32 packetCount = (batch.count + k_packetSize - 1) / k_packetSize;
+	g_jobSystem.ParallelFor(packetCount, k_packetsPerJob, [results, resultCounts, &snapshot, &batch](int32 begin, int32 end)
+	{
+		QueryAABBPackets(results, resultCounts, snapshot, batch, begin * k_packetSize, b2Min(end * k_packetSize, batch.count));
+	});
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "WorldSnapshot.h"
+
+// What a ray reports, after the three ray-cast callbacks of the RayCast test:
+// the closest hit, any hit (for obstruction checks), or the first maxHits
+// hits in traversal order, which are not sorted along the ray.
+enum RayBatchMode
+{
+	e_rayClosest,
+	e_rayAny,
+	e_rayMultiple
+};
+
+// Many ray casts against one snapshot, given as parallel arrays: ray i runs
+// from points1[i] to points2[i]. A proxy is only reported to ray i if it
+// passes filters[i], or filter when filters is null, under the rules of
+// b2ContactFilter. The query filter acts like a fixture: its categoryBits
+// must be in the proxy's maskBits and its maskBits must include the proxy's
+// categoryBits, and a shared non-zero group always (positive) or never
+// (negative) passes.
+struct RayBatch
+{
+	RayBatch();
+
+	const b2Vec2* points1;
+	const b2Vec2* points2;
+	const b2Filter* filters;
+	b2Filter filter;
+	int32 count;
+	RayBatchMode mode;
+
+	// Hits kept per ray in e_rayMultiple; the other modes keep one.
+	int32 maxHits;
+	bool includeSensors;
+};
+
+struct RayBatchHit
+{
+	const SnapshotProxy* proxy;
+	b2Vec2 point;
+	b2Vec2 normal;
+	float32 fraction;
+};
+
+// Many AABB queries against one snapshot. Box i reports the first
+// maxResults proxies that overlap aabbs[i] and pass its filter, which works
+// as in RayBatch.
+struct AABBBatch
+{
+	AABBBatch();
+
+	const b2AABB* aabbs;
+	const b2Filter* filters;
+	b2Filter filter;
+	int32 count;
+	int32 maxResults;
+	bool includeSensors;
+};
+
+// Whether a query with this filter reports the proxy.
+bool ShouldQueryProxy(const b2Filter& filter, bool includeSensors, const SnapshotProxy& proxy);
+
+// The outputs for ray i are hits[i * stride, i * stride + hitCounts[i]),
+// where stride is batch.maxHits in e_rayMultiple and 1 otherwise. Every
+// function below fills rays [begin, end) or the whole batch.
+
+// One WorldSnapshot::RayCast per ray with a callback that filters, like the
+// RayCast test does. This is the reference the packets are measured against.
+void RayCastScalar(RayBatchHit* hits, int32* hitCounts, const WorldSnapshot& snapshot, const RayBatch& batch, int32 begin, int32 end);
+
+// Rays in packets of four consecutive rays that walk the tree together: a
+// node is visited once per packet and its box is tested against all four
+// rays at once, and the filter is checked before a proxy's shape is ray
+// cast. Packets pay off when neighbouring rays in the batch go the same
+// way, as in a fan or a grid of parallel rays; give scattered rays in an
+// order that groups them. Closest hits match RayCastScalar's.
+void RayCastPackets(RayBatchHit* hits, int32* hitCounts, const WorldSnapshot& snapshot, const RayBatch& batch, int32 begin, int32 end);
+
+// RayCastPackets over the whole batch, split across g_jobSystem.
+void RayCastBatch(RayBatchHit* hits, int32* hitCounts, const WorldSnapshot& snapshot, const RayBatch& batch);
+
+// The results for box i are results[i * batch.maxResults] onwards,
+// resultCounts[i] of them.
+void QueryAABBScalar(const SnapshotProxy** results, int32* resultCounts, const WorldSnapshot& snapshot, const AABBBatch& batch, int32 begin, int32 end);
+void QueryAABBPackets(const SnapshotProxy** results, int32* resultCounts, const WorldSnapshot& snapshot, const AABBBatch& batch, int32 begin, int32 end);
+void QueryAABBBatch(const SnapshotProxy** results, int32* resultCounts, const WorldSnapshot& snapshot, const AABBBatch& batch);
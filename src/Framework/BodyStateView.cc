@@ -0,0 +1,227 @@
+#include "BodyStateView.h"
+#include "JobSystem.h"
+#include "WorldChecksum.h"
+
+BodyStateView::BodyStateView()
+{
+	m_stamp = 0;
+	m_refreshTime = 0.0f;
+	m_applyTime = 0.0f;
+}
+
+void BodyStateView::Clear()
+{
+	m_indices.clear();
+	m_bodies.clear();
+	m_transforms.clear();
+	m_angles.clear();
+	m_linearVelocities.clear();
+	m_angularVelocities.clear();
+	m_flags.clear();
+	m_generations.clear();
+	m_signatures.clear();
+	m_stamps.clear();
+	m_positions.clear();
+	m_order.clear();
+	m_nextOrder.clear();
+	m_free.clear();
+}
+
+int32 BodyStateView::GetIndex(const b2Body* body) const
+{
+	std::unordered_map<const b2Body*, int32>::const_iterator it = m_indices.find(body);
+	return it != m_indices.end() ? it->second : -1;
+}
+
+int32 BodyStateView::AddBody(b2Body* body)
+{
+	int32 index;
+	if (m_free.empty() == false)
+	{
+		index = m_free.back();
+		m_free.pop_back();
+	}
+	else
+	{
+		index = (int32)m_bodies.size();
+		m_bodies.push_back(NULL);
+		m_transforms.push_back(b2Transform());
+		m_transforms.back().SetIdentity();
+		m_angles.push_back(0.0f);
+		m_linearVelocities.push_back(b2Vec2_zero);
+		m_angularVelocities.push_back(0.0f);
+		m_flags.push_back(0);
+		m_generations.push_back(0);
+		m_signatures.push_back(0);
+		m_stamps.push_back(0);
+		m_positions.push_back(-1);
+	}
+
+	m_bodies[index] = body;
+	++m_generations[index];
+	m_signatures[index] = ComputeFixtureSignature(body);
+	m_indices[body] = index;
+	return index;
+}
+
+void BodyStateView::Refresh(b2World* world)
+{
+	b2Timer timer;
+	++m_stamp;
+
+	// New bodies go to the head of the list and destroyed ones are unlinked
+	// in place, so the list keeps the order of the last refresh between the
+	// changes. Where it differs, a lookup finds the body and the match
+	// picks up again after its old position.
+	int32 orderCount = (int32)m_order.size();
+	int32 next = 0;
+	m_nextOrder.resize(0);
+	for (b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+	{
+		int32 index;
+		if (next < orderCount && m_bodies[m_order[next]] == body)
+		{
+			index = m_order[next++];
+		}
+		else
+		{
+			index = GetIndex(body);
+			if (index == -1)
+			{
+				index = AddBody(body);
+			}
+			else
+			{
+				next = m_positions[index] + 1;
+			}
+		}
+
+		m_stamps[index] = m_stamp;
+		m_positions[index] = (int32)m_nextOrder.size();
+		m_nextOrder.push_back(index);
+	}
+
+	for (int32 i = 0; i < orderCount; ++i)
+	{
+		int32 index = m_order[i];
+		if (m_stamps[index] != m_stamp)
+		{
+			m_indices.erase(m_bodies[index]);
+			m_bodies[index] = NULL;
+			m_flags[index] = 0;
+			m_positions[index] = -1;
+			m_free.push_back(index);
+		}
+	}
+
+	m_order.swap(m_nextOrder);
+
+	// Bodies are read in place, so a range per worker hides some of the
+	// cache misses of getting at them.
+	g_jobSystem.ParallelFor((int32)m_order.size(), 1024, [this](int32 begin, int32 end)
+	{
+		CopyStates(begin, end);
+	});
+
+	m_refreshTime = timer.GetMilliseconds();
+}
+
+void BodyStateView::CopyStates(int32 begin, int32 end)
+{
+	for (int32 i = begin; i < end; ++i)
+	{
+		int32 index = m_order[i];
+		const b2Body* body = m_bodies[index];
+
+		// Another body at the same address: the slot is a new body's now.
+		uint32 signature = ComputeFixtureSignature(body);
+		if (signature != m_signatures[index])
+		{
+			m_signatures[index] = signature;
+			++m_generations[index];
+		}
+
+		m_transforms[index] = body->GetTransform();
+		m_angles[index] = body->GetAngle();
+		m_linearVelocities[index] = body->GetLinearVelocity();
+		m_angularVelocities[index] = body->GetAngularVelocity();
+
+		uint8 flags = e_live;
+		if (body->IsAwake())
+		{
+			flags |= e_awake;
+		}
+
+		switch (body->GetType())
+		{
+		case b2_staticBody:
+			flags |= e_static;
+			break;
+
+		case b2_kinematicBody:
+			flags |= e_kinematic;
+			break;
+
+		default:
+			flags |= e_dynamic;
+			break;
+		}
+
+		m_flags[index] = flags;
+	}
+}
+
+int32 BodyStateView::ApplyKinematicTargets(const KinematicTarget* targets, int32 count, float32 timeStep)
+{
+	b2Timer timer;
+
+	float32 inv_dt = timeStep > 0.0f ? 1.0f / timeStep : 0.0f;
+	int32 capacity = GetCapacity();
+	int32 moved = 0;
+	for (int32 i = 0; i < count; ++i)
+	{
+		const KinematicTarget& target = targets[i];
+		int32 index = target.index;
+		if (index < 0 || index >= capacity || (m_flags[index] & e_kinematic) == 0)
+		{
+			continue;
+		}
+
+		b2Body* body = m_bodies[index];
+		if (timeStep > 0.0f)
+		{
+			// The solver moves the center of mass, so aim that at where the
+			// target pose puts it.
+			const b2Transform& xf = m_transforms[index];
+			b2Vec2 localCenter = body->GetLocalCenter();
+			b2Vec2 center = b2Mul(xf, localCenter);
+			b2Vec2 targetCenter = target.position + b2Mul(b2Rot(target.angle), localCenter);
+
+			m_linearVelocities[index] = inv_dt * (targetCenter - center);
+			m_angularVelocities[index] = inv_dt * (target.angle - m_angles[index]);
+		}
+		else
+		{
+			if (target.position != m_transforms[index].p || target.angle != m_angles[index])
+			{
+				body->SetTransform(target.position, target.angle);
+				m_transforms[index] = body->GetTransform();
+				m_angles[index] = target.angle;
+			}
+
+			m_linearVelocities[index] = target.linearVelocity;
+			m_angularVelocities[index] = target.angularVelocity;
+		}
+
+		body->SetLinearVelocity(m_linearVelocities[index]);
+		body->SetAngularVelocity(m_angularVelocities[index]);
+		if (body->IsAwake())
+		{
+			m_flags[index] |= e_awake;
+		}
+		++moved;
+	}
+
+	m_applyTime = timer.GetMilliseconds();
+	return moved;
+}
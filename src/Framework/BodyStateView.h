@@ -0,0 +1,107 @@
+#pragma once
+#include "Box2D/Box2D.h"
+#include <unordered_map>
+#include <vector>
+
+// A kinematic body's pose and velocities for BodyStateView::ApplyKinematicTargets.
+struct KinematicTarget
+{
+	int32 index;
+	b2Vec2 position;
+	float32 angle;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+};
+
+// The transforms and velocities of a world's bodies as flat arrays, so that
+// renderers, networking and AI read them without walking the body list or
+// calling into every body. Each body gets a slot when it is first seen and
+// keeps it for as long as it lives; the slots of destroyed bodies are reused,
+// and a slot's generation goes up each time it is. Every array has
+// GetCapacity() entries; free slots have zero flags.
+//
+// Refresh once per step, after b2World::Step. The arrays are then valid
+// until the next refresh. The walk matches the body list against the order
+// of the last refresh, so a world whose bodies did not change needs no
+// lookups; the copying and the signature checks are split across the job
+// system.
+//
+// Bodies are found by their address. Box2D hands a destroyed body's memory
+// to the next one it creates, so each refresh also checks the fixture
+// signature (see ComputeFixtureSignature) of every body. When it changed,
+// the slot's generation goes up as for a new body. A body that gains or
+// loses fixtures is treated the same way; one remade with equal shapes at
+// the same fixture addresses cannot be told apart.
+class BodyStateView
+{
+public:
+	enum
+	{
+		e_live = 0x01,
+		e_awake = 0x02,
+		e_static = 0x04,
+		e_kinematic = 0x08,
+		e_dynamic = 0x10
+	};
+
+	BodyStateView();
+
+	void Refresh(b2World* world);
+
+	// Forgets all bodies, as for a new world.
+	void Clear();
+
+	// Moves the targets' kinematic bodies in one pass. With timeStep > 0
+	// each body gets the velocities that carry it to the target pose over a
+	// step of that length, so contacts see the motion, and the targets'
+	// velocities are ignored. With timeStep 0 each body is placed at the
+	// target with the target's velocities. Targets for free slots and for
+	// bodies that are not kinematic are skipped. The view is updated to
+	// match. Call between a refresh and the next body destruction. Returns
+	// the number of bodies moved.
+	int32 ApplyKinematicTargets(const KinematicTarget* targets, int32 count, float32 timeStep);
+
+	int32 GetCapacity() const { return (int32)m_bodies.size(); }
+	int32 GetBodyCount() const { return (int32)m_order.size(); }
+
+	const b2Transform* GetTransforms() const { return m_transforms.data(); }
+	const float32* GetAngles() const { return m_angles.data(); }
+	const b2Vec2* GetLinearVelocities() const { return m_linearVelocities.data(); }
+	const float32* GetAngularVelocities() const { return m_angularVelocities.data(); }
+	const uint8* GetFlags() const { return m_flags.data(); }
+	const uint32* GetGenerations() const { return m_generations.data(); }
+
+	// Slots of the live bodies in body list order.
+	const int32* GetOrder() const { return m_order.data(); }
+
+	// The body in a slot, or NULL for a free slot.
+	b2Body* GetBody(int32 index) const { return m_bodies[index]; }
+
+	// The body's slot, or -1 if the last refresh did not see it.
+	int32 GetIndex(const b2Body* body) const;
+
+	float32 GetRefreshTime() const { return m_refreshTime; }
+	float32 GetApplyTime() const { return m_applyTime; }
+
+private:
+	int32 AddBody(b2Body* body);
+	void CopyStates(int32 begin, int32 end);
+
+	std::unordered_map<const b2Body*, int32> m_indices;
+	std::vector<b2Body*> m_bodies;
+	std::vector<b2Transform> m_transforms;
+	std::vector<float32> m_angles;
+	std::vector<b2Vec2> m_linearVelocities;
+	std::vector<float32> m_angularVelocities;
+	std::vector<uint8> m_flags;
+	std::vector<uint32> m_generations;
+	std::vector<uint32> m_signatures;
+	std::vector<int32> m_stamps;
+	std::vector<int32> m_positions;
+	std::vector<int32> m_order;
+	std::vector<int32> m_nextOrder;
+	std::vector<int32> m_free;
+	int32 m_stamp;
+	float32 m_refreshTime;
+	float32 m_applyTime;
+};
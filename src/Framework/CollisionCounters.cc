@@ -0,0 +1,175 @@
+#include "CollisionCounters.h"
+#include <atomic>
+#include <mutex>
+
+// Defined in b2Distance.cpp and b2TimeOfImpact.cpp.
+extern int32 b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
+extern int32 b2_toiCalls, b2_toiIters, b2_toiMaxIters;
+extern int32 b2_toiRootIters, b2_toiMaxRootIters;
+extern float32 b2_toiTime, b2_toiMaxTime;
+
+// Scope bookkeeping, and every read and write of the globals by the
+// scopes, happens under this lock.
+static std::mutex s_mutex;
+static int32 s_activeScopes = 0;
+static uint32 s_scopeGeneration = 0;
+static CollisionCounters s_outside;
+
+static std::atomic<int32> s_concurrentScopes(0);
+static std::atomic<uint32> s_concurrentGeneration(0);
+
+CollisionCounters::CollisionCounters()
+{
+	Reset();
+}
+
+void CollisionCounters::Reset()
+{
+	gjkCalls = 0;
+	gjkIters = 0;
+	gjkMaxIters = 0;
+	toiCalls = 0;
+	toiCallsWithoutIters = 0;
+	toiIters = 0;
+	toiMaxIters = 0;
+	toiRootIters = 0;
+	toiMaxRootIters = 0;
+	toiTime = 0.0f;
+	toiMaxTime = 0.0f;
+	exact = true;
+}
+
+void CollisionCounters::Add(const CollisionCounters& other)
+{
+	gjkCalls += other.gjkCalls;
+	gjkIters += other.gjkIters;
+	gjkMaxIters = b2Max(gjkMaxIters, other.gjkMaxIters);
+	toiCalls += other.toiCalls;
+	toiCallsWithoutIters += other.toiCallsWithoutIters;
+	toiIters += other.toiIters;
+	toiMaxIters = b2Max(toiMaxIters, other.toiMaxIters);
+	toiRootIters += other.toiRootIters;
+	toiMaxRootIters = b2Max(toiMaxRootIters, other.toiMaxRootIters);
+	toiTime += other.toiTime;
+	toiMaxTime = b2Max(toiMaxTime, other.toiMaxTime);
+	exact = exact && other.exact;
+}
+
+static void ReadGlobals(CollisionCounters* counters)
+{
+	counters->gjkCalls = b2_gjkCalls;
+	counters->gjkIters = b2_gjkIters;
+	counters->gjkMaxIters = b2_gjkMaxIters;
+	counters->toiCalls = b2_toiCalls;
+	counters->toiIters = b2_toiIters;
+	counters->toiMaxIters = b2_toiMaxIters;
+	counters->toiRootIters = b2_toiRootIters;
+	counters->toiMaxRootIters = b2_toiMaxRootIters;
+	counters->toiTime = b2_toiTime;
+	counters->toiMaxTime = b2_toiMaxTime;
+}
+
+static void WriteGlobals(const CollisionCounters& counters)
+{
+	b2_gjkCalls = counters.gjkCalls;
+	b2_gjkIters = counters.gjkIters;
+	b2_gjkMaxIters = counters.gjkMaxIters;
+	b2_toiCalls = counters.toiCalls;
+	b2_toiIters = counters.toiIters;
+	b2_toiMaxIters = counters.toiMaxIters;
+	b2_toiRootIters = counters.toiRootIters;
+	b2_toiMaxRootIters = counters.toiMaxRootIters;
+	b2_toiTime = counters.toiTime;
+	b2_toiMaxTime = counters.toiMaxTime;
+}
+
+CollisionCounterScope::CollisionCounterScope(CollisionCounters* counters)
+{
+	m_counters = counters;
+
+	std::lock_guard<std::mutex> lock(s_mutex);
+	if (s_activeScopes == 0)
+	{
+		ReadGlobals(&s_outside);
+		CollisionCounters zero;
+		WriteGlobals(zero);
+	}
+
+	m_alone = s_activeScopes == 0 && s_concurrentScopes.load(std::memory_order_acquire) == 0;
+	++s_activeScopes;
+	m_generation = ++s_scopeGeneration;
+	m_concurrentGeneration = s_concurrentGeneration.load(std::memory_order_acquire);
+	ReadGlobals(&m_start);
+}
+
+CollisionCounterScope::~CollisionCounterScope()
+{
+	CollisionCounters captured;
+	{
+		std::lock_guard<std::mutex> lock(s_mutex);
+		ReadGlobals(&captured);
+
+		bool exact = m_alone && s_scopeGeneration == m_generation
+			&& s_concurrentGeneration.load(std::memory_order_acquire) == m_concurrentGeneration
+			&& s_concurrentScopes.load(std::memory_order_acquire) == 0;
+
+		--s_activeScopes;
+		if (s_activeScopes == 0)
+		{
+			// Nobody else measures from the zeroed globals any more.
+			CollisionCounters totals = s_outside;
+			totals.Add(captured);
+			WriteGlobals(totals);
+		}
+
+		// A lone scope started from zero, so its maxima are its own; for
+		// the others they cover everything since the first scope started.
+		captured.gjkCalls -= m_start.gjkCalls;
+		captured.gjkIters -= m_start.gjkIters;
+		captured.toiCalls -= m_start.toiCalls;
+		captured.toiIters -= m_start.toiIters;
+		captured.toiRootIters -= m_start.toiRootIters;
+		captured.toiTime -= m_start.toiTime;
+		captured.exact = exact;
+	}
+
+	m_counters->Add(captured);
+}
+
+ConcurrentCollisionScope::ConcurrentCollisionScope()
+{
+	s_concurrentScopes.fetch_add(1, std::memory_order_acq_rel);
+	s_concurrentGeneration.fetch_add(1, std::memory_order_acq_rel);
+}
+
+ConcurrentCollisionScope::~ConcurrentCollisionScope()
+{
+	s_concurrentScopes.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void CountedStep(b2World* world, float32 timeStep, int32 velocityIterations, int32 positionIterations, CollisionCounters* counters)
+{
+	CollisionCounterScope scope(counters);
+	world->Step(timeStep, velocityIterations, positionIterations);
+}
+
+void CountedDistance(b2DistanceOutput* output, b2SimplexCache* cache, const b2DistanceInput* input, CollisionCounters* counters)
+{
+	b2Distance(output, cache, input);
+
+	++counters->gjkCalls;
+	counters->gjkIters += output->iterations;
+	counters->gjkMaxIters = b2Max(counters->gjkMaxIters, output->iterations);
+}
+
+void CountedTimeOfImpact(b2TOIOutput* output, const b2TOIInput* input, CollisionCounters* counters)
+{
+	b2Timer timer;
+	b2TimeOfImpact(output, input);
+	float32 time = timer.GetMilliseconds();
+
+	++counters->toiCalls;
+	++counters->toiCallsWithoutIters;
+	counters->toiTime += time;
+	counters->toiMaxTime = b2Max(counters->toiMaxTime, time);
+}
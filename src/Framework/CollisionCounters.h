@@ -0,0 +1,95 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+// GJK and time of impact statistics for one world (or any other owner).
+// Box2D keeps these in process-wide globals (b2_gjkCalls, b2_toiIters, ...)
+// that every world and thread updates at once; CollisionCounters.cc is the
+// only code in the testbed that touches them.
+//
+// Box2D is not patched here, so it still bumps the globals without any
+// synchronization. Counts taken from them are only exact while one world
+// steps at a time and no other thread runs b2Distance or b2TimeOfImpact.
+// With several worlds stepping at once, the updates race inside Box2D itself
+// and can be lost, whatever this file does. Such counts are marked inexact.
+// Only the CountedDistance and CountedTimeOfImpact blocks stay exact then.
+struct CollisionCounters
+{
+	CollisionCounters();
+
+	void Reset();
+
+	// Sums the counts and keeps the larger maxima.
+	void Add(const CollisionCounters& other);
+
+	int32 gjkCalls;
+	int32 gjkIters;
+	int32 gjkMaxIters;
+	int32 toiCalls;
+
+	// Calls made through CountedTimeOfImpact, which cannot see the root
+	// finder's iterations. The iteration sums and maxima cover only the
+	// other toiCalls - toiCallsWithoutIters calls.
+	int32 toiCallsWithoutIters;
+
+	int32 toiIters;
+	int32 toiMaxIters;
+	int32 toiRootIters;
+	int32 toiMaxRootIters;
+	float32 toiTime;
+	float32 toiMaxTime;
+
+	// False if the numbers may include work that was not the scope's own:
+	// another scope or a ConcurrentCollisionScope ran at the same time.
+	bool exact;
+};
+
+// Attributes the Box2D globals' activity between construction and
+// destruction to one counter block, as the difference between the globals
+// at either end. The first scope to start sets the process totals aside
+// and zeroes the globals, which makes a lone scope's maxima exact too; the
+// last one to finish puts the totals back with the work added, so code
+// reading the globals outside any scope still sees process totals. No
+// other scope writes them, so scopes on different threads may overlap and
+// keep their sums; the sums then include each other's work, the maxima are
+// shared, and the counters are marked inexact. The mutex only orders the
+// scopes among themselves; it does not stop Box2D writing the globals from
+// other threads meanwhile.
+class CollisionCounterScope
+{
+public:
+	explicit CollisionCounterScope(CollisionCounters* counters);
+	~CollisionCounterScope();
+
+private:
+	CollisionCounters* m_counters;
+	CollisionCounters m_start;
+	uint32 m_generation;
+	uint32 m_concurrentGeneration;
+	bool m_alone;
+};
+
+// Brackets b2Distance and b2TimeOfImpact calls made off the thread that
+// steps the world, such as job workers. Box2D bumps its global counters
+// from every calling thread without synchronization, so such calls add to,
+// and may lose updates of, whatever a CollisionCounterScope is measuring;
+// the scopes they overlap are marked inexact. Count the work itself with
+// CountedDistance and CountedTimeOfImpact.
+class ConcurrentCollisionScope
+{
+public:
+	ConcurrentCollisionScope();
+	~ConcurrentCollisionScope();
+};
+
+// Steps the world and adds its GJK/TOI work to counters.
+void CountedStep(b2World* world, float32 timeStep, int32 velocityIterations, int32 positionIterations, CollisionCounters* counters);
+
+// b2Distance and b2TimeOfImpact for code running on worker threads, inside
+// a ConcurrentCollisionScope. They count into a block private to the
+// calling thread instead of relying on the globals, so they are exact under
+// any amount of parallelism; merge the blocks with Add once the threads are
+// done. Iteration counts of the TOI root finder are only available from
+// the globals, so these only report TOI calls and times, counted in
+// toiCallsWithoutIters, plus the GJK work b2Distance reports itself.
+void CountedDistance(b2DistanceOutput* output, b2SimplexCache* cache, const b2DistanceInput* input, CollisionCounters* counters);
+void CountedTimeOfImpact(b2TOIOutput* output, const b2TOIInput* input, CollisionCounters* counters);
@@ -248,6 +248,9 @@ void DebugDraw::DrawPoint(const b2Vec2& p, float32 size, const b2Color& color)
 //
 void DebugDraw::DrawString(int x, int y, const char *string, ...)
 {
+	if (!enabled)
+		return;
+
 	va_list arg;
 	va_start(arg, string);
 	ImGui::Begin("Overlay", NULL, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoScrollbar);
@@ -260,6 +263,9 @@ void DebugDraw::DrawString(int x, int y, const char *string, ...)
 //
 void DebugDraw::DrawString(const b2Vec2& pw, const char *string, ...)
 {
+	if (!enabled)
+		return;
+
 	auto ps = g_camera.ConvertWorldToScreen({ pw.x,pw.y });
 
 	va_list arg;
@@ -387,6 +393,8 @@ void DebugDraw::Discard()
 
 void DebugDraw::Render(const glm::mat4 & mvpMatrix)
 {
+	if (!enabled)
+		return;
 	DebugGeometryShader::vsParams params{ mvpMatrix };
 	if (!triangles.Empty()) {
 		Gfx::UpdateVertices(this->drawState[0].Mesh[0], this->triangles.begin(), this->triangles.Size() * sizeof(vertex_t));
@@ -413,18 +421,18 @@ void DebugDraw::Render(const glm::mat4 & mvpMatrix)
 
 void DebugDraw::LineVertex(const b2Vec2 & position, const b2Color & color)
 {
-	if (lines.Size() < MaxNumLineVertices)
+	if (enabled && lines.Size() < MaxNumLineVertices)
 		lines.Add({ position.x,position.y,Color(color).value });
 }
 
 void DebugDraw::TriangleVertex(const b2Vec2 & position, const b2Color & color)
 {
-	if (triangles.Size() < MaxNumTriangleVertices)
+	if (enabled && triangles.Size() < MaxNumTriangleVertices)
 		triangles.Add({ position.x,position.y,Color(color).value });
 }
 
 void DebugDraw::PointVertex(const b2Vec2 & position, const b2Color & color, float32 size)
 {
-	if (points.Size() < MaxNumPointVertices)
+	if (enabled && points.Size() < MaxNumPointVertices)
 		points.Add({ position.x,position.y,size/g_camera.Zoom,Color(color).value });
 }
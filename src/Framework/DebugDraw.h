@@ -79,6 +79,9 @@ public:
 	void DrawAABB(b2AABB* aabb, const b2Color& color);
 
 	void Render(const glm::mat4 & mvpMatrix);
+	//While disabled nothing is drawn and Gfx and ImGui are never touched, so tests can run without a window.
+	void SetEnabled(bool flag) { enabled = flag; }
+	bool IsEnabled() const { return enabled; }
 
 private:
 	struct instance_t {
@@ -92,6 +95,7 @@ private:
 	};
 	Oryol::DrawState drawState[3];
 	Oryol::ResourceLabel label;
+	bool enabled = true;
 	Oryol::Array<vertex_t> lines;
 	Oryol::Array<vertex_t> triangles;
 	Oryol::Array<instance_t> points;
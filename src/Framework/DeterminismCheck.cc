@@ -0,0 +1,73 @@
+#include "DeterminismCheck.h"
+#include <cstdio>
+#include <vector>
+
+const int32 k_determinismWorkerCounts[k_determinismRunCount] = { 1, 4, 16 };
+
+// Steps a fresh instance of the scene and records its checksums.
+static void RunScene(const TestEntry* entry, const Settings& settings, int32 workerCount, std::vector<uint32>* checksums)
+{
+	g_jobSystem.Setup(workerCount);
+
+	Settings runSettings = MakeHeadlessSettings(settings);
+	runSettings.workerCount = workerCount;
+	runSettings.enableParallelTOI = true;
+
+	Test* test = entry->createFcn();
+	for (int32 i = 0; i < (int32)checksums->size(); ++i)
+	{
+		test->Step(&runSettings);
+		(*checksums)[i] = test->GetChecksum();
+	}
+	delete test;
+}
+
+int32 RunDeterminismCheck(const Settings& settings, int32 stepCount)
+{
+	HeadlessDrawScope drawScope;
+
+	std::vector<uint32> reference(stepCount);
+	std::vector<uint32> checksums(stepCount);
+
+	int32 sceneCount = 0;
+	int32 failureCount = 0;
+	for (const TestEntry* entry = g_testEntries; entry->createFcn != NULL; ++entry)
+	{
+		RunScene(entry, settings, k_determinismWorkerCounts[0], &reference);
+
+		int32 mismatchStep = -1;
+		int32 mismatchWorkers = 0;
+		for (int32 run = 1; run < k_determinismRunCount && mismatchStep < 0; ++run)
+		{
+			RunScene(entry, settings, k_determinismWorkerCounts[run], &checksums);
+			for (int32 i = 0; i < stepCount; ++i)
+			{
+				if (checksums[i] != reference[i])
+				{
+					mismatchStep = i;
+					mismatchWorkers = k_determinismWorkerCounts[run];
+					break;
+				}
+			}
+		}
+
+		uint32 last = stepCount > 0 ? reference[stepCount - 1] : 0;
+		if (mismatchStep < 0)
+		{
+			printf("%-32s %08x ok\n", entry->name, last);
+		}
+		else
+		{
+			printf("%-32s %08x differs at step %d with %d workers\n", entry->name, last, mismatchStep + 1, mismatchWorkers);
+			++failureCount;
+		}
+		fflush(stdout);
+		++sceneCount;
+	}
+
+	printf("%d of %d scenes stepped identically with 1, 4 and 16 workers over %d steps\n",
+		sceneCount - failureCount, sceneCount, stepCount);
+
+	g_jobSystem.Setup(settings.workerCount);
+	return failureCount;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "Test.h"
+
+// Runs every scene in g_testEntries for stepCount steps once per entry of
+// k_determinismWorkerCounts, with Parallel TOI on so the workers have
+// something to do, and compares each step's checksum with the first run.
+// Drawing is switched off meanwhile, so no window is needed. One line per
+// scene goes to stdout. Returns the number of scenes that differed; the
+// job system is left set up for settings.workerCount.
+const int32 k_determinismRunCount = 3;
+extern const int32 k_determinismWorkerCounts[k_determinismRunCount];
+
+int32 RunDeterminismCheck(const Settings& settings, int32 stepCount);
@@ -0,0 +1,346 @@
+#include "InputRecording.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* const k_eventNames[InputRecording::e_eventTypeCount] =
+{
+	"mousedown",
+	"shiftmousedown",
+	"mouseup",
+	"mousemove",
+	"bomb",
+	"keydown",
+	"keyup"
+};
+
+InputRecording::InputRecording()
+{
+}
+
+void InputRecording::Begin(const char* testName, const Settings& settings)
+{
+	m_testName = testName;
+	m_settings = settings;
+	m_events.resize(0);
+	m_timer.Reset();
+}
+
+void InputRecording::Add(const Event& event)
+{
+	// Replay sends events in file order, so they must not go back in steps.
+	b2Assert(m_events.empty() || m_events.back().step <= event.step);
+	m_events.push_back(event);
+}
+
+void InputRecording::AddMouse(int32 step, EventType type, const b2Vec2& point)
+{
+	Event event;
+	event.step = step;
+	event.time = 0.001f * m_timer.GetMilliseconds();
+	event.type = type;
+	event.key = 0;
+	event.point = point;
+	Add(event);
+}
+
+void InputRecording::AddKey(int32 step, EventType type, int32 key)
+{
+	Event event;
+	event.step = step;
+	event.time = 0.001f * m_timer.GetMilliseconds();
+	event.type = type;
+	event.key = key;
+	event.point.SetZero();
+	Add(event);
+}
+
+int32 InputRecording::GetLastStep() const
+{
+	return m_events.empty() ? -1 : m_events.back().step;
+}
+
+void InputRecording::ApplySettings(Settings* settings) const
+{
+	settings->hz = m_settings.hz;
+	settings->velocityIterations = m_settings.velocityIterations;
+	settings->positionIterations = m_settings.positionIterations;
+	settings->enableWarmStarting = m_settings.enableWarmStarting;
+	settings->enableContinuous = m_settings.enableContinuous;
+	settings->enableSubStepping = m_settings.enableSubStepping;
+	settings->enableSleep = m_settings.enableSleep;
+	settings->enableParallelTOI = m_settings.enableParallelTOI;
+	settings->labSolver = m_settings.labSolver;
+	settings->labBroadPhase = m_settings.labBroadPhase;
+}
+
+const char* InputRecording::GetEventName(EventType type)
+{
+	return k_eventNames[type];
+}
+
+static bool HasPoint(InputRecording::EventType type)
+{
+	return type != InputRecording::e_launchBomb && type != InputRecording::e_keyDown && type != InputRecording::e_keyUp;
+}
+
+bool InputRecording::Save(const char* path) const
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	const Settings& s = m_settings;
+	fprintf(file, "test %s\n", m_testName.c_str());
+	fprintf(file, "settings %.9g %d %d %d %d %d %d %d %d %d\n", s.hz, s.velocityIterations, s.positionIterations,
+		s.enableWarmStarting, s.enableContinuous, s.enableSubStepping, s.enableSleep, s.labSolver, s.labBroadPhase,
+		s.enableParallelTOI);
+
+	// %.9g gives back every float32 bit for bit.
+	for (size_t i = 0; i < m_events.size(); ++i)
+	{
+		const Event& e = m_events[i];
+		if (HasPoint(e.type))
+		{
+			fprintf(file, "%d %.3f %s %.9g %.9g\n", e.step, e.time, k_eventNames[e.type], e.point.x, e.point.y);
+		}
+		else
+		{
+			fprintf(file, "%d %.3f %s %d\n", e.step, e.time, k_eventNames[e.type], e.key);
+		}
+	}
+
+	return fclose(file) == 0;
+}
+
+bool InputRecording::Load(const char* path)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	Settings settings;
+	std::string testName;
+	std::vector<Event> events;
+	bool valid = true;
+
+	char line[256];
+	while (valid && fgets(line, sizeof(line), file) != NULL)
+	{
+		line[strcspn(line, "\r\n")] = 0;
+		if (line[0] == 0 || line[0] == '#')
+		{
+			continue;
+		}
+
+		if (strncmp(line, "test ", 5) == 0)
+		{
+			testName = line + 5;
+			continue;
+		}
+
+		if (strncmp(line, "settings ", 9) == 0)
+		{
+			// Files from before the parallel TOI flag lack the last field.
+			int32 flags[5] = { 0, 0, 0, 0, 0 };
+			int32 count = sscanf(line + 9, "%f %d %d %d %d %d %d %d %d %d", &settings.hz, &settings.velocityIterations,
+				&settings.positionIterations, flags, flags + 1, flags + 2, flags + 3, &settings.labSolver, &settings.labBroadPhase,
+				flags + 4);
+			valid = count == 9 || count == 10;
+			settings.enableWarmStarting = flags[0] != 0;
+			settings.enableContinuous = flags[1] != 0;
+			settings.enableSubStepping = flags[2] != 0;
+			settings.enableSleep = flags[3] != 0;
+			settings.enableParallelTOI = flags[4] != 0;
+			continue;
+		}
+
+		Event event;
+		char name[32];
+		int32 offset = 0;
+		valid = sscanf(line, "%d %f %31s %n", &event.step, &event.time, name, &offset) == 3;
+		if (valid == false)
+		{
+			break;
+		}
+
+		int32 type = 0;
+		while (type < e_eventTypeCount && strcmp(name, k_eventNames[type]) != 0)
+		{
+			++type;
+		}
+		valid = type < e_eventTypeCount && (events.empty() || events.back().step <= event.step);
+		if (valid == false)
+		{
+			break;
+		}
+
+		event.type = (EventType)type;
+		event.key = 0;
+		event.point.SetZero();
+		if (HasPoint(event.type))
+		{
+			valid = sscanf(line + offset, "%f %f", &event.point.x, &event.point.y) == 2;
+		}
+		else if (event.type != e_launchBomb)
+		{
+			valid = sscanf(line + offset, "%d", &event.key) == 1;
+		}
+		events.push_back(event);
+	}
+	fclose(file);
+
+	if (valid == false || testName.empty())
+	{
+		return false;
+	}
+
+	m_testName = testName;
+	m_settings = settings;
+	m_events.swap(events);
+	return true;
+}
+
+InputPlayer::InputPlayer()
+{
+	m_recording = NULL;
+	m_next = 0;
+}
+
+void InputPlayer::Begin(const InputRecording* recording)
+{
+	m_recording = recording;
+	m_next = 0;
+}
+
+bool InputPlayer::IsFinished() const
+{
+	return m_recording == NULL || m_next == m_recording->GetEventCount();
+}
+
+void InputPlayer::Apply(Test* test)
+{
+	if (m_recording == NULL)
+	{
+		return;
+	}
+
+	int32 step = test->GetStepCount();
+	int32 count = m_recording->GetEventCount();
+	while (m_next < count && m_recording->GetEvent(m_next).step <= step)
+	{
+		const InputRecording::Event& e = m_recording->GetEvent(m_next);
+		switch (e.type)
+		{
+		case InputRecording::e_mouseDown:
+			test->MouseDown(e.point);
+			break;
+
+		case InputRecording::e_shiftMouseDown:
+			test->ShiftMouseDown(e.point);
+			break;
+
+		case InputRecording::e_mouseUp:
+			test->MouseUp(e.point);
+			break;
+
+		case InputRecording::e_mouseMove:
+			test->MouseMove(e.point);
+			break;
+
+		case InputRecording::e_launchBomb:
+			test->LaunchBomb();
+			break;
+
+		case InputRecording::e_keyDown:
+			test->Keyboard((Oryol::Key::Code)e.key);
+			break;
+
+		case InputRecording::e_keyUp:
+			test->KeyboardUp(e.key);
+			break;
+
+		default:
+			break;
+		}
+		++m_next;
+	}
+}
+
+uint32 RunInputReplay(const InputRecording& recording, const Settings& settings, int32 stepCount, int32 tailStepCount)
+{
+	const TestEntry* entry = FindTestEntry(recording.GetTestName());
+	if (entry == NULL)
+	{
+		printf("no test named '%s'\n", recording.GetTestName());
+		return 0;
+	}
+
+	if (stepCount <= 0)
+	{
+		stepCount = recording.GetLastStep() + 1 + tailStepCount;
+	}
+
+	HeadlessDrawScope drawScope;
+
+	Settings runSettings = MakeHeadlessSettings(settings);
+	recording.ApplySettings(&runSettings);
+
+	Test* test = entry->createFcn();
+	InputPlayer player;
+	player.Begin(&recording);
+
+	float32 totalTime = 0.0f;
+	float32 maxTime = 0.0f;
+	int32 maxStep = 0;
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		b2Timer timer;
+		player.Apply(test);
+		test->Step(&runSettings);
+		float32 time = timer.GetMilliseconds();
+
+		totalTime += time;
+		if (time > maxTime)
+		{
+			maxTime = time;
+			maxStep = i + 1;
+		}
+	}
+
+	uint32 checksum = test->GetChecksum();
+	printf("%s: %d events over %d steps, %.1f ms, %.3f ms/step, max %.3f ms at step %d, checksum %08x\n",
+		entry->name, recording.GetEventCount(), stepCount, totalTime, stepCount > 0 ? totalTime / stepCount : 0.0f,
+		maxTime, maxStep, checksum);
+	fflush(stdout);
+
+	delete test;
+	return checksum;
+}
+
+void MakePyramidScenario(InputRecording* recording, const Settings& settings)
+{
+	recording->Begin("Pyramid", settings);
+
+	// The left box of the 11th row; the pyramid has settled by step 30.
+	b2Vec2 grab(-1.375f, 13.25f);
+	b2Vec2 drop(-25.0f, 16.0f);
+	int32 dragStart = 30;
+	int32 dragSteps = 60;
+
+	recording->AddMouse(dragStart, InputRecording::e_mouseDown, grab);
+	for (int32 i = 1; i <= dragSteps; ++i)
+	{
+		float32 t = (float32)i / dragSteps;
+		recording->AddMouse(dragStart + i, InputRecording::e_mouseMove, (1.0f - t) * grab + t * drop);
+	}
+	recording->AddMouse(dragStart + dragSteps + 1, InputRecording::e_mouseUp, drop);
+
+	for (int32 i = 0; i < 10; ++i)
+	{
+		recording->AddKey(dragStart + dragSteps + 30 + 30 * i, InputRecording::e_launchBomb, 0);
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "Test.h"
+#include <string>
+#include <vector>
+
+// The testbed's input to one test, as it reached the test: mouse points
+// are in world space, so a replay does not depend on the camera. Each
+// event is tagged with the test's step count when it arrived and is
+// replayed just before that step is taken, so a replay steps exactly as
+// the recorded run did. Bombs launched with the space bar come from the
+// seeded RandomFloat and need no more than the step. The settings that
+// change stepping are stored once with the events; the testbed keeps them
+// fixed while it records or replays.
+//
+// Files are text, one event per line, so scenarios can be written or
+// edited by hand:
+//   test Pyramid
+//   settings 60 8 3 1 1 0 1 0 0 0
+//   <step> <seconds> <event> [<key> | <x> <y>]
+// The settings are the hz, the velocity and position iterations, the warm
+// starting, continuous, sub-stepping and sleep flags, the lab solver and
+// broad-phase, and the parallel TOI flag, which older files leave off.
+class InputRecording
+{
+public:
+	enum EventType
+	{
+		e_mouseDown,
+		e_shiftMouseDown,
+		e_mouseUp,
+		e_mouseMove,
+		e_launchBomb,
+		e_keyDown,
+		e_keyUp,
+		e_eventTypeCount
+	};
+
+	struct Event
+	{
+		int32 step;
+		float32 time;
+		EventType type;
+		int32 key;
+		b2Vec2 point;
+	};
+
+	InputRecording();
+
+	// Forgets the events and starts over for the named test.
+	void Begin(const char* testName, const Settings& settings);
+
+	void AddMouse(int32 step, EventType type, const b2Vec2& point);
+	void AddKey(int32 step, EventType type, int32 key);
+
+	int32 GetEventCount() const { return (int32)m_events.size(); }
+	const Event& GetEvent(int32 index) const { return m_events[index]; }
+	const char* GetTestName() const { return m_testName.c_str(); }
+
+	// The step of the last event, or -1 when there are none.
+	int32 GetLastStep() const;
+
+	// Copies the recorded stepping settings over the given ones.
+	void ApplySettings(Settings* settings) const;
+
+	bool Save(const char* path) const;
+	bool Load(const char* path);
+
+	static const char* GetEventName(EventType type);
+
+private:
+	void Add(const Event& event);
+
+	std::string m_testName;
+	Settings m_settings;
+	std::vector<Event> m_events;
+	b2Timer m_timer;
+};
+
+// Feeds a recording to a test as it steps.
+class InputPlayer
+{
+public:
+	InputPlayer();
+
+	void Begin(const InputRecording* recording);
+	void Stop() { m_recording = NULL; }
+
+	// Sends the test every event due before its next step.
+	void Apply(Test* test);
+
+	bool IsPlaying() const { return m_recording != NULL; }
+	bool IsFinished() const;
+
+private:
+	const InputRecording* m_recording;
+	int32 m_next;
+};
+
+// Where the testbed's Record Input button saves and Replay Input loads.
+const char* const k_inputRecordingPath = "testbed.input";
+
+// Replays the recording without a window and reports the time per step
+// on stdout. Runs stepCount steps, or to tailStepCount steps past the last
+// event when stepCount is 0. Returns the checksum after the last step.
+uint32 RunInputReplay(const InputRecording& recording, const Settings& settings, int32 stepCount, int32 tailStepCount);
+
+// A scripted benchmark: drags a row of the Pyramid scene out sideways,
+// then launches ten bombs into what is left.
+void MakePyramidScenario(InputRecording* recording, const Settings& settings);
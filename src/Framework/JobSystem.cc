@@ -0,0 +1,293 @@
+#include "JobSystem.h"
+#include <chrono>
+
+JobSystem g_jobSystem;
+
+// Index of the worker running on this thread. Threads that are not workers
+// use the deque of worker 0, which is why every deque has a lock.
+static thread_local int32 t_workerIndex = 0;
+
+static int64_t JobNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+JobCounter::JobCounter()
+{
+	m_pending = 0;
+}
+
+JobSystem::JobSystem()
+{
+	m_workerCount = 1;
+	m_queued = 0;
+	m_sleeping = 0;
+	m_quit = false;
+	m_lastSample = JobNow();
+	for (int32 i = 0; i < e_maxWorkers; ++i)
+	{
+		m_workers[i].busyNanoseconds = 0;
+		m_workers[i].jobCount = 0;
+		m_workers[i].stealCount = 0;
+		memset(m_stats + i, 0, sizeof(JobWorkerStats));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	Discard();
+}
+
+int32 JobSystem::GetDefaultWorkerCount()
+{
+	int32 count = (int32)std::thread::hardware_concurrency();
+	return b2Clamp(count, 1, (int32)e_maxWorkers);
+}
+
+void JobSystem::Setup(int32 workerCount)
+{
+	Discard();
+
+	m_workerCount = b2Clamp(workerCount, 1, (int32)e_maxWorkers);
+	m_quit = false;
+	t_workerIndex = 0;
+
+	for (int32 i = 1; i < m_workerCount; ++i)
+	{
+		m_threads.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+	}
+
+	m_lastSample = JobNow();
+}
+
+void JobSystem::Discard()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (size_t i = 0; i < m_threads.size(); ++i)
+	{
+		m_threads[i].join();
+	}
+	m_threads.clear();
+	m_workerCount = 1;
+}
+
+void JobSystem::WorkerMain(int32 index)
+{
+	t_workerIndex = index;
+
+	for (;;)
+	{
+		Job job;
+		if (Pop(index, &job) || Steal(index, &job))
+		{
+			Execute(index, job);
+			continue;
+		}
+
+		// Spin briefly before sleeping: at physics granularity the next
+		// batch usually arrives within microseconds.
+		bool found = false;
+		for (int32 i = 0; i < 64 && found == false; ++i)
+		{
+			std::this_thread::yield();
+			found = m_queued.load(std::memory_order_acquire) > 0;
+		}
+
+		if (found)
+		{
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleeping.fetch_add(1);
+		while (m_quit == false && m_queued.load() == 0)
+		{
+			m_wake.wait(lock);
+		}
+		m_sleeping.fetch_sub(1);
+
+		if (m_quit)
+		{
+			return;
+		}
+	}
+}
+
+void JobSystem::Push(const Job& job)
+{
+	Worker& worker = m_workers[t_workerIndex];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.jobs.push_back(job);
+	}
+
+	// Pairs with WorkerMain: a worker announces itself in m_sleeping before
+	// it checks m_queued, so either it sees this job or we see it sleeping.
+	m_queued.fetch_add(1);
+	if (m_sleeping.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+		m_wake.notify_one();
+	}
+}
+
+bool JobSystem::Pop(int32 index, Job* job)
+{
+	Worker& worker = m_workers[index];
+	std::lock_guard<std::mutex> lock(worker.mutex);
+	if (worker.jobs.empty())
+	{
+		return false;
+	}
+
+	*job = worker.jobs.back();
+	worker.jobs.pop_back();
+	m_queued.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool JobSystem::Steal(int32 index, Job* job)
+{
+	for (int32 i = 1; i < m_workerCount; ++i)
+	{
+		Worker& victim = m_workers[(index + i) % m_workerCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.jobs.empty())
+		{
+			continue;
+		}
+
+		*job = victim.jobs.front();
+		victim.jobs.pop_front();
+		m_queued.fetch_sub(1, std::memory_order_relaxed);
+		m_workers[index].stealCount.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(int32 index, const Job& job)
+{
+	int64_t start = JobNow();
+	job.fcn(job.data, job.begin, job.end);
+
+	Worker& worker = m_workers[index];
+	worker.busyNanoseconds.fetch_add(JobNow() - start, std::memory_order_relaxed);
+	worker.jobCount.fetch_add(1, std::memory_order_relaxed);
+
+	Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (counter == NULL)
+	{
+		return;
+	}
+
+	// The decrement happens under the counter's lock so RunAfter cannot
+	// attach a continuation after the list has been taken. Wait takes the
+	// same lock before returning, which keeps the counter alive until here.
+	std::vector<Job> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			continuations.swap(counter->m_continuations);
+		}
+	}
+
+	for (size_t i = 0; i < continuations.size(); ++i)
+	{
+		Push(continuations[i]);
+	}
+}
+
+void JobSystem::Run(JobCounter* counter, JobFcn* fcn, void* data, int32 begin, int32 end)
+{
+	Job job;
+	job.fcn = fcn;
+	job.data = data;
+	job.begin = begin;
+	job.end = end;
+	job.counter = counter;
+
+	if (counter != NULL)
+	{
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Push(job);
+}
+
+void JobSystem::RunAfter(JobCounter* dependency, JobCounter* counter, JobFcn* fcn, void* data, int32 begin, int32 end)
+{
+	Job job;
+	job.fcn = fcn;
+	job.data = data;
+	job.begin = begin;
+	job.end = end;
+	job.counter = counter;
+
+	if (counter != NULL)
+	{
+		counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(dependency->m_mutex);
+		if (dependency->m_pending.load(std::memory_order_relaxed) > 0)
+		{
+			dependency->m_continuations.push_back(job);
+			return;
+		}
+	}
+
+	Push(job);
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	int32 index = t_workerIndex;
+	while (counter->IsDone() == false)
+	{
+		Job job;
+		if (Pop(index, &job) || Steal(index, &job))
+		{
+			Execute(index, job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// The last Finish may still hold the counter's lock; see Finish.
+	std::lock_guard<std::mutex> lock(counter->m_mutex);
+}
+
+void JobSystem::SampleStats()
+{
+	int64_t now = JobNow();
+	float32 wall = float32(now - m_lastSample);
+	m_lastSample = now;
+
+	for (int32 i = 0; i < m_workerCount; ++i)
+	{
+		Worker& worker = m_workers[i];
+		int64_t busy = worker.busyNanoseconds.exchange(0, std::memory_order_relaxed);
+		JobWorkerStats& stats = m_stats[i];
+		stats.utilization = wall > 0.0f ? b2Min(float32(busy) / wall, 1.0f) : 0.0f;
+		stats.jobCount = worker.jobCount.exchange(0, std::memory_order_relaxed);
+		stats.stealCount = worker.stealCount.exchange(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include "Box2D/Box2D.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void JobFcn(void* data, int32 begin, int32 end);
+
+struct Job
+{
+	JobFcn* fcn;
+	void* data;
+	int32 begin;
+	int32 end;
+	class JobCounter* counter;
+};
+
+// Counts unfinished jobs. Jobs added with RunAfter start once the counter
+// they depend on drops to zero. A counter must outlive its jobs.
+class JobCounter
+{
+public:
+	JobCounter();
+
+	bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int32> m_pending;
+	std::mutex m_mutex;
+	std::vector<Job> m_continuations;
+};
+
+struct JobWorkerStats
+{
+	float32 utilization;
+	int32 jobCount;
+	int32 stealCount;
+};
+
+// Work-stealing scheduler. Every worker owns a deque: it pushes and pops
+// its own jobs at the back and steals from the front of the others' when
+// it runs dry. The thread that calls Setup is worker 0 and only runs jobs
+// while it waits; threads that are not workers share its deque.
+class JobSystem
+{
+public:
+	enum
+	{
+		e_maxWorkers = 32,
+		e_jobsPerWorker = 4
+	};
+
+	JobSystem();
+	~JobSystem();
+
+	// Starts workerCount - 1 background threads. Calling it again restarts
+	// the workers; no jobs may be in flight.
+	void Setup(int32 workerCount);
+	void Discard();
+
+	static int32 GetDefaultWorkerCount();
+	int32 GetWorkerCount() const { return m_workerCount; }
+
+	// Queues fcn(data, begin, end) on the calling worker's deque.
+	void Run(JobCounter* counter, JobFcn* fcn, void* data, int32 begin = 0, int32 end = 0);
+
+	// Queues the job once dependency is done. counter tracks the new job.
+	void RunAfter(JobCounter* dependency, JobCounter* counter, JobFcn* fcn, void* data, int32 begin = 0, int32 end = 0);
+
+	// Runs queued jobs until counter is done.
+	void Wait(JobCounter* counter);
+
+	// Calls fn(begin, end) over [0, count) in ranges of at least grainSize
+	// and returns when all ranges are done. The caller runs the first range.
+	template <typename F>
+	void ParallelFor(int32 count, int32 grainSize, const F& fn);
+
+	// Busy time per worker since the previous call, as a fraction of the
+	// wall time in between. Call once per frame.
+	void SampleStats();
+	const JobWorkerStats& GetStats(int32 worker) const { return m_stats[worker]; }
+
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+		std::atomic<int64_t> busyNanoseconds;
+		std::atomic<int32> jobCount;
+		std::atomic<int32> stealCount;
+	};
+
+	template <typename F>
+	static void ParallelForThunk(void* data, int32 begin, int32 end)
+	{
+		(*(const F*)data)(begin, end);
+	}
+
+	void WorkerMain(int32 index);
+	void Push(const Job& job);
+	bool Pop(int32 index, Job* job);
+	bool Steal(int32 index, Job* job);
+	void Execute(int32 index, const Job& job);
+	void Finish(JobCounter* counter);
+
+	Worker m_workers[e_maxWorkers];
+	std::vector<std::thread> m_threads;
+	int32 m_workerCount;
+
+	std::atomic<int32> m_queued;
+	std::atomic<int32> m_sleeping;
+	std::atomic<bool> m_quit;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+
+	JobWorkerStats m_stats[e_maxWorkers];
+	int64_t m_lastSample;
+};
+
+template <typename F>
+inline void JobSystem::ParallelFor(int32 count, int32 grainSize, const F& fn)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	// A few ranges per worker lets stealing even out uneven ranges without
+	// paying the scheduling cost per item.
+	int32 rangeCount = (count + b2Max(grainSize, 1) - 1) / b2Max(grainSize, 1);
+	rangeCount = b2Min(rangeCount, (int32)e_jobsPerWorker * m_workerCount);
+	if (rangeCount <= 1 || m_workerCount <= 1)
+	{
+		fn(0, count);
+		return;
+	}
+
+	int32 rangeSize = (count + rangeCount - 1) / rangeCount;
+	JobCounter counter;
+	for (int32 begin = rangeSize; begin < count; begin += rangeSize)
+	{
+		Run(&counter, &ParallelForThunk<F>, (void*)&fn, begin, b2Min(begin + rangeSize, count));
+	}
+
+	fn(0, rangeSize);
+	Wait(&counter);
+}
+
+extern JobSystem g_jobSystem;
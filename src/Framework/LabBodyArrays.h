@@ -0,0 +1,75 @@
+#pragma once
+#include "SimdMath.h"
+#include <vector>
+
+// Simulation state of the lab world's bodies as structure-of-arrays, indexed
+// by body id. Every array holds GetCapacity() entries, a multiple of
+// k_simdWidth, so loops can run whole SIMD batches; the padding entries are
+// zero, which makes them asleep, massless and non-dynamic.
+//
+// Flags are stored as 1.0f or 0.0f so they can be turned into lane masks.
+struct LabBodyArrays
+{
+	LabBodyArrays()
+	{
+		count = 0;
+	}
+
+	// Grows all arrays to hold 'newCount' bodies; new entries are zero.
+	void Resize(int32 newCount)
+	{
+		count = newCount;
+		int32 capacity = GetCapacity();
+		std::vector<float32>* arrays[] =
+		{
+			&cx, &cy, &a, &c0x, &c0y, &a0,
+			&vx, &vy, &w,
+			&invMass, &invI, &localCenterX, &localCenterY,
+			&linearDamping, &angularDamping, &gravityScale,
+			&sleepTime, &awake, &dynamic, &allowSleep,
+			&px, &py, &qs, &qc
+		};
+		for (int32 i = 0; i < (int32)(sizeof(arrays) / sizeof(arrays[0])); ++i)
+		{
+			arrays[i]->resize(capacity, 0.0f);
+		}
+	}
+
+	int32 GetCapacity() const
+	{
+		return (count + k_simdWidth - 1) / k_simdWidth * k_simdWidth;
+	}
+
+	b2Vec2 GetCenter(int32 i) const { return b2Vec2(cx[i], cy[i]); }
+	void SetCenter(int32 i, const b2Vec2& c) { cx[i] = c.x; cy[i] = c.y; }
+	b2Vec2 GetLinearVelocity(int32 i) const { return b2Vec2(vx[i], vy[i]); }
+	void SetLinearVelocity(int32 i, const b2Vec2& v) { vx[i] = v.x; vy[i] = v.y; }
+	b2Vec2 GetLocalCenter(int32 i) const { return b2Vec2(localCenterX[i], localCenterY[i]); }
+
+	b2Transform GetTransform(int32 i) const
+	{
+		b2Transform xf;
+		xf.p.Set(px[i], py[i]);
+		xf.q.s = qs[i];
+		xf.q.c = qc[i];
+		return xf;
+	}
+
+	int32 count;
+
+	// Sweep: center of mass and angle now and at the start of the step.
+	std::vector<float32> cx, cy, a;
+	std::vector<float32> c0x, c0y, a0;
+
+	std::vector<float32> vx, vy, w;
+
+	std::vector<float32> invMass, invI;
+	std::vector<float32> localCenterX, localCenterY;
+	std::vector<float32> linearDamping, angularDamping, gravityScale;
+
+	std::vector<float32> sleepTime;
+	std::vector<float32> awake, dynamic, allowSleep;
+
+	// Body origin transform, derived from the sweep after each step.
+	std::vector<float32> px, py, qs, qc;
+};
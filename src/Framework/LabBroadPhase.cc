@@ -0,0 +1,74 @@
+#include "LabBroadPhase.h"
+#include "LabGridBroadPhase.h"
+#include "LabSapBroadPhase.h"
+#include "LabTreeBroadPhase.h"
+
+LabBroadPhase* LabBroadPhase::Create(Type type)
+{
+	switch (type)
+	{
+	case e_sweepAndPrune:
+		return new LabSapBroadPhase;
+
+	case e_hashedGrid:
+		return new LabGridBroadPhase;
+
+	default:
+		return new LabTreeBroadPhase;
+	}
+}
+
+const char* LabBroadPhase::GetName(Type type)
+{
+	switch (type)
+	{
+	case e_tree:
+		return "Tree";
+
+	case e_sweepAndPrune:
+		return "Sweep and Prune";
+
+	case e_hashedGrid:
+		return "Hashed Grid";
+
+	default:
+		return "Unknown";
+	}
+}
+
+b2AABB LabBroadPhase::Fatten(const b2AABB& aabb)
+{
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b2AABB fatAABB;
+	fatAABB.lowerBound = aabb.lowerBound - r;
+	fatAABB.upperBound = aabb.upperBound + r;
+	return fatAABB;
+}
+
+b2AABB LabBroadPhase::Fatten(const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2AABB b = Fatten(aabb);
+
+	// Predict AABB displacement.
+	b2Vec2 d = b2_aabbMultiplier * displacement;
+
+	if (d.x < 0.0f)
+	{
+		b.lowerBound.x += d.x;
+	}
+	else
+	{
+		b.upperBound.x += d.x;
+	}
+
+	if (d.y < 0.0f)
+	{
+		b.lowerBound.y += d.y;
+	}
+	else
+	{
+		b.upperBound.y += d.y;
+	}
+
+	return b;
+}
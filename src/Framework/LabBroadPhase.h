@@ -0,0 +1,110 @@
+#pragma once
+#include "Box2D/Box2D.h"
+#include <algorithm>
+#include <vector>
+
+enum LabProxyType
+{
+	e_labStaticProxy,
+	e_labDynamicProxy,
+	e_labSleepingProxy,
+	e_labProxyTypeCount
+};
+
+// Interface of the lab world's broad-phase backends. Every backend gives
+// proxies the same fat AABBs as b2BroadPhase, with the same margin and
+// displacement prediction, and a proxy looks for pairs when it is created
+// or leaves its fat AABB. So all backends report the same new pairs in the
+// same order and only differ in how long it takes.
+class LabBroadPhase
+{
+public:
+	enum Type
+	{
+		e_tree,
+		e_sweepAndPrune,
+		e_hashedGrid,
+		e_typeCount
+	};
+
+	static LabBroadPhase* Create(Type type);
+	static const char* GetName(Type type);
+
+	virtual ~LabBroadPhase() {}
+
+	virtual Type GetType() const = 0;
+
+	// Proxy ids count up from zero in creation order.
+	virtual int32 CreateProxy(const b2AABB& aabb, LabProxyType type, void* userData) = 0;
+
+	// Same contract as b2BroadPhase::MoveProxy.
+	virtual void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement) = 0;
+
+	// Called when the body sleeps or wakes. The fat AABB stays the same and
+	// pairs are not looked for until the proxy moves.
+	virtual void SetProxyType(int32 proxyId, LabProxyType type) = 0;
+	virtual LabProxyType GetProxyType(int32 proxyId) const = 0;
+
+	// Puts the proxy back at a fat AABB read from GetFatAABB earlier, for
+	// rolling back. The proxy does not look for pairs: the caller restores
+	// the contacts that went with the old boxes.
+	virtual void SetFatAABB(int32 proxyId, const b2AABB& fatAABB) = 0;
+
+	virtual void* GetUserData(int32 proxyId) const = 0;
+	virtual const b2AABB& GetFatAABB(int32 proxyId) const = 0;
+	virtual int32 GetProxyCount() const = 0;
+
+	bool TestOverlap(int32 proxyIdA, int32 proxyIdB) const
+	{
+		return b2TestOverlap(GetFatAABB(proxyIdA), GetFatAABB(proxyIdB));
+	}
+
+	// Calls callback->AddPair(userDataA, userDataB) once for every new
+	// overlap of a created or moved proxy, ordered by proxy ids.
+	template <typename T>
+	void UpdatePairs(T* callback);
+
+protected:
+	// Appends a pair for every overlap between a proxy created or moved
+	// since the last call and any other proxy, with proxyIdA < proxyIdB.
+	// Pairs of two static proxies and duplicates may be left in.
+	virtual void FindPairs(std::vector<b2Pair>* pairs) = 0;
+
+	static b2AABB Fatten(const b2AABB& aabb);
+
+	// The fat AABB of a proxy that left its old one, as b2DynamicTree::MoveProxy.
+	static b2AABB Fatten(const b2AABB& aabb, const b2Vec2& displacement);
+
+private:
+	std::vector<b2Pair> m_pairBuffer;
+};
+
+template <typename T>
+inline void LabBroadPhase::UpdatePairs(T* callback)
+{
+	m_pairBuffer.resize(0);
+	FindPairs(&m_pairBuffer);
+
+	// Sort the pair buffer to expose duplicates.
+	std::sort(m_pairBuffer.begin(), m_pairBuffer.end(), b2PairLessThan);
+
+	int32 i = 0;
+	int32 pairCount = (int32)m_pairBuffer.size();
+	while (i < pairCount)
+	{
+		const b2Pair& primaryPair = m_pairBuffer[i];
+		callback->AddPair(GetUserData(primaryPair.proxyIdA), GetUserData(primaryPair.proxyIdB));
+		++i;
+
+		// Skip any duplicate pairs.
+		while (i < pairCount)
+		{
+			const b2Pair& pair = m_pairBuffer[i];
+			if (pair.proxyIdA != primaryPair.proxyIdA || pair.proxyIdB != primaryPair.proxyIdB)
+			{
+				break;
+			}
+			++i;
+		}
+	}
+}
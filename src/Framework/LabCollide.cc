@@ -0,0 +1,510 @@
+#include "LabCollide.h"
+#include "SimdMath.h"
+
+// Tag for polygons that LabGetShapeKind found to be rectangles.
+struct LabBoxShape;
+
+template <typename T>
+struct LabShapeTraits
+{
+	typedef T Shape;
+};
+
+template <>
+struct LabShapeTraits<LabBoxShape>
+{
+	typedef b2PolygonShape Shape;
+};
+
+static inline void Collide(b2Manifold* manifold, const b2CircleShape* circleA, const b2Transform& xfA, const b2CircleShape* circleB, const b2Transform& xfB)
+{
+	b2CollideCircles(manifold, circleA, xfA, circleB, xfB);
+}
+
+static inline void Collide(b2Manifold* manifold, const b2PolygonShape* polygonA, const b2Transform& xfA, const b2CircleShape* circleB, const b2Transform& xfB)
+{
+	b2CollidePolygonAndCircle(manifold, polygonA, xfA, circleB, xfB);
+}
+
+static inline void Collide(b2Manifold* manifold, const b2PolygonShape* polygonA, const b2Transform& xfA, const b2PolygonShape* polygonB, const b2Transform& xfB)
+{
+	LabCollidePolygons(manifold, polygonA, xfA, polygonB, xfB);
+}
+
+static inline void Collide(b2Manifold* manifold, const b2EdgeShape* edgeA, const b2Transform& xfA, const b2CircleShape* circleB, const b2Transform& xfB)
+{
+	b2CollideEdgeAndCircle(manifold, edgeA, xfA, circleB, xfB);
+}
+
+static inline void Collide(b2Manifold* manifold, const b2EdgeShape* edgeA, const b2Transform& xfA, const b2PolygonShape* polygonB, const b2Transform& xfB)
+{
+	b2CollideEdgeAndPolygon(manifold, edgeA, xfA, polygonB, xfB);
+}
+
+// Boxes fall back to the polygon functions except against each other.
+template <typename ShapeA, typename ShapeB>
+static void CollideKernel(b2Manifold* manifold, const b2Shape* shapeA, const b2Transform& xfA, const b2Shape* shapeB, const b2Transform& xfB)
+{
+	typedef typename LabShapeTraits<ShapeA>::Shape TypeA;
+	typedef typename LabShapeTraits<ShapeB>::Shape TypeB;
+	Collide(manifold, static_cast<const TypeA*>(shapeA), xfA, static_cast<const TypeB*>(shapeB), xfB);
+}
+
+template <>
+void CollideKernel<LabBoxShape, LabBoxShape>(b2Manifold* manifold, const b2Shape* shapeA, const b2Transform& xfA, const b2Shape* shapeB, const b2Transform& xfB)
+{
+	LabCollideBoxes(manifold, static_cast<const b2PolygonShape*>(shapeA), xfA, static_cast<const b2PolygonShape*>(shapeB), xfB);
+}
+
+// Rows are shape A, columns shape B, in LabShapeKind order.
+static LabCollideFcn* const s_collideFcns[e_labShapeKindCount][e_labShapeKindCount] =
+{
+	{ CollideKernel<b2CircleShape, b2CircleShape>, NULL, NULL, NULL },
+	{ CollideKernel<b2EdgeShape, b2CircleShape>, NULL, CollideKernel<b2EdgeShape, b2PolygonShape>, CollideKernel<b2EdgeShape, LabBoxShape> },
+	{ CollideKernel<b2PolygonShape, b2CircleShape>, NULL, CollideKernel<b2PolygonShape, b2PolygonShape>, NULL },
+	{ CollideKernel<LabBoxShape, b2CircleShape>, NULL, CollideKernel<LabBoxShape, b2PolygonShape>, CollideKernel<LabBoxShape, LabBoxShape> }
+};
+
+LabCollideFcn* LabGetCollideFcn(LabShapeKind kindA, LabShapeKind kindB)
+{
+	b2Assert(0 <= kindA && kindA < e_labShapeKindCount);
+	b2Assert(0 <= kindB && kindB < e_labShapeKindCount);
+	return s_collideFcns[kindA][kindB];
+}
+
+LabShapeKind LabGetShapeKind(const b2Shape* shape)
+{
+	switch (shape->GetType())
+	{
+	case b2Shape::e_circle:
+		return e_labCircle;
+
+	case b2Shape::e_edge:
+		return e_labEdge;
+
+	case b2Shape::e_polygon:
+		break;
+
+	default:
+		b2Assert(false);
+		return e_labShapeKindCount;
+	}
+
+	// A quad whose opposite normals cancel and whose neighbouring normals
+	// are perpendicular is a rectangle centered on its centroid.
+	const b2PolygonShape* polygon = static_cast<const b2PolygonShape*>(shape);
+	if (polygon->m_count != 4)
+	{
+		return e_labPolygon;
+	}
+
+	const float32 tolerance = 1.0e-5f;
+	const b2Vec2* normals = polygon->m_normals;
+	for (int32 i = 0; i < 2; ++i)
+	{
+		if ((normals[i] + normals[i + 2]).LengthSquared() > tolerance * tolerance)
+		{
+			return e_labPolygon;
+		}
+	}
+
+	if (b2Abs(b2Dot(normals[0], normals[1])) > tolerance)
+	{
+		return e_labPolygon;
+	}
+
+	return e_labBox;
+}
+
+// Half extents along normals 0 and 1. Normals 2 and 3 are their negatives.
+static void GetBoxExtents(const b2PolygonShape* box, float32 extents[2])
+{
+	const b2Vec2& center = box->m_centroid;
+	extents[0] = b2Dot(box->m_normals[0], box->m_vertices[0] - center);
+	extents[1] = b2Dot(box->m_normals[1], box->m_vertices[1] - center);
+}
+
+// Index of the largest of the four face separations; like the polygon
+// version the first face wins ties.
+static int32 FindMaxFace(const float32 separations[4])
+{
+	int32 bestIndex = 0;
+	for (int32 i = 1; i < 4; ++i)
+	{
+		if (separations[i] > separations[bestIndex])
+		{
+			bestIndex = i;
+		}
+	}
+	return bestIndex;
+}
+
+// b2FindIncidentEdge for a box: the most anti-parallel face follows from
+// the reference normal's projections on the first two face normals.
+static void FindIncidentBoxEdge(b2ClipVertex c[2], int32 edge1, const b2Vec2& normal1, const b2PolygonShape* box2, const b2Transform& xf2)
+{
+	float32 dot0 = b2Dot(normal1, b2Mul(xf2.q, box2->m_normals[0]));
+	float32 dot1 = b2Dot(normal1, b2Mul(xf2.q, box2->m_normals[1]));
+	float32 dots[4] = { -dot0, -dot1, dot0, dot1 };
+	int32 i1 = FindMaxFace(dots);
+	int32 i2 = (i1 + 1) & 3;
+
+	c[0].v = b2Mul(xf2, box2->m_vertices[i1]);
+	c[0].id.cf.indexA = (uint8)edge1;
+	c[0].id.cf.indexB = (uint8)i1;
+	c[0].id.cf.typeA = b2ContactFeature::e_face;
+	c[0].id.cf.typeB = b2ContactFeature::e_vertex;
+
+	c[1].v = b2Mul(xf2, box2->m_vertices[i2]);
+	c[1].id.cf.indexA = (uint8)edge1;
+	c[1].id.cf.indexB = (uint8)i2;
+	c[1].id.cf.typeA = b2ContactFeature::e_face;
+	c[1].id.cf.typeB = b2ContactFeature::e_vertex;
+}
+
+// The end of b2CollidePolygons: clips the incident edge against the sides
+// of the reference face and keeps the points below it.
+static void ClipIncidentEdge(b2Manifold* manifold, const b2PolygonShape* poly1, const b2Transform& xf1, int32 edge1,
+	const b2Transform& xf2, const b2ClipVertex incidentEdge[2], float32 totalRadius, uint8 flip)
+{
+	int32 count1 = poly1->m_count;
+	const b2Vec2* vertices1 = poly1->m_vertices;
+
+	int32 iv1 = edge1;
+	int32 iv2 = edge1 + 1 < count1 ? edge1 + 1 : 0;
+
+	b2Vec2 v11 = vertices1[iv1];
+	b2Vec2 v12 = vertices1[iv2];
+
+	b2Vec2 localTangent = v12 - v11;
+	localTangent.Normalize();
+
+	b2Vec2 localNormal = b2Cross(localTangent, 1.0f);
+	b2Vec2 planePoint = 0.5f * (v11 + v12);
+
+	b2Vec2 tangent = b2Mul(xf1.q, localTangent);
+	b2Vec2 normal = b2Cross(tangent, 1.0f);
+
+	v11 = b2Mul(xf1, v11);
+	v12 = b2Mul(xf1, v12);
+
+	// Face offset.
+	float32 frontOffset = b2Dot(normal, v11);
+
+	// Side offsets, extended by polytope skin thickness.
+	float32 sideOffset1 = -b2Dot(tangent, v11) + totalRadius;
+	float32 sideOffset2 = b2Dot(tangent, v12) + totalRadius;
+
+	// Clip incident edge against extruded edge1 side edges.
+	b2ClipVertex clipPoints1[2];
+	b2ClipVertex clipPoints2[2];
+	int32 np;
+
+	// Clip to box side 1
+	np = b2ClipSegmentToLine(clipPoints1, incidentEdge, -tangent, sideOffset1, iv1);
+
+	if (np < 2)
+	{
+		return;
+	}
+
+	// Clip to negative box side 1
+	np = b2ClipSegmentToLine(clipPoints2, clipPoints1, tangent, sideOffset2, iv2);
+
+	if (np < 2)
+	{
+		return;
+	}
+
+	// Now clipPoints2 contains the clipped points.
+	manifold->localNormal = localNormal;
+	manifold->localPoint = planePoint;
+
+	int32 pointCount = 0;
+	for (int32 i = 0; i < b2_maxManifoldPoints; ++i)
+	{
+		float32 separation = b2Dot(normal, clipPoints2[i].v) - frontOffset;
+
+		if (separation <= totalRadius)
+		{
+			b2ManifoldPoint* cp = manifold->points + pointCount;
+			cp->localPoint = b2MulT(xf2, clipPoints2[i].v);
+			cp->id = clipPoints2[i].id;
+			if (flip)
+			{
+				// Swap features
+				b2ContactFeature cf = cp->id.cf;
+				cp->id.cf.indexA = cf.indexB;
+				cp->id.cf.indexB = cf.indexA;
+				cp->id.cf.typeA = cf.typeB;
+				cp->id.cf.typeB = cf.typeA;
+			}
+			++pointCount;
+		}
+	}
+
+	manifold->pointCount = pointCount;
+}
+
+// b2FindMaxSeparation with the faces of poly1 in SIMD lanes. Every lane
+// does the same float operations in the same order as the scalar loop, and
+// min and max are exact, so the result is bit for bit the same.
+static float32 FindMaxSeparation(int32* edgeIndex, const b2PolygonShape* poly1, const b2Transform& xf1, const b2PolygonShape* poly2, const b2Transform& xf2)
+{
+	int32 count1 = poly1->m_count;
+	int32 count2 = poly2->m_count;
+	const b2Vec2* n1s = poly1->m_normals;
+	const b2Vec2* v1s = poly1->m_vertices;
+	const b2Vec2* v2s = poly2->m_vertices;
+	b2Transform xf = b2MulT(xf2, xf1);
+
+	const FloatW c = SimdSet(xf.q.c);
+	const FloatW s = SimdSet(xf.q.s);
+	const FloatW px = SimdSet(xf.p.x);
+	const FloatW py = SimdSet(xf.p.y);
+
+	float32 separations[b2_maxPolygonVertices + k_simdWidth];
+	for (int32 base = 0; base < count1; base += k_simdWidth)
+	{
+		// Lanes past the last face repeat it and are ignored below.
+		float32 nx[k_simdWidth], ny[k_simdWidth], vx[k_simdWidth], vy[k_simdWidth];
+		for (int32 lane = 0; lane < k_simdWidth; ++lane)
+		{
+			int32 i = b2Min(base + lane, count1 - 1);
+			nx[lane] = n1s[i].x;
+			ny[lane] = n1s[i].y;
+			vx[lane] = v1s[i].x;
+			vy[lane] = v1s[i].y;
+		}
+
+		// n = b2Mul(xf.q, n1s[i]), v1 = b2Mul(xf, v1s[i])
+		FloatW n1x = SimdLoad(nx), n1y = SimdLoad(ny);
+		FloatW x1 = SimdLoad(vx), y1 = SimdLoad(vy);
+		FloatW nX = c * n1x - s * n1y;
+		FloatW nY = s * n1x + c * n1y;
+		FloatW v1X = (c * x1 - s * y1) + px;
+		FloatW v1Y = (s * x1 + c * y1) + py;
+
+		FloatW si = SimdSet(b2_maxFloat);
+		for (int32 j = 0; j < count2; ++j)
+		{
+			FloatW dx = SimdSet(v2s[j].x) - v1X;
+			FloatW dy = SimdSet(v2s[j].y) - v1Y;
+			si = SimdMin(si, nX * dx + nY * dy);
+		}
+
+		SimdStore(separations + base, si);
+	}
+
+	int32 bestIndex = 0;
+	float32 maxSeparation = separations[0];
+	for (int32 i = 1; i < count1; ++i)
+	{
+		if (separations[i] > maxSeparation)
+		{
+			maxSeparation = separations[i];
+			bestIndex = i;
+		}
+	}
+
+	*edgeIndex = bestIndex;
+	return maxSeparation;
+}
+
+// Port of b2FindIncidentEdge, which Box2D does not export.
+static void FindIncidentEdge(b2ClipVertex c[2], const b2PolygonShape* poly1, const b2Transform& xf1, int32 edge1, const b2PolygonShape* poly2, const b2Transform& xf2)
+{
+	const b2Vec2* normals1 = poly1->m_normals;
+
+	int32 count2 = poly2->m_count;
+	const b2Vec2* vertices2 = poly2->m_vertices;
+	const b2Vec2* normals2 = poly2->m_normals;
+
+	b2Assert(0 <= edge1 && edge1 < poly1->m_count);
+
+	// Get the normal of the reference edge in poly2's frame.
+	b2Vec2 normal1 = b2MulT(xf2.q, b2Mul(xf1.q, normals1[edge1]));
+
+	// Find the incident edge on poly2.
+	int32 index = 0;
+	float32 minDot = b2_maxFloat;
+	for (int32 i = 0; i < count2; ++i)
+	{
+		float32 dot = b2Dot(normal1, normals2[i]);
+		if (dot < minDot)
+		{
+			minDot = dot;
+			index = i;
+		}
+	}
+
+	// Build the clip vertices for the incident edge.
+	int32 i1 = index;
+	int32 i2 = i1 + 1 < count2 ? i1 + 1 : 0;
+
+	c[0].v = b2Mul(xf2, vertices2[i1]);
+	c[0].id.cf.indexA = (uint8)edge1;
+	c[0].id.cf.indexB = (uint8)i1;
+	c[0].id.cf.typeA = b2ContactFeature::e_face;
+	c[0].id.cf.typeB = b2ContactFeature::e_vertex;
+
+	c[1].v = b2Mul(xf2, vertices2[i2]);
+	c[1].id.cf.indexA = (uint8)edge1;
+	c[1].id.cf.indexB = (uint8)i2;
+	c[1].id.cf.typeA = b2ContactFeature::e_face;
+	c[1].id.cf.typeB = b2ContactFeature::e_vertex;
+}
+
+void LabCollideBoxes(b2Manifold* manifold, const b2PolygonShape* boxA, const b2Transform& xfA, const b2PolygonShape* boxB, const b2Transform& xfB)
+{
+	manifold->pointCount = 0;
+	float32 totalRadius = boxA->m_radius + boxB->m_radius;
+
+	float32 extentsA[2], extentsB[2];
+	GetBoxExtents(boxA, extentsA);
+	GetBoxExtents(boxB, extentsB);
+
+	// Face normals and centers in world space. The deepest point of one
+	// box along a face normal of the other follows from its extents and
+	// the absolute cosines between the two boxes' normals.
+	b2Vec2 axesA[2] = { b2Mul(xfA.q, boxA->m_normals[0]), b2Mul(xfA.q, boxA->m_normals[1]) };
+	b2Vec2 axesB[2] = { b2Mul(xfB.q, boxB->m_normals[0]), b2Mul(xfB.q, boxB->m_normals[1]) };
+	b2Vec2 d = b2Mul(xfB, boxB->m_centroid) - b2Mul(xfA, boxA->m_centroid);
+
+	float32 c00 = b2Abs(b2Dot(axesA[0], axesB[0]));
+	float32 c01 = b2Abs(b2Dot(axesA[0], axesB[1]));
+	float32 c10 = b2Abs(b2Dot(axesA[1], axesB[0]));
+	float32 c11 = b2Abs(b2Dot(axesA[1], axesB[1]));
+
+	float32 separationsA[4];
+	{
+		float32 offset0 = b2Dot(axesA[0], d);
+		float32 offset1 = b2Dot(axesA[1], d);
+		float32 depth0 = extentsA[0] + extentsB[0] * c00 + extentsB[1] * c01;
+		float32 depth1 = extentsA[1] + extentsB[0] * c10 + extentsB[1] * c11;
+		separationsA[0] = offset0 - depth0;
+		separationsA[1] = offset1 - depth1;
+		separationsA[2] = -offset0 - depth0;
+		separationsA[3] = -offset1 - depth1;
+	}
+
+	int32 edgeA = FindMaxFace(separationsA);
+	float32 separationA = separationsA[edgeA];
+	if (separationA > totalRadius)
+	{
+		return;
+	}
+
+	float32 separationsB[4];
+	{
+		float32 offset0 = -b2Dot(axesB[0], d);
+		float32 offset1 = -b2Dot(axesB[1], d);
+		float32 depth0 = extentsB[0] + extentsA[0] * c00 + extentsA[1] * c10;
+		float32 depth1 = extentsB[1] + extentsA[0] * c01 + extentsA[1] * c11;
+		separationsB[0] = offset0 - depth0;
+		separationsB[1] = offset1 - depth1;
+		separationsB[2] = -offset0 - depth0;
+		separationsB[3] = -offset1 - depth1;
+	}
+
+	int32 edgeB = FindMaxFace(separationsB);
+	float32 separationB = separationsB[edgeB];
+	if (separationB > totalRadius)
+	{
+		return;
+	}
+
+	// From here on this is b2CollidePolygons.
+	const b2PolygonShape* poly1;	// reference polygon
+	const b2PolygonShape* poly2;	// incident polygon
+	b2Transform xf1, xf2;
+	int32 edge1;					// reference edge
+	uint8 flip;
+	const float32 k_tol = 0.1f * b2_linearSlop;
+
+	if (separationB > separationA + k_tol)
+	{
+		poly1 = boxB;
+		poly2 = boxA;
+		xf1 = xfB;
+		xf2 = xfA;
+		edge1 = edgeB;
+		manifold->type = b2Manifold::e_faceB;
+		flip = 1;
+	}
+	else
+	{
+		poly1 = boxA;
+		poly2 = boxB;
+		xf1 = xfA;
+		xf2 = xfB;
+		edge1 = edgeA;
+		manifold->type = b2Manifold::e_faceA;
+		flip = 0;
+	}
+
+	// World normal of the reference face.
+	b2Vec2 normal1 = (edge1 & 1) ? (flip ? axesB[1] : axesA[1]) : (flip ? axesB[0] : axesA[0]);
+	if (edge1 & 2)
+	{
+		normal1 = -normal1;
+	}
+
+	b2ClipVertex incidentEdge[2];
+	FindIncidentBoxEdge(incidentEdge, edge1, normal1, poly2, xf2);
+
+	ClipIncidentEdge(manifold, poly1, xf1, edge1, xf2, incidentEdge, totalRadius, flip);
+}
+
+void LabCollidePolygons(b2Manifold* manifold, const b2PolygonShape* polyA, const b2Transform& xfA, const b2PolygonShape* polyB, const b2Transform& xfB)
+{
+	manifold->pointCount = 0;
+	float32 totalRadius = polyA->m_radius + polyB->m_radius;
+
+	int32 edgeA = 0;
+	float32 separationA = FindMaxSeparation(&edgeA, polyA, xfA, polyB, xfB);
+	if (separationA > totalRadius)
+	{
+		return;
+	}
+
+	int32 edgeB = 0;
+	float32 separationB = FindMaxSeparation(&edgeB, polyB, xfB, polyA, xfA);
+	if (separationB > totalRadius)
+	{
+		return;
+	}
+
+	const b2PolygonShape* poly1;	// reference polygon
+	const b2PolygonShape* poly2;	// incident polygon
+	b2Transform xf1, xf2;
+	int32 edge1;					// reference edge
+	uint8 flip;
+	const float32 k_tol = 0.1f * b2_linearSlop;
+
+	if (separationB > separationA + k_tol)
+	{
+		poly1 = polyB;
+		poly2 = polyA;
+		xf1 = xfB;
+		xf2 = xfA;
+		edge1 = edgeB;
+		manifold->type = b2Manifold::e_faceB;
+		flip = 1;
+	}
+	else
+	{
+		poly1 = polyA;
+		poly2 = polyB;
+		xf1 = xfA;
+		xf2 = xfB;
+		edge1 = edgeA;
+		manifold->type = b2Manifold::e_faceA;
+		flip = 0;
+	}
+
+	b2ClipVertex incidentEdge[2];
+	FindIncidentEdge(incidentEdge, poly1, xf1, edge1, poly2, xf2);
+
+	ClipIncidentEdge(manifold, poly1, xf1, edge1, xf2, incidentEdge, totalRadius, flip);
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+// Narrow-phase kernels for the lab world. Every ordered shape pair has its
+// own kernel, instantiated from a template, and the lab world looks the
+// kernel up once when it creates a contact instead of branching on shape
+// types every step. Polygons that are rectangles (anything SetAsBox makes)
+// get their own kind and a box-box kernel.
+
+enum LabShapeKind
+{
+	e_labCircle,
+	e_labEdge,
+	e_labPolygon,
+	e_labBox,
+	e_labShapeKindCount
+};
+
+typedef void LabCollideFcn(b2Manifold* manifold, const b2Shape* shapeA, const b2Transform& xfA, const b2Shape* shapeB, const b2Transform& xfB);
+
+// Chain shapes are not supported.
+LabShapeKind LabGetShapeKind(const b2Shape* shape);
+
+// Returns NULL when the pair has to be swapped or never collides; edges
+// always come first and otherwise the kinds are in decreasing order.
+LabCollideFcn* LabGetCollideFcn(LabShapeKind kindA, LabShapeKind kindB);
+
+// b2CollidePolygons with the separating axis search done in SIMD lanes.
+// The manifold is identical to Box2D's as long as neither is compiled with
+// floating point contraction into FMA.
+void LabCollidePolygons(b2Manifold* manifold, const b2PolygonShape* polyA, const b2Transform& xfA, const b2PolygonShape* polyB, const b2Transform& xfB);
+
+// Same manifold as b2CollidePolygons, up to rounding, for two boxes. The
+// separating axis test is done in closed form on the box extents instead
+// of looping over all vertex pairs.
+void LabCollideBoxes(b2Manifold* manifold, const b2PolygonShape* boxA, const b2Transform& xfA, const b2PolygonShape* boxB, const b2Transform& xfB);
@@ -0,0 +1,631 @@
+#include "LabContactSolver.h"
+#include "LabWorld.h"
+
+// Same threshold as b2ContactSolver for using the 2-point block solver.
+static const float32 k_maxConditionNumber = 1000.0f;
+
+void LabContactSolver::Initialize(const LabContactSolverDef& def)
+{
+	m_step = def.step;
+	m_bodies = def.bodies;
+	m_contacts = def.contacts;
+	m_count = def.count;
+	m_velocityConstraints.resize(m_count);
+	m_positionConstraints.resize(m_count);
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		const LabContact* contact = m_contacts[i];
+		int32 indexA = contact->bodyA;
+		int32 indexB = contact->bodyB;
+		const b2Manifold* manifold = &contact->manifold;
+
+		int32 pointCount = manifold->pointCount;
+		b2Assert(pointCount > 0);
+
+		LabContactVelocityConstraint* vc = m_velocityConstraints.data() + i;
+		vc->friction = contact->friction;
+		vc->restitution = contact->restitution;
+		vc->indexA = indexA;
+		vc->indexB = indexB;
+		vc->invMassA = m_bodies->invMass[indexA];
+		vc->invMassB = m_bodies->invMass[indexB];
+		vc->invIA = m_bodies->invI[indexA];
+		vc->invIB = m_bodies->invI[indexB];
+		vc->contactIndex = i;
+		vc->pointCount = pointCount;
+		vc->K.ex.SetZero();
+		vc->K.ey.SetZero();
+		vc->normalMass.ex.SetZero();
+		vc->normalMass.ey.SetZero();
+
+		LabContactPositionConstraint* pc = m_positionConstraints.data() + i;
+		pc->indexA = indexA;
+		pc->indexB = indexB;
+		pc->invMassA = m_bodies->invMass[indexA];
+		pc->invMassB = m_bodies->invMass[indexB];
+		pc->localCenterA = m_bodies->GetLocalCenter(indexA);
+		pc->localCenterB = m_bodies->GetLocalCenter(indexB);
+		pc->invIA = m_bodies->invI[indexA];
+		pc->invIB = m_bodies->invI[indexB];
+		pc->localNormal = manifold->localNormal;
+		pc->localPoint = manifold->localPoint;
+		pc->pointCount = pointCount;
+		pc->radiusA = contact->radiusA;
+		pc->radiusB = contact->radiusB;
+		pc->type = manifold->type;
+
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			const b2ManifoldPoint* cp = manifold->points + j;
+			LabVelocityConstraintPoint* vcp = vc->points + j;
+
+			if (m_step.warmStarting)
+			{
+				vcp->normalImpulse = m_step.dtRatio * cp->normalImpulse;
+				vcp->tangentImpulse = m_step.dtRatio * cp->tangentImpulse;
+			}
+			else
+			{
+				vcp->normalImpulse = 0.0f;
+				vcp->tangentImpulse = 0.0f;
+			}
+
+			vcp->rA.SetZero();
+			vcp->rB.SetZero();
+			vcp->normalMass = 0.0f;
+			vcp->tangentMass = 0.0f;
+			vcp->velocityBias = 0.0f;
+
+			pc->localPoints[j] = cp->localPoint;
+		}
+	}
+}
+
+void LabContactSolver::InitializeVelocityConstraints()
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		LabContactVelocityConstraint* vc = m_velocityConstraints.data() + i;
+		const LabContactPositionConstraint* pc = m_positionConstraints.data() + i;
+
+		float32 radiusA = pc->radiusA;
+		float32 radiusB = pc->radiusB;
+		const b2Manifold* manifold = &m_contacts[vc->contactIndex]->manifold;
+
+		int32 indexA = vc->indexA;
+		int32 indexB = vc->indexB;
+
+		float32 mA = vc->invMassA;
+		float32 mB = vc->invMassB;
+		float32 iA = vc->invIA;
+		float32 iB = vc->invIB;
+		b2Vec2 localCenterA = pc->localCenterA;
+		b2Vec2 localCenterB = pc->localCenterB;
+
+		b2Vec2 cA = m_bodies->GetCenter(indexA);
+		float32 aA = m_bodies->a[indexA];
+		b2Vec2 vA = m_bodies->GetLinearVelocity(indexA);
+		float32 wA = m_bodies->w[indexA];
+
+		b2Vec2 cB = m_bodies->GetCenter(indexB);
+		float32 aB = m_bodies->a[indexB];
+		b2Vec2 vB = m_bodies->GetLinearVelocity(indexB);
+		float32 wB = m_bodies->w[indexB];
+
+		b2Transform xfA, xfB;
+		xfA.q.Set(aA);
+		xfB.q.Set(aB);
+		xfA.p = cA - b2Mul(xfA.q, localCenterA);
+		xfB.p = cB - b2Mul(xfB.q, localCenterB);
+
+		b2WorldManifold worldManifold;
+		worldManifold.Initialize(manifold, xfA, radiusA, xfB, radiusB);
+
+		vc->normal = worldManifold.normal;
+
+		int32 pointCount = vc->pointCount;
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			LabVelocityConstraintPoint* vcp = vc->points + j;
+
+			vcp->rA = worldManifold.points[j] - cA;
+			vcp->rB = worldManifold.points[j] - cB;
+
+			float32 rnA = b2Cross(vcp->rA, vc->normal);
+			float32 rnB = b2Cross(vcp->rB, vc->normal);
+
+			float32 kNormal = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+
+			vcp->normalMass = kNormal > 0.0f ? 1.0f / kNormal : 0.0f;
+
+			b2Vec2 tangent = b2Cross(vc->normal, 1.0f);
+
+			float32 rtA = b2Cross(vcp->rA, tangent);
+			float32 rtB = b2Cross(vcp->rB, tangent);
+
+			float32 kTangent = mA + mB + iA * rtA * rtA + iB * rtB * rtB;
+
+			vcp->tangentMass = kTangent > 0.0f ? 1.0f / kTangent : 0.0f;
+
+			// Setup a velocity bias for restitution.
+			vcp->velocityBias = 0.0f;
+			float32 vRel = b2Dot(vc->normal, vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA));
+			if (vRel < -b2_velocityThreshold)
+			{
+				vcp->velocityBias = -vc->restitution * vRel;
+			}
+		}
+
+		// If we have two points, then prepare the block solver.
+		if (vc->pointCount == 2)
+		{
+			LabVelocityConstraintPoint* vcp1 = vc->points + 0;
+			LabVelocityConstraintPoint* vcp2 = vc->points + 1;
+
+			float32 rn1A = b2Cross(vcp1->rA, vc->normal);
+			float32 rn1B = b2Cross(vcp1->rB, vc->normal);
+			float32 rn2A = b2Cross(vcp2->rA, vc->normal);
+			float32 rn2B = b2Cross(vcp2->rB, vc->normal);
+
+			float32 k11 = mA + mB + iA * rn1A * rn1A + iB * rn1B * rn1B;
+			float32 k22 = mA + mB + iA * rn2A * rn2A + iB * rn2B * rn2B;
+			float32 k12 = mA + mB + iA * rn1A * rn2A + iB * rn1B * rn2B;
+
+			// Ensure a reasonable condition number.
+			if (k11 * k11 < k_maxConditionNumber * (k11 * k22 - k12 * k12))
+			{
+				// K is safe to invert.
+				vc->K.ex.Set(k11, k12);
+				vc->K.ey.Set(k12, k22);
+				vc->normalMass = vc->K.GetInverse();
+			}
+			else
+			{
+				// The constraints are redundant, just use one.
+				// TODO_ERIN use deepest?
+				vc->pointCount = 1;
+			}
+		}
+	}
+}
+
+void LabContactSolver::WarmStart()
+{
+	// Warm start.
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		LabContactVelocityConstraint* vc = m_velocityConstraints.data() + i;
+
+		int32 indexA = vc->indexA;
+		int32 indexB = vc->indexB;
+		float32 mA = vc->invMassA;
+		float32 iA = vc->invIA;
+		float32 mB = vc->invMassB;
+		float32 iB = vc->invIB;
+		int32 pointCount = vc->pointCount;
+
+		b2Vec2 vA = m_bodies->GetLinearVelocity(indexA);
+		float32 wA = m_bodies->w[indexA];
+		b2Vec2 vB = m_bodies->GetLinearVelocity(indexB);
+		float32 wB = m_bodies->w[indexB];
+
+		b2Vec2 normal = vc->normal;
+		b2Vec2 tangent = b2Cross(normal, 1.0f);
+
+		for (int32 j = 0; j < pointCount; ++j)
+		{
+			LabVelocityConstraintPoint* vcp = vc->points + j;
+			b2Vec2 P = vcp->normalImpulse * normal + vcp->tangentImpulse * tangent;
+			wA -= iA * b2Cross(vcp->rA, P);
+			vA -= mA * P;
+			wB += iB * b2Cross(vcp->rB, P);
+			vB += mB * P;
+		}
+
+		m_bodies->SetLinearVelocity(indexA, vA);
+		m_bodies->w[indexA] = wA;
+		m_bodies->SetLinearVelocity(indexB, vB);
+		m_bodies->w[indexB] = wB;
+	}
+}
+
+void LabContactSolver::SolveVelocityConstraints()
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		SolveVelocityConstraint(i);
+	}
+}
+
+void LabContactSolver::SolveVelocityConstraint(int32 index)
+{
+	LabContactVelocityConstraint* vc = m_velocityConstraints.data() + index;
+
+	int32 indexA = vc->indexA;
+	int32 indexB = vc->indexB;
+	float32 mA = vc->invMassA;
+	float32 iA = vc->invIA;
+	float32 mB = vc->invMassB;
+	float32 iB = vc->invIB;
+	int32 pointCount = vc->pointCount;
+
+	b2Vec2 vA = m_bodies->GetLinearVelocity(indexA);
+	float32 wA = m_bodies->w[indexA];
+	b2Vec2 vB = m_bodies->GetLinearVelocity(indexB);
+	float32 wB = m_bodies->w[indexB];
+
+	b2Vec2 normal = vc->normal;
+	b2Vec2 tangent = b2Cross(normal, 1.0f);
+	float32 friction = vc->friction;
+
+	// Solve tangent constraints first because non-penetration is more important
+	// than friction.
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		LabVelocityConstraintPoint* vcp = vc->points + j;
+
+		// Relative velocity at contact
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+
+		// Compute tangent force
+		float32 vt = b2Dot(dv, tangent);
+		float32 lambda = vcp->tangentMass * (-vt);
+
+		// b2Clamp the accumulated force
+		float32 maxFriction = friction * vcp->normalImpulse;
+		float32 newImpulse = b2Clamp(vcp->tangentImpulse + lambda, -maxFriction, maxFriction);
+		lambda = newImpulse - vcp->tangentImpulse;
+		vcp->tangentImpulse = newImpulse;
+
+		// Apply contact impulse
+		b2Vec2 P = lambda * tangent;
+
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
+
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
+
+	// Solve normal constraints
+	if (pointCount == 1)
+	{
+		LabVelocityConstraintPoint* vcp = vc->points + 0;
+
+		// Relative velocity at contact
+		b2Vec2 dv = vB + b2Cross(wB, vcp->rB) - vA - b2Cross(wA, vcp->rA);
+
+		// Compute normal impulse
+		float32 vn = b2Dot(dv, normal);
+		float32 lambda = -vcp->normalMass * (vn - vcp->velocityBias);
+
+		// b2Clamp the accumulated impulse
+		float32 newImpulse = b2Max(vcp->normalImpulse + lambda, 0.0f);
+		lambda = newImpulse - vcp->normalImpulse;
+		vcp->normalImpulse = newImpulse;
+
+		// Apply contact impulse
+		b2Vec2 P = lambda * normal;
+		vA -= mA * P;
+		wA -= iA * b2Cross(vcp->rA, P);
+
+		vB += mB * P;
+		wB += iB * b2Cross(vcp->rB, P);
+	}
+	else
+	{
+		// Block solver developed in collaboration with Dirk Gregorius (back in 01/07 on Box2D_Lite).
+		// See b2ContactSolver.cpp for the derivation; the four cases below
+		// are tried in order and the first admissible one is taken.
+		LabVelocityConstraintPoint* cp1 = vc->points + 0;
+		LabVelocityConstraintPoint* cp2 = vc->points + 1;
+
+		b2Vec2 a(cp1->normalImpulse, cp2->normalImpulse);
+		b2Assert(a.x >= 0.0f && a.y >= 0.0f);
+
+		// Relative velocity at contact
+		b2Vec2 dv1 = vB + b2Cross(wB, cp1->rB) - vA - b2Cross(wA, cp1->rA);
+		b2Vec2 dv2 = vB + b2Cross(wB, cp2->rB) - vA - b2Cross(wA, cp2->rA);
+
+		// Compute normal velocity
+		float32 vn1 = b2Dot(dv1, normal);
+		float32 vn2 = b2Dot(dv2, normal);
+
+		b2Vec2 b;
+		b.x = vn1 - cp1->velocityBias;
+		b.y = vn2 - cp2->velocityBias;
+
+		// Compute b'
+		b -= b2Mul(vc->K, a);
+
+		for (;;)
+		{
+			//
+			// Case 1: vn = 0
+			//
+			// 0 = A * x + b'
+			//
+			// Solve for x:
+			//
+			// x = - inv(A) * b'
+			//
+			b2Vec2 x = -b2Mul(vc->normalMass, b);
+
+			if (x.x >= 0.0f && x.y >= 0.0f)
+			{
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
+
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
+				break;
+			}
+
+			//
+			// Case 2: vn1 = 0 and x2 = 0
+			//
+			//   0 = a11 * x1 + a12 * 0 + b1'
+			// vn2 = a21 * x1 + a22 * 0 + b2'
+			//
+			x.x = -cp1->normalMass * b.x;
+			x.y = 0.0f;
+			vn1 = 0.0f;
+			vn2 = vc->K.ex.y * x.x + b.y;
+
+			if (x.x >= 0.0f && vn2 >= 0.0f)
+			{
+				// Get the incremental impulse
+				b2Vec2 d = x - a;
+
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
+				break;
+			}
+
+
+			//
+			// Case 3: vn2 = 0 and x1 = 0
+			//
+			// vn1 = a11 * 0 + a12 * x2 + b1'
+			//   0 = a21 * 0 + a22 * x2 + b2'
+			//
+			x.x = 0.0f;
+			x.y = -cp2->normalMass * b.y;
+			vn1 = vc->K.ey.x * x.y + b.x;
+			vn2 = 0.0f;
+
+			if (x.y >= 0.0f && vn1 >= 0.0f)
+			{
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
+
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
+				break;
+			}
+
+			//
+			// Case 4: x1 = 0 and x2 = 0
+			//
+			// vn1 = b1
+			// vn2 = b2;
+			x.x = 0.0f;
+			x.y = 0.0f;
+			vn1 = b.x;
+			vn2 = b.y;
+
+			if (vn1 >= 0.0f && vn2 >= 0.0f)
+			{
+				// Resubstitute for the incremental impulse
+				b2Vec2 d = x - a;
+
+				// Apply incremental impulse
+				b2Vec2 P1 = d.x * normal;
+				b2Vec2 P2 = d.y * normal;
+				vA -= mA * (P1 + P2);
+				wA -= iA * (b2Cross(cp1->rA, P1) + b2Cross(cp2->rA, P2));
+
+				vB += mB * (P1 + P2);
+				wB += iB * (b2Cross(cp1->rB, P1) + b2Cross(cp2->rB, P2));
+
+				// Accumulate
+				cp1->normalImpulse = x.x;
+				cp2->normalImpulse = x.y;
+
+				break;
+			}
+
+			// No solution, give up. This is hit sometimes, but it doesn't seem to matter.
+			break;
+		}
+	}
+
+	m_bodies->SetLinearVelocity(indexA, vA);
+	m_bodies->w[indexA] = wA;
+	m_bodies->SetLinearVelocity(indexB, vB);
+	m_bodies->w[indexB] = wB;
+}
+
+void LabContactSolver::StoreImpulses()
+{
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		LabContactVelocityConstraint* vc = m_velocityConstraints.data() + i;
+		b2Manifold* manifold = &m_contacts[vc->contactIndex]->manifold;
+
+		for (int32 j = 0; j < vc->pointCount; ++j)
+		{
+			manifold->points[j].normalImpulse = vc->points[j].normalImpulse;
+			manifold->points[j].tangentImpulse = vc->points[j].tangentImpulse;
+		}
+	}
+}
+
+struct LabPositionSolverManifold
+{
+	void Initialize(const LabContactPositionConstraint* pc, const b2Transform& xfA, const b2Transform& xfB, int32 index)
+	{
+		b2Assert(pc->pointCount > 0);
+
+		switch (pc->type)
+		{
+		case b2Manifold::e_circles:
+			{
+				b2Vec2 pointA = b2Mul(xfA, pc->localPoint);
+				b2Vec2 pointB = b2Mul(xfB, pc->localPoints[0]);
+				normal = pointB - pointA;
+				normal.Normalize();
+				point = 0.5f * (pointA + pointB);
+				separation = b2Dot(pointB - pointA, normal) - pc->radiusA - pc->radiusB;
+			}
+			break;
+
+		case b2Manifold::e_faceA:
+			{
+				normal = b2Mul(xfA.q, pc->localNormal);
+				b2Vec2 planePoint = b2Mul(xfA, pc->localPoint);
+
+				b2Vec2 clipPoint = b2Mul(xfB, pc->localPoints[index]);
+				separation = b2Dot(clipPoint - planePoint, normal) - pc->radiusA - pc->radiusB;
+				point = clipPoint;
+			}
+			break;
+
+		case b2Manifold::e_faceB:
+			{
+				normal = b2Mul(xfB.q, pc->localNormal);
+				b2Vec2 planePoint = b2Mul(xfB, pc->localPoint);
+
+				b2Vec2 clipPoint = b2Mul(xfA, pc->localPoints[index]);
+				separation = b2Dot(clipPoint - planePoint, normal) - pc->radiusA - pc->radiusB;
+				point = clipPoint;
+
+				// Ensure normal points from A to B
+				normal = -normal;
+			}
+			break;
+		}
+	}
+
+	b2Vec2 normal;
+	b2Vec2 point;
+	float32 separation;
+};
+
+bool LabContactSolver::SolvePositionConstraints()
+{
+	float32 minSeparation = 0.0f;
+
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		minSeparation = b2Min(minSeparation, SolvePositionConstraint(i));
+	}
+
+	// We can't expect minSpeparation >= -b2_linearSlop because we don't
+	// push the separation above -b2_linearSlop.
+	return minSeparation >= -3.0f * b2_linearSlop;
+}
+
+float32 LabContactSolver::SolvePositionConstraint(int32 index)
+{
+	const LabContactPositionConstraint* pc = m_positionConstraints.data() + index;
+
+	int32 indexA = pc->indexA;
+	int32 indexB = pc->indexB;
+	b2Vec2 localCenterA = pc->localCenterA;
+	float32 mA = pc->invMassA;
+	float32 iA = pc->invIA;
+	b2Vec2 localCenterB = pc->localCenterB;
+	float32 mB = pc->invMassB;
+	float32 iB = pc->invIB;
+	int32 pointCount = pc->pointCount;
+
+	b2Vec2 cA = m_bodies->GetCenter(indexA);
+	float32 aA = m_bodies->a[indexA];
+
+	b2Vec2 cB = m_bodies->GetCenter(indexB);
+	float32 aB = m_bodies->a[indexB];
+
+	float32 minSeparation = 0.0f;
+
+	// Solve normal constraints
+	for (int32 j = 0; j < pointCount; ++j)
+	{
+		b2Transform xfA, xfB;
+		xfA.q.Set(aA);
+		xfB.q.Set(aB);
+		xfA.p = cA - b2Mul(xfA.q, localCenterA);
+		xfB.p = cB - b2Mul(xfB.q, localCenterB);
+
+		LabPositionSolverManifold psm;
+		psm.Initialize(pc, xfA, xfB, j);
+		b2Vec2 normal = psm.normal;
+
+		b2Vec2 point = psm.point;
+		float32 separation = psm.separation;
+
+		b2Vec2 rA = point - cA;
+		b2Vec2 rB = point - cB;
+
+		// Track max constraint error.
+		minSeparation = b2Min(minSeparation, separation);
+
+		// Prevent large corrections and allow slop.
+		float32 C = b2Clamp(b2_baumgarte * (separation + b2_linearSlop), -b2_maxLinearCorrection, 0.0f);
+
+		// Compute the effective mass.
+		float32 rnA = b2Cross(rA, normal);
+		float32 rnB = b2Cross(rB, normal);
+		float32 K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+
+		// Compute normal impulse
+		float32 impulse = K > 0.0f ? - C / K : 0.0f;
+
+		b2Vec2 P = impulse * normal;
+
+		cA -= mA * P;
+		aA -= iA * b2Cross(rA, P);
+
+		cB += mB * P;
+		aB += iB * b2Cross(rB, P);
+	}
+
+	m_bodies->SetCenter(indexA, cA);
+	m_bodies->a[indexA] = aA;
+
+	m_bodies->SetCenter(indexB, cB);
+	m_bodies->a[indexB] = aB;
+
+	return minSeparation;
+}
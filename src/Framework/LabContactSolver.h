@@ -0,0 +1,98 @@
+#pragma once
+#include "LabBodyArrays.h"
+#include <vector>
+
+struct LabContact;
+
+struct LabTimeStep
+{
+	float32 dt;
+	float32 inv_dt;
+	float32 dtRatio;
+	int32 velocityIterations;
+	int32 positionIterations;
+	bool warmStarting;
+};
+
+// The solver reads masses and updates positions and velocities in place.
+struct LabContactSolverDef
+{
+	LabTimeStep step;
+	LabContact* const* contacts;
+	int32 count;
+	LabBodyArrays* bodies;
+};
+
+struct LabVelocityConstraintPoint
+{
+	b2Vec2 rA;
+	b2Vec2 rB;
+	float32 normalImpulse;
+	float32 tangentImpulse;
+	float32 normalMass;
+	float32 tangentMass;
+	float32 velocityBias;
+};
+
+struct LabContactVelocityConstraint
+{
+	LabVelocityConstraintPoint points[b2_maxManifoldPoints];
+	b2Vec2 normal;
+	b2Mat22 normalMass;
+	b2Mat22 K;
+	int32 indexA;
+	int32 indexB;
+	float32 invMassA, invMassB;
+	float32 invIA, invIB;
+	float32 friction;
+	float32 restitution;
+	int32 pointCount;
+	int32 contactIndex;
+};
+
+struct LabContactPositionConstraint
+{
+	b2Vec2 localPoints[b2_maxManifoldPoints];
+	b2Vec2 localNormal;
+	b2Vec2 localPoint;
+	int32 indexA;
+	int32 indexB;
+	float32 invMassA, invMassB;
+	b2Vec2 localCenterA, localCenterB;
+	float32 invIA, invIB;
+	b2Manifold::Type type;
+	float32 radiusA, radiusB;
+	int32 pointCount;
+};
+
+// Sequential impulse contact solver, a port of b2ContactSolver that works
+// on the lab world's contacts. One constraint at a time, in contact order.
+class LabContactSolver
+{
+public:
+	void Initialize(const LabContactSolverDef& def);
+
+	void InitializeVelocityConstraints();
+	void WarmStart();
+	void SolveVelocityConstraints();
+	void StoreImpulses();
+
+	// True once the largest penetration is within tolerance.
+	bool SolvePositionConstraints();
+
+	// Single constraints, for solvers that batch the rest themselves.
+	void SolveVelocityConstraint(int32 index);
+	float32 SolvePositionConstraint(int32 index);
+
+	int32 GetCount() const { return m_count; }
+	LabContactVelocityConstraint* GetVelocityConstraints() { return m_velocityConstraints.data(); }
+	const LabContactPositionConstraint* GetPositionConstraints() const { return m_positionConstraints.data(); }
+
+private:
+	LabTimeStep m_step;
+	LabBodyArrays* m_bodies;
+	LabContact* const* m_contacts;
+	int32 m_count;
+	std::vector<LabContactVelocityConstraint> m_velocityConstraints;
+	std::vector<LabContactPositionConstraint> m_positionConstraints;
+};
@@ -0,0 +1,259 @@
+#include "LabGridBroadPhase.h"
+#include <cmath>
+
+LabGridBroadPhase::LabGridBroadPhase()
+{
+	m_cellSize = 0.0f;
+	m_inverseCellSize = 0.0f;
+}
+
+uint64_t LabGridBroadPhase::CellKey(int32 x, int32 y)
+{
+	return (uint64_t((uint32)x) << 32) | (uint32)y;
+}
+
+// The cell holding coordinate v. The cell is clamped while still a float,
+// so converting a far or non-finite coordinate is defined; the grid then
+// lumps everything beyond the limit into its edge cells.
+static int32 GetCell(float32 v, float32 inverseCellSize)
+{
+	const float32 k_cellLimit = 1073741824.0f;
+	return (int32)b2Clamp(floorf(v * inverseCellSize), -k_cellLimit, k_cellLimit);
+}
+
+void LabGridBroadPhase::AddToCells(int32 proxyId)
+{
+	Proxy* proxy = &m_proxies[proxyId];
+	proxy->lowerX = GetCell(proxy->aabb.lowerBound.x, m_inverseCellSize);
+	proxy->lowerY = GetCell(proxy->aabb.lowerBound.y, m_inverseCellSize);
+	proxy->upperX = GetCell(proxy->aabb.upperBound.x, m_inverseCellSize);
+	proxy->upperY = GetCell(proxy->aabb.upperBound.y, m_inverseCellSize);
+
+	// Clamped cells still span up to 2^31 per axis, so the extents are
+	// checked one at a time before they are multiplied.
+	int64_t width = int64_t(proxy->upperX) - proxy->lowerX + 1;
+	int64_t height = int64_t(proxy->upperY) - proxy->lowerY + 1;
+	if (width > e_maxProxyCells || height > e_maxProxyCells || width * height > e_maxProxyCells)
+	{
+		proxy->largeIndex = (int32)m_largeProxies.size();
+		m_largeProxies.push_back(proxyId);
+		return;
+	}
+
+	for (int32 y = proxy->lowerY; y <= proxy->upperY; ++y)
+	{
+		for (int32 x = proxy->lowerX; x <= proxy->upperX; ++x)
+		{
+			m_cells[CellKey(x, y)].push_back(proxyId);
+		}
+	}
+}
+
+void LabGridBroadPhase::RemoveFromCells(int32 proxyId)
+{
+	Proxy* proxy = &m_proxies[proxyId];
+	if (proxy->largeIndex != -1)
+	{
+		int32 last = m_largeProxies.back();
+		m_largeProxies[proxy->largeIndex] = last;
+		m_proxies[last].largeIndex = proxy->largeIndex;
+		m_largeProxies.pop_back();
+		proxy->largeIndex = -1;
+		return;
+	}
+
+	for (int32 y = proxy->lowerY; y <= proxy->upperY; ++y)
+	{
+		for (int32 x = proxy->lowerX; x <= proxy->upperX; ++x)
+		{
+			std::unordered_map<uint64_t, std::vector<int32> >::iterator it = m_cells.find(CellKey(x, y));
+			b2Assert(it != m_cells.end());
+			std::vector<int32>& cell = it->second;
+			for (int32 i = 0; i < (int32)cell.size(); ++i)
+			{
+				if (cell[i] == proxyId)
+				{
+					cell[i] = cell.back();
+					cell.pop_back();
+					break;
+				}
+			}
+
+			if (cell.empty())
+			{
+				m_cells.erase(it);
+			}
+		}
+	}
+}
+
+int32 LabGridBroadPhase::CreateProxy(const b2AABB& aabb, LabProxyType type, void* userData)
+{
+	int32 proxyId = (int32)m_proxies.size();
+
+	Proxy proxy;
+	proxy.aabb = Fatten(aabb);
+	proxy.userData = userData;
+	proxy.type = type;
+	proxy.lowerX = proxy.lowerY = 0;
+	proxy.upperX = proxy.upperY = -1;
+	proxy.largeIndex = -1;
+	proxy.moved = true;
+	m_proxies.push_back(proxy);
+	m_moveBuffer.push_back(proxyId);
+
+	if (m_cellSize > 0.0f)
+	{
+		AddToCells(proxyId);
+	}
+
+	return proxyId;
+}
+
+void LabGridBroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	Proxy* proxy = &m_proxies[proxyId];
+	if (proxy->aabb.Contains(aabb))
+	{
+		return;
+	}
+
+	b2AABB fatAABB = Fatten(aabb, displacement);
+	if (m_cellSize > 0.0f)
+	{
+		// Most moves stay within the same cells.
+		int32 lowerX = GetCell(fatAABB.lowerBound.x, m_inverseCellSize);
+		int32 lowerY = GetCell(fatAABB.lowerBound.y, m_inverseCellSize);
+		int32 upperX = GetCell(fatAABB.upperBound.x, m_inverseCellSize);
+		int32 upperY = GetCell(fatAABB.upperBound.y, m_inverseCellSize);
+		if (proxy->largeIndex != -1 || lowerX != proxy->lowerX || lowerY != proxy->lowerY || upperX != proxy->upperX || upperY != proxy->upperY)
+		{
+			RemoveFromCells(proxyId);
+			proxy->aabb = fatAABB;
+			AddToCells(proxyId);
+		}
+	}
+	proxy->aabb = fatAABB;
+
+	if (proxy->moved == false)
+	{
+		proxy->moved = true;
+		m_moveBuffer.push_back(proxyId);
+	}
+}
+
+void LabGridBroadPhase::SetFatAABB(int32 proxyId, const b2AABB& fatAABB)
+{
+	if (m_cellSize > 0.0f)
+	{
+		RemoveFromCells(proxyId);
+		m_proxies[proxyId].aabb = fatAABB;
+		AddToCells(proxyId);
+	}
+	else
+	{
+		m_proxies[proxyId].aabb = fatAABB;
+	}
+}
+
+void LabGridBroadPhase::ChooseCellSize()
+{
+	float32 totalSize = 0.0f;
+	int32 count = 0;
+	for (int32 pass = 0; pass < 2 && count == 0; ++pass)
+	{
+		// Static proxies only count when there is nothing else.
+		for (int32 i = 0; i < (int32)m_proxies.size(); ++i)
+		{
+			const Proxy* proxy = &m_proxies[i];
+			if (pass == 0 && proxy->type == e_labStaticProxy)
+			{
+				continue;
+			}
+
+			b2Vec2 extents = proxy->aabb.upperBound - proxy->aabb.lowerBound;
+			totalSize += b2Max(extents.x, extents.y);
+			++count;
+		}
+	}
+
+	m_cellSize = count > 0 ? 2.0f * totalSize / count : 1.0f;
+	m_inverseCellSize = 1.0f / m_cellSize;
+
+	for (int32 i = 0; i < (int32)m_proxies.size(); ++i)
+	{
+		AddToCells(i);
+	}
+}
+
+void LabGridBroadPhase::AddPair(std::vector<b2Pair>* pairs, int32 proxyIdA, int32 proxyIdB) const
+{
+	const Proxy* proxyA = &m_proxies[proxyIdA];
+	const Proxy* proxyB = &m_proxies[proxyIdB];
+	if (proxyIdA == proxyIdB || (proxyA->type == e_labStaticProxy && proxyB->type == e_labStaticProxy))
+	{
+		return;
+	}
+
+	if (b2TestOverlap(proxyA->aabb, proxyB->aabb) == false)
+	{
+		return;
+	}
+
+	b2Pair pair;
+	pair.proxyIdA = b2Min(proxyIdA, proxyIdB);
+	pair.proxyIdB = b2Max(proxyIdA, proxyIdB);
+	pairs->push_back(pair);
+}
+
+void LabGridBroadPhase::FindPairs(std::vector<b2Pair>* pairs)
+{
+	if (m_cellSize == 0.0f)
+	{
+		ChooseCellSize();
+	}
+
+	int32 proxyCount = (int32)m_proxies.size();
+	for (int32 i = 0; i < (int32)m_moveBuffer.size(); ++i)
+	{
+		int32 proxyId = m_moveBuffer[i];
+		Proxy* proxy = &m_proxies[proxyId];
+		proxy->moved = false;
+
+		if (proxy->largeIndex != -1)
+		{
+			for (int32 other = 0; other < proxyCount; ++other)
+			{
+				AddPair(pairs, proxyId, other);
+			}
+			continue;
+		}
+
+		for (int32 y = proxy->lowerY; y <= proxy->upperY; ++y)
+		{
+			for (int32 x = proxy->lowerX; x <= proxy->upperX; ++x)
+			{
+				const std::vector<int32>& cell = m_cells[CellKey(x, y)];
+				for (int32 j = 0; j < (int32)cell.size(); ++j)
+				{
+					// Two proxies can share several cells. Only the one holding
+					// the lower corner of their common cell range reports them.
+					const Proxy* other = &m_proxies[cell[j]];
+					if (b2Max(proxy->lowerX, other->lowerX) != x || b2Max(proxy->lowerY, other->lowerY) != y)
+					{
+						continue;
+					}
+
+					AddPair(pairs, proxyId, cell[j]);
+				}
+			}
+		}
+
+		for (int32 j = 0; j < (int32)m_largeProxies.size(); ++j)
+		{
+			AddPair(pairs, proxyId, m_largeProxies[j]);
+		}
+	}
+
+	m_moveBuffer.resize(0);
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "LabBroadPhase.h"
+#include <cstdint>
+#include <unordered_map>
+
+// A uniform grid stored in a hash map, so the world has no bounds. Each
+// proxy is listed in every cell its fat AABB touches, and a moved proxy
+// only tests the proxies that share a cell with it. The cell size is fixed
+// the first time pairs are found: twice the average size of the proxies
+// that are not static, which suits scenes of many similar bodies. Proxies
+// spanning too many cells, like a long ground box, go in a list that every
+// moved proxy tests directly.
+class LabGridBroadPhase : public LabBroadPhase
+{
+public:
+	enum
+	{
+		e_maxProxyCells = 64
+	};
+
+	LabGridBroadPhase();
+
+	Type GetType() const override { return e_hashedGrid; }
+
+	int32 CreateProxy(const b2AABB& aabb, LabProxyType type, void* userData) override;
+	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement) override;
+	void SetProxyType(int32 proxyId, LabProxyType type) override { m_proxies[proxyId].type = type; }
+	LabProxyType GetProxyType(int32 proxyId) const override { return m_proxies[proxyId].type; }
+	void SetFatAABB(int32 proxyId, const b2AABB& fatAABB) override;
+
+	void* GetUserData(int32 proxyId) const override { return m_proxies[proxyId].userData; }
+	const b2AABB& GetFatAABB(int32 proxyId) const override { return m_proxies[proxyId].aabb; }
+	int32 GetProxyCount() const override { return (int32)m_proxies.size(); }
+
+	float32 GetCellSize() const { return m_cellSize; }
+	int32 GetCellCount() const { return (int32)m_cells.size(); }
+
+protected:
+	void FindPairs(std::vector<b2Pair>* pairs) override;
+
+private:
+	struct Proxy
+	{
+		b2AABB aabb;
+		void* userData;
+		LabProxyType type;
+
+		// Cell range, or lowerX > upperX when the proxy is not in the grid.
+		int32 lowerX;
+		int32 lowerY;
+		int32 upperX;
+		int32 upperY;
+
+		// Index in m_largeProxies, or -1.
+		int32 largeIndex;
+
+		bool moved;
+	};
+
+	static uint64_t CellKey(int32 x, int32 y);
+	void AddToCells(int32 proxyId);
+	void RemoveFromCells(int32 proxyId);
+	void ChooseCellSize();
+	void AddPair(std::vector<b2Pair>* pairs, int32 proxyIdA, int32 proxyIdB) const;
+
+	std::vector<Proxy> m_proxies;
+	std::unordered_map<uint64_t, std::vector<int32> > m_cells;
+	std::vector<int32> m_largeProxies;
+	std::vector<int32> m_moveBuffer;
+	float32 m_cellSize;
+	float32 m_inverseCellSize;
+};
@@ -0,0 +1,144 @@
+#include "LabSapBroadPhase.h"
+
+LabSapBroadPhase::LabSapBroadPhase()
+{
+}
+
+void LabSapBroadPhase::SetBounds(int32 proxyId)
+{
+	const Proxy* proxy = &m_proxies[proxyId];
+	Entry* entry = &m_entries[proxy->entry];
+	entry->lowerX = proxy->aabb.lowerBound.x;
+	entry->upperX = proxy->aabb.upperBound.x;
+	entry->lowerY = proxy->aabb.lowerBound.y;
+	entry->upperY = proxy->aabb.upperBound.y;
+	entry->proxyId = proxyId;
+	entry->isStatic = proxy->type == e_labStaticProxy;
+}
+
+void LabSapBroadPhase::SetEntry(int32 proxyId)
+{
+	SetBounds(proxyId);
+
+	Entry* entry = &m_entries[m_proxies[proxyId].entry];
+	if (entry->moved == false)
+	{
+		entry->moved = true;
+		m_moveBuffer.push_back(proxyId);
+	}
+}
+
+int32 LabSapBroadPhase::CreateProxy(const b2AABB& aabb, LabProxyType type, void* userData)
+{
+	int32 proxyId = (int32)m_proxies.size();
+
+	Proxy proxy;
+	proxy.aabb = Fatten(aabb);
+	proxy.userData = userData;
+	proxy.type = type;
+	proxy.entry = (int32)m_entries.size();
+	m_proxies.push_back(proxy);
+
+	Entry entry;
+	entry.moved = false;
+	m_entries.push_back(entry);
+	SetEntry(proxyId);
+
+	return proxyId;
+}
+
+void LabSapBroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	Proxy* proxy = &m_proxies[proxyId];
+	if (proxy->aabb.Contains(aabb))
+	{
+		return;
+	}
+
+	proxy->aabb = Fatten(aabb, displacement);
+	SetEntry(proxyId);
+}
+
+// The entries may now be out of order; the next sweep sorts them first.
+void LabSapBroadPhase::SetFatAABB(int32 proxyId, const b2AABB& fatAABB)
+{
+	m_proxies[proxyId].aabb = fatAABB;
+	SetBounds(proxyId);
+}
+
+void LabSapBroadPhase::SetProxyType(int32 proxyId, LabProxyType type)
+{
+	Proxy* proxy = &m_proxies[proxyId];
+	proxy->type = type;
+	m_entries[proxy->entry].isStatic = type == e_labStaticProxy;
+}
+
+// Insertion sort by lower x. Moved proxies only shift a few places.
+void LabSapBroadPhase::SortEntries()
+{
+	int32 count = (int32)m_entries.size();
+	for (int32 i = 1; i < count; ++i)
+	{
+		if (m_entries[i - 1].lowerX <= m_entries[i].lowerX)
+		{
+			continue;
+		}
+
+		Entry entry = m_entries[i];
+		int32 j = i;
+		while (j > 0 && m_entries[j - 1].lowerX > entry.lowerX)
+		{
+			m_entries[j] = m_entries[j - 1];
+			m_proxies[m_entries[j].proxyId].entry = j;
+			--j;
+		}
+		m_entries[j] = entry;
+		m_proxies[entry.proxyId].entry = j;
+	}
+}
+
+void LabSapBroadPhase::FindPairs(std::vector<b2Pair>* pairs)
+{
+	if (m_moveBuffer.empty())
+	{
+		return;
+	}
+
+	SortEntries();
+
+	int32 count = (int32)m_entries.size();
+	const Entry* entries = m_entries.data();
+	for (int32 i = 0; i < count; ++i)
+	{
+		const Entry* a = entries + i;
+		for (int32 j = i + 1; j < count && entries[j].lowerX <= a->upperX; ++j)
+		{
+			const Entry* b = entries + j;
+			if (a->moved == false && b->moved == false)
+			{
+				continue;
+			}
+
+			if (a->isStatic && b->isStatic)
+			{
+				continue;
+			}
+
+			if (b->lowerY > a->upperY || a->lowerY > b->upperY)
+			{
+				continue;
+			}
+
+			b2Pair pair;
+			pair.proxyIdA = b2Min(a->proxyId, b->proxyId);
+			pair.proxyIdB = b2Max(a->proxyId, b->proxyId);
+			pairs->push_back(pair);
+		}
+	}
+
+	for (int32 i = 0; i < (int32)m_moveBuffer.size(); ++i)
+	{
+		m_entries[m_proxies[m_moveBuffer[i]].entry].moved = false;
+	}
+	m_moveBuffer.resize(0);
+}
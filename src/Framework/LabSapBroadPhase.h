@@ -0,0 +1,57 @@
+#pragma once
+#include "LabBroadPhase.h"
+
+// Sweep and prune on the x axis. The fat AABBs are kept in an array sorted
+// by lower x, which stays nearly sorted from step to step, so an insertion
+// sort puts it back in order cheaply. A sweep over the array then tests
+// every pair that overlaps on x and involves a moved proxy. It suits many
+// small proxies spread out along x; long static boxes on x cost it dearly.
+class LabSapBroadPhase : public LabBroadPhase
+{
+public:
+	LabSapBroadPhase();
+
+	Type GetType() const override { return e_sweepAndPrune; }
+
+	int32 CreateProxy(const b2AABB& aabb, LabProxyType type, void* userData) override;
+	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement) override;
+	void SetProxyType(int32 proxyId, LabProxyType type) override;
+	LabProxyType GetProxyType(int32 proxyId) const override { return m_proxies[proxyId].type; }
+	void SetFatAABB(int32 proxyId, const b2AABB& fatAABB) override;
+
+	void* GetUserData(int32 proxyId) const override { return m_proxies[proxyId].userData; }
+	const b2AABB& GetFatAABB(int32 proxyId) const override { return m_proxies[proxyId].aabb; }
+	int32 GetProxyCount() const override { return (int32)m_proxies.size(); }
+
+protected:
+	void FindPairs(std::vector<b2Pair>* pairs) override;
+
+private:
+	struct Proxy
+	{
+		b2AABB aabb;
+		void* userData;
+		LabProxyType type;
+		int32 entry;
+	};
+
+	// A copy of the bounds in sort order, so the sweep reads memory in order.
+	struct Entry
+	{
+		float32 lowerX;
+		float32 upperX;
+		float32 lowerY;
+		float32 upperY;
+		int32 proxyId;
+		bool moved;
+		bool isStatic;
+	};
+
+	void SetBounds(int32 proxyId);
+	void SetEntry(int32 proxyId);
+	void SortEntries();
+
+	std::vector<Proxy> m_proxies;
+	std::vector<Entry> m_entries;
+	std::vector<int32> m_moveBuffer;
+};
@@ -0,0 +1,169 @@
+#include "LabTest.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+LabTest::LabTest()
+{
+	b2Vec2 gravity;
+	gravity.Set(0.0f, -10.0f);
+	m_lab = new LabWorld(gravity);
+	m_broadPhaseChosen = false;
+	m_rewind = 0;
+}
+
+LabTest::~LabTest()
+{
+	delete m_lab;
+	m_lab = NULL;
+}
+
+void LabTest::StepWorld(Settings* settings, float32 timeStep, b2Profile* profile)
+{
+	m_lab->SetAllowSleeping(settings->enableSleep);
+	m_lab->SetWarmStarting(settings->enableWarmStarting);
+	m_lab->SetSolverType((LabWorld::SolverType)settings->labSolver);
+
+	// Switching later would mix the costs of two backends in the profile.
+	if (m_broadPhaseChosen == false)
+	{
+		m_lab->SetBroadPhaseType((LabBroadPhase::Type)settings->labBroadPhase);
+		m_broadPhaseChosen = true;
+	}
+
+	// Rewound states are only shown; the world steps on once the setting is
+	// back at zero, from the last state shown.
+	int32 rewind = b2Min(settings->labRewind, m_states.GetCount() - 1);
+	if (rewind > 0 && rewind != m_rewind)
+	{
+		if (m_lab->RestoreState(m_states.Get(rewind)))
+		{
+			m_rewind = rewind;
+		}
+		else
+		{
+			// Bodies or fixtures were added since the states were saved, so
+			// none of them fits the world any more; step on from here.
+			m_states.Clear();
+			m_rewind = 0;
+			rewind = 0;
+		}
+	}
+
+	if (rewind == 0)
+	{
+		if (m_rewind > 0)
+		{
+			m_states.Drop(m_rewind);
+			m_rewind = 0;
+		}
+
+		m_lab->Step(timeStep, settings->velocityIterations, settings->positionIterations);
+
+		if (timeStep > 0.0f)
+		{
+			m_states.Push(m_lab);
+		}
+	}
+
+	*profile = m_lab->GetProfile();
+	m_lab->DrawDebugData(&g_debugDraw);
+
+	if (settings->drawStats)
+	{
+		const LabWideSolver& wide = m_lab->GetWideSolver();
+		g_debugDraw.DrawString(5, m_textLine, "lab bodies/contacts/awake = %d/%d/%d",
+			m_lab->GetBodyCount(), m_lab->GetContactCount(), m_lab->GetAwakeBodyCount());
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "lab saved states = %d (%d kB), rewound %d",
+			m_states.GetCount(), m_states.GetByteCount() / 1024, m_rewind);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		if (m_lab->GetSolverType() == LabWorld::e_wideSolver)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "lab colors/batches/leftovers = %d/%d/%d (%d lanes)",
+				wide.GetColorCount(), wide.GetBatchCount(), wide.GetLeftoverCount(), (int32)k_simdWidth);
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+	}
+
+	if (settings->drawProfile)
+	{
+		g_debugDraw.DrawString(5, m_textLine, "lab broad-phase = %s, %5.2f ms",
+			LabBroadPhase::GetName(m_lab->GetBroadPhaseType()), profile->broadphase);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+}
+
+uint32 LabTest::ComputeChecksum() const
+{
+	return m_lab->ComputeChecksum();
+}
+
+// Same settling time as the Lab Pyramid scene.
+static const int32 k_labSettleSteps = 300;
+
+void RunLabSolverReport(const Settings& settings, int32 stepCount)
+{
+	const TestEntry* entry = FindTestEntry("Lab Pyramid");
+	if (entry == NULL || stepCount <= 0)
+	{
+		return;
+	}
+
+	HeadlessDrawScope drawScope;
+
+	Settings runSettings = MakeHeadlessSettings(settings);
+
+	printf("%s, %d steps at %d/%d iterations, %d lanes\n", entry->name, stepCount,
+		runSettings.velocityIterations, runSettings.positionIterations, (int32)k_simdWidth);
+	printf("solver       ave solve ms  p99 solve ms   top y   max drift\n");
+
+	std::vector<float32> times(stepCount);
+	std::vector<b2Vec2> settled;
+	for (int32 type = 0; type < LabWorld::e_solverTypeCount; ++type)
+	{
+		runSettings.labSolver = type;
+
+		// Every lab scene is a LabTest.
+		LabTest* test = static_cast<LabTest*>(entry->createFcn());
+		const LabWorld* lab = test->GetLabWorld();
+
+		float32 total = 0.0f;
+		float32 maxDrift = 0.0f;
+		for (int32 i = 0; i < stepCount; ++i)
+		{
+			test->Step(&runSettings);
+			times[i] = test->GetLastProfile().solve;
+			total += times[i];
+
+			int32 bodyCount = lab->GetBodyCount();
+			if (i + 1 == k_labSettleSteps)
+			{
+				settled.resize(bodyCount);
+				for (int32 j = 0; j < bodyCount; ++j)
+				{
+					settled[j] = lab->GetTransform(j).p;
+				}
+			}
+			else if (i + 1 > k_labSettleSteps)
+			{
+				for (int32 j = 0; j < bodyCount; ++j)
+				{
+					maxDrift = b2Max(maxDrift, b2Distance(lab->GetTransform(j).p, settled[j]));
+				}
+			}
+		}
+
+		float32 top = lab->GetTransform(lab->GetBodyCount() - 1).p.y;
+		delete test;
+
+		int32 index = (int32)(0.99f * (stepCount - 1));
+		std::nth_element(times.begin(), times.begin() + index, times.end());
+
+		printf("%-12s %12.3f %13.3f %7.3f %11.4f\n", LabWorld::GetSolverName((LabWorld::SolverType)type),
+			total / stepCount, times[index], top, maxDrift);
+		fflush(stdout);
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "Test.h"
+#include "LabWorld.h"
+
+// Base for scenes that run in a LabWorld instead of m_world. The testbed's
+// sleep, warm starting, iteration and lab solver settings apply, and the
+// lab broad-phase setting is taken on the first step; mouse joints, bombs
+// and contact point drawing only see m_world and do nothing. The state after
+// each step is kept so the lab rewind setting can go back through the last
+// few; stepping on from a rewound state forgets the ones after it.
+class LabTest : public Test
+{
+public:
+	LabTest();
+	virtual ~LabTest();
+
+	int32 GetBodyCount() const override { return m_lab->GetBodyCount(); }
+	int32 GetContactCount() const override { return m_lab->GetContactCount(); }
+
+	const LabWorld* GetLabWorld() const { return m_lab; }
+
+protected:
+	void StepWorld(Settings* settings, float32 timeStep, b2Profile* profile) override;
+	uint32 ComputeChecksum() const override;
+
+	LabWorld* m_lab;
+	bool m_broadPhaseChosen;
+	LabStateRing m_states;
+	int32 m_rewind;
+};
+
+// Headless: steps Lab Pyramid with each lab solver and prints the average
+// and p99 solve time, the top box height and the largest drift after the
+// stack settled, the figures the wide solver was measured by.
+void RunLabSolverReport(const Settings& settings, int32 stepCount);
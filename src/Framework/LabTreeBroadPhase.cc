@@ -0,0 +1,199 @@
+#include "LabTreeBroadPhase.h"
+
+LabTreeBroadPhase::LabTreeBroadPhase()
+{
+	m_pairs = NULL;
+	m_queryProxyId = b2_nullNode;
+	m_queryTree = NULL;
+	m_splitMode = e_sleepingSplit;
+	m_staticTreeDirty = false;
+}
+
+const char* LabTreeBroadPhase::GetSplitModeName(SplitMode mode)
+{
+	switch (mode)
+	{
+	case e_singleTree:
+		return "single tree";
+
+	case e_staticSplit:
+		return "static + moving trees";
+
+	case e_sleepingSplit:
+		return "static + awake + sleeping trees";
+
+	default:
+		return "unknown";
+	}
+}
+
+int32 LabTreeBroadPhase::GetTreeIndex(LabProxyType type) const
+{
+	switch (m_splitMode)
+	{
+	case e_singleTree:
+		return e_labDynamicProxy;
+
+	case e_staticSplit:
+		return type == e_labStaticProxy ? e_labStaticProxy : e_labDynamicProxy;
+
+	default:
+		return type;
+	}
+}
+
+// Adds the proxy to the tree for its type. The tree fattens the box again,
+// so take the margin off first; rounding can still move a bound by an ulp,
+// in which case the fat AABB is put back exactly.
+void LabTreeBroadPhase::InsertProxy(int32 proxyId, const b2AABB& fatAABB)
+{
+	Proxy* proxy = &m_proxies[proxyId];
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b2AABB aabb;
+	aabb.lowerBound = fatAABB.lowerBound + r;
+	aabb.upperBound = fatAABB.upperBound - r;
+
+	proxy->tree = GetTreeIndex(proxy->type);
+	proxy->treeProxyId = m_trees[proxy->tree].CreateProxy(aabb, (void*)(intptr_t)proxyId);
+	m_trees[proxy->tree].SetFatAABB(proxy->treeProxyId, fatAABB);
+
+	if (proxy->tree == e_labStaticProxy)
+	{
+		m_staticTreeDirty = true;
+	}
+}
+
+int32 LabTreeBroadPhase::CreateProxy(const b2AABB& aabb, LabProxyType type, void* userData)
+{
+	int32 proxyId = (int32)m_proxies.size();
+
+	Proxy proxy;
+	proxy.type = type;
+	proxy.tree = GetTreeIndex(type);
+	proxy.userData = userData;
+	proxy.treeProxyId = m_trees[proxy.tree].CreateProxy(aabb, (void*)(intptr_t)proxyId);
+	m_proxies.push_back(proxy);
+
+	if (proxy.tree == e_labStaticProxy)
+	{
+		m_staticTreeDirty = true;
+	}
+
+	m_moveBuffer.push_back(proxyId);
+	return proxyId;
+}
+
+void LabTreeBroadPhase::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	Proxy* proxy = &m_proxies[proxyId];
+	bool buffer = m_trees[proxy->tree].MoveProxy(proxy->treeProxyId, aabb, displacement);
+	if (buffer)
+	{
+		m_moveBuffer.push_back(proxyId);
+	}
+}
+
+void LabTreeBroadPhase::SetProxyType(int32 proxyId, LabProxyType type)
+{
+	Proxy* proxy = &m_proxies[proxyId];
+	if (proxy->type == type)
+	{
+		return;
+	}
+
+	proxy->type = type;
+	if (GetTreeIndex(type) == proxy->tree)
+	{
+		return;
+	}
+
+	b2AABB fatAABB = m_trees[proxy->tree].GetFatAABB(proxy->treeProxyId);
+	m_trees[proxy->tree].DestroyProxy(proxy->treeProxyId);
+	InsertProxy(proxyId, fatAABB);
+}
+
+void LabTreeBroadPhase::SetFatAABB(int32 proxyId, const b2AABB& fatAABB)
+{
+	const Proxy* proxy = &m_proxies[proxyId];
+	if (m_trees[proxy->tree].SetFatAABB(proxy->treeProxyId, fatAABB) && proxy->tree == e_labStaticProxy)
+	{
+		m_staticTreeDirty = true;
+	}
+}
+
+void LabTreeBroadPhase::SetSplitMode(SplitMode mode)
+{
+	if (mode == m_splitMode)
+	{
+		return;
+	}
+
+	m_splitMode = mode;
+	for (int32 i = 0; i < (int32)m_proxies.size(); ++i)
+	{
+		Proxy* proxy = &m_proxies[i];
+		if (GetTreeIndex(proxy->type) == proxy->tree)
+		{
+			continue;
+		}
+
+		b2AABB fatAABB = m_trees[proxy->tree].GetFatAABB(proxy->treeProxyId);
+		m_trees[proxy->tree].DestroyProxy(proxy->treeProxyId);
+		InsertProxy(i, fatAABB);
+	}
+}
+
+const b2AABB& LabTreeBroadPhase::GetFatAABB(int32 proxyId) const
+{
+	const Proxy* proxy = &m_proxies[proxyId];
+	return m_trees[proxy->tree].GetFatAABB(proxy->treeProxyId);
+}
+
+bool LabTreeBroadPhase::QueryCallback(int32 treeProxyId)
+{
+	int32 proxyId = (int32)(intptr_t)m_queryTree->GetUserData(treeProxyId);
+
+	// A proxy cannot form a pair with itself.
+	if (proxyId == m_queryProxyId)
+	{
+		return true;
+	}
+
+	b2Pair pair;
+	pair.proxyIdA = b2Min(proxyId, m_queryProxyId);
+	pair.proxyIdB = b2Max(proxyId, m_queryProxyId);
+	m_pairs->push_back(pair);
+	return true;
+}
+
+// Queries every tree with each moved proxy. Static proxies never pair with
+// each other, so they skip the static tree.
+void LabTreeBroadPhase::FindPairs(std::vector<b2Pair>* pairs)
+{
+	if (m_staticTreeDirty)
+	{
+		m_trees[e_labStaticProxy].Rebuild();
+		m_staticTreeDirty = false;
+	}
+
+	m_pairs = pairs;
+	for (int32 i = 0; i < (int32)m_moveBuffer.size(); ++i)
+	{
+		m_queryProxyId = m_moveBuffer[i];
+		const Proxy* proxy = &m_proxies[m_queryProxyId];
+		const b2AABB& fatAABB = m_trees[proxy->tree].GetFatAABB(proxy->treeProxyId);
+
+		for (int32 tree = 0; tree < e_labProxyTypeCount; ++tree)
+		{
+			if (tree == e_labStaticProxy && proxy->type == e_labStaticProxy && m_splitMode != e_singleTree)
+			{
+				continue;
+			}
+
+			m_queryTree = m_trees + tree;
+			m_queryTree->Query(this, fatAABB);
+		}
+	}
+
+	m_moveBuffer.resize(0);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "LabBroadPhase.h"
+#include "WideTree.h"
+
+// The lab world's default broad-phase. Proxies of static bodies, awake
+// bodies and sleeping bodies can live in separate trees, so the proxies
+// that move every step are in a small tree and static geometry sits in a
+// tree that is rebuilt with the SAH builder whenever static proxies were
+// added. Only proxies that moved look for pairs, and they look in every
+// tree.
+class LabTreeBroadPhase : public LabBroadPhase
+{
+public:
+	enum SplitMode
+	{
+		e_singleTree,
+		e_staticSplit,
+		e_sleepingSplit,
+		e_splitModeCount
+	};
+
+	LabTreeBroadPhase();
+
+	Type GetType() const override { return e_tree; }
+
+	int32 CreateProxy(const b2AABB& aabb, LabProxyType type, void* userData) override;
+	void MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement) override;
+
+	// Moves the proxy to the tree for its new type.
+	void SetProxyType(int32 proxyId, LabProxyType type) override;
+	LabProxyType GetProxyType(int32 proxyId) const override { return m_proxies[proxyId].type; }
+	void SetFatAABB(int32 proxyId, const b2AABB& fatAABB) override;
+
+	// Redistributes all proxies; the fat AABBs are kept.
+	void SetSplitMode(SplitMode mode);
+	SplitMode GetSplitMode() const { return m_splitMode; }
+	static const char* GetSplitModeName(SplitMode mode);
+
+	void* GetUserData(int32 proxyId) const override { return m_proxies[proxyId].userData; }
+	const b2AABB& GetFatAABB(int32 proxyId) const override;
+	int32 GetProxyCount() const override { return (int32)m_proxies.size(); }
+
+	// The tree that proxies of this type are in under the current mode.
+	const WideTree& GetTree(LabProxyType type) const { return m_trees[GetTreeIndex(type)]; }
+
+	bool QueryCallback(int32 treeProxyId);
+
+protected:
+	void FindPairs(std::vector<b2Pair>* pairs) override;
+
+private:
+	struct Proxy
+	{
+		LabProxyType type;
+		int32 tree;
+		int32 treeProxyId;
+		void* userData;
+	};
+
+	int32 GetTreeIndex(LabProxyType type) const;
+	void InsertProxy(int32 proxyId, const b2AABB& fatAABB);
+
+	WideTree m_trees[e_labProxyTypeCount];
+	std::vector<Proxy> m_proxies;
+	std::vector<int32> m_moveBuffer;
+	std::vector<b2Pair>* m_pairs;
+	int32 m_queryProxyId;
+	const WideTree* m_queryTree;
+	SplitMode m_splitMode;
+	bool m_staticTreeDirty;
+};
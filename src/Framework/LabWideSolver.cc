@@ -0,0 +1,583 @@
+#include "LabWideSolver.h"
+
+static float32 MaskValue(bool flag)
+{
+	uint32 bits = flag ? 0xFFFFFFFFu : 0u;
+	float32 value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+void LabWideSolver::Initialize(const LabContactSolverDef& def)
+{
+	m_scalar.Initialize(def);
+	m_bodies = def.bodies;
+
+	ColorConstraints();
+	PackPositionBatches();
+}
+
+void LabWideSolver::ColorConstraints()
+{
+	int32 count = m_scalar.GetCount();
+	const LabContactVelocityConstraint* constraints = m_scalar.GetVelocityConstraints();
+
+	m_bodyColors.assign(m_bodies->count, 0);
+	m_constraintColors.resize(count);
+
+	// Color e_maxColors collects the constraints that found no free color.
+	int32 colorCounts[e_maxColors + 1] = { 0 };
+
+	for (int32 i = 0; i < count; ++i)
+	{
+		const LabContactVelocityConstraint* vc = constraints + i;
+		bool dynamicA = vc->invMassA > 0.0f;
+		bool dynamicB = vc->invMassB > 0.0f;
+
+		uint64_t used = 0;
+		if (dynamicA)
+		{
+			used |= m_bodyColors[vc->indexA];
+		}
+		if (dynamicB)
+		{
+			used |= m_bodyColors[vc->indexB];
+		}
+
+		int32 color = 0;
+		while (color < e_maxColors && (used & (uint64_t(1) << color)) != 0)
+		{
+			++color;
+		}
+
+		if (color < e_maxColors)
+		{
+			uint64_t bit = uint64_t(1) << color;
+			if (dynamicA)
+			{
+				m_bodyColors[vc->indexA] |= bit;
+			}
+			if (dynamicB)
+			{
+				m_bodyColors[vc->indexB] |= bit;
+			}
+		}
+
+		m_constraintColors[i] = color;
+		++colorCounts[color];
+	}
+
+	// Counting sort by color, keeping contact order within a color.
+	int32 colorStarts[e_maxColors + 1];
+	int32 start = 0;
+	for (int32 c = 0; c <= e_maxColors; ++c)
+	{
+		colorStarts[c] = start;
+		start += colorCounts[c];
+	}
+
+	m_order.resize(count);
+	for (int32 i = 0; i < count; ++i)
+	{
+		m_order[colorStarts[m_constraintColors[i]]++] = i;
+	}
+
+	// Full batches first, then the rest of the color goes to the scalar path.
+	m_colors.resize(0);
+	m_leftovers.resize(0);
+	int32 batchCount = 0;
+	int32 index = 0;
+	for (int32 c = 0; c <= e_maxColors; ++c)
+	{
+		int32 n = colorCounts[c];
+		if (n == 0)
+		{
+			continue;
+		}
+
+		int32 fullBatches = c < e_maxColors ? n / k_simdWidth : 0;
+
+		ColorRange range;
+		range.batchBegin = batchCount;
+		range.batchEnd = batchCount + fullBatches;
+		range.leftoverBegin = (int32)m_leftovers.size();
+		for (int32 i = fullBatches * k_simdWidth; i < n; ++i)
+		{
+			m_leftovers.push_back(m_order[index + i]);
+		}
+		range.leftoverEnd = (int32)m_leftovers.size();
+		m_colors.push_back(range);
+
+		batchCount += fullBatches;
+		index += n;
+	}
+
+	// m_order now lists the batched constraints color by color, k_simdWidth
+	// per batch, followed by leftovers; compact it to the batched ones.
+	int32 write = 0;
+	index = 0;
+	for (int32 c = 0; c <= e_maxColors; ++c)
+	{
+		int32 n = colorCounts[c];
+		int32 batched = c < e_maxColors ? (n / k_simdWidth) * k_simdWidth : 0;
+		for (int32 i = 0; i < batched; ++i)
+		{
+			m_order[write++] = m_order[index + i];
+		}
+		index += n;
+	}
+	m_order.resize(write);
+
+	m_velocityBatches.resize(batchCount);
+	m_positionBatches.resize(batchCount);
+}
+
+void LabWideSolver::PackPositionBatches()
+{
+	const LabContactPositionConstraint* constraints = m_scalar.GetPositionConstraints();
+
+	for (size_t b = 0; b < m_positionBatches.size(); ++b)
+	{
+		PositionBatch* batch = m_positionBatches.data() + b;
+		for (int32 lane = 0; lane < k_simdWidth; ++lane)
+		{
+			const LabContactPositionConstraint* pc = constraints + m_order[b * k_simdWidth + lane];
+			batch->indexA[lane] = pc->indexA;
+			batch->indexB[lane] = pc->indexB;
+			batch->invMassA[lane] = pc->invMassA;
+			batch->invMassB[lane] = pc->invMassB;
+			batch->invIA[lane] = pc->invIA;
+			batch->invIB[lane] = pc->invIB;
+			batch->localCenterAx[lane] = pc->localCenterA.x;
+			batch->localCenterAy[lane] = pc->localCenterA.y;
+			batch->localCenterBx[lane] = pc->localCenterB.x;
+			batch->localCenterBy[lane] = pc->localCenterB.y;
+			batch->localNormalX[lane] = pc->localNormal.x;
+			batch->localNormalY[lane] = pc->localNormal.y;
+			batch->localPointX[lane] = pc->localPoint.x;
+			batch->localPointY[lane] = pc->localPoint.y;
+			batch->radius[lane] = pc->radiusA + pc->radiusB;
+			batch->circlesMask[lane] = MaskValue(pc->type == b2Manifold::e_circles);
+			batch->faceBMask[lane] = MaskValue(pc->type == b2Manifold::e_faceB);
+
+			for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+			{
+				bool active = j < pc->pointCount;
+				batch->localPointsX[j][lane] = active ? pc->localPoints[j].x : 0.0f;
+				batch->localPointsY[j][lane] = active ? pc->localPoints[j].y : 0.0f;
+				batch->pointMask[j][lane] = MaskValue(active);
+			}
+		}
+	}
+}
+
+void LabWideSolver::InitializeVelocityConstraints()
+{
+	m_scalar.InitializeVelocityConstraints();
+	PackVelocityBatches();
+}
+
+void LabWideSolver::PackVelocityBatches()
+{
+	const LabContactVelocityConstraint* constraints = m_scalar.GetVelocityConstraints();
+
+	for (size_t b = 0; b < m_velocityBatches.size(); ++b)
+	{
+		VelocityBatch* batch = m_velocityBatches.data() + b;
+		for (int32 lane = 0; lane < k_simdWidth; ++lane)
+		{
+			int32 index = m_order[b * k_simdWidth + lane];
+			const LabContactVelocityConstraint* vc = constraints + index;
+			batch->constraints[lane] = index;
+			batch->indexA[lane] = vc->indexA;
+			batch->indexB[lane] = vc->indexB;
+			batch->normalX[lane] = vc->normal.x;
+			batch->normalY[lane] = vc->normal.y;
+			batch->friction[lane] = vc->friction;
+			batch->invMassA[lane] = vc->invMassA;
+			batch->invMassB[lane] = vc->invMassB;
+			batch->invIA[lane] = vc->invIA;
+			batch->invIB[lane] = vc->invIB;
+
+			bool block = vc->pointCount == 2;
+			batch->k11[lane] = block ? vc->K.ex.x : 0.0f;
+			batch->k12[lane] = block ? vc->K.ey.x : 0.0f;
+			batch->k22[lane] = block ? vc->K.ey.y : 0.0f;
+			batch->m11[lane] = block ? vc->normalMass.ex.x : 0.0f;
+			batch->m12[lane] = block ? vc->normalMass.ey.x : 0.0f;
+			batch->m22[lane] = block ? vc->normalMass.ey.y : 0.0f;
+			batch->blockMask[lane] = MaskValue(block);
+
+			// Points the constraint does not solve get zero mass and lever
+			// arms, so they produce no impulse.
+			for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+			{
+				VelocityPoint* point = batch->points + j;
+				if (j < vc->pointCount)
+				{
+					const LabVelocityConstraintPoint* vcp = vc->points + j;
+					point->rAx[lane] = vcp->rA.x;
+					point->rAy[lane] = vcp->rA.y;
+					point->rBx[lane] = vcp->rB.x;
+					point->rBy[lane] = vcp->rB.y;
+					point->normalMass[lane] = vcp->normalMass;
+					point->tangentMass[lane] = vcp->tangentMass;
+					point->velocityBias[lane] = vcp->velocityBias;
+					point->normalImpulse[lane] = vcp->normalImpulse;
+					point->tangentImpulse[lane] = vcp->tangentImpulse;
+				}
+				else
+				{
+					point->rAx[lane] = 0.0f;
+					point->rAy[lane] = 0.0f;
+					point->rBx[lane] = 0.0f;
+					point->rBy[lane] = 0.0f;
+					point->normalMass[lane] = 0.0f;
+					point->tangentMass[lane] = 0.0f;
+					point->velocityBias[lane] = 0.0f;
+					point->normalImpulse[lane] = 0.0f;
+					point->tangentImpulse[lane] = 0.0f;
+				}
+			}
+		}
+	}
+}
+
+void LabWideSolver::WarmStart()
+{
+	// One pass over the impulses; not worth batching.
+	m_scalar.WarmStart();
+}
+
+void LabWideSolver::SolveVelocityConstraints()
+{
+	for (size_t c = 0; c < m_colors.size(); ++c)
+	{
+		const ColorRange& range = m_colors[c];
+		for (int32 b = range.batchBegin; b < range.batchEnd; ++b)
+		{
+			SolveVelocityBatch(m_velocityBatches.data() + b);
+		}
+
+		for (int32 i = range.leftoverBegin; i < range.leftoverEnd; ++i)
+		{
+			m_scalar.SolveVelocityConstraint(m_leftovers[i]);
+		}
+	}
+}
+
+void LabWideSolver::SolveVelocityBatch(VelocityBatch* batch)
+{
+	float32 vAx[k_simdWidth], vAy[k_simdWidth], wA[k_simdWidth];
+	float32 vBx[k_simdWidth], vBy[k_simdWidth], wB[k_simdWidth];
+	for (int32 lane = 0; lane < k_simdWidth; ++lane)
+	{
+		int32 indexA = batch->indexA[lane];
+		int32 indexB = batch->indexB[lane];
+		vAx[lane] = m_bodies->vx[indexA];
+		vAy[lane] = m_bodies->vy[indexA];
+		wA[lane] = m_bodies->w[indexA];
+		vBx[lane] = m_bodies->vx[indexB];
+		vBy[lane] = m_bodies->vy[indexB];
+		wB[lane] = m_bodies->w[indexB];
+	}
+
+	FloatW vax = SimdLoad(vAx), vay = SimdLoad(vAy), wa = SimdLoad(wA);
+	FloatW vbx = SimdLoad(vBx), vby = SimdLoad(vBy), wb = SimdLoad(wB);
+
+	FloatW mA = SimdLoad(batch->invMassA), iA = SimdLoad(batch->invIA);
+	FloatW mB = SimdLoad(batch->invMassB), iB = SimdLoad(batch->invIB);
+	FloatW nx = SimdLoad(batch->normalX), ny = SimdLoad(batch->normalY);
+	FloatW tx = ny, ty = -nx;
+	FloatW friction = SimdLoad(batch->friction);
+	FloatW zero = SimdZero();
+
+	// Friction.
+	for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+	{
+		VelocityPoint* point = batch->points + j;
+		FloatW rax = SimdLoad(point->rAx), ray = SimdLoad(point->rAy);
+		FloatW rbx = SimdLoad(point->rBx), rby = SimdLoad(point->rBy);
+
+		FloatW dvx = vbx - wb * rby - vax + wa * ray;
+		FloatW dvy = vby + wb * rbx - vay - wa * rax;
+
+		FloatW vt = dvx * tx + dvy * ty;
+		FloatW lambda = SimdLoad(point->tangentMass) * -vt;
+
+		FloatW maxFriction = friction * SimdLoad(point->normalImpulse);
+		FloatW oldImpulse = SimdLoad(point->tangentImpulse);
+		FloatW newImpulse = SimdMin(SimdMax(oldImpulse + lambda, -maxFriction), maxFriction);
+		lambda = newImpulse - oldImpulse;
+		SimdStore(point->tangentImpulse, newImpulse);
+
+		FloatW px = lambda * tx, py = lambda * ty;
+		vax = vax - mA * px;
+		vay = vay - mA * py;
+		wa = wa - iA * (rax * py - ray * px);
+		vbx = vbx + mB * px;
+		vby = vby + mB * py;
+		wb = wb + iB * (rbx * py - rby * px);
+	}
+
+	// Normal.
+	{
+		VelocityPoint* cp1 = batch->points + 0;
+		VelocityPoint* cp2 = batch->points + 1;
+		FloatW r1ax = SimdLoad(cp1->rAx), r1ay = SimdLoad(cp1->rAy);
+		FloatW r1bx = SimdLoad(cp1->rBx), r1by = SimdLoad(cp1->rBy);
+		FloatW r2ax = SimdLoad(cp2->rAx), r2ay = SimdLoad(cp2->rAy);
+		FloatW r2bx = SimdLoad(cp2->rBx), r2by = SimdLoad(cp2->rBy);
+
+		FloatW a1 = SimdLoad(cp1->normalImpulse);
+		FloatW a2 = SimdLoad(cp2->normalImpulse);
+
+		FloatW dv1x = vbx - wb * r1by - vax + wa * r1ay;
+		FloatW dv1y = vby + wb * r1bx - vay - wa * r1ax;
+		FloatW dv2x = vbx - wb * r2by - vax + wa * r2ay;
+		FloatW dv2y = vby + wb * r2bx - vay - wa * r2ax;
+		FloatW vn1 = dv1x * nx + dv1y * ny;
+		FloatW vn2 = dv2x * nx + dv2y * ny;
+
+		FloatW bias1 = SimdLoad(cp1->velocityBias);
+		FloatW bias2 = SimdLoad(cp2->velocityBias);
+		FloatW normalMass1 = SimdLoad(cp1->normalMass);
+		FloatW normalMass2 = SimdLoad(cp2->normalMass);
+
+		// One point: clamped sequential impulse.
+		FloatW single = SimdMax(a1 - normalMass1 * (vn1 - bias1), zero);
+
+		// Two points: the four cases of the block solver, first admissible wins.
+		FloatW k11 = SimdLoad(batch->k11), k12 = SimdLoad(batch->k12), k22 = SimdLoad(batch->k22);
+		FloatW m11 = SimdLoad(batch->m11), m12 = SimdLoad(batch->m12), m22 = SimdLoad(batch->m22);
+		FloatW bx = (vn1 - bias1) - (k11 * a1 + k12 * a2);
+		FloatW by = (vn2 - bias2) - (k12 * a1 + k22 * a2);
+
+		FloatW x1Case1 = -(m11 * bx + m12 * by);
+		FloatW x2Case1 = -(m12 * bx + m22 * by);
+		FloatW case1 = (x1Case1 >= zero) & (x2Case1 >= zero);
+
+		FloatW x1Case2 = -normalMass1 * bx;
+		FloatW case2 = (x1Case2 >= zero) & ((k12 * x1Case2 + by) >= zero);
+
+		FloatW x2Case3 = -normalMass2 * by;
+		FloatW case3 = (x2Case3 >= zero) & ((k12 * x2Case3 + bx) >= zero);
+
+		FloatW case4 = (bx >= zero) & (by >= zero);
+
+		FloatW x1 = SimdSelect(case1, x1Case1, SimdSelect(case2, x1Case2, SimdSelect(case3 | case4, zero, a1)));
+		FloatW x2 = SimdSelect(case1, x2Case1, SimdSelect(case2 | case3, SimdSelect(case2, zero, x2Case3), SimdSelect(case4, zero, a2)));
+
+		FloatW block = SimdLoad(batch->blockMask);
+		x1 = SimdSelect(block, x1, single);
+		x2 = SimdSelect(block, x2, a2);
+
+		FloatW d1 = x1 - a1;
+		FloatW d2 = x2 - a2;
+		FloatW p1x = d1 * nx, p1y = d1 * ny;
+		FloatW p2x = d2 * nx, p2y = d2 * ny;
+
+		vax = vax - mA * (p1x + p2x);
+		vay = vay - mA * (p1y + p2y);
+		wa = wa - iA * ((r1ax * p1y - r1ay * p1x) + (r2ax * p2y - r2ay * p2x));
+		vbx = vbx + mB * (p1x + p2x);
+		vby = vby + mB * (p1y + p2y);
+		wb = wb + iB * ((r1bx * p1y - r1by * p1x) + (r2bx * p2y - r2by * p2x));
+
+		SimdStore(cp1->normalImpulse, x1);
+		SimdStore(cp2->normalImpulse, x2);
+	}
+
+	SimdStore(vAx, vax);
+	SimdStore(vAy, vay);
+	SimdStore(wA, wa);
+	SimdStore(vBx, vbx);
+	SimdStore(vBy, vby);
+	SimdStore(wB, wb);
+
+	// No two lanes share a dynamic body, so the order of the stores only
+	// matters for static bodies, whose velocity did not change.
+	for (int32 lane = 0; lane < k_simdWidth; ++lane)
+	{
+		int32 indexA = batch->indexA[lane];
+		int32 indexB = batch->indexB[lane];
+		m_bodies->vx[indexA] = vAx[lane];
+		m_bodies->vy[indexA] = vAy[lane];
+		m_bodies->w[indexA] = wA[lane];
+		m_bodies->vx[indexB] = vBx[lane];
+		m_bodies->vy[indexB] = vBy[lane];
+		m_bodies->w[indexB] = wB[lane];
+	}
+}
+
+void LabWideSolver::StoreImpulses()
+{
+	LabContactVelocityConstraint* constraints = m_scalar.GetVelocityConstraints();
+
+	for (size_t b = 0; b < m_velocityBatches.size(); ++b)
+	{
+		const VelocityBatch* batch = m_velocityBatches.data() + b;
+		for (int32 lane = 0; lane < k_simdWidth; ++lane)
+		{
+			LabContactVelocityConstraint* vc = constraints + batch->constraints[lane];
+			for (int32 j = 0; j < vc->pointCount; ++j)
+			{
+				vc->points[j].normalImpulse = batch->points[j].normalImpulse[lane];
+				vc->points[j].tangentImpulse = batch->points[j].tangentImpulse[lane];
+			}
+		}
+	}
+
+	m_scalar.StoreImpulses();
+}
+
+bool LabWideSolver::SolvePositionConstraints()
+{
+	FloatW minSeparation = SimdZero();
+	float32 leftoverSeparation = 0.0f;
+
+	for (size_t c = 0; c < m_colors.size(); ++c)
+	{
+		const ColorRange& range = m_colors[c];
+		for (int32 b = range.batchBegin; b < range.batchEnd; ++b)
+		{
+			minSeparation = SimdMin(minSeparation, SolvePositionBatch(m_positionBatches.data() + b));
+		}
+
+		for (int32 i = range.leftoverBegin; i < range.leftoverEnd; ++i)
+		{
+			leftoverSeparation = b2Min(leftoverSeparation, m_scalar.SolvePositionConstraint(m_leftovers[i]));
+		}
+	}
+
+	float32 separation = b2Min(SimdReduceMin(minSeparation), leftoverSeparation);
+	return separation >= -3.0f * b2_linearSlop;
+}
+
+FloatW LabWideSolver::SolvePositionBatch(const PositionBatch* batch)
+{
+	float32 cAx[k_simdWidth], cAy[k_simdWidth], aA[k_simdWidth];
+	float32 cBx[k_simdWidth], cBy[k_simdWidth], aB[k_simdWidth];
+	for (int32 lane = 0; lane < k_simdWidth; ++lane)
+	{
+		int32 indexA = batch->indexA[lane];
+		int32 indexB = batch->indexB[lane];
+		cAx[lane] = m_bodies->cx[indexA];
+		cAy[lane] = m_bodies->cy[indexA];
+		aA[lane] = m_bodies->a[indexA];
+		cBx[lane] = m_bodies->cx[indexB];
+		cBy[lane] = m_bodies->cy[indexB];
+		aB[lane] = m_bodies->a[indexB];
+	}
+
+	FloatW cax = SimdLoad(cAx), cay = SimdLoad(cAy), aa = SimdLoad(aA);
+	FloatW cbx = SimdLoad(cBx), cby = SimdLoad(cBy), ab = SimdLoad(aB);
+
+	FloatW mA = SimdLoad(batch->invMassA), iA = SimdLoad(batch->invIA);
+	FloatW mB = SimdLoad(batch->invMassB), iB = SimdLoad(batch->invIB);
+	FloatW lcax = SimdLoad(batch->localCenterAx), lcay = SimdLoad(batch->localCenterAy);
+	FloatW lcbx = SimdLoad(batch->localCenterBx), lcby = SimdLoad(batch->localCenterBy);
+	FloatW lnx = SimdLoad(batch->localNormalX), lny = SimdLoad(batch->localNormalY);
+	FloatW lpx = SimdLoad(batch->localPointX), lpy = SimdLoad(batch->localPointY);
+	FloatW radius = SimdLoad(batch->radius);
+	FloatW circles = SimdLoad(batch->circlesMask);
+	FloatW faceB = SimdLoad(batch->faceBMask);
+	FloatW zero = SimdZero();
+	FloatW half = SimdSet(0.5f);
+
+	FloatW minSeparation = zero;
+
+	for (int32 j = 0; j < b2_maxManifoldPoints; ++j)
+	{
+		FloatW active = SimdLoad(batch->pointMask[j]);
+
+		FloatW sA, qcA, sB, qcB;
+		SimdSinCos(aa, &sA, &qcA);
+		SimdSinCos(ab, &sB, &qcB);
+		FloatW pax = cax - (qcA * lcax - sA * lcay);
+		FloatW pay = cay - (sA * lcax + qcA * lcay);
+		FloatW pbx = cbx - (qcB * lcbx - sB * lcby);
+		FloatW pby = cby - (sB * lcbx + qcB * lcby);
+
+		// Face manifolds: the reference body is A for e_faceA and B for e_faceB.
+		FloatW refC = SimdSelect(faceB, qcB, qcA), refS = SimdSelect(faceB, sB, sA);
+		FloatW refX = SimdSelect(faceB, pbx, pax), refY = SimdSelect(faceB, pby, pay);
+		FloatW incC = SimdSelect(faceB, qcA, qcB), incS = SimdSelect(faceB, sA, sB);
+		FloatW incX = SimdSelect(faceB, pax, pbx), incY = SimdSelect(faceB, pay, pby);
+
+		FloatW lqx = SimdLoad(batch->localPointsX[j]), lqy = SimdLoad(batch->localPointsY[j]);
+
+		FloatW nx = refC * lnx - refS * lny;
+		FloatW ny = refS * lnx + refC * lny;
+		FloatW planeX = (refC * lpx - refS * lpy) + refX;
+		FloatW planeY = (refS * lpx + refC * lpy) + refY;
+		FloatW clipX = (incC * lqx - incS * lqy) + incX;
+		FloatW clipY = (incS * lqx + incC * lqy) + incY;
+		FloatW separation = (clipX - planeX) * nx + (clipY - planeY) * ny - radius;
+		FloatW pointX = clipX, pointY = clipY;
+		nx = SimdSelect(faceB, -nx, nx);
+		ny = SimdSelect(faceB, -ny, ny);
+
+		// Circles: only point 0 is used, and only point 0 is active.
+		{
+			FloatW circleAx = (qcA * lpx - sA * lpy) + pax;
+			FloatW circleAy = (sA * lpx + qcA * lpy) + pay;
+			FloatW circleBx = (qcB * lqx - sB * lqy) + pbx;
+			FloatW circleBy = (sB * lqx + qcB * lqy) + pby;
+			FloatW dx = circleBx - circleAx, dy = circleBy - circleAy;
+			FloatW length = SimdSqrt(dx * dx + dy * dy);
+			FloatW invLength = SimdSelect(length < SimdSet(b2_epsilon), SimdSet(1.0f), SimdSet(1.0f) / length);
+			FloatW cnx = dx * invLength, cny = dy * invLength;
+			FloatW circleSeparation = dx * cnx + dy * cny - radius;
+
+			nx = SimdSelect(circles, cnx, nx);
+			ny = SimdSelect(circles, cny, ny);
+			pointX = SimdSelect(circles, half * (circleAx + circleBx), pointX);
+			pointY = SimdSelect(circles, half * (circleAy + circleBy), pointY);
+			separation = SimdSelect(circles, circleSeparation, separation);
+		}
+
+		FloatW rax = pointX - cax, ray = pointY - cay;
+		FloatW rbx = pointX - cbx, rby = pointY - cby;
+
+		minSeparation = SimdSelect(active, SimdMin(minSeparation, separation), minSeparation);
+
+		FloatW C = SimdMin(SimdMax(SimdSet(b2_baumgarte) * (separation + SimdSet(b2_linearSlop)), SimdSet(-b2_maxLinearCorrection)), zero);
+
+		FloatW rnA = rax * ny - ray * nx;
+		FloatW rnB = rbx * ny - rby * nx;
+		FloatW K = mA + mB + iA * rnA * rnA + iB * rnB * rnB;
+
+		FloatW positive = K > zero;
+		FloatW impulse = SimdSelect(active & positive, -C / SimdSelect(positive, K, SimdSet(1.0f)), zero);
+
+		FloatW px = impulse * nx, py = impulse * ny;
+		cax = cax - mA * px;
+		cay = cay - mA * py;
+		aa = aa - iA * (rax * py - ray * px);
+		cbx = cbx + mB * px;
+		cby = cby + mB * py;
+		ab = ab + iB * (rbx * py - rby * px);
+	}
+
+	SimdStore(cAx, cax);
+	SimdStore(cAy, cay);
+	SimdStore(aA, aa);
+	SimdStore(cBx, cbx);
+	SimdStore(cBy, cby);
+	SimdStore(aB, ab);
+
+	for (int32 lane = 0; lane < k_simdWidth; ++lane)
+	{
+		int32 indexA = batch->indexA[lane];
+		int32 indexB = batch->indexB[lane];
+		m_bodies->cx[indexA] = cAx[lane];
+		m_bodies->cy[indexA] = cAy[lane];
+		m_bodies->a[indexA] = aA[lane];
+		m_bodies->cx[indexB] = cBx[lane];
+		m_bodies->cy[indexB] = cBy[lane];
+		m_bodies->a[indexB] = aB[lane];
+	}
+
+	return minSeparation;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "LabContactSolver.h"
+#include "SimdMath.h"
+#include <cstdint>
+
+// Contact solver that solves k_simdWidth constraints at once. The contact
+// graph is colored greedily so that no two constraints of a color share a
+// dynamic body; each color is cut into full batches solved in SIMD lanes and
+// the remainder is solved with the scalar code. Static and kinematic bodies
+// may appear in several lanes of a batch because they are never written.
+//
+// The velocity pass does LabContactSolver's arithmetic (including the
+// 2-point block solver) in a different order of constraints. The position
+// pass builds each body's rotation with SimdSinCos, which is within a few
+// ulp of sinf/cosf but not equal to them, so positions can differ from the
+// scalar solver's in the last bits as well.
+class LabWideSolver
+{
+public:
+	enum
+	{
+		e_maxColors = 64
+	};
+
+	void Initialize(const LabContactSolverDef& def);
+
+	void InitializeVelocityConstraints();
+	void WarmStart();
+	void SolveVelocityConstraints();
+	void StoreImpulses();
+	bool SolvePositionConstraints();
+
+	int32 GetColorCount() const { return (int32)m_colors.size(); }
+	int32 GetBatchCount() const { return (int32)m_velocityBatches.size(); }
+	int32 GetLeftoverCount() const { return (int32)m_leftovers.size(); }
+
+private:
+	struct VelocityPoint
+	{
+		float32 rAx[k_simdWidth], rAy[k_simdWidth];
+		float32 rBx[k_simdWidth], rBy[k_simdWidth];
+		float32 normalMass[k_simdWidth];
+		float32 tangentMass[k_simdWidth];
+		float32 velocityBias[k_simdWidth];
+		float32 normalImpulse[k_simdWidth];
+		float32 tangentImpulse[k_simdWidth];
+	};
+
+	struct VelocityBatch
+	{
+		int32 constraints[k_simdWidth];
+		int32 indexA[k_simdWidth], indexB[k_simdWidth];
+		float32 normalX[k_simdWidth], normalY[k_simdWidth];
+		float32 friction[k_simdWidth];
+		float32 invMassA[k_simdWidth], invMassB[k_simdWidth];
+		float32 invIA[k_simdWidth], invIB[k_simdWidth];
+
+		// Block solver: K and its inverse, both symmetric. Zero for lanes
+		// with one point; blockMask selects between the two paths.
+		float32 k11[k_simdWidth], k12[k_simdWidth], k22[k_simdWidth];
+		float32 m11[k_simdWidth], m12[k_simdWidth], m22[k_simdWidth];
+		float32 blockMask[k_simdWidth];
+		VelocityPoint points[b2_maxManifoldPoints];
+	};
+
+	struct PositionBatch
+	{
+		int32 indexA[k_simdWidth], indexB[k_simdWidth];
+		float32 invMassA[k_simdWidth], invMassB[k_simdWidth];
+		float32 invIA[k_simdWidth], invIB[k_simdWidth];
+		float32 localCenterAx[k_simdWidth], localCenterAy[k_simdWidth];
+		float32 localCenterBx[k_simdWidth], localCenterBy[k_simdWidth];
+		float32 localNormalX[k_simdWidth], localNormalY[k_simdWidth];
+		float32 localPointX[k_simdWidth], localPointY[k_simdWidth];
+		float32 localPointsX[b2_maxManifoldPoints][k_simdWidth];
+		float32 localPointsY[b2_maxManifoldPoints][k_simdWidth];
+		float32 radius[k_simdWidth];
+		float32 circlesMask[k_simdWidth];
+		float32 faceBMask[k_simdWidth];
+		float32 pointMask[b2_maxManifoldPoints][k_simdWidth];
+	};
+
+	struct ColorRange
+	{
+		int32 batchBegin, batchEnd;
+		int32 leftoverBegin, leftoverEnd;
+	};
+
+	void ColorConstraints();
+	void PackPositionBatches();
+	void PackVelocityBatches();
+	void SolveVelocityBatch(VelocityBatch* batch);
+	FloatW SolvePositionBatch(const PositionBatch* batch);
+
+	LabContactSolver m_scalar;
+	LabBodyArrays* m_bodies;
+
+	std::vector<uint64_t> m_bodyColors;
+	std::vector<int32> m_constraintColors;
+	std::vector<ColorRange> m_colors;
+	std::vector<int32> m_order;
+	std::vector<int32> m_leftovers;
+	std::vector<VelocityBatch> m_velocityBatches;
+	std::vector<PositionBatch> m_positionBatches;
+};
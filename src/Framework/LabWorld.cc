@@ -0,0 +1,1153 @@
+#include "LabWorld.h"
+#include "WorldChecksum.h"
+#include <cstring>
+#include <new>
+
+// Same mixing rules as b2Contact.
+static float32 MixFriction(float32 friction1, float32 friction2)
+{
+	return b2Sqrt(friction1 * friction2);
+}
+
+static float32 MixRestitution(float32 restitution1, float32 restitution2)
+{
+	return restitution1 > restitution2 ? restitution1 : restitution2;
+}
+
+// Circles, edges and polygons own no memory, so their copies can live in
+// the arena and never be destroyed.
+static b2Shape* CloneShape(const b2Shape* shape, WorldArena* arena)
+{
+	switch (shape->GetType())
+	{
+	case b2Shape::e_circle:
+		return new (arena->Allocate(sizeof(b2CircleShape))) b2CircleShape(*(const b2CircleShape*)shape);
+
+	case b2Shape::e_edge:
+		return new (arena->Allocate(sizeof(b2EdgeShape))) b2EdgeShape(*(const b2EdgeShape*)shape);
+
+	default:
+		b2Assert(shape->GetType() == b2Shape::e_polygon);
+		return new (arena->Allocate(sizeof(b2PolygonShape))) b2PolygonShape(*(const b2PolygonShape*)shape);
+	}
+}
+
+static bool ShouldCollide(const b2Filter& filterA, const b2Filter& filterB)
+{
+	if (filterA.groupIndex == filterB.groupIndex && filterA.groupIndex != 0)
+	{
+		return filterA.groupIndex > 0;
+	}
+
+	return (filterA.maskBits & filterB.categoryBits) != 0 && (filterA.categoryBits & filterB.maskBits) != 0;
+}
+
+LabWorld::LabWorld(const b2Vec2& gravity)
+{
+	m_gravity = gravity;
+	m_solverType = e_scalarSolver;
+	m_inv_dt0 = 0.0f;
+	m_awakeCount = 0;
+	m_allowSleep = true;
+	m_warmStarting = true;
+	m_newFixture = false;
+	m_broadPhase = LabBroadPhase::Create(LabBroadPhase::e_tree);
+	memset(&m_profile, 0, sizeof(b2Profile));
+}
+
+LabWorld::~LabWorld()
+{
+	// The shapes go with the arena.
+	delete m_broadPhase;
+}
+
+const char* LabWorld::GetSolverName(SolverType type)
+{
+	switch (type)
+	{
+	case e_scalarSolver:
+		return "Scalar";
+
+	case e_wideSolver:
+		return "Wide (" SIMD_NAME ")";
+
+	default:
+		return "";
+	}
+}
+
+int32 LabWorld::CreateBody(const b2BodyDef* def)
+{
+	int32 id = (int32)m_bodies.size();
+
+	LabBody body;
+	body.type = def->type;
+	body.mass = 0.0f;
+	body.I = 0.0f;
+	body.fixtureList = -1;
+	body.userData = def->userData;
+	body.fixedRotation = def->fixedRotation;
+	m_bodies.push_back(body);
+
+	m_state.Resize(id + 1);
+
+	b2Rot q(def->angle);
+	m_state.px[id] = def->position.x;
+	m_state.py[id] = def->position.y;
+	m_state.qs[id] = q.s;
+	m_state.qc[id] = q.c;
+	m_state.cx[id] = m_state.c0x[id] = def->position.x;
+	m_state.cy[id] = m_state.c0y[id] = def->position.y;
+	m_state.a[id] = m_state.a0[id] = def->angle;
+
+	if (def->type != b2_staticBody)
+	{
+		m_state.vx[id] = def->linearVelocity.x;
+		m_state.vy[id] = def->linearVelocity.y;
+		m_state.w[id] = def->angularVelocity;
+		m_state.awake[id] = def->awake || def->allowSleep == false ? 1.0f : 0.0f;
+	}
+
+	m_state.linearDamping[id] = def->linearDamping;
+	m_state.angularDamping[id] = def->angularDamping;
+	m_state.gravityScale[id] = def->gravityScale;
+	m_state.allowSleep[id] = def->allowSleep ? 1.0f : 0.0f;
+
+	if (def->type == b2_dynamicBody)
+	{
+		m_state.dynamic[id] = 1.0f;
+		m_bodies[id].mass = 1.0f;
+		m_state.invMass[id] = 1.0f;
+	}
+
+	return id;
+}
+
+int32 LabWorld::CreateFixture(int32 body, const b2Shape* shape, float32 density)
+{
+	b2FixtureDef def;
+	def.shape = shape;
+	def.density = density;
+	return CreateFixture(body, &def);
+}
+
+int32 LabWorld::CreateFixture(int32 body, const b2FixtureDef* def)
+{
+	b2Assert(def->shape->GetType() != b2Shape::e_chain);
+	b2Assert(def->isSensor == false);
+
+	LabBody* b = &m_bodies[body];
+	int32 index = (int32)m_fixtures.size();
+
+	LabFixture fixture;
+	fixture.shape = CloneShape(def->shape, &m_arena);
+	fixture.kind = LabGetShapeKind(fixture.shape);
+	fixture.body = body;
+	fixture.next = b->fixtureList;
+	fixture.density = def->density;
+	fixture.friction = def->friction;
+	fixture.restitution = def->restitution;
+	fixture.filter = def->filter;
+	fixture.userData = def->userData;
+
+	b2AABB aabb;
+	fixture.shape->ComputeAABB(&aabb, m_state.GetTransform(body), 0);
+	LabProxyType proxyType = e_labStaticProxy;
+	if (b->type != b2_staticBody)
+	{
+		proxyType = IsAwake(body) ? e_labDynamicProxy : e_labSleepingProxy;
+	}
+	fixture.proxyId = m_broadPhase->CreateProxy(aabb, proxyType, (void*)(intptr_t)index);
+
+	m_fixtures.push_back(fixture);
+	b->fixtureList = index;
+
+	if (fixture.density > 0.0f)
+	{
+		ResetMassData(body);
+	}
+
+	m_newFixture = true;
+	return index;
+}
+
+void LabWorld::ResetMassData(int32 id)
+{
+	LabBody* b = &m_bodies[id];
+	b2Transform xf = m_state.GetTransform(id);
+
+	b->mass = 0.0f;
+	b->I = 0.0f;
+	m_state.invMass[id] = 0.0f;
+	m_state.invI[id] = 0.0f;
+	m_state.localCenterX[id] = 0.0f;
+	m_state.localCenterY[id] = 0.0f;
+
+	if (b->type != b2_dynamicBody)
+	{
+		m_state.cx[id] = m_state.c0x[id] = xf.p.x;
+		m_state.cy[id] = m_state.c0y[id] = xf.p.y;
+		m_state.a0[id] = m_state.a[id];
+		return;
+	}
+
+	b2Vec2 localCenter = b2Vec2_zero;
+	for (int32 f = b->fixtureList; f != -1; f = m_fixtures[f].next)
+	{
+		const LabFixture& fixture = m_fixtures[f];
+		if (fixture.density == 0.0f)
+		{
+			continue;
+		}
+
+		b2MassData massData;
+		fixture.shape->ComputeMass(&massData, fixture.density);
+		b->mass += massData.mass;
+		localCenter += massData.mass * massData.center;
+		b->I += massData.I;
+	}
+
+	if (b->mass > 0.0f)
+	{
+		m_state.invMass[id] = 1.0f / b->mass;
+		localCenter *= m_state.invMass[id];
+	}
+	else
+	{
+		// Force all dynamic bodies to have a positive mass.
+		b->mass = 1.0f;
+		m_state.invMass[id] = 1.0f;
+	}
+
+	if (b->I > 0.0f && b->fixedRotation == false)
+	{
+		// Center the inertia about the center of mass.
+		b->I -= b->mass * b2Dot(localCenter, localCenter);
+		m_state.invI[id] = 1.0f / b->I;
+	}
+	else
+	{
+		b->I = 0.0f;
+	}
+
+	b2Vec2 c = b2Mul(xf, localCenter);
+	m_state.localCenterX[id] = localCenter.x;
+	m_state.localCenterY[id] = localCenter.y;
+	m_state.cx[id] = m_state.c0x[id] = c.x;
+	m_state.cy[id] = m_state.c0y[id] = c.y;
+}
+
+void LabWorld::SetAwake(int32 id)
+{
+	if (m_bodies[id].type != b2_staticBody && m_state.awake[id] == 0.0f)
+	{
+		m_state.awake[id] = 1.0f;
+		m_state.sleepTime[id] = 0.0f;
+	}
+}
+
+void LabWorld::SetBroadPhaseType(LabBroadPhase::Type type)
+{
+	if (type == m_broadPhase->GetType())
+	{
+		return;
+	}
+
+	// The new broad-phase fattens the boxes again, so take the margin off.
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	LabBroadPhase* broadPhase = LabBroadPhase::Create(type);
+	for (int32 i = 0; i < (int32)m_fixtures.size(); ++i)
+	{
+		LabFixture* fixture = &m_fixtures[i];
+		b2AABB fatAABB = m_broadPhase->GetFatAABB(fixture->proxyId);
+		b2AABB aabb;
+		aabb.lowerBound = fatAABB.lowerBound + r;
+		aabb.upperBound = fatAABB.upperBound - r;
+		fixture->proxyId = broadPhase->CreateProxy(aabb, m_broadPhase->GetProxyType(fixture->proxyId), (void*)(intptr_t)i);
+
+		// Rounding in the margin can move a bound by an ulp.
+		broadPhase->SetFatAABB(fixture->proxyId, fatAABB);
+	}
+
+	delete m_broadPhase;
+	m_broadPhase = broadPhase;
+
+	// Every proxy looks for pairs again; the existing contacts are kept.
+	m_newFixture = true;
+}
+
+void LabWorld::SetBroadPhaseSplit(LabTreeBroadPhase::SplitMode mode)
+{
+	if (m_broadPhase->GetType() == LabBroadPhase::e_tree)
+	{
+		((LabTreeBroadPhase*)m_broadPhase)->SetSplitMode(mode);
+	}
+}
+
+const LabTreeBroadPhase* LabWorld::GetTreeBroadPhase() const
+{
+	if (m_broadPhase->GetType() == LabBroadPhase::e_tree)
+	{
+		return (const LabTreeBroadPhase*)m_broadPhase;
+	}
+
+	return NULL;
+}
+
+void LabWorld::SetAllowSleeping(bool flag)
+{
+	if (flag == m_allowSleep)
+	{
+		return;
+	}
+
+	m_allowSleep = flag;
+	if (m_allowSleep == false)
+	{
+		for (int32 i = 0; i < m_state.count; ++i)
+		{
+			SetAwake(i);
+		}
+	}
+}
+
+uint64_t LabWorld::PairKey(int32 fixtureA, int32 fixtureB)
+{
+	uint32 low = (uint32)b2Min(fixtureA, fixtureB);
+	uint32 high = (uint32)b2Max(fixtureA, fixtureB);
+	return (uint64_t(high) << 32) | low;
+}
+
+void LabWorld::AddPair(void* proxyUserDataA, void* proxyUserDataB)
+{
+	int32 fixtureA = (int32)(intptr_t)proxyUserDataA;
+	int32 fixtureB = (int32)(intptr_t)proxyUserDataB;
+
+	const LabFixture* fa = &m_fixtures[fixtureA];
+	const LabFixture* fb = &m_fixtures[fixtureB];
+
+	// Are the fixtures on the same body?
+	if (fa->body == fb->body)
+	{
+		return;
+	}
+
+	// At least one body should be dynamic.
+	const LabBody* bodyA = &m_bodies[fa->body];
+	const LabBody* bodyB = &m_bodies[fb->body];
+	if (bodyA->type != b2_dynamicBody && bodyB->type != b2_dynamicBody)
+	{
+		return;
+	}
+
+	if (ShouldCollide(fa->filter, fb->filter) == false)
+	{
+		return;
+	}
+
+	uint64_t key = PairKey(fixtureA, fixtureB);
+	if (m_pairs.find(key) != m_pairs.end())
+	{
+		return;
+	}
+
+	// The kernel table only has one order of each pair.
+	LabCollideFcn* collide = LabGetCollideFcn(fa->kind, fb->kind);
+	if (collide == NULL)
+	{
+		b2Swap(fixtureA, fixtureB);
+		b2Swap(fa, fb);
+		collide = LabGetCollideFcn(fa->kind, fb->kind);
+		if (collide == NULL)
+		{
+			return;
+		}
+	}
+
+	// Value-initialized, which zeroes the padding too, so saved states
+	// compare bytes.
+	LabContact contact = LabContact();
+	contact.fixtureA = fixtureA;
+	contact.fixtureB = fixtureB;
+	contact.bodyA = fa->body;
+	contact.bodyB = fb->body;
+	contact.collide = collide;
+	contact.manifold.pointCount = 0;
+	contact.friction = MixFriction(fa->friction, fb->friction);
+	contact.restitution = MixRestitution(fa->restitution, fb->restitution);
+	contact.radiusA = fa->shape->m_radius;
+	contact.radiusB = fb->shape->m_radius;
+	contact.touching = false;
+
+	m_pairs[key] = (int32)m_contacts.size();
+	m_contacts.push_back(contact);
+}
+
+
+void LabWorld::DestroyContact(int32 index)
+{
+	LabContact* contact = &m_contacts[index];
+	if (contact->manifold.pointCount > 0)
+	{
+		SetAwake(contact->bodyA);
+		SetAwake(contact->bodyB);
+	}
+
+	m_pairs.erase(PairKey(contact->fixtureA, contact->fixtureB));
+
+	int32 last = (int32)m_contacts.size() - 1;
+	if (index != last)
+	{
+		m_contacts[index] = m_contacts[last];
+		m_pairs[PairKey(m_contacts[index].fixtureA, m_contacts[index].fixtureB)] = index;
+	}
+	m_contacts.pop_back();
+}
+
+void LabWorld::Collide()
+{
+	int32 index = 0;
+	while (index < (int32)m_contacts.size())
+	{
+		LabContact* contact = &m_contacts[index];
+		const LabFixture* fixtureA = &m_fixtures[contact->fixtureA];
+		const LabFixture* fixtureB = &m_fixtures[contact->fixtureB];
+
+		// Static bodies are never awake.
+		bool activeA = IsAwake(contact->bodyA);
+		bool activeB = IsAwake(contact->bodyB);
+
+		// At least one body must be awake and it must be dynamic or kinematic.
+		if (activeA == false && activeB == false)
+		{
+			++index;
+			continue;
+		}
+
+		// The contact persists until the fat AABBs stop overlapping.
+		if (m_broadPhase->TestOverlap(fixtureA->proxyId, fixtureB->proxyId) == false)
+		{
+			DestroyContact(index);
+			continue;
+		}
+
+		b2Manifold oldManifold = contact->manifold;
+		b2Transform xfA = m_state.GetTransform(contact->bodyA);
+		b2Transform xfB = m_state.GetTransform(contact->bodyB);
+		contact->collide(&contact->manifold, fixtureA->shape, xfA, fixtureB->shape, xfB);
+
+		// Match old contact ids to new contact ids and copy the
+		// stored impulses to warm start the solver.
+		b2Manifold* manifold = &contact->manifold;
+		for (int32 i = 0; i < manifold->pointCount; ++i)
+		{
+			b2ManifoldPoint* mp2 = manifold->points + i;
+			mp2->normalImpulse = 0.0f;
+			mp2->tangentImpulse = 0.0f;
+
+			for (int32 j = 0; j < oldManifold.pointCount; ++j)
+			{
+				const b2ManifoldPoint* mp1 = oldManifold.points + j;
+				if (mp1->id.key == mp2->id.key)
+				{
+					mp2->normalImpulse = mp1->normalImpulse;
+					mp2->tangentImpulse = mp1->tangentImpulse;
+					break;
+				}
+			}
+		}
+
+		bool touching = manifold->pointCount > 0;
+		if (touching != contact->touching)
+		{
+			SetAwake(contact->bodyA);
+			SetAwake(contact->bodyB);
+		}
+		contact->touching = touching;
+
+		++index;
+	}
+}
+
+int32 LabWorld::FindRoot(int32 body)
+{
+	while (m_islandParents[body] != body)
+	{
+		m_islandParents[body] = m_islandParents[m_islandParents[body]];
+		body = m_islandParents[body];
+	}
+	return body;
+}
+
+void LabWorld::IntegrateVelocities(float32 h)
+{
+	const FloatW zero = SimdZero();
+	const FloatW one = SimdSet(1.0f);
+	const FloatW hw = SimdSet(h);
+	const FloatW gx = SimdSet(h * m_gravity.x);
+	const FloatW gy = SimdSet(h * m_gravity.y);
+
+	LabBodyArrays* s = &m_state;
+	int32 capacity = s->GetCapacity();
+	for (int32 i = 0; i < capacity; i += k_simdWidth)
+	{
+		// Store positions for continuous collision. Sleeping and static
+		// bodies do not move, so copying theirs too is harmless.
+		SimdStore(&s->c0x[i], SimdLoad(&s->cx[i]));
+		SimdStore(&s->c0y[i], SimdLoad(&s->cy[i]));
+		SimdStore(&s->a0[i], SimdLoad(&s->a[i]));
+
+		FloatW active = (SimdLoad(&s->awake[i]) > zero) & (SimdLoad(&s->dynamic[i]) > zero);
+		FloatW vx = SimdLoad(&s->vx[i]);
+		FloatW vy = SimdLoad(&s->vy[i]);
+		FloatW w = SimdLoad(&s->w[i]);
+
+		// Integrate velocities.
+		FloatW gravityScale = SimdLoad(&s->gravityScale[i]);
+		FloatW nvx = vx + gravityScale * gx;
+		FloatW nvy = vy + gravityScale * gy;
+
+		// Apply damping.
+		FloatW linear = one / (one + hw * SimdLoad(&s->linearDamping[i]));
+		FloatW angular = one / (one + hw * SimdLoad(&s->angularDamping[i]));
+
+		SimdStore(&s->vx[i], SimdSelect(active, nvx * linear, vx));
+		SimdStore(&s->vy[i], SimdSelect(active, nvy * linear, vy));
+		SimdStore(&s->w[i], SimdSelect(active, w * angular, w));
+	}
+}
+
+void LabWorld::IntegratePositions(float32 h)
+{
+	const FloatW zero = SimdZero();
+	const FloatW one = SimdSet(1.0f);
+	const FloatW hw = SimdSet(h);
+	const FloatW maxTranslation = SimdSet(b2_maxTranslation);
+	const FloatW maxTranslationSquared = SimdSet(b2_maxTranslationSquared);
+	const FloatW maxRotation = SimdSet(b2_maxRotation);
+	const FloatW maxRotationSquared = SimdSet(b2_maxRotationSquared);
+
+	LabBodyArrays* s = &m_state;
+	int32 capacity = s->GetCapacity();
+	for (int32 i = 0; i < capacity; i += k_simdWidth)
+	{
+		FloatW awake = SimdLoad(&s->awake[i]) > zero;
+		FloatW vx = SimdLoad(&s->vx[i]);
+		FloatW vy = SimdLoad(&s->vy[i]);
+		FloatW w = SimdLoad(&s->w[i]);
+
+		// Check for large velocities.
+		FloatW tx = hw * vx;
+		FloatW ty = hw * vy;
+		FloatW translationSquared = tx * tx + ty * ty;
+		FloatW large = translationSquared > maxTranslationSquared;
+		FloatW ratio = SimdSelect(large, maxTranslation / SimdSqrt(SimdMax(translationSquared, maxTranslationSquared)), one);
+		vx = vx * ratio;
+		vy = vy * ratio;
+
+		FloatW rotation = hw * w;
+		FloatW rotationSquared = rotation * rotation;
+		large = rotationSquared > maxRotationSquared;
+		ratio = SimdSelect(large, maxRotation / SimdSqrt(SimdMax(rotationSquared, maxRotationSquared)), one);
+		w = w * ratio;
+
+		// Integrate
+		SimdStore(&s->cx[i], SimdSelect(awake, SimdLoad(&s->cx[i]) + hw * vx, SimdLoad(&s->cx[i])));
+		SimdStore(&s->cy[i], SimdSelect(awake, SimdLoad(&s->cy[i]) + hw * vy, SimdLoad(&s->cy[i])));
+		SimdStore(&s->a[i], SimdSelect(awake, SimdLoad(&s->a[i]) + hw * w, SimdLoad(&s->a[i])));
+		SimdStore(&s->vx[i], SimdSelect(awake, vx, SimdLoad(&s->vx[i])));
+		SimdStore(&s->vy[i], SimdSelect(awake, vy, SimdLoad(&s->vy[i])));
+		SimdStore(&s->w[i], SimdSelect(awake, w, SimdLoad(&s->w[i])));
+	}
+}
+
+void LabWorld::SynchronizeTransforms()
+{
+	const FloatW zero = SimdZero();
+
+	LabBodyArrays* s = &m_state;
+	int32 capacity = s->GetCapacity();
+	for (int32 i = 0; i < capacity; i += k_simdWidth)
+	{
+		FloatW awake = SimdLoad(&s->awake[i]) > zero;
+
+		FloatW sine, cosine;
+		SimdSinCos(SimdLoad(&s->a[i]), &sine, &cosine);
+
+		// xf.p = c - R * localCenter
+		FloatW lcx = SimdLoad(&s->localCenterX[i]);
+		FloatW lcy = SimdLoad(&s->localCenterY[i]);
+		FloatW px = SimdLoad(&s->cx[i]) - (cosine * lcx - sine * lcy);
+		FloatW py = SimdLoad(&s->cy[i]) - (sine * lcx + cosine * lcy);
+
+		SimdStore(&s->px[i], SimdSelect(awake, px, SimdLoad(&s->px[i])));
+		SimdStore(&s->py[i], SimdSelect(awake, py, SimdLoad(&s->py[i])));
+		SimdStore(&s->qs[i], SimdSelect(awake, sine, SimdLoad(&s->qs[i])));
+		SimdStore(&s->qc[i], SimdSelect(awake, cosine, SimdLoad(&s->qc[i])));
+	}
+}
+
+void LabWorld::UpdateSleepTimes(float32 h)
+{
+	const FloatW zero = SimdZero();
+	const FloatW hw = SimdSet(h);
+	const FloatW linTolSqr = SimdSet(b2_linearSleepTolerance * b2_linearSleepTolerance);
+	const FloatW angTolSqr = SimdSet(b2_angularSleepTolerance * b2_angularSleepTolerance);
+
+	LabBodyArrays* s = &m_state;
+	int32 capacity = s->GetCapacity();
+	for (int32 i = 0; i < capacity; i += k_simdWidth)
+	{
+		FloatW awake = SimdLoad(&s->awake[i]) > zero;
+		FloatW vx = SimdLoad(&s->vx[i]);
+		FloatW vy = SimdLoad(&s->vy[i]);
+		FloatW w = SimdLoad(&s->w[i]);
+
+		FloatW moving = zero >= SimdLoad(&s->allowSleep[i]);
+		moving = moving | (w * w > angTolSqr) | (vx * vx + vy * vy > linTolSqr);
+
+		FloatW sleepTime = SimdLoad(&s->sleepTime[i]);
+		FloatW resting = SimdSelect(moving, zero, sleepTime + hw);
+		SimdStore(&s->sleepTime[i], SimdSelect(awake, resting, sleepTime));
+	}
+}
+
+void LabWorld::Solve(const LabTimeStep& step)
+{
+	b2Timer timer;
+
+	int32 bodyCount = m_state.count;
+	float32 h = step.dt;
+
+	// Islands: touching contacts connect bodies, except through static ones.
+	m_islandParents.resize(bodyCount);
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		m_islandParents[i] = i;
+	}
+
+	for (size_t i = 0; i < m_contacts.size(); ++i)
+	{
+		const LabContact& contact = m_contacts[i];
+		if (contact.touching == false)
+		{
+			continue;
+		}
+
+		if (m_bodies[contact.bodyA].type == b2_staticBody || m_bodies[contact.bodyB].type == b2_staticBody)
+		{
+			continue;
+		}
+
+		int32 rootA = FindRoot(contact.bodyA);
+		int32 rootB = FindRoot(contact.bodyB);
+		if (rootA != rootB)
+		{
+			m_islandParents[rootA] = rootB;
+		}
+	}
+
+	// An island is awake if any of its bodies is; wake the rest.
+	m_islandAwake.assign(bodyCount, 0);
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		if (IsAwake(i))
+		{
+			m_islandAwake[FindRoot(i)] = 1;
+		}
+	}
+
+	m_awakeCount = 0;
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		if (m_islandAwake[FindRoot(i)])
+		{
+			SetAwake(i);
+		}
+
+		m_awakeCount += IsAwake(i);
+	}
+
+	IntegrateVelocities(h);
+
+	m_solverContacts.resize(0);
+	for (size_t i = 0; i < m_contacts.size(); ++i)
+	{
+		LabContact* contact = &m_contacts[i];
+		if (contact->touching && (IsAwake(contact->bodyA) || IsAwake(contact->bodyB)))
+		{
+			m_solverContacts.push_back(contact);
+		}
+	}
+
+	LabContactSolverDef solverDef;
+	solverDef.step = step;
+	solverDef.contacts = m_solverContacts.data();
+	solverDef.count = (int32)m_solverContacts.size();
+	solverDef.bodies = &m_state;
+
+	bool wide = m_solverType == e_wideSolver;
+	if (wide)
+	{
+		m_wideSolver.Initialize(solverDef);
+		m_wideSolver.InitializeVelocityConstraints();
+		if (step.warmStarting)
+		{
+			m_wideSolver.WarmStart();
+		}
+	}
+	else
+	{
+		m_scalarSolver.Initialize(solverDef);
+		m_scalarSolver.InitializeVelocityConstraints();
+		if (step.warmStarting)
+		{
+			m_scalarSolver.WarmStart();
+		}
+	}
+
+	m_profile.solveInit = timer.GetMilliseconds();
+
+	// Solve velocity constraints.
+	timer.Reset();
+	for (int32 i = 0; i < step.velocityIterations; ++i)
+	{
+		if (wide)
+		{
+			m_wideSolver.SolveVelocityConstraints();
+		}
+		else
+		{
+			m_scalarSolver.SolveVelocityConstraints();
+		}
+	}
+
+	// Store impulses for warm starting.
+	if (wide)
+	{
+		m_wideSolver.StoreImpulses();
+	}
+	else
+	{
+		m_scalarSolver.StoreImpulses();
+	}
+	m_profile.solveVelocity = timer.GetMilliseconds();
+
+	IntegratePositions(h);
+
+	// Solve position constraints
+	timer.Reset();
+	bool positionSolved = false;
+	for (int32 i = 0; i < step.positionIterations; ++i)
+	{
+		bool contactsOkay = wide ? m_wideSolver.SolvePositionConstraints() : m_scalarSolver.SolvePositionConstraints();
+		if (contactsOkay)
+		{
+			// Exit early if the position errors are small.
+			positionSolved = true;
+			break;
+		}
+	}
+	m_profile.solvePosition = timer.GetMilliseconds();
+
+	SynchronizeTransforms();
+
+	// Sleep whole islands whose bodies have all been resting long enough.
+	// Unlike b2Island the position test covers all islands at once.
+	if (m_allowSleep)
+	{
+		UpdateSleepTimes(h);
+
+		m_islandSleepTimes.assign(bodyCount, b2_maxFloat);
+		for (int32 i = 0; i < bodyCount; ++i)
+		{
+			if (IsAwake(i))
+			{
+				int32 root = FindRoot(i);
+				m_islandSleepTimes[root] = b2Min(m_islandSleepTimes[root], m_state.sleepTime[i]);
+			}
+		}
+
+		if (positionSolved)
+		{
+			for (int32 i = 0; i < bodyCount; ++i)
+			{
+				if (IsAwake(i) && m_islandSleepTimes[FindRoot(i)] >= b2_timeToSleep)
+				{
+					m_state.awake[i] = 0.0f;
+					m_state.sleepTime[i] = 0.0f;
+					m_state.vx[i] = 0.0f;
+					m_state.vy[i] = 0.0f;
+					m_state.w[i] = 0.0f;
+				}
+			}
+		}
+	}
+}
+
+void LabWorld::SynchronizeFixtures()
+{
+	for (int32 i = 0; i < m_state.count; ++i)
+	{
+		int32 fixtureList = m_bodies[i].fixtureList;
+		if (m_bodies[i].type == b2_staticBody || fixtureList == -1)
+		{
+			continue;
+		}
+
+		// Keep sleeping bodies out of the tree that moved proxies live in.
+		LabProxyType proxyType = IsAwake(i) ? e_labDynamicProxy : e_labSleepingProxy;
+		if (m_broadPhase->GetProxyType(m_fixtures[fixtureList].proxyId) != proxyType)
+		{
+			for (int32 f = fixtureList; f != -1; f = m_fixtures[f].next)
+			{
+				m_broadPhase->SetProxyType(m_fixtures[f].proxyId, proxyType);
+			}
+		}
+
+		if (IsAwake(i) == false)
+		{
+			continue;
+		}
+
+		b2Transform xf1;
+		xf1.q.Set(m_state.a0[i]);
+		xf1.p = b2Vec2(m_state.c0x[i], m_state.c0y[i]) - b2Mul(xf1.q, m_state.GetLocalCenter(i));
+		b2Transform xf2 = m_state.GetTransform(i);
+
+		for (int32 f = m_bodies[i].fixtureList; f != -1; f = m_fixtures[f].next)
+		{
+			const LabFixture& fixture = m_fixtures[f];
+
+			// Compute an AABB that covers the swept shape.
+			b2AABB aabb1, aabb2;
+			fixture.shape->ComputeAABB(&aabb1, xf1, 0);
+			fixture.shape->ComputeAABB(&aabb2, xf2, 0);
+
+			b2AABB aabb;
+			aabb.Combine(aabb1, aabb2);
+
+			b2Vec2 displacement = xf2.p - xf1.p;
+			m_broadPhase->MoveProxy(fixture.proxyId, aabb, displacement);
+		}
+	}
+}
+
+void LabWorld::Step(float32 dt, int32 velocityIterations, int32 positionIterations)
+{
+	b2Timer stepTimer;
+
+	// If new fixtures were added, we need to find the new contacts.
+	if (m_newFixture)
+	{
+		m_broadPhase->UpdatePairs(this);
+		m_newFixture = false;
+	}
+
+	LabTimeStep step;
+	step.dt = dt;
+	step.velocityIterations = velocityIterations;
+	step.positionIterations = positionIterations;
+	step.inv_dt = dt > 0.0f ? 1.0f / dt : 0.0f;
+	step.dtRatio = m_inv_dt0 * dt;
+	step.warmStarting = m_warmStarting;
+
+	// Update contacts. This is where some contacts are destroyed.
+	{
+		b2Timer timer;
+		Collide();
+		m_profile.collide = timer.GetMilliseconds();
+	}
+
+	// Integrate velocities, solve velocity constraints, and integrate positions.
+	if (step.dt > 0.0f)
+	{
+		b2Timer timer;
+		Solve(step);
+		m_profile.solve = timer.GetMilliseconds();
+
+		// Synchronize fixtures, check for out of range bodies, and find
+		// new contacts.
+		timer.Reset();
+		SynchronizeFixtures();
+		m_broadPhase->UpdatePairs(this);
+		m_profile.broadphase = timer.GetMilliseconds();
+	}
+
+	if (step.dt > 0.0f)
+	{
+		m_inv_dt0 = step.inv_dt;
+	}
+
+	m_profile.solveTOI = 0.0f;
+	m_profile.step = stepTimer.GetMilliseconds();
+}
+
+// The body arrays that Step writes. The others only change when fixtures
+// are created, and a state cannot be restored across that.
+static int32 GetStepArrays(std::vector<float32>** arrays, LabBodyArrays* state)
+{
+	int32 count = 0;
+	arrays[count++] = &state->cx;
+	arrays[count++] = &state->cy;
+	arrays[count++] = &state->a;
+	arrays[count++] = &state->c0x;
+	arrays[count++] = &state->c0y;
+	arrays[count++] = &state->a0;
+	arrays[count++] = &state->vx;
+	arrays[count++] = &state->vy;
+	arrays[count++] = &state->w;
+	arrays[count++] = &state->sleepTime;
+	arrays[count++] = &state->awake;
+	arrays[count++] = &state->px;
+	arrays[count++] = &state->py;
+	arrays[count++] = &state->qs;
+	arrays[count++] = &state->qc;
+	return count;
+}
+
+static const int32 k_maxStepArrays = 16;
+
+void LabWorld::SaveState(LabWorldState* state)
+{
+	// The pairs would be found at the start of the next step; finding them
+	// now leaves the proxies with nothing pending, as after any step.
+	if (m_newFixture)
+	{
+		m_broadPhase->UpdatePairs(this);
+		m_newFixture = false;
+	}
+
+	std::vector<float32>* arrays[k_maxStepArrays];
+	int32 arrayCount = GetStepArrays(arrays, &m_state);
+
+	int32 bodyCount = m_state.count;
+	int32 fixtureCount = (int32)m_fixtures.size();
+	int32 contactCount = (int32)m_contacts.size();
+	size_t arrayBytes = bodyCount * sizeof(float32);
+	size_t size = contactCount * sizeof(LabContact) + arrayCount * arrayBytes + fixtureCount * (sizeof(b2AABB) + sizeof(uint8));
+
+	state->m_bodyCount = bodyCount;
+	state->m_fixtureCount = fixtureCount;
+	state->m_contactCount = contactCount;
+	state->m_awakeCount = m_awakeCount;
+	state->m_inv_dt0 = m_inv_dt0;
+	state->m_buffer.resize(size);
+
+	// Contacts go first so they stay aligned in the buffer.
+	uint8* p = state->m_buffer.data();
+	memcpy(p, m_contacts.data(), contactCount * sizeof(LabContact));
+	p += contactCount * sizeof(LabContact);
+
+	for (int32 i = 0; i < arrayCount; ++i)
+	{
+		memcpy(p, arrays[i]->data(), arrayBytes);
+		p += arrayBytes;
+	}
+
+	for (int32 i = 0; i < fixtureCount; ++i)
+	{
+		int32 proxyId = m_fixtures[i].proxyId;
+		memcpy(p, &m_broadPhase->GetFatAABB(proxyId), sizeof(b2AABB));
+		p += sizeof(b2AABB);
+	}
+
+	for (int32 i = 0; i < fixtureCount; ++i)
+	{
+		*p++ = (uint8)m_broadPhase->GetProxyType(m_fixtures[i].proxyId);
+	}
+
+	b2Assert(p == state->m_buffer.data() + size);
+}
+
+bool LabWorld::RestoreState(const LabWorldState& state)
+{
+	// Bodies and fixtures are only ever added, so the counts tell whether
+	// the state was saved by this world as it is now.
+	if (state.m_bodyCount != m_state.count || state.m_fixtureCount != (int32)m_fixtures.size())
+	{
+		return false;
+	}
+
+	std::vector<float32>* arrays[k_maxStepArrays];
+	int32 arrayCount = GetStepArrays(arrays, &m_state);
+	int32 contactCount = state.m_contactCount;
+	size_t arrayBytes = m_state.count * sizeof(float32);
+	size_t size = contactCount * sizeof(LabContact) + arrayCount * arrayBytes + state.m_fixtureCount * (sizeof(b2AABB) + sizeof(uint8));
+	if (state.m_buffer.size() != size)
+	{
+		return false;
+	}
+
+	const uint8* p = state.m_buffer.data();
+	const LabContact* contacts = (const LabContact*)p;
+	int32 oldCount = (int32)m_contacts.size();
+	p += contactCount * sizeof(LabContact);
+
+	// A few steps on, most contacts are still at the same index, and their
+	// pair map entries are already right. Only the others are redone.
+	for (int32 i = 0; i < oldCount; ++i)
+	{
+		const LabContact* contact = &m_contacts[i];
+		if (i >= contactCount || contact->fixtureA != contacts[i].fixtureA || contact->fixtureB != contacts[i].fixtureB)
+		{
+			m_pairs.erase(PairKey(contact->fixtureA, contact->fixtureB));
+		}
+	}
+
+	for (int32 i = 0; i < contactCount; ++i)
+	{
+		const LabContact* contact = contacts + i;
+		if (i >= oldCount || contact->fixtureA != m_contacts[i].fixtureA || contact->fixtureB != m_contacts[i].fixtureB)
+		{
+			m_pairs[PairKey(contact->fixtureA, contact->fixtureB)] = i;
+		}
+	}
+
+	m_contacts.resize(contactCount);
+	memcpy(m_contacts.data(), contacts, contactCount * sizeof(LabContact));
+
+	for (int32 i = 0; i < arrayCount; ++i)
+	{
+		memcpy(arrays[i]->data(), p, arrayBytes);
+		p += arrayBytes;
+	}
+
+	// Type first: moving a proxy between trees may round its fat AABB,
+	// which is then put back exactly. Only the proxies that moved since
+	// the save are touched.
+	int32 fixtureCount = state.m_fixtureCount;
+	const uint8* aabbs = p;
+	const uint8* types = p + fixtureCount * sizeof(b2AABB);
+	for (int32 i = 0; i < fixtureCount; ++i)
+	{
+		int32 proxyId = m_fixtures[i].proxyId;
+		LabProxyType type = (LabProxyType)types[i];
+		if (m_broadPhase->GetProxyType(proxyId) != type)
+		{
+			m_broadPhase->SetProxyType(proxyId, type);
+		}
+
+		b2AABB fatAABB;
+		memcpy(&fatAABB, aabbs + i * sizeof(b2AABB), sizeof(b2AABB));
+		const b2AABB& current = m_broadPhase->GetFatAABB(proxyId);
+		if (current.lowerBound != fatAABB.lowerBound || current.upperBound != fatAABB.upperBound)
+		{
+			m_broadPhase->SetFatAABB(proxyId, fatAABB);
+		}
+	}
+
+	m_awakeCount = state.m_awakeCount;
+	m_inv_dt0 = state.m_inv_dt0;
+	m_newFixture = false;
+	return true;
+}
+
+uint32 LabWorld::ComputeChecksum() const
+{
+	uint32 hash = k_checksumBasis;
+	for (int32 i = 0; i < m_state.count; ++i)
+	{
+		float32 state[6];
+		state[0] = m_state.px[i];
+		state[1] = m_state.py[i];
+		state[2] = m_state.a[i];
+		state[3] = m_state.vx[i];
+		state[4] = m_state.vy[i];
+		state[5] = m_state.w[i];
+		hash = ChecksumWords(hash, state, sizeof(state));
+
+		uint32 awake = IsAwake(i);
+		hash = ChecksumWords(hash, &awake, sizeof(uint32));
+	}
+	return hash;
+}
+
+void LabWorld::DrawDebugData(b2Draw* draw) const
+{
+	uint32 flags = draw->GetFlags();
+
+	for (int32 i = 0; i < m_state.count; ++i)
+	{
+		const LabBody* b = &m_bodies[i];
+		b2Transform xf = m_state.GetTransform(i);
+
+		b2Color color;
+		if (b->type == b2_staticBody)
+		{
+			color = b2Color(0.5f, 0.9f, 0.5f);
+		}
+		else if (b->type == b2_kinematicBody)
+		{
+			color = b2Color(0.5f, 0.5f, 0.9f);
+		}
+		else if (IsAwake(i) == false)
+		{
+			color = b2Color(0.6f, 0.6f, 0.6f);
+		}
+		else
+		{
+			color = b2Color(0.9f, 0.7f, 0.7f);
+		}
+
+		for (int32 f = b->fixtureList; f != -1; f = m_fixtures[f].next)
+		{
+			const LabFixture& fixture = m_fixtures[f];
+
+			if (flags & b2Draw::e_shapeBit)
+			{
+				switch (fixture.shape->GetType())
+				{
+				case b2Shape::e_circle:
+					{
+						const b2CircleShape* circle = (const b2CircleShape*)fixture.shape;
+						b2Vec2 center = b2Mul(xf, circle->m_p);
+						b2Vec2 axis = b2Mul(xf.q, b2Vec2(1.0f, 0.0f));
+						draw->DrawSolidCircle(center, circle->m_radius, axis, color);
+					}
+					break;
+
+				case b2Shape::e_edge:
+					{
+						const b2EdgeShape* edge = (const b2EdgeShape*)fixture.shape;
+						draw->DrawSegment(b2Mul(xf, edge->m_vertex1), b2Mul(xf, edge->m_vertex2), color);
+					}
+					break;
+
+				case b2Shape::e_polygon:
+					{
+						const b2PolygonShape* poly = (const b2PolygonShape*)fixture.shape;
+						b2Vec2 vertices[b2_maxPolygonVertices];
+						for (int32 j = 0; j < poly->m_count; ++j)
+						{
+							vertices[j] = b2Mul(xf, poly->m_vertices[j]);
+						}
+						draw->DrawSolidPolygon(vertices, poly->m_count, color);
+					}
+					break;
+
+				default:
+					break;
+				}
+			}
+
+			if (flags & b2Draw::e_aabbBit)
+			{
+				b2AABB aabb = m_broadPhase->GetFatAABB(fixture.proxyId);
+				b2Vec2 vs[4];
+				vs[0].Set(aabb.lowerBound.x, aabb.lowerBound.y);
+				vs[1].Set(aabb.upperBound.x, aabb.lowerBound.y);
+				vs[2].Set(aabb.upperBound.x, aabb.upperBound.y);
+				vs[3].Set(aabb.lowerBound.x, aabb.upperBound.y);
+				draw->DrawPolygon(vs, 4, b2Color(0.9f, 0.3f, 0.9f));
+			}
+		}
+
+		if (flags & b2Draw::e_centerOfMassBit)
+		{
+			b2Transform centerXf = xf;
+			centerXf.p = m_state.GetCenter(i);
+			draw->DrawTransform(centerXf);
+		}
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include "LabCollide.h"
+#include "LabContactSolver.h"
+#include "LabTreeBroadPhase.h"
+#include "LabWideSolver.h"
+#include "LabWorldState.h"
+#include "WorldArena.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Per-body data that the step does not touch. The simulation state lives
+// in LabWorld's LabBodyArrays under the same body id.
+struct LabBody
+{
+	b2BodyType type;
+	float32 mass;
+	float32 I;
+	int32 fixtureList;
+	void* userData;
+	bool fixedRotation;
+};
+
+struct LabFixture
+{
+	b2Shape* shape;
+	LabShapeKind kind;
+	int32 body;
+	int32 next;
+	int32 proxyId;
+	float32 density;
+	float32 friction;
+	float32 restitution;
+	b2Filter filter;
+	void* userData;
+};
+
+struct LabContact
+{
+	int32 fixtureA;
+	int32 fixtureB;
+	int32 bodyA;
+	int32 bodyB;
+	LabCollideFcn* collide;
+	b2Manifold manifold;
+	float32 friction;
+	float32 restitution;
+	float32 radiusA;
+	float32 radiusB;
+	bool touching;
+};
+
+// A small rigid body world for solver experiments that b2World's internals
+// do not allow: it has its own bodies, contacts and islands but uses Box2D's
+// shapes and manifold functions with its own broad-phase. Bodies may only be created,
+// so a body id stays valid for the life of the world. There are no joints,
+// sensors, chain shapes or continuous collision.
+//
+// Everything the world owns is in a few flat arrays and an arena for the
+// shapes, so deleting it frees a handful of blocks however big it is.
+class LabWorld
+{
+public:
+	enum SolverType
+	{
+		e_scalarSolver,
+		e_wideSolver,
+		e_solverTypeCount
+	};
+
+	LabWorld(const b2Vec2& gravity);
+	~LabWorld();
+
+	// Returns the body id.
+	int32 CreateBody(const b2BodyDef* def);
+
+	// Shapes are copied. Chain shapes are not supported.
+	int32 CreateFixture(int32 body, const b2FixtureDef* def);
+	int32 CreateFixture(int32 body, const b2Shape* shape, float32 density);
+
+	void Step(float32 timeStep, int32 velocityIterations, int32 positionIterations);
+
+	// Copies out or puts back everything Step changes, for rollback; see
+	// LabWorldState. Stepping on from a restored state repeats the steps
+	// taken after it was saved bit for bit. Saving first finds the pairs of
+	// fixtures created since the last step, as the next Step would.
+	// Restoring returns false, and changes nothing, if the state was saved
+	// with other body or fixture counts.
+	void SaveState(LabWorldState* state);
+	bool RestoreState(const LabWorldState& state);
+
+	// Same contents and hash as ComputeWorldChecksum, in body id order.
+	uint32 ComputeChecksum() const;
+
+	void SetSolverType(SolverType type) { m_solverType = type; }
+	SolverType GetSolverType() const { return m_solverType; }
+	static const char* GetSolverName(SolverType type);
+
+	void SetGravity(const b2Vec2& gravity) { m_gravity = gravity; }
+	void SetAllowSleeping(bool flag);
+	void SetWarmStarting(bool flag) { m_warmStarting = flag; }
+
+	// Moves every proxy into a new broad-phase of the given type, keeping
+	// the proxy ids and fat AABBs, so it can be switched at any time.
+	void SetBroadPhaseType(LabBroadPhase::Type type);
+	LabBroadPhase::Type GetBroadPhaseType() const { return m_broadPhase->GetType(); }
+
+	// Does nothing unless the broad-phase is a tree.
+	void SetBroadPhaseSplit(LabTreeBroadPhase::SplitMode mode);
+
+	// Same flags as b2World::DrawDebugData; joints and pairs are ignored.
+	void DrawDebugData(b2Draw* draw) const;
+
+	int32 GetBodyCount() const { return (int32)m_bodies.size(); }
+	int32 GetContactCount() const { return (int32)m_contacts.size(); }
+	int32 GetAwakeBodyCount() const { return m_awakeCount; }
+	const LabBody& GetBody(int32 id) const { return m_bodies[id]; }
+	const LabBodyArrays& GetBodyArrays() const { return m_state; }
+	b2Transform GetTransform(int32 id) const { return m_state.GetTransform(id); }
+	bool IsAwake(int32 id) const { return m_state.awake[id] != 0.0f; }
+	const b2Profile& GetProfile() const { return m_profile; }
+	const LabWideSolver& GetWideSolver() const { return m_wideSolver; }
+	const LabBroadPhase& GetBroadPhase() const { return *m_broadPhase; }
+
+	// NULL unless the broad-phase is a tree.
+	const LabTreeBroadPhase* GetTreeBroadPhase() const;
+
+	// Broad-phase callback.
+	void AddPair(void* proxyUserDataA, void* proxyUserDataB);
+
+private:
+	void ResetMassData(int32 body);
+	void SetAwake(int32 body);
+	void Collide();
+	void DestroyContact(int32 index);
+	void Solve(const LabTimeStep& step);
+	void SynchronizeFixtures();
+
+	// Loops over all bodies, k_simdWidth at a time.
+	void IntegrateVelocities(float32 h);
+	void IntegratePositions(float32 h);
+	void SynchronizeTransforms();
+	void UpdateSleepTimes(float32 h);
+	int32 FindRoot(int32 body);
+
+	static uint64_t PairKey(int32 fixtureA, int32 fixtureB);
+
+	b2Vec2 m_gravity;
+	std::vector<LabBody> m_bodies;
+	LabBodyArrays m_state;
+	std::vector<LabFixture> m_fixtures;
+	std::vector<LabContact> m_contacts;
+	std::unordered_map<uint64_t, int32> m_pairs;
+	LabBroadPhase* m_broadPhase;
+	WorldArena m_arena;
+
+	// Step scratch.
+	std::vector<LabContact*> m_solverContacts;
+	std::vector<int32> m_islandParents;
+	std::vector<float32> m_islandSleepTimes;
+	std::vector<uint8> m_islandAwake;
+
+	LabContactSolver m_scalarSolver;
+	LabWideSolver m_wideSolver;
+	SolverType m_solverType;
+
+	b2Profile m_profile;
+	float32 m_inv_dt0;
+	int32 m_awakeCount;
+	bool m_allowSleep;
+	bool m_warmStarting;
+	bool m_newFixture;
+};
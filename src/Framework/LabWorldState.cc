@@ -0,0 +1,68 @@
+#include "LabWorldState.h"
+#include "LabWorld.h"
+#include <cstring>
+
+LabWorldState::LabWorldState()
+{
+	m_bodyCount = 0;
+	m_fixtureCount = 0;
+	m_contactCount = 0;
+	m_awakeCount = 0;
+	m_inv_dt0 = 0.0f;
+}
+
+bool LabWorldState::IsEqual(const LabWorldState& other) const
+{
+	if (m_bodyCount != other.m_bodyCount || m_fixtureCount != other.m_fixtureCount || m_contactCount != other.m_contactCount)
+	{
+		return false;
+	}
+
+	if (m_awakeCount != other.m_awakeCount || memcmp(&m_inv_dt0, &other.m_inv_dt0, sizeof(float32)) != 0)
+	{
+		return false;
+	}
+
+	return m_buffer.size() == other.m_buffer.size() && memcmp(m_buffer.data(), other.m_buffer.data(), m_buffer.size()) == 0;
+}
+
+LabStateRing::LabStateRing(int32 capacity)
+{
+	b2Assert(capacity > 0);
+	m_states.resize(capacity);
+	m_newest = capacity - 1;
+	m_count = 0;
+}
+
+void LabStateRing::Push(LabWorld* world)
+{
+	int32 capacity = (int32)m_states.size();
+	m_newest = (m_newest + 1) % capacity;
+	m_count = b2Min(m_count + 1, capacity);
+	world->SaveState(&m_states[m_newest]);
+}
+
+const LabWorldState& LabStateRing::Get(int32 back) const
+{
+	b2Assert(0 <= back && back < m_count);
+	int32 capacity = (int32)m_states.size();
+	return m_states[(m_newest - back + capacity) % capacity];
+}
+
+void LabStateRing::Drop(int32 count)
+{
+	b2Assert(0 <= count && count <= m_count);
+	int32 capacity = (int32)m_states.size();
+	m_newest = (m_newest - count + capacity) % capacity;
+	m_count -= count;
+}
+
+int32 LabStateRing::GetByteCount() const
+{
+	int32 bytes = 0;
+	for (int32 i = 0; i < m_count; ++i)
+	{
+		bytes += Get(i).GetSize();
+	}
+	return bytes;
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "Box2D/Box2D.h"
+#include <vector>
+
+class LabWorld;
+
+// Everything LabWorld::Step changes, packed into one buffer: the bodies'
+// sweeps, velocities, transforms and sleep state, the contacts with their
+// manifolds and warm starting impulses, and the fat AABB and type of every
+// broad-phase proxy. Body and fixture definitions are not copied, so a
+// state can only be restored into the world that saved it, and only while
+// that world has the same bodies and fixtures. Contacts keep their collide
+// function pointers, so a state does not outlive the process.
+class LabWorldState
+{
+public:
+	LabWorldState();
+
+	int32 GetSize() const { return (int32)m_buffer.size(); }
+	int32 GetBodyCount() const { return m_bodyCount; }
+	int32 GetContactCount() const { return m_contactCount; }
+
+	// Byte for byte, so two equal states step on identically.
+	bool IsEqual(const LabWorldState& other) const;
+
+private:
+	friend class LabWorld;
+
+	std::vector<uint8> m_buffer;
+	int32 m_bodyCount;
+	int32 m_fixtureCount;
+	int32 m_contactCount;
+	int32 m_awakeCount;
+	float32 m_inv_dt0;
+};
+
+// The most recent states of a world, for rewinding. Once full, each save
+// reuses the buffer of the oldest state, so saving does not allocate. A
+// state of a few thousand bodies in contact is about a megabyte, so the
+// default keeps one second at 60 Hz.
+class LabStateRing
+{
+public:
+	enum
+	{
+		e_defaultCapacity = 60
+	};
+
+	explicit LabStateRing(int32 capacity = e_defaultCapacity);
+
+	// Saves the world as the newest state.
+	void Push(LabWorld* world);
+
+	// The state saved 'back' saves before the newest one.
+	const LabWorldState& Get(int32 back) const;
+
+	// Forgets the newest 'count' states, e.g. to carry on from a rewound one.
+	void Drop(int32 count);
+
+	void Clear() { m_count = 0; }
+
+	int32 GetCount() const { return m_count; }
+	int32 GetCapacity() const { return (int32)m_states.size(); }
+
+	// Bytes held by all saved states.
+	int32 GetByteCount() const;
+
+private:
+	std::vector<LabWorldState> m_states;
+	int32 m_newest;
+	int32 m_count;
+};
@@ -0,0 +1,436 @@
+#include "ParallelToi.h"
+#include "JobSystem.h"
+#include "Test.h"
+#include <algorithm>
+#include <cstdio>
+
+ParallelToi::ParallelToi()
+{
+	m_time = 0.0f;
+	m_eventCount = 0;
+	m_roundCount = 0;
+}
+
+void ParallelToi::Begin(b2World* world)
+{
+	m_bodies.clear();
+	m_bodyIndices.clear();
+
+	for (b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+	{
+		if (body->GetType() == b2_staticBody)
+		{
+			continue;
+		}
+
+		BodyState state;
+		state.body = body;
+		state.sweep.localCenter = body->GetLocalCenter();
+		state.sweep.c0 = body->GetWorldCenter();
+		state.sweep.c = state.sweep.c0;
+		state.sweep.a0 = body->GetAngle();
+		state.sweep.a = state.sweep.a0;
+		state.sweep.alpha0 = 0.0f;
+		state.claimRound = -1;
+
+		m_bodyIndices[body] = (int32)m_bodies.size();
+		m_bodies.push_back(state);
+	}
+}
+
+void ParallelToi::GetSweep(b2Sweep* sweep, int32 index, const b2Body* body) const
+{
+	if (index == b2_nullNode)
+	{
+		// Static bodies do not move.
+		sweep->localCenter = body->GetLocalCenter();
+		sweep->c0 = body->GetWorldCenter();
+		sweep->c = sweep->c0;
+		sweep->a0 = body->GetAngle();
+		sweep->a = sweep->a0;
+		sweep->alpha0 = 0.0f;
+		return;
+	}
+
+	*sweep = m_bodies[index].sweep;
+}
+
+void ParallelToi::ComputeToi(int32 begin, int32 end)
+{
+	ConcurrentCollisionScope concurrent;
+	CollisionCounters counters;
+	for (int32 i = begin; i < end; ++i)
+	{
+		Candidate& candidate = m_candidates[m_dirty[i]];
+		b2Contact* contact = candidate.contact;
+		b2Fixture* fA = contact->GetFixtureA();
+		b2Fixture* fB = contact->GetFixtureB();
+
+		b2TOIInput input;
+		input.proxyA.Set(fA->GetShape(), contact->GetChildIndexA());
+		input.proxyB.Set(fB->GetShape(), contact->GetChildIndexB());
+		GetSweep(&input.sweepA, candidate.indexA, fA->GetBody());
+		GetSweep(&input.sweepB, candidate.indexB, fB->GetBody());
+
+		// Put the sweeps onto the same time interval, as b2World::SolveTOI
+		// does. Advancing only reparameterizes the copy; the motion is the
+		// same.
+		float32 alpha0 = b2Max(input.sweepA.alpha0, input.sweepB.alpha0);
+		if (input.sweepA.alpha0 < alpha0)
+		{
+			input.sweepA.Advance(alpha0);
+		}
+		else if (input.sweepB.alpha0 < alpha0)
+		{
+			input.sweepB.Advance(alpha0);
+		}
+		input.tMax = 1.0f;
+
+		b2TOIOutput output;
+		CountedTimeOfImpact(&output, &input, &counters);
+
+		// A pair touching at the start of its interval was already in
+		// contact there; the discrete solver owns it. Otherwise the fraction
+		// of the remaining interval goes back to the step's time line.
+		if (output.state == b2TOIOutput::e_touching && output.t > 0.0f)
+		{
+			candidate.t = b2Min(alpha0 + (1.0f - alpha0) * output.t, 1.0f);
+		}
+		else
+		{
+			candidate.t = 1.0f;
+		}
+		candidate.dirty = false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_countersMutex);
+	m_counters.Add(counters);
+}
+
+void ParallelToi::Clamp(int32 index, float32 alpha)
+{
+	BodyState& state = m_bodies[index];
+	b2Sweep& sweep = state.sweep;
+
+	// Like b2Body::Advance: the sweep now starts at the impact and stays
+	// there. alpha0 keeps it on the step's time line, so later evaluations
+	// line it up with the sweeps of bodies that were not clamped.
+	sweep.Advance(alpha);
+	sweep.c = sweep.c0;
+	sweep.a = sweep.a0;
+
+	b2Transform xf;
+	sweep.GetTransform(&xf, 1.0f);
+	state.body->SetTransform(xf.p, sweep.a);
+	state.body->SetAwake(true);
+}
+
+struct ParallelToiHitLess
+{
+	explicit ParallelToiHitLess(const float32* times) : times(times) {}
+
+	bool operator()(int32 a, int32 b) const
+	{
+		// Ties go to the lower candidate index so the result never depends
+		// on how the work was split.
+		return times[a] < times[b] || (times[a] == times[b] && a < b);
+	}
+
+	const float32* times;
+};
+
+// Orders the ranges being merged by their next hit. Greater rather than
+// less, so the standard heap functions keep the earliest one on top.
+struct ParallelToiHeadGreater
+{
+	ParallelToiHeadGreater(const float32* times, const int32* hits, const int32* next)
+		: less(times), hits(hits), next(next) {}
+
+	bool operator()(int32 a, int32 b) const
+	{
+		return less(hits[next[b]], hits[next[a]]);
+	}
+
+	ParallelToiHitLess less;
+	const int32* hits;
+	const int32* next;
+};
+
+void ParallelToi::CollectHits(int32 begin, int32 end)
+{
+	// The range keeps its hits at the front of its own part of m_hits,
+	// sorted, so the ranges only need merging.
+	int32 count = 0;
+	for (int32 i = begin; i < end; ++i)
+	{
+		float32 t = m_candidates[i].t;
+		m_times[i] = t;
+		if (t < 1.0f)
+		{
+			m_hits[begin + count] = i;
+			++count;
+		}
+	}
+
+	std::sort(m_hits.begin() + begin, m_hits.begin() + begin + count, ParallelToiHitLess(m_times.data()));
+	m_rangeEnds[begin] = end;
+	m_rangeHitCounts[begin] = count;
+}
+
+void ParallelToi::Solve(b2World* world)
+{
+	b2Timer timer;
+	m_candidates.clear();
+	m_counters.Reset();
+	m_eventCount = 0;
+	m_roundCount = 0;
+
+	// The step moved every body to its end pose; that closes each sweep.
+	for (size_t i = 0; i < m_bodies.size(); ++i)
+	{
+		BodyState& state = m_bodies[i];
+		state.sweep.c = state.body->GetWorldCenter();
+		state.sweep.a = state.body->GetAngle();
+	}
+
+	for (b2Contact* contact = world->GetContactList(); contact; contact = contact->GetNext())
+	{
+		if (contact->IsEnabled() == false)
+		{
+			continue;
+		}
+
+		b2Fixture* fA = contact->GetFixtureA();
+		b2Fixture* fB = contact->GetFixtureB();
+		if (fA->IsSensor() || fB->IsSensor())
+		{
+			continue;
+		}
+
+		b2Body* bA = fA->GetBody();
+		b2Body* bB = fB->GetBody();
+		b2BodyType typeA = bA->GetType();
+		b2BodyType typeB = bB->GetType();
+
+		bool activeA = bA->IsAwake() && typeA != b2_staticBody;
+		bool activeB = bB->IsAwake() && typeB != b2_staticBody;
+		if (activeA == false && activeB == false)
+		{
+			continue;
+		}
+
+		// Same rule as b2World::SolveTOI: dynamic pairs only when a bullet
+		// is involved.
+		bool collideA = bA->IsBullet() || typeA != b2_dynamicBody;
+		bool collideB = bB->IsBullet() || typeB != b2_dynamicBody;
+		if (collideA == false && collideB == false)
+		{
+			continue;
+		}
+
+		Candidate candidate;
+		candidate.contact = contact;
+		candidate.indexA = b2_nullNode;
+		candidate.indexB = b2_nullNode;
+		if (typeA != b2_staticBody)
+		{
+			std::unordered_map<const b2Body*, int32>::const_iterator it = m_bodyIndices.find(bA);
+			if (it == m_bodyIndices.end())
+			{
+				// Created after Begin; it has no sweep for this step.
+				continue;
+			}
+			candidate.indexA = it->second;
+		}
+		if (typeB != b2_staticBody)
+		{
+			std::unordered_map<const b2Body*, int32>::const_iterator it = m_bodyIndices.find(bB);
+			if (it == m_bodyIndices.end())
+			{
+				continue;
+			}
+			candidate.indexB = it->second;
+		}
+		candidate.t = 1.0f;
+		candidate.dirty = true;
+		candidate.resolved = false;
+		m_candidates.push_back(candidate);
+	}
+
+	for (int32 round = 0; round < e_maxRounds; ++round)
+	{
+		m_dirty.clear();
+		for (int32 i = 0; i < (int32)m_candidates.size(); ++i)
+		{
+			if (m_candidates[i].dirty)
+			{
+				m_dirty.push_back(i);
+			}
+		}
+
+		g_jobSystem.ParallelFor((int32)m_dirty.size(), e_minChunkSize, [this](int32 begin, int32 end)
+		{
+			ComputeToi(begin, end);
+		});
+
+		// Ordered reduction: every range sorts its own hits by (t, index)
+		// and the ranges are merged, earliest first. The first hit is the
+		// minimum b2World::SolveTOI would find; the rest form the batch.
+		int32 candidateCount = (int32)m_candidates.size();
+		m_times.resize(candidateCount);
+		m_hits.resize(candidateCount);
+		m_rangeEnds.resize(candidateCount);
+		m_rangeHitCounts.resize(candidateCount);
+		m_rangeNext.resize(candidateCount);
+		g_jobSystem.ParallelFor(candidateCount, e_minChunkSize, [this](int32 begin, int32 end)
+		{
+			CollectHits(begin, end);
+		});
+
+		// A range's hits start at its first candidate's index.
+		m_heads.clear();
+		for (int32 begin = 0; begin < candidateCount; begin = m_rangeEnds[begin])
+		{
+			if (m_rangeHitCounts[begin] > 0)
+			{
+				m_rangeNext[begin] = begin;
+				m_heads.push_back(begin);
+			}
+		}
+
+		if (m_heads.empty())
+		{
+			break;
+		}
+
+		++m_roundCount;
+		ParallelToiHeadGreater greater(m_times.data(), m_hits.data(), m_rangeNext.data());
+		std::make_heap(m_heads.begin(), m_heads.end(), greater);
+
+		// Events on disjoint bodies cannot affect each other's impact times,
+		// so take the earliest one per body this round.
+		while (m_heads.empty() == false)
+		{
+			std::pop_heap(m_heads.begin(), m_heads.end(), greater);
+			int32 range = m_heads.back();
+			Candidate& candidate = m_candidates[m_hits[m_rangeNext[range]]];
+			if (++m_rangeNext[range] < range + m_rangeHitCounts[range])
+			{
+				std::push_heap(m_heads.begin(), m_heads.end(), greater);
+			}
+			else
+			{
+				m_heads.pop_back();
+			}
+
+			int32 indexA = candidate.indexA;
+			int32 indexB = candidate.indexB;
+
+			bool claimedA = indexA != b2_nullNode && m_bodies[indexA].claimRound == round;
+			bool claimedB = indexB != b2_nullNode && m_bodies[indexB].claimRound == round;
+			if (claimedA || claimedB)
+			{
+				continue;
+			}
+
+			// Kinematic bodies follow their prescribed motion; only dynamic
+			// bodies are clamped.
+			if (indexA != b2_nullNode)
+			{
+				m_bodies[indexA].claimRound = round;
+				if (m_bodies[indexA].body->GetType() == b2_dynamicBody)
+				{
+					Clamp(indexA, candidate.t);
+				}
+			}
+			if (indexB != b2_nullNode)
+			{
+				m_bodies[indexB].claimRound = round;
+				if (m_bodies[indexB].body->GetType() == b2_dynamicBody)
+				{
+					Clamp(indexB, candidate.t);
+				}
+			}
+
+			// The pair now ends exactly at its target separation; re-evaluating
+			// it would only rediscover the same impact at t ~ 1.
+			candidate.t = 1.0f;
+			candidate.resolved = true;
+			++m_eventCount;
+		}
+
+		// Re-evaluate everything that touches a body moved this round.
+		for (size_t i = 0; i < m_candidates.size(); ++i)
+		{
+			Candidate& candidate = m_candidates[i];
+			if (candidate.resolved)
+			{
+				continue;
+			}
+			bool movedA = candidate.indexA != b2_nullNode && m_bodies[candidate.indexA].claimRound == round;
+			bool movedB = candidate.indexB != b2_nullNode && m_bodies[candidate.indexB].claimRound == round;
+			if (movedA || movedB)
+			{
+				candidate.dirty = true;
+			}
+		}
+	}
+
+	m_time = timer.GetMilliseconds();
+}
+
+static const char* const k_toiScenes[] = { "Bullet Test", "Continuous Test", "Add Pair Stress Test" };
+static const int32 k_toiSceneCount = 3;
+
+void RunToiReport(const Settings& settings, int32 stepCount)
+{
+	if (stepCount <= 0)
+	{
+		return;
+	}
+
+	HeadlessDrawScope drawScope;
+
+	Settings runSettings = MakeHeadlessSettings(settings);
+	runSettings.enableContinuous = true;
+	runSettings.enableParallelTOI = true;
+
+	std::vector<float32> times(stepCount);
+	printf("approximate parallel TOI pass, %d steps\n", stepCount);
+	printf("scene                    ave ms   p99 ms   max ms  events/step  max rounds\n");
+
+	for (int32 i = 0; i < k_toiSceneCount; ++i)
+	{
+		const TestEntry* entry = FindTestEntry(k_toiScenes[i]);
+		if (entry == NULL)
+		{
+			continue;
+		}
+
+		Test* test = entry->createFcn();
+		const ParallelToi& pass = test->GetParallelToi();
+		float32 total = 0.0f;
+		float32 maxTime = 0.0f;
+		int32 eventCount = 0;
+		int32 maxRounds = 0;
+		for (int32 j = 0; j < stepCount; ++j)
+		{
+			test->Step(&runSettings);
+			float32 time = pass.GetTime();
+			times[j] = time;
+			total += time;
+			maxTime = b2Max(maxTime, time);
+			eventCount += pass.GetEventCount();
+			maxRounds = b2Max(maxRounds, pass.GetRoundCount());
+		}
+		delete test;
+
+		// Same percentile as the profile panel.
+		int32 index = (int32)(0.99f * (stepCount - 1));
+		std::nth_element(times.begin(), times.begin() + index, times.end());
+
+		printf("%-22s %8.3f %8.3f %8.3f %12.2f %11d\n", entry->name, total / stepCount, times[index], maxTime,
+			(float32)eventCount / stepCount, maxRounds);
+		fflush(stdout);
+	}
+}
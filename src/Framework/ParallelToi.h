@@ -0,0 +1,100 @@
+#pragma once
+#include "CollisionCounters.h"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Approximate continuous collision pass that runs after b2World::Step while
+// the world's own TOI solver is switched off. It follows the same candidate rules as
+// b2World::SolveTOI (bullets against everything, dynamic bodies against
+// static and kinematic ones), but evaluates b2TimeOfImpact for all
+// candidates in parallel and resolves events in batches: each round takes
+// the earliest events whose bodies are disjoint, clamps those bodies to
+// their impact poses and re-evaluates only the candidates that touched them.
+// Like b2World::SolveTOI, times are fractions of the whole step: a clamped
+// body's sweep starts at its impact time, and every pair is evaluated over
+// the part of the step that is left for both of its bodies.
+//
+// Unlike b2World::SolveTOI the remaining time after an impact is not
+// sub-stepped, so this is different physics: the body stops at the impact
+// pose for the rest of the step, keeps its velocity, and the next step's
+// contact solver resolves the impact. That stops tunneling but does not
+// match the world's results. The sub-step solve needs b2Island and the
+// private body state, so it cannot be done from outside Box2D. The pass is
+// off by default, labelled approximate in the testbed, and its time is
+// reported on its own rather than as solveTOI.
+class ParallelToi
+{
+public:
+	enum
+	{
+		e_maxRounds = 16,
+		e_minChunkSize = 32
+	};
+
+	ParallelToi();
+
+	// Records the pose of every moving body before the step.
+	void Begin(b2World* world);
+
+	// Finds the TOI events of the step just taken and clamps the bodies.
+	void Solve(b2World* world);
+
+	float32 GetTime() const { return m_time; }
+	int32 GetCandidateCount() const { return (int32)m_candidates.size(); }
+	int32 GetEventCount() const { return m_eventCount; }
+	int32 GetRoundCount() const { return m_roundCount; }
+	const CollisionCounters& GetCounters() const { return m_counters; }
+
+private:
+	struct BodyState
+	{
+		b2Body* body;
+		b2Sweep sweep;
+		int32 claimRound;
+	};
+
+	struct Candidate
+	{
+		b2Contact* contact;
+		int32 indexA;
+		int32 indexB;
+		float32 t;
+		bool dirty;
+		bool resolved;
+	};
+
+	void GetSweep(b2Sweep* sweep, int32 index, const b2Body* body) const;
+	void ComputeToi(int32 begin, int32 end);
+	void CollectHits(int32 begin, int32 end);
+	void Clamp(int32 index, float32 alpha);
+
+	std::vector<BodyState> m_bodies;
+	std::unordered_map<const b2Body*, int32> m_bodyIndices;
+	std::vector<Candidate> m_candidates;
+	std::vector<int32> m_dirty;
+	std::vector<float32> m_times;
+
+	// Hits sorted per job range, then merged. Per-range values are stored
+	// at the index of the range's first candidate.
+	std::vector<int32> m_hits;
+	std::vector<int32> m_rangeEnds;
+	std::vector<int32> m_rangeHitCounts;
+	std::vector<int32> m_rangeNext;
+	std::vector<int32> m_heads;
+
+	CollisionCounters m_counters;
+	std::mutex m_countersMutex;
+
+	float32 m_time;
+	int32 m_eventCount;
+	int32 m_roundCount;
+};
+
+struct Settings;
+
+// Headless: steps the continuous collision scenes with ParallelToi and
+// prints the average, p99 and maximum time of the pass and its events per
+// step to stdout. b2World's solveTOI is not timed next to it, since the two
+// do different work.
+void RunToiReport(const Settings& settings, int32 stepCount);
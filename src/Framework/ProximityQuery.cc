@@ -0,0 +1,90 @@
+#include "ProximityQuery.h"
+
+ProximityQuery::ProximityQuery()
+{
+	m_fixtureA = NULL;
+	m_fixtureB = NULL;
+	m_shapeA = NULL;
+	m_shapeB = NULL;
+	m_childA = 0;
+	m_childB = 0;
+	m_useRadii = true;
+	m_measureSavings = false;
+	m_output.pointA.SetZero();
+	m_output.pointB.SetZero();
+	m_output.distance = 0.0f;
+	m_output.iterations = 0;
+	Reset();
+}
+
+void ProximityQuery::Set(const b2Fixture* fixtureA, int32 childA, const b2Fixture* fixtureB, int32 childB)
+{
+	Set(fixtureA->GetShape(), childA, fixtureB->GetShape(), childB);
+	m_fixtureA = fixtureA;
+	m_fixtureB = fixtureB;
+}
+
+void ProximityQuery::Set(const b2Fixture* fixtureA, int32 childA, const b2Shape* shapeB, int32 childB)
+{
+	Set(fixtureA->GetShape(), childA, shapeB, childB);
+	m_fixtureA = fixtureA;
+}
+
+void ProximityQuery::Set(const b2Shape* shapeA, int32 childA, const b2Shape* shapeB, int32 childB)
+{
+	m_fixtureA = NULL;
+	m_fixtureB = NULL;
+	m_shapeA = shapeA;
+	m_shapeB = shapeB;
+	m_childA = childA;
+	m_childB = childB;
+	Reset();
+}
+
+void ProximityQuery::Reset()
+{
+	m_cache.count = 0;
+	m_updateCount = 0;
+	m_warmIterations = 0;
+	m_coldIterations = 0;
+}
+
+void ProximityQuery::Update()
+{
+	b2Assert(m_fixtureA != NULL && m_fixtureB != NULL);
+	Update(m_fixtureA->GetBody()->GetTransform(), m_fixtureB->GetBody()->GetTransform());
+}
+
+void ProximityQuery::Update(const b2Transform& xfB)
+{
+	b2Assert(m_fixtureA != NULL && m_fixtureB == NULL);
+	Update(m_fixtureA->GetBody()->GetTransform(), xfB);
+}
+
+void ProximityQuery::Update(const b2Transform& xfA, const b2Transform& xfB)
+{
+	// Proxies of chain children point into the proxy itself, so they are
+	// set up here rather than kept in the query, which may be moved.
+	b2DistanceInput input;
+	input.proxyA.Set(m_shapeA, m_childA);
+	input.proxyB.Set(m_shapeB, m_childB);
+	input.transformA = xfA;
+	input.transformB = xfB;
+	input.useRadii = m_useRadii;
+
+	if (m_measureSavings)
+	{
+		b2SimplexCache cache;
+		cache.count = 0;
+		b2DistanceOutput output;
+		b2Distance(&output, &cache, &input);
+		m_coldIterations += output.iterations;
+	}
+
+	// b2Distance rebuilds the cached simplex from the current poses and
+	// falls back to a cold start if it has degenerated.
+	b2Distance(&m_output, &m_cache, &input);
+
+	++m_updateCount;
+	m_warmIterations += m_output.iterations;
+}
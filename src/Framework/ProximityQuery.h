@@ -0,0 +1,69 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+// Distance between two convex shapes tracked across steps. b2Distance is
+// given the simplex of the previous update, so when the shapes have barely
+// moved GJK starts next to the answer and usually finishes in one
+// iteration instead of rebuilding the simplex from the first vertices.
+//
+// Either side can be a fixture, whose pose is read from its body, or a
+// bare shape, whose pose is passed to Update. The fixtures and shapes must
+// outlive the query (or the next Set).
+class ProximityQuery
+{
+public:
+	ProximityQuery();
+
+	void Set(const b2Fixture* fixtureA, int32 childA, const b2Fixture* fixtureB, int32 childB);
+	void Set(const b2Fixture* fixtureA, int32 childA, const b2Shape* shapeB, int32 childB);
+	void Set(const b2Shape* shapeA, int32 childA, const b2Shape* shapeB, int32 childB);
+
+	// Whether the distance is between the shapes including their radii
+	// (the default) or between their core polygons.
+	void SetUseRadii(bool flag) { m_useRadii = flag; }
+
+	// Also runs every update from a cold cache to count the iterations the
+	// warm start saved. This doubles the cost; use it for statistics only.
+	void SetMeasureSavings(bool flag) { m_measureSavings = flag; }
+
+	// Drops the cached simplex, e.g. after a teleport.
+	void Reset();
+
+	// For two fixtures.
+	void Update();
+
+	// For a fixture and a shape at xfB.
+	void Update(const b2Transform& xfB);
+
+	// For two shapes.
+	void Update(const b2Transform& xfA, const b2Transform& xfB);
+
+	const b2DistanceOutput& GetOutput() const { return m_output; }
+	float32 GetDistance() const { return m_output.distance; }
+
+	// GJK iterations of the last update.
+	int32 GetIterations() const { return m_output.iterations; }
+
+	// Totals since the last Set or Reset. Cold iterations are only counted
+	// while SetMeasureSavings is on.
+	int32 GetUpdateCount() const { return m_updateCount; }
+	int32 GetWarmIterations() const { return m_warmIterations; }
+	int32 GetColdIterations() const { return m_coldIterations; }
+	int32 GetSavedIterations() const { return m_coldIterations - m_warmIterations; }
+
+private:
+	const b2Fixture* m_fixtureA;
+	const b2Fixture* m_fixtureB;
+	const b2Shape* m_shapeA;
+	const b2Shape* m_shapeB;
+	int32 m_childA;
+	int32 m_childB;
+	b2SimplexCache m_cache;
+	b2DistanceOutput m_output;
+	bool m_useRadii;
+	bool m_measureSavings;
+
+	int32 m_updateCount;
+	int32 m_warmIterations;
+	int32 m_coldIterations;
+};
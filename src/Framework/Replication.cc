@@ -0,0 +1,732 @@
+#include "Replication.h"
+#include "Test.h"
+#include "WorldChecksum.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#define REPLICATION_HAS_PROCESSES 1
+#else
+#define REPLICATION_HAS_PROCESSES 0
+#endif
+
+// Past the shard messages, so the two can share a link.
+enum ReplicationMessageType
+{
+	e_replicationPacket = 16,
+	e_replicationChecksum,
+	e_replicationQuit
+};
+
+struct ReplicationChecksumReply
+{
+	uint32 checksum;
+	int32 bodyCount;
+	int32 stepIndex;
+};
+
+// Record flags. The asleep bit carries the body's state; the others say
+// which values follow.
+enum ReplicationRecordFlags
+{
+	e_recordSpawn = 0x01,
+	e_recordAsleep = 0x02,
+	e_recordPosition = 0x04,
+	e_recordAngle = 0x08,
+	e_recordVelocity = 0x10,
+	e_recordAngularVelocity = 0x20
+};
+
+// Bodies the decoder accepts; more means a corrupt stream.
+static const int32 k_maxReplicaIds = 1 << 24;
+
+ReplicationConfig::ReplicationConfig()
+{
+	positionQuantum = 1.0f / 256.0f;
+	angleQuantum = 1.0f / 256.0f;
+	velocityQuantum = 1.0f / 64.0f;
+	angularVelocityQuantum = 1.0f / 64.0f;
+	packetBytes = 1200;
+}
+
+ReplicationStats::ReplicationStats()
+{
+	byteCount = 0;
+	spawnCount = 0;
+	removeCount = 0;
+	updateCount = 0;
+	deferredCount = 0;
+	sleepingCount = 0;
+}
+
+uint32 ComputeReplicaChecksum(const std::vector<ReplicaState>& states)
+{
+	uint32 hash = k_checksumBasis;
+	for (size_t i = 0; i < states.size(); ++i)
+	{
+		if (states[i].flags & ReplicaState::e_live)
+		{
+			uint32 id = (uint32)i;
+			hash = ChecksumWords(hash, &id, sizeof(id));
+			hash = ChecksumWords(hash, &states[i], sizeof(ReplicaState));
+		}
+	}
+	return hash;
+}
+
+static int32 QuantizeValue(float32 value, float32 quantum)
+{
+	float32 q = b2Clamp(value / quantum, -1.0e9f, 1.0e9f);
+	return (int32)floorf(q + 0.5f);
+}
+
+static uint32 ZigZag(int32 value)
+{
+	return ((uint32)value << 1) ^ (uint32)(value >> 31);
+}
+
+static int32 UnZigZag(uint32 value)
+{
+	return (int32)(value >> 1) ^ -(int32)(value & 1);
+}
+
+static int32 GetVarintSize(uint32 value)
+{
+	int32 size = 1;
+	while (value >= 0x80)
+	{
+		value >>= 7;
+		++size;
+	}
+	return size;
+}
+
+// The values behind each record flag, as ranges of ReplicaState::values.
+static const uint32 k_recordValueFlags[4] = { e_recordPosition, e_recordAngle, e_recordVelocity, e_recordAngularVelocity };
+static const int32 k_recordValueFirst[4] = { 0, 2, 3, 5 };
+static const int32 k_recordValueCount[4] = { 2, 1, 2, 1 };
+
+// The flags for the values that differ between what the viewers know and
+// the current state; all of them for a spawn.
+static uint32 GetRecordFlags(const ReplicaState& known, const ReplicaState& current)
+{
+	if ((known.flags & ReplicaState::e_live) == 0)
+	{
+		uint32 flags = e_recordSpawn | e_recordPosition | e_recordAngle | e_recordVelocity | e_recordAngularVelocity;
+		return flags | ((current.flags & ReplicaState::e_asleep) ? e_recordAsleep : 0);
+	}
+
+	uint32 flags = 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		for (int32 j = 0; j < k_recordValueCount[i]; ++j)
+		{
+			int32 index = k_recordValueFirst[i] + j;
+			if (known.values[index] != current.values[index])
+			{
+				flags |= k_recordValueFlags[i];
+			}
+		}
+	}
+
+	bool asleepChanged = ((known.flags ^ current.flags) & ReplicaState::e_asleep) != 0;
+	if (flags == 0 && asleepChanged == false)
+	{
+		return 0;
+	}
+	return flags | ((current.flags & ReplicaState::e_asleep) ? e_recordAsleep : 0);
+}
+
+// Flags then the zigzag deltas of the flagged values; deltas from zero for
+// a spawn.
+static void WriteRecord(ShardBuffer* buffer, uint32 flags, const ReplicaState& known, const ReplicaState& current)
+{
+	buffer->Write((uint8)flags);
+	bool spawn = (flags & e_recordSpawn) != 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		if ((flags & k_recordValueFlags[i]) == 0)
+		{
+			continue;
+		}
+		for (int32 j = 0; j < k_recordValueCount[i]; ++j)
+		{
+			int32 index = k_recordValueFirst[i] + j;
+			int32 base = spawn ? 0 : known.values[index];
+			buffer->WriteVarint(ZigZag(current.values[index] - base));
+		}
+	}
+}
+
+static int32 GetRecordSize(uint32 flags, const ReplicaState& known, const ReplicaState& current)
+{
+	int32 size = 1;
+	bool spawn = (flags & e_recordSpawn) != 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		if ((flags & k_recordValueFlags[i]) == 0)
+		{
+			continue;
+		}
+		for (int32 j = 0; j < k_recordValueCount[i]; ++j)
+		{
+			int32 index = k_recordValueFirst[i] + j;
+			int32 base = spawn ? 0 : known.values[index];
+			size += GetVarintSize(ZigZag(current.values[index] - base));
+		}
+	}
+	return size;
+}
+
+ReplicationEncoder::ReplicationEncoder(const ReplicationConfig& config)
+{
+	m_config = config;
+	m_stamp = 0;
+	m_stepIndex = 0;
+}
+
+void ReplicationEncoder::Quantize(const b2Body* body, ReplicaState* state) const
+{
+	b2Vec2 p = body->GetPosition();
+	b2Vec2 v = body->GetLinearVelocity();
+	state->values[0] = QuantizeValue(p.x, m_config.positionQuantum);
+	state->values[1] = QuantizeValue(p.y, m_config.positionQuantum);
+	state->values[2] = QuantizeValue(body->GetAngle(), m_config.angleQuantum);
+	state->values[3] = QuantizeValue(v.x, m_config.velocityQuantum);
+	state->values[4] = QuantizeValue(v.y, m_config.velocityQuantum);
+	state->values[5] = QuantizeValue(body->GetAngularVelocity(), m_config.angularVelocityQuantum);
+	state->flags = ReplicaState::e_live | (body->IsAwake() ? 0 : ReplicaState::e_asleep);
+}
+
+int32 ReplicationEncoder::AddBody(const b2Body* body, uint32 signature)
+{
+	ReplicaState unknown;
+	memset(&unknown, 0, sizeof(unknown));
+
+	int32 id;
+	if (m_freeIds.empty() == false)
+	{
+		id = m_freeIds.back();
+		m_freeIds.pop_back();
+	}
+	else
+	{
+		id = (int32)m_states.size();
+		m_states.push_back(unknown);
+		m_current.push_back(unknown);
+		m_bodies.push_back(NULL);
+		m_signatures.push_back(0);
+		m_extents.push_back(0.0f);
+		m_priorities.push_back(0.0f);
+		m_stamps.push_back(0);
+	}
+
+	// Ids are only reused once the viewers know the old body is gone, so
+	// there are never more than the bodies alive since the last packet.
+	b2Assert(id < k_maxReplicaIds);
+
+	m_ids[body] = id;
+	m_states[id] = unknown;
+	m_current[id] = unknown;
+	m_bodies[id] = body;
+	m_signatures[id] = signature;
+	m_priorities[id] = 0.0f;
+	m_stamps[id] = 0;
+
+	// The distance from the origin to the far side of the fixtures, to weigh
+	// angle errors and importance by size.
+	b2Transform identity;
+	identity.SetIdentity();
+	float32 extent = 0.0f;
+	for (const b2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+	{
+		const b2Shape* shape = f->GetShape();
+		for (int32 i = 0; i < shape->GetChildCount(); ++i)
+		{
+			b2AABB aabb;
+			shape->ComputeAABB(&aabb, identity, i);
+			b2Vec2 corner = b2Max(b2Abs(aabb.lowerBound), b2Abs(aabb.upperBound));
+			extent = b2Max(extent, corner.Length());
+		}
+	}
+	m_extents[id] = extent;
+
+	return id;
+}
+
+void ReplicationEncoder::Encode(b2World* world, float32 hz, ShardBuffer* packet, ReplicationStats* stats)
+{
+	*stats = ReplicationStats();
+	++m_stamp;
+
+	// Find every body's id. A body at the address of a destroyed one is
+	// told apart by its fixtures' signature.
+	for (const b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+	{
+		uint32 signature = ComputeFixtureSignature(body);
+		std::unordered_map<const b2Body*, int32>::iterator it = m_ids.find(body);
+		int32 id;
+		if (it == m_ids.end() || m_signatures[it->second] != signature)
+		{
+			id = AddBody(body, signature);
+		}
+		else
+		{
+			id = it->second;
+		}
+
+		m_stamps[id] = m_stamp;
+		Quantize(body, &m_current[id]);
+	}
+
+	m_sent.resize(0);
+	for (int32 id = 0; id < (int32)m_states.size(); ++id)
+	{
+		if ((m_states[id].flags & ReplicaState::e_live) && m_stamps[id] != m_stamp)
+		{
+			m_sent.push_back(id);
+		}
+	}
+
+	packet->Clear();
+	packet->Write(m_stepIndex);
+	packet->WriteVarint((uint32)m_sent.size());
+	int32 previous = -1;
+	for (size_t i = 0; i < m_sent.size(); ++i)
+	{
+		int32 id = m_sent[i];
+		packet->WriteVarint((uint32)(id - previous - 1));
+		previous = id;
+
+		m_states[id].flags = 0;
+		m_priorities[id] = 0.0f;
+		// Unless a new body took over the address.
+		std::unordered_map<const b2Body*, int32>::iterator it = m_ids.find(m_bodies[id]);
+		if (it != m_ids.end() && it->second == id)
+		{
+			m_ids.erase(it);
+		}
+		m_bodies[id] = NULL;
+		m_freeIds.push_back(id);
+	}
+	stats->removeCount = (int32)m_sent.size();
+
+	float32 inv_hz = hz > 0.0f ? 1.0f / hz : 0.0f;
+	m_candidates.resize(0);
+	for (int32 id = 0; id < (int32)m_states.size(); ++id)
+	{
+		if (m_stamps[id] != m_stamp)
+		{
+			continue;
+		}
+
+		const ReplicaState& known = m_states[id];
+		const ReplicaState& current = m_current[id];
+		uint32 flags = GetRecordFlags(known, current);
+		if (flags == 0)
+		{
+			stats->sleepingCount += (current.flags & ReplicaState::e_asleep) ? 1 : 0;
+			continue;
+		}
+
+		Candidate candidate;
+		candidate.id = id;
+		candidate.size = GetVarintSize((uint32)id) + GetRecordSize(flags, known, current);
+
+		if (flags & e_recordSpawn)
+		{
+			candidate.priority = b2_maxFloat;
+		}
+		else
+		{
+			// How far off the viewers draw the body, and will be a step later.
+			const int32* a = known.values;
+			const int32* b = current.values;
+			float32 extent = m_extents[id];
+			float32 position = m_config.positionQuantum * b2Vec2((float32)(b[0] - a[0]), (float32)(b[1] - a[1])).Length();
+			float32 angle = m_config.angleQuantum * b2Abs((float32)(b[2] - a[2])) * extent;
+			float32 velocity = m_config.velocityQuantum * b2Vec2((float32)(b[3] - a[3]), (float32)(b[4] - a[4])).Length();
+			float32 angularVelocity = m_config.angularVelocityQuantum * b2Abs((float32)(b[5] - a[5])) * extent;
+			float32 error = position + angle + inv_hz * (velocity + angularVelocity);
+
+			// Falling asleep must get through even when the error rounds away.
+			m_priorities[id] += (1.0f + extent) * error + ((flags & ~e_recordAsleep) == 0 ? 1.0f : 0.0f);
+			candidate.priority = m_priorities[id];
+		}
+		m_candidates.push_back(candidate);
+	}
+
+	struct CandidateOrder
+	{
+		bool operator()(const Candidate& a, const Candidate& b) const
+		{
+			return a.priority > b.priority || (a.priority == b.priority && a.id < b.id);
+		}
+	};
+	std::sort(m_candidates.begin(), m_candidates.end(), CandidateOrder());
+
+	// Take the candidates in order of priority while they fit, skipping the
+	// ones that do not so smaller ones can fill the space.
+	int32 budget = m_config.packetBytes > 0 ? m_config.packetBytes : 0x7FFFFFFF;
+	int32 size = packet->GetSize() + GetVarintSize((uint32)m_candidates.size());
+	m_sent.resize(0);
+	for (size_t i = 0; i < m_candidates.size(); ++i)
+	{
+		if (size + m_candidates[i].size <= budget)
+		{
+			size += m_candidates[i].size;
+			m_sent.push_back(m_candidates[i].id);
+		}
+	}
+	std::sort(m_sent.begin(), m_sent.end());
+
+	packet->WriteVarint((uint32)m_sent.size());
+	previous = -1;
+	for (size_t i = 0; i < m_sent.size(); ++i)
+	{
+		int32 id = m_sent[i];
+		uint32 flags = GetRecordFlags(m_states[id], m_current[id]);
+
+		packet->WriteVarint((uint32)(id - previous - 1));
+		WriteRecord(packet, flags, m_states[id], m_current[id]);
+		previous = id;
+
+		stats->spawnCount += (flags & e_recordSpawn) ? 1 : 0;
+		stats->updateCount += (flags & e_recordSpawn) ? 0 : 1;
+
+		m_states[id] = m_current[id];
+		m_priorities[id] = 0.0f;
+	}
+
+	stats->deferredCount = (int32)(m_candidates.size() - m_sent.size());
+	stats->byteCount = packet->GetSize();
+	++m_stepIndex;
+}
+
+ReplicationDecoder::ReplicationDecoder()
+{
+	m_bodyCount = 0;
+	m_stepIndex = -1;
+}
+
+bool ReplicationDecoder::Decode(ShardBuffer* packet)
+{
+	if (packet->Read(&m_stepIndex) == false)
+	{
+		return false;
+	}
+
+	uint32 removeCount;
+	if (packet->ReadVarint(&removeCount) == false)
+	{
+		return false;
+	}
+
+	int32 id = -1;
+	for (uint32 i = 0; i < removeCount; ++i)
+	{
+		uint32 gap;
+		if (packet->ReadVarint(&gap) == false)
+		{
+			return false;
+		}
+		id += (int32)gap + 1;
+		if (id < 0 || id >= (int32)m_states.size() || (m_states[id].flags & ReplicaState::e_live) == 0)
+		{
+			return false;
+		}
+		m_states[id].flags = 0;
+		--m_bodyCount;
+	}
+
+	uint32 recordCount;
+	if (packet->ReadVarint(&recordCount) == false)
+	{
+		return false;
+	}
+
+	id = -1;
+	for (uint32 i = 0; i < recordCount; ++i)
+	{
+		uint32 gap;
+		uint8 flags;
+		if (packet->ReadVarint(&gap) == false || packet->Read(&flags) == false)
+		{
+			return false;
+		}
+
+		id += (int32)gap + 1;
+		if (id < 0 || id >= k_maxReplicaIds)
+		{
+			return false;
+		}
+
+		if (id >= (int32)m_states.size())
+		{
+			ReplicaState unknown;
+			memset(&unknown, 0, sizeof(unknown));
+			m_states.resize(id + 1, unknown);
+		}
+
+		ReplicaState* state = &m_states[id];
+		bool spawn = (flags & e_recordSpawn) != 0;
+		if (spawn == ((state->flags & ReplicaState::e_live) != 0))
+		{
+			// A spawn of a known body or an update of an unknown one.
+			return false;
+		}
+
+		for (int32 j = 0; j < 4; ++j)
+		{
+			if ((flags & k_recordValueFlags[j]) == 0)
+			{
+				continue;
+			}
+			for (int32 k = 0; k < k_recordValueCount[j]; ++k)
+			{
+				uint32 delta;
+				if (packet->ReadVarint(&delta) == false)
+				{
+					return false;
+				}
+				int32 index = k_recordValueFirst[j] + k;
+				state->values[index] = (spawn ? 0 : state->values[index]) + UnZigZag(delta);
+			}
+		}
+
+		state->flags = ReplicaState::e_live | ((flags & e_recordAsleep) ? ReplicaState::e_asleep : 0);
+		m_bodyCount += spawn ? 1 : 0;
+	}
+
+	return packet->IsAtEnd();
+}
+
+ReplicationViewer::ReplicationViewer()
+{
+	m_pid = -1;
+}
+
+ReplicationViewer::~ReplicationViewer()
+{
+	Stop();
+}
+
+void RunReplicationViewer(int fd)
+{
+	ShardLink link(fd);
+	ShardBuffer payload;
+	ReplicationDecoder decoder;
+	uint32 type;
+	while (link.Receive(&type, &payload))
+	{
+		if (type == e_replicationPacket)
+		{
+			if (decoder.Decode(&payload) == false)
+			{
+				break;
+			}
+		}
+		else if (type == e_replicationChecksum)
+		{
+			ReplicationChecksumReply reply;
+			reply.checksum = decoder.GetChecksum();
+			reply.bodyCount = decoder.GetBodyCount();
+			reply.stepIndex = decoder.GetStepIndex();
+			payload.Clear();
+			payload.Write(reply);
+			link.Send(e_replicationChecksum, payload);
+		}
+		else
+		{
+			break;
+		}
+	}
+	link.Close();
+}
+
+bool ReplicationViewer::Start()
+{
+	Stop();
+
+	// The testbed runs the viewer when started with -replicationviewer.
+	int fd;
+	int pid = ShardSpawnProcess(k_replicationViewerOption, &fd);
+	if (pid < 0)
+	{
+		return false;
+	}
+
+	m_link = ShardLink(fd);
+	m_pid = pid;
+	return true;
+}
+
+void ReplicationViewer::Stop()
+{
+#if REPLICATION_HAS_PROCESSES
+	if (m_link.IsOpen())
+	{
+		m_buffer.Clear();
+		m_link.Send(e_replicationQuit, m_buffer);
+		m_link.Close();
+	}
+	if (m_pid > 0)
+	{
+		waitpid(m_pid, NULL, 0);
+		m_pid = -1;
+	}
+#endif
+}
+
+bool ReplicationViewer::Send(const ShardBuffer& packet)
+{
+	return m_link.Send(e_replicationPacket, packet);
+}
+
+bool ReplicationViewer::GetChecksum(uint32* checksum, int32* bodyCount)
+{
+	m_buffer.Clear();
+	uint32 type;
+	if (m_link.Send(e_replicationChecksum, m_buffer) == false || m_link.Receive(&type, &m_buffer) == false
+		|| type != e_replicationChecksum)
+	{
+		return false;
+	}
+
+	ReplicationChecksumReply reply;
+	if (m_buffer.Read(&reply) == false)
+	{
+		return false;
+	}
+	*checksum = reply.checksum;
+	*bodyCount = reply.bodyCount;
+	return true;
+}
+
+static const char* const k_replicationScenes[] = { "Pyramid", "Add Pair Stress Test", "Tumbler" };
+static const int32 k_replicationSceneCount = 3;
+
+// Position quanta; the others follow from them.
+static const int32 k_replicationLevels[] = { 16, 64, 256, 1024 };
+static const int32 k_replicationLevelCount = 4;
+
+static const int32 k_replicationBudgets[] = { 0, 1200 };
+static const int32 k_replicationBudgetCount = 2;
+
+// Steps one scene with one configuration and checks the viewer against the
+// encoder every second and at the end.
+static bool RunReplication(const TestEntry* entry, const Settings& settings, const ReplicationConfig& config, int32 stepCount, int32 level)
+{
+	ReplicationViewer viewer;
+	if (viewer.Start() == false)
+	{
+		printf("%-22s needs local sockets and processes (Linux/macOS)\n", entry->name);
+		return false;
+	}
+
+	Test* test = entry->createFcn();
+	ReplicationEncoder encoder(config);
+	ShardBuffer packet;
+	ReplicationStats stats;
+
+	float32 totalBytes = 0.0f;
+	int32 maxBytes = 0;
+	float32 updates = 0.0f;
+	float32 deferred = 0.0f;
+	float32 sleeping = 0.0f;
+	float32 encodeTime = 0.0f;
+	bool matches = true;
+	int32 bodyCount = 0;
+
+	Settings runSettings = settings;
+	for (int32 i = 0; i < stepCount && matches; ++i)
+	{
+		test->Step(&runSettings);
+
+		b2Timer timer;
+		encoder.Encode(test->GetWorld(), runSettings.hz, &packet, &stats);
+		encodeTime += timer.GetMilliseconds();
+
+		if (viewer.Send(packet) == false)
+		{
+			matches = false;
+			break;
+		}
+
+		totalBytes += stats.byteCount;
+		maxBytes = b2Max(maxBytes, stats.byteCount);
+		updates += stats.updateCount + stats.spawnCount;
+		deferred += stats.deferredCount;
+		sleeping += stats.sleepingCount;
+
+		if ((i + 1) % 60 == 0 || i == stepCount - 1)
+		{
+			uint32 checksum;
+			matches = viewer.GetChecksum(&checksum, &bodyCount) && checksum == encoder.GetChecksum();
+		}
+	}
+
+	delete test;
+	viewer.Stop();
+
+	float32 scale = stepCount > 0 ? 1.0f / stepCount : 0.0f;
+	char budget[16];
+	if (config.packetBytes > 0)
+	{
+		sprintf(budget, "%d B", config.packetBytes);
+	}
+	else
+	{
+		sprintf(budget, "none");
+	}
+	printf("%-22s 1/%-4d %-7s %7.1f B/step (max %5d), %6.1f sent, %6.1f deferred, %6.1f asleep, %d bodies, %.3f ms/step, viewer %s\n",
+		entry->name, level, budget, scale * totalBytes, maxBytes, scale * updates, scale * deferred, scale * sleeping,
+		bodyCount, scale * encodeTime, matches ? "matches" : "DIFFERS");
+	fflush(stdout);
+
+	return matches;
+}
+
+int32 RunReplicationReport(const Settings& settings, int32 stepCount)
+{
+	HeadlessDrawScope drawScope;
+
+	Settings runSettings = MakeHeadlessSettings(settings);
+
+	printf("scene                  quantum budget  bytes per step, bodies sent, deferred and asleep per step\n");
+
+	int32 failureCount = 0;
+	for (int32 i = 0; i < k_replicationSceneCount; ++i)
+	{
+		const TestEntry* entry = FindTestEntry(k_replicationScenes[i]);
+		if (entry == NULL)
+		{
+			continue;
+		}
+
+		for (int32 j = 0; j < k_replicationLevelCount; ++j)
+		{
+			for (int32 k = 0; k < k_replicationBudgetCount; ++k)
+			{
+				// Velocities are sent four times coarser than positions.
+				float32 quantum = 1.0f / k_replicationLevels[j];
+				ReplicationConfig config;
+				config.positionQuantum = quantum;
+				config.angleQuantum = quantum;
+				config.velocityQuantum = 4.0f * quantum;
+				config.angularVelocityQuantum = 4.0f * quantum;
+				config.packetBytes = k_replicationBudgets[k];
+
+				if (RunReplication(entry, runSettings, config, stepCount, k_replicationLevels[j]) == false)
+				{
+					++failureCount;
+				}
+			}
+		}
+	}
+
+	return failureCount;
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include "ShardProtocol.h"
+#include <unordered_map>
+
+struct Settings;
+
+// Mirrors a world's bodies to remote viewers, one packet per step. The
+// encoder keeps a copy of what the viewers know: every body's position,
+// angle and velocities as integers in units of the quantization steps. A
+// body goes into a packet only when one of those integers has changed, and
+// then only the changed ones go, as varint deltas from the known values.
+// Sleeping bodies cost nothing once the viewers know they sleep.
+//
+// Packets are bounded in size. Changed bodies that miss a packet keep
+// their place: each step adds the body's visible error, scaled by its
+// size, to its priority, and the highest priorities are sent first, so
+// nothing starves. New and removed bodies always go first.
+//
+// Deltas need every packet delivered in order, as over a stream socket.
+// Shapes are not replicated; viewers get them some other way, such as a
+// world file.
+//
+// Bodies are known by their address and a signature of their fixtures'
+// addresses and shapes. A body destroyed and another created at the same
+// address with different shapes is removed and spawned; one made again
+// with the same shapes, like a relaunched bomb, is taken for the same body
+// moved. The ids of removed bodies are reused once the removal is sent.
+struct ReplicationConfig
+{
+	ReplicationConfig();
+
+	float32 positionQuantum;
+	float32 angleQuantum;
+	float32 velocityQuantum;
+	float32 angularVelocityQuantum;
+
+	// 0 for no bound.
+	int32 packetBytes;
+};
+
+struct ReplicationStats
+{
+	ReplicationStats();
+
+	int32 byteCount;
+	int32 spawnCount;
+	int32 removeCount;
+	int32 updateCount;
+	int32 deferredCount;
+	int32 sleepingCount;
+};
+
+// A body as the viewers know it.
+struct ReplicaState
+{
+	enum
+	{
+		e_live = 0x01,
+		e_asleep = 0x02
+	};
+
+	// x, y, angle, vx, vy, angular velocity
+	int32 values[6];
+	uint32 flags;
+};
+
+// Same on both ends when they agree.
+uint32 ComputeReplicaChecksum(const std::vector<ReplicaState>& states);
+
+class ReplicationEncoder
+{
+public:
+	explicit ReplicationEncoder(const ReplicationConfig& config);
+
+	// Writes the packet for the world's current state.
+	void Encode(b2World* world, float32 hz, ShardBuffer* packet, ReplicationStats* stats);
+
+	// Checksum of what the viewers should know after the last packet.
+	uint32 GetChecksum() const { return ComputeReplicaChecksum(m_states); }
+
+private:
+	struct Candidate
+	{
+		int32 id;
+		float32 priority;
+		int32 size;
+	};
+
+	void Quantize(const b2Body* body, ReplicaState* state) const;
+	int32 AddBody(const b2Body* body, uint32 signature);
+
+	ReplicationConfig m_config;
+	std::unordered_map<const b2Body*, int32> m_ids;
+	std::vector<ReplicaState> m_states;
+	std::vector<ReplicaState> m_current;
+	std::vector<const b2Body*> m_bodies;
+	std::vector<uint32> m_signatures;
+	std::vector<float32> m_extents;
+	std::vector<float32> m_priorities;
+	std::vector<int32> m_stamps;
+	std::vector<Candidate> m_candidates;
+	std::vector<int32> m_sent;
+	std::vector<uint8> m_scratch;
+
+	// Ids whose removal has been sent, for new bodies to reuse.
+	std::vector<int32> m_freeIds;
+	int32 m_stamp;
+	int32 m_stepIndex;
+};
+
+class ReplicationDecoder
+{
+public:
+	ReplicationDecoder();
+
+	// False, leaving the state undefined, for a malformed packet.
+	bool Decode(ShardBuffer* packet);
+
+	uint32 GetChecksum() const { return ComputeReplicaChecksum(m_states); }
+	int32 GetBodyCount() const { return m_bodyCount; }
+	int32 GetStepIndex() const { return m_stepIndex; }
+
+private:
+	std::vector<ReplicaState> m_states;
+	int32 m_bodyCount;
+	int32 m_stepIndex;
+};
+
+// The testbed runs RunReplicationViewer on the given socket when started
+// with this option.
+const char* const k_replicationViewerOption = "-replicationviewer";
+
+// A decoder in a child process at the end of a Unix socket, standing in
+// for a remote viewer. Uses the shard links' framing. The child is started
+// through ShardSpawnProcess.
+class ReplicationViewer
+{
+public:
+	ReplicationViewer();
+	~ReplicationViewer();
+
+	bool Start();
+	void Stop();
+
+	bool Send(const ShardBuffer& packet);
+
+	// Asks the viewer for the checksum of what it has decoded so far.
+	bool GetChecksum(uint32* checksum, int32* bodyCount);
+
+	bool IsRunning() const { return m_link.IsOpen(); }
+	uint64_t GetBytesSent() const { return m_link.GetBytesSent(); }
+
+private:
+	ShardLink m_link;
+	ShardBuffer m_buffer;
+	int m_pid;
+};
+
+// The viewer's side: decodes packets from the socket and answers checksum
+// requests until the link closes or a quit arrives.
+void RunReplicationViewer(int fd);
+
+// Steps Pyramid, Add Pair Stress Test and Tumbler without a window for
+// stepCount steps at several quantization levels, with and without a packet
+// bound, streams each run to a viewer process and prints the bytes per step
+// on stdout. Returns the number of runs where the viewer's checksum did
+// not match the encoder's.
+int32 RunReplicationReport(const Settings& settings, int32 stepCount);
@@ -0,0 +1,19 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+struct Settings;
+
+// Headless reports that run one scene and read its results. They are
+// defined in Tests/SceneReports.cc, next to the scenes, the same way
+// g_testEntries is, so the framework never includes a scene.
+
+// Headless: runs the "Nearest Queries" scene and prints, per query, the
+// average time of the snapshot's QueryNearest and QueryShape against
+// b2World::QueryAABB with b2Distance or b2TestOverlap, and how many
+// answers differed.
+void RunNearestQueryReport(const Settings& settings, int32 stepCount);
+
+// Headless: builds the "World File Loading" level runCount times the way
+// b2World::Dump output does and loads it from memory and from a file, and
+// prints the times of each and whether the loaded world matched.
+void RunWorldFileReport(const Settings& settings, int32 runCount);
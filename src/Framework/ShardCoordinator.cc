@@ -0,0 +1,445 @@
+#include "ShardCoordinator.h"
+#include "DebugDraw.h"
+#include "Test.h"
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#define SHARD_HAS_PROCESSES 1
+#else
+#define SHARD_HAS_PROCESSES 0
+#endif
+
+ShardCoordinator::ShardCoordinator()
+{
+	m_shardCount = 0;
+	m_scene = e_shardTiles;
+	m_ghostMargin = 2.0f;
+	m_running = false;
+	m_displayBody = NULL;
+	m_minX = 0.0f;
+	m_shardWidth = 1.0f;
+	m_stepIndex = 0;
+	m_bytesLastStep = 0;
+	m_totalBytes = 0.0;
+	m_latencyLastStep = 0.0f;
+	m_totalLatency = 0.0f;
+	m_maxLatency = 0.0f;
+	m_workerTimeLastStep = 0.0f;
+	m_ghostCountLastStep = 0;
+	m_migrationCountLastStep = 0;
+	for (int32 i = 0; i < e_maxShards; ++i)
+	{
+		m_workers[i].pid = -1;
+	}
+}
+
+ShardCoordinator::~ShardCoordinator()
+{
+	Stop();
+}
+
+int32 ShardCoordinator::FindShard(float32 x) const
+{
+	int32 index = (int32)floorf((x - m_minX) / m_shardWidth);
+	return b2Clamp(index, 0, m_shardCount - 1);
+}
+
+void ShardCoordinator::AddStatic(const b2Shape* shape)
+{
+	if (m_displayBody)
+	{
+		m_displayBody->CreateFixture(shape, 0.0f);
+	}
+}
+
+void ShardCoordinator::AddBody(uint32 id, const b2BodyDef& def, const ShardShape& shape)
+{
+	if (id >= m_bodies.size())
+	{
+		m_bodies.resize(id + 1);
+	}
+
+	BodyView& view = m_bodies[id];
+	view.shape = shape;
+	view.xf.Set(def.position, def.angle);
+	view.owner = FindShard(def.position.x);
+}
+
+bool ShardCoordinator::Start(int32 scene, int32 scale, int32 shardCount, b2Body* displayBody)
+{
+	Stop();
+
+#if SHARD_HAS_PROCESSES
+	m_scene = scene;
+	m_shardCount = b2Clamp(shardCount, 1, (int32)e_maxShards);
+	m_displayBody = displayBody;
+
+	float32 minX, maxX;
+	ShardSceneExtent(scene, scale, &minX, &maxX);
+	m_minX = minX;
+	m_shardWidth = (maxX - minX) / m_shardCount;
+
+	// The coordinator runs the scene builder too, but only to catalog the
+	// shapes and initial poses it needs for drawing.
+	m_bodies.clear();
+	BuildShardScene(scene, scale, this);
+
+	for (int32 i = 0; i < m_shardCount; ++i)
+	{
+		// The testbed runs the worker when started with -shardworker.
+		int fd;
+		int pid = ShardSpawnProcess(k_shardWorkerOption, &fd);
+		if (pid < 0)
+		{
+			Stop();
+			return false;
+		}
+
+		Worker& worker = m_workers[i];
+		worker.link = ShardLink(fd);
+		worker.pid = pid;
+		worker.minX = i == 0 ? -b2_maxFloat : m_minX + i * m_shardWidth;
+		worker.maxX = i == m_shardCount - 1 ? b2_maxFloat : m_minX + (i + 1) * m_shardWidth;
+		worker.ghostIds.clear();
+		worker.ghostsOut.clear();
+		worker.migrationsOut.clear();
+		worker.boundaryIn.clear();
+	}
+
+	for (int32 i = 0; i < m_shardCount; ++i)
+	{
+		ShardSetup setup;
+		setup.shardIndex = i;
+		setup.shardCount = m_shardCount;
+		setup.scene = scene;
+		setup.scale = scale;
+		setup.minX = m_workers[i].minX;
+		setup.maxX = m_workers[i].maxX;
+		setup.ghostMargin = m_ghostMargin;
+
+		m_buffer.Clear();
+		m_buffer.Write(setup);
+		if (m_workers[i].link.Send(e_shardSetup, m_buffer) == false)
+		{
+			Stop();
+			return false;
+		}
+	}
+
+	// Workers build their part of the scene in parallel; wait for all acks.
+	for (int32 i = 0; i < m_shardCount; ++i)
+	{
+		uint32 type;
+		if (m_workers[i].link.Receive(&type, &m_buffer) == false || type != e_shardReport)
+		{
+			Stop();
+			return false;
+		}
+	}
+
+	m_stepIndex = 0;
+	m_bytesLastStep = 0;
+	m_totalBytes = 0.0;
+	m_latencyLastStep = 0.0f;
+	m_totalLatency = 0.0f;
+	m_maxLatency = 0.0f;
+	m_running = true;
+	return true;
+#else
+	B2_NOT_USED(scene);
+	B2_NOT_USED(scale);
+	B2_NOT_USED(shardCount);
+	B2_NOT_USED(displayBody);
+	return false;
+#endif
+}
+
+void ShardCoordinator::Stop()
+{
+#if SHARD_HAS_PROCESSES
+	for (int32 i = 0; i < e_maxShards; ++i)
+	{
+		Worker& worker = m_workers[i];
+		if (worker.link.IsOpen())
+		{
+			m_buffer.Clear();
+			worker.link.Send(e_shardQuit, m_buffer);
+			worker.link.Close();
+		}
+		if (worker.pid > 0)
+		{
+			waitpid(worker.pid, NULL, 0);
+			worker.pid = -1;
+		}
+	}
+#endif
+	m_running = false;
+	m_shardCount = 0;
+}
+
+bool ShardCoordinator::ReadReport(int32 index)
+{
+	Worker& worker = m_workers[index];
+	uint32 type;
+	if (worker.link.Receive(&type, &m_buffer) == false || type != e_shardReport)
+	{
+		return false;
+	}
+
+	ShardReportHeader header;
+	if (m_buffer.Read(&header) == false)
+	{
+		return false;
+	}
+	m_workerTimeLastStep = b2Max(m_workerTimeLastStep, header.stepTime);
+
+	for (int32 i = 0; i < header.transformCount; ++i)
+	{
+		ShardTransform xf;
+		if (m_buffer.Read(&xf) == false || xf.id >= m_bodies.size())
+		{
+			return false;
+		}
+		BodyView& view = m_bodies[xf.id];
+		view.xf.Set(b2Vec2(xf.x, xf.y), xf.angle);
+		view.owner = index;
+	}
+
+	worker.boundaryIn.resize(header.boundaryCount);
+	if (header.boundaryCount > 0 &&
+		m_buffer.ReadBytes(worker.boundaryIn.data(), header.boundaryCount * sizeof(ShardBodyState)) == false)
+	{
+		return false;
+	}
+
+	for (int32 i = 0; i < header.migrationCount; ++i)
+	{
+		ShardMigration migration;
+		if (m_buffer.Read(&migration) == false || migration.state.id >= m_bodies.size())
+		{
+			return false;
+		}
+
+		// Fast bodies can skip a shard entirely, so route by position rather
+		// than to the immediate neighbour.
+		int32 destination = FindShard(migration.state.position.x);
+		m_workers[destination].migrationsOut.push_back(migration);
+
+		BodyView& view = m_bodies[migration.state.id];
+		view.xf.Set(migration.state.position, migration.state.angle);
+		view.owner = destination;
+		++m_migrationCountLastStep;
+	}
+
+	return true;
+}
+
+bool ShardCoordinator::Step(float32 timeStep, int32 velocityIterations, int32 positionIterations)
+{
+	if (m_running == false)
+	{
+		return false;
+	}
+
+	b2Timer timer;
+	uint64_t bytesBefore = 0;
+	for (int32 i = 0; i < m_shardCount; ++i)
+	{
+		bytesBefore += m_workers[i].link.GetBytesSent() + m_workers[i].link.GetBytesReceived();
+	}
+
+	++m_stepIndex;
+	m_ghostCountLastStep = 0;
+	m_migrationCountLastStep = 0;
+	m_workerTimeLastStep = 0.0f;
+
+	for (int32 i = 0; i < m_shardCount; ++i)
+	{
+		Worker& worker = m_workers[i];
+
+		ShardStepHeader header;
+		header.stepIndex = m_stepIndex;
+		header.timeStep = timeStep;
+		header.velocityIterations = velocityIterations;
+		header.positionIterations = positionIterations;
+		header.ghostCount = (int32)worker.ghostsOut.size();
+		header.migrationCount = (int32)worker.migrationsOut.size();
+
+		m_buffer.Clear();
+		m_buffer.Write(header);
+
+		// Shapes only travel with ghosts the worker did not have last step.
+		std::vector<uint32> ghostIds;
+		ghostIds.reserve(worker.ghostsOut.size());
+		for (size_t j = 0; j < worker.ghostsOut.size(); ++j)
+		{
+			ShardBodyState state = worker.ghostsOut[j];
+			bool known = std::binary_search(worker.ghostIds.begin(), worker.ghostIds.end(), state.id);
+			if (known == false)
+			{
+				state.flags |= e_shardHasShape;
+			}
+			m_buffer.Write(state);
+			if (known == false)
+			{
+				m_buffer.Write(m_bodies[state.id].shape);
+			}
+			ghostIds.push_back(state.id);
+		}
+		std::sort(ghostIds.begin(), ghostIds.end());
+		worker.ghostIds.swap(ghostIds);
+		m_ghostCountLastStep += (int32)worker.ghostsOut.size();
+
+		if (worker.migrationsOut.empty() == false)
+		{
+			m_buffer.WriteBytes(worker.migrationsOut.data(), (int32)(worker.migrationsOut.size() * sizeof(ShardMigration)));
+		}
+
+		worker.ghostsOut.clear();
+		worker.migrationsOut.clear();
+
+		if (worker.link.Send(e_shardStep, m_buffer) == false)
+		{
+			Stop();
+			return false;
+		}
+	}
+
+	// The workers step concurrently; collect their reports in order.
+	for (int32 i = 0; i < m_shardCount; ++i)
+	{
+		if (ReadReport(i) == false)
+		{
+			Stop();
+			return false;
+		}
+	}
+
+	// Route boundary states to the neighbours for the next step.
+	for (int32 i = 0; i < m_shardCount; ++i)
+	{
+		const std::vector<ShardBodyState>& boundary = m_workers[i].boundaryIn;
+		for (size_t j = 0; j < boundary.size(); ++j)
+		{
+			ShardBodyState state = boundary[j];
+			uint32 side = state.flags;
+			state.flags = 0;
+			if ((side & e_shardLeft) && i > 0)
+			{
+				m_workers[i - 1].ghostsOut.push_back(state);
+			}
+			if ((side & e_shardRight) && i < m_shardCount - 1)
+			{
+				m_workers[i + 1].ghostsOut.push_back(state);
+			}
+		}
+	}
+
+	uint64_t bytesAfter = 0;
+	for (int32 i = 0; i < m_shardCount; ++i)
+	{
+		bytesAfter += m_workers[i].link.GetBytesSent() + m_workers[i].link.GetBytesReceived();
+	}
+
+	m_bytesLastStep = (int32)(bytesAfter - bytesBefore);
+	m_totalBytes += m_bytesLastStep;
+	m_latencyLastStep = timer.GetMilliseconds();
+	m_totalLatency += m_latencyLastStep;
+	m_maxLatency = b2Max(m_maxLatency, m_latencyLastStep);
+	return true;
+}
+
+void ShardCoordinator::Draw()
+{
+	static const b2Color colors[e_maxShards] =
+	{
+		b2Color(0.9f, 0.7f, 0.7f),
+		b2Color(0.7f, 0.9f, 0.7f),
+		b2Color(0.7f, 0.7f, 0.9f),
+		b2Color(0.9f, 0.9f, 0.6f),
+		b2Color(0.6f, 0.9f, 0.9f),
+		b2Color(0.9f, 0.6f, 0.9f),
+		b2Color(0.9f, 0.8f, 0.5f),
+		b2Color(0.8f, 0.8f, 0.8f)
+	};
+
+	for (size_t i = 0; i < m_bodies.size(); ++i)
+	{
+		const BodyView& view = m_bodies[i];
+		ShardDrawShape(view.shape, view.xf, colors[view.owner]);
+	}
+
+	b2Color boundaryColor(0.4f, 0.4f, 0.4f);
+	for (int32 i = 1; i < m_shardCount; ++i)
+	{
+		float32 x = m_minX + i * m_shardWidth;
+		g_debugDraw.DrawSegment(b2Vec2(x, -10.0f), b2Vec2(x, 40.0f), boundaryColor);
+	}
+}
+
+static const int32 k_shardReportScales[] = { 2, 4, 8 };
+static const int32 k_shardReportScaleCount = 3;
+static const int32 k_shardReportCounts[] = { 1, 2, 4, 8 };
+static const int32 k_shardReportCountCount = 4;
+
+void RunShardReport(const Settings& settings, int32 stepCount)
+{
+	static const char* const sceneNames[e_shardSceneCount] = { "Tiles", "Add Pair" };
+	float32 timeStep = settings.hz > 0.0f ? 1.0f / settings.hz : 1.0f / 60.0f;
+
+	printf("scene     scale shards bodies  bytes/step (max)    latency ms ave / p99 / max   slowest worker ms\n");
+
+	std::vector<float32> latencies;
+	for (int32 scene = 0; scene < e_shardSceneCount; ++scene)
+	{
+		for (int32 i = 0; i < k_shardReportScaleCount; ++i)
+		{
+			for (int32 j = 0; j < k_shardReportCountCount; ++j)
+			{
+				int32 scale = k_shardReportScales[i];
+				int32 shardCount = k_shardReportCounts[j];
+
+				ShardCoordinator coordinator;
+				if (coordinator.Start(scene, scale, shardCount, NULL) == false)
+				{
+					printf("%-9s %5d %6d needs local sockets and processes (Linux/macOS)\n", sceneNames[scene], scale, shardCount);
+					continue;
+				}
+
+				latencies.resize(0);
+				int32 maxBytes = 0;
+				float32 workerTime = 0.0f;
+				for (int32 k = 0; k < stepCount; ++k)
+				{
+					if (coordinator.Step(timeStep, settings.velocityIterations, settings.positionIterations) == false)
+					{
+						break;
+					}
+					latencies.push_back(coordinator.GetLatencyLastStep());
+					maxBytes = b2Max(maxBytes, coordinator.GetBytesLastStep());
+					workerTime += coordinator.GetWorkerTimeLastStep();
+				}
+
+				float32 p99 = 0.0f;
+				if (latencies.empty() == false)
+				{
+					size_t index = (latencies.size() * 99) / 100;
+					index = b2Min(index, latencies.size() - 1);
+					std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+					p99 = latencies[index];
+				}
+
+				int32 steps = b2Max(coordinator.GetStepCount(), 1);
+				printf("%-9s %5d %6d %6d %10.0f (%7d) %10.3f / %6.3f / %6.3f %12.3f\n",
+					sceneNames[scene], scale, shardCount, coordinator.GetBodyCount(),
+					coordinator.GetAverageBytes(), maxBytes, coordinator.GetAverageLatency(), p99,
+					coordinator.GetMaxLatency(), workerTime / steps);
+				fflush(stdout);
+
+				coordinator.Stop();
+			}
+		}
+	}
+}
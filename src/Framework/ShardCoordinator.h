@@ -0,0 +1,105 @@
+#pragma once
+#include "ShardProtocol.h"
+
+struct Settings;
+
+// The testbed runs a ShardWorker on the descriptor after this option.
+const char* const k_shardWorkerOption = "-shardworker";
+
+// Splits a world into vertical strips, runs each strip in a worker process
+// and merges the workers' transforms for display. Every step the coordinator
+// routes boundary-body states to the neighbouring shard (where they become
+// kinematic ghosts) and forwards bodies that crossed a boundary to their new
+// owner. All traffic is star shaped through the coordinator, which keeps the
+// workers unaware of each other's addresses.
+class ShardCoordinator : public ShardSceneSink
+{
+public:
+	enum
+	{
+		e_maxShards = 8
+	};
+
+	ShardCoordinator();
+	~ShardCoordinator();
+
+	// Starts shardCount worker processes connected through Unix domain
+	// sockets; see ShardSpawnProcess. Static geometry is added to
+	// displayBody, if there is one, so the caller can draw it. Returns false
+	// if the platform has no local sockets or a worker failed to start.
+	bool Start(int32 scene, int32 scale, int32 shardCount, b2Body* displayBody);
+	void Stop();
+
+	// Steps every shard once and merges the results.
+	bool Step(float32 timeStep, int32 velocityIterations, int32 positionIterations);
+
+	// Draws all bodies, colored by owning shard, and the shard boundaries.
+	void Draw();
+
+	bool IsRunning() const { return m_running; }
+	int32 GetShardCount() const { return m_shardCount; }
+	int32 GetBodyCount() const { return (int32)m_bodies.size(); }
+	int32 GetStepCount() const { return m_stepIndex; }
+
+	// Per-step traffic and timing, both directions, all workers.
+	int32 GetBytesLastStep() const { return m_bytesLastStep; }
+	float32 GetAverageBytes() const { return m_stepIndex > 0 ? float32(m_totalBytes / m_stepIndex) : 0.0f; }
+	float32 GetLatencyLastStep() const { return m_latencyLastStep; }
+	float32 GetAverageLatency() const { return m_stepIndex > 0 ? m_totalLatency / m_stepIndex : 0.0f; }
+	float32 GetMaxLatency() const { return m_maxLatency; }
+	float32 GetWorkerTimeLastStep() const { return m_workerTimeLastStep; }
+	int32 GetGhostCountLastStep() const { return m_ghostCountLastStep; }
+	int32 GetMigrationCountLastStep() const { return m_migrationCountLastStep; }
+
+	void AddStatic(const b2Shape* shape) override;
+	void AddBody(uint32 id, const b2BodyDef& def, const ShardShape& shape) override;
+
+private:
+	struct Worker
+	{
+		ShardLink link;
+		int pid;
+		float32 minX;
+		float32 maxX;
+		std::vector<uint32> ghostIds;
+		std::vector<ShardBodyState> ghostsOut;
+		std::vector<ShardMigration> migrationsOut;
+		std::vector<ShardBodyState> boundaryIn;
+	};
+
+	struct BodyView
+	{
+		ShardShape shape;
+		b2Transform xf;
+		int32 owner;
+	};
+
+	int32 FindShard(float32 x) const;
+	bool ReadReport(int32 index);
+
+	Worker m_workers[e_maxShards];
+	int32 m_shardCount;
+	int32 m_scene;
+	float32 m_ghostMargin;
+	float32 m_minX;
+	float32 m_shardWidth;
+	bool m_running;
+	b2Body* m_displayBody;
+	std::vector<BodyView> m_bodies;
+	ShardBuffer m_buffer;
+
+	int32 m_stepIndex;
+	int32 m_bytesLastStep;
+	double m_totalBytes;
+	float32 m_latencyLastStep;
+	float32 m_totalLatency;
+	float32 m_maxLatency;
+	float32 m_workerTimeLastStep;
+	int32 m_ghostCountLastStep;
+	int32 m_migrationCountLastStep;
+};
+
+// Steps the Tiles and AddPair shard scenes at several scales and shard
+// counts without a window and prints the traffic and latency per step on
+// stdout.
+void RunShardReport(const Settings& settings, int32 stepCount);
@@ -0,0 +1,433 @@
+#include "ShardProtocol.h"
+#include "DebugDraw.h"
+
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
+#define SHARD_HAS_SOCKETS 1
+#else
+#define SHARD_HAS_SOCKETS 0
+#endif
+
+// Payloads larger than this are treated as a corrupt stream.
+static const uint32 k_maxShardPayload = 64 * 1024 * 1024;
+
+bool ShardLink::WriteAll(const void* data, size_t size)
+{
+#if SHARD_HAS_SOCKETS
+	const uint8* bytes = (const uint8*)data;
+	while (size > 0)
+	{
+#ifdef MSG_NOSIGNAL
+		ssize_t n = send(m_fd, bytes, size, MSG_NOSIGNAL);
+#else
+		ssize_t n = send(m_fd, bytes, size, 0);
+#endif
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		bytes += n;
+		size -= n;
+	}
+	return true;
+#else
+	B2_NOT_USED(data);
+	B2_NOT_USED(size);
+	return false;
+#endif
+}
+
+bool ShardLink::ReadAll(void* data, size_t size)
+{
+#if SHARD_HAS_SOCKETS
+	uint8* bytes = (uint8*)data;
+	while (size > 0)
+	{
+		ssize_t n = recv(m_fd, bytes, size, 0);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		bytes += n;
+		size -= n;
+	}
+	return true;
+#else
+	B2_NOT_USED(data);
+	B2_NOT_USED(size);
+	return false;
+#endif
+}
+
+bool ShardLink::Send(uint32 type, const ShardBuffer& payload)
+{
+	if (m_fd < 0)
+	{
+		return false;
+	}
+
+	ShardMessageHeader header;
+	header.type = type;
+	header.size = payload.GetSize();
+	if (WriteAll(&header, sizeof(header)) == false || WriteAll(payload.GetData(), header.size) == false)
+	{
+		Close();
+		return false;
+	}
+
+	m_bytesSent += sizeof(header) + header.size;
+	return true;
+}
+
+bool ShardLink::Receive(uint32* type, ShardBuffer* payload)
+{
+	if (m_fd < 0)
+	{
+		return false;
+	}
+
+	ShardMessageHeader header;
+	if (ReadAll(&header, sizeof(header)) == false || header.size > k_maxShardPayload)
+	{
+		Close();
+		return false;
+	}
+
+	payload->Clear();
+	std::vector<uint8>& storage = payload->GetStorage();
+	storage.resize(header.size);
+	if (header.size > 0 && ReadAll(storage.data(), header.size) == false)
+	{
+		Close();
+		return false;
+	}
+
+	*type = header.type;
+	m_bytesReceived += sizeof(header) + header.size;
+	return true;
+}
+
+void ShardLink::Close()
+{
+#if SHARD_HAS_SOCKETS
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+	}
+#endif
+	m_fd = -1;
+}
+
+#if SHARD_HAS_SOCKETS
+static bool GetExecutablePath(char* path, uint32_t size)
+{
+#if defined(__APPLE__)
+	return _NSGetExecutablePath(path, &size) == 0;
+#else
+	ssize_t length = readlink("/proc/self/exe", path, size - 1);
+	if (length <= 0)
+	{
+		return false;
+	}
+	path[length] = 0;
+	return true;
+#endif
+}
+#endif
+
+int ShardSpawnProcess(const char* option, int* fd)
+{
+#if SHARD_HAS_SOCKETS
+	char path[1024];
+	if (GetExecutablePath(path, sizeof(path)) == false)
+	{
+		return -1;
+	}
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+	{
+		return -1;
+	}
+
+	// Other helpers started later must not hold this end open.
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+	// Everything the child needs is made before the fork; between fork and
+	// exec it may only make async-signal-safe calls.
+	char fdText[16];
+	snprintf(fdText, sizeof(fdText), "%d", fds[1]);
+	char* argv[] = { path, (char*)option, fdText, NULL };
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		execv(path, argv);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	if (pid < 0)
+	{
+		close(fds[0]);
+		return -1;
+	}
+
+	*fd = fds[0];
+	return (int)pid;
+#else
+	B2_NOT_USED(option);
+	B2_NOT_USED(fd);
+	return -1;
+#endif
+}
+
+bool ShardShapeFromFixture(ShardShape* out, const b2Fixture* fixture)
+{
+	*out = ShardShape();
+	const b2Shape* shape = fixture->GetShape();
+	out->type = (uint8)shape->GetType();
+	out->radius = shape->m_radius;
+	if (shape->GetType() == b2Shape::e_circle)
+	{
+		const b2CircleShape* circle = (const b2CircleShape*)shape;
+		out->count = 1;
+		out->vertices[0] = circle->m_p;
+	}
+	else if (shape->GetType() == b2Shape::e_edge)
+	{
+		// The ghost vertices are not kept, so the edge loses its smoothing.
+		const b2EdgeShape* edge = (const b2EdgeShape*)shape;
+		out->count = 2;
+		out->vertices[0] = edge->m_vertex1;
+		out->vertices[1] = edge->m_vertex2;
+	}
+	else if (shape->GetType() == b2Shape::e_polygon)
+	{
+		const b2PolygonShape* polygon = (const b2PolygonShape*)shape;
+		out->count = (uint8)polygon->m_count;
+		for (int32 i = 0; i < polygon->m_count; ++i)
+		{
+			out->vertices[i] = polygon->m_vertices[i];
+		}
+	}
+	else
+	{
+		return false;
+	}
+	out->density = fixture->GetDensity();
+	out->friction = fixture->GetFriction();
+	out->restitution = fixture->GetRestitution();
+	return true;
+}
+
+b2Fixture* ShardCreateFixture(b2Body* body, const ShardShape& shape)
+{
+	b2FixtureDef fd;
+	fd.density = shape.density;
+	fd.friction = shape.friction;
+	fd.restitution = shape.restitution;
+
+	if (shape.type == b2Shape::e_circle && shape.count == 1)
+	{
+		b2CircleShape circle;
+		circle.m_p = shape.vertices[0];
+		circle.m_radius = shape.radius;
+		fd.shape = &circle;
+		return body->CreateFixture(&fd);
+	}
+
+	if (shape.type == b2Shape::e_edge && shape.count == 2)
+	{
+		b2EdgeShape edge;
+		edge.Set(shape.vertices[0], shape.vertices[1]);
+		fd.shape = &edge;
+		return body->CreateFixture(&fd);
+	}
+
+	if (shape.type == b2Shape::e_polygon && shape.count >= 3 && shape.count <= b2_maxPolygonVertices)
+	{
+		b2PolygonShape polygon;
+		polygon.Set(shape.vertices, shape.count);
+		fd.shape = &polygon;
+		return body->CreateFixture(&fd);
+	}
+
+	return NULL;
+}
+
+void ShardDrawShape(const ShardShape& shape, const b2Transform& xf, const b2Color& color)
+{
+	if (shape.type == b2Shape::e_circle)
+	{
+		b2Vec2 center = b2Mul(xf, shape.vertices[0]);
+		g_debugDraw.DrawSolidCircle(center, shape.radius, xf.q.GetXAxis(), color);
+		return;
+	}
+
+	if (shape.type == b2Shape::e_edge)
+	{
+		g_debugDraw.DrawSegment(b2Mul(xf, shape.vertices[0]), b2Mul(xf, shape.vertices[1]), color);
+		return;
+	}
+
+	b2Vec2 vertices[b2_maxPolygonVertices];
+	for (int32 i = 0; i < shape.count; ++i)
+	{
+		vertices[i] = b2Mul(xf, shape.vertices[i]);
+	}
+	g_debugDraw.DrawSolidPolygon(vertices, shape.count, color);
+}
+
+// Small LCG so every process generates the same scene regardless of how
+// much the testbed generator has been used.
+static float32 ShardRandom(uint32* state, float32 lo, float32 hi)
+{
+	*state = *state * 1664525u + 1013904223u;
+	float32 r = (float32)((*state >> 8) & 0xFFFF) / 65535.0f;
+	return (hi - lo) * r + lo;
+}
+
+void ShardSceneExtent(int32 scene, int32 scale, float32* minX, float32* maxX)
+{
+	if (scene == e_shardTiles)
+	{
+		// 0.5m tiles, 160 columns per scale step.
+		float32 halfWidth = 40.0f * scale;
+		*minX = -halfWidth;
+		*maxX = halfWidth;
+	}
+	else
+	{
+		float32 halfWidth = 10.0f * scale;
+		*minX = -halfWidth;
+		*maxX = halfWidth;
+	}
+}
+
+void BuildShardScene(int32 scene, int32 scale, ShardSceneSink* sink)
+{
+	scale = b2Max(scale, 1);
+	float32 minX, maxX;
+	ShardSceneExtent(scene, scale, &minX, &maxX);
+	uint32 nextId = 0;
+
+	if (scene == e_shardTiles)
+	{
+		// A scaled-up version of the Tiles test: a field of static tiles with
+		// a row of pyramids spread across every shard.
+		float32 a = 0.5f;
+		int32 N = (int32)((maxX - minX) / (2.0f * a));
+		int32 M = 10;
+		b2Vec2 position;
+		position.y = -a;
+		for (int32 j = 0; j < M; ++j)
+		{
+			position.x = minX + a;
+			for (int32 i = 0; i < N; ++i)
+			{
+				b2PolygonShape shape;
+				shape.SetAsBox(a, a, position, 0.0f);
+				sink->AddStatic(&shape);
+				position.x += 2.0f * a;
+			}
+			position.y -= 2.0f * a;
+		}
+
+		const int32 pyramidCount = 4 * scale;
+		const int32 baseCount = 12;
+		b2PolygonShape box;
+		box.SetAsBox(a, a);
+
+		ShardShape shape = ShardShape();
+		shape.type = b2Shape::e_polygon;
+		shape.count = (uint8)box.m_count;
+		shape.radius = box.m_radius;
+		for (int32 i = 0; i < box.m_count; ++i)
+		{
+			shape.vertices[i] = box.m_vertices[i];
+		}
+		shape.density = 5.0f;
+		shape.friction = 0.6f;
+
+		float32 spacing = (maxX - minX) / pyramidCount;
+		for (int32 p = 0; p < pyramidCount; ++p)
+		{
+			b2Vec2 x(minX + (p + 0.5f) * spacing - 0.5f * baseCount * 1.125f, 0.75f);
+			b2Vec2 deltaX(0.5625f, 1.25f);
+			b2Vec2 deltaY(1.125f, 0.0f);
+
+			for (int32 i = 0; i < baseCount; ++i)
+			{
+				b2Vec2 y = x;
+				for (int32 j = i; j < baseCount; ++j)
+				{
+					b2BodyDef bd;
+					bd.type = b2_dynamicBody;
+					bd.position = y;
+					sink->AddBody(nextId++, bd, shape);
+					y += deltaY;
+				}
+				x += deltaX;
+			}
+		}
+	}
+	else
+	{
+		// A scaled-up version of AddPair: a band of small circles with no
+		// gravity and a fast box that ploughs through every shard.
+		uint32 seed = 12345u;
+		ShardShape circle = ShardShape();
+		circle.type = b2Shape::e_circle;
+		circle.count = 1;
+		circle.radius = 0.1f;
+		circle.density = 0.01f;
+		circle.friction = 0.2f;
+
+		int32 circleCount = 400 * scale;
+		for (int32 i = 0; i < circleCount; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.x = ShardRandom(&seed, minX, maxX);
+			bd.position.y = ShardRandom(&seed, 4.0f, 6.0f);
+			sink->AddBody(nextId++, bd, circle);
+		}
+
+		b2PolygonShape box;
+		box.SetAsBox(1.5f, 1.5f);
+		ShardShape bullet = ShardShape();
+		bullet.type = b2Shape::e_polygon;
+		bullet.count = (uint8)box.m_count;
+		bullet.radius = box.m_radius;
+		for (int32 i = 0; i < box.m_count; ++i)
+		{
+			bullet.vertices[i] = box.m_vertices[i];
+		}
+		bullet.density = 1.0f;
+		bullet.friction = 0.2f;
+
+		b2BodyDef bd;
+		bd.type = b2_dynamicBody;
+		bd.position.Set(minX - 10.0f, 5.0f);
+		bd.bullet = true;
+		bd.linearVelocity.Set(150.0f, 0.0f);
+		sink->AddBody(nextId++, bd, bullet);
+	}
+}
@@ -0,0 +1,244 @@
+#pragma once
+#include "Box2D/Box2D.h"
+#include <vector>
+
+// Wire format shared by the shard coordinator and its worker processes.
+// Every message is a fixed header followed by a payload, so the same framing
+// works over the local Unix domain sockets used today and a TCP stream later.
+// Payloads are raw structs: both ends are the same binary on the same machine.
+
+enum ShardMessageType
+{
+	e_shardSetup = 1,
+	e_shardStep,
+	e_shardReport,
+	e_shardQuit
+};
+
+enum ShardScene
+{
+	e_shardTiles,
+	e_shardAddPair,
+	e_shardSceneCount
+};
+
+// Flags on boundary states: the side of the shard the body was found on,
+// and whether a ShardShape record follows the state on the wire.
+enum ShardSide
+{
+	e_shardLeft = 1,
+	e_shardRight = 2,
+	e_shardHasShape = 4
+};
+
+struct ShardMessageHeader
+{
+	uint32 type;
+	uint32 size;
+};
+
+struct ShardSetup
+{
+	int32 shardIndex;
+	int32 shardCount;
+	int32 scene;
+	int32 scale;
+	float32 minX;
+	float32 maxX;
+	float32 ghostMargin;
+};
+
+struct ShardStepHeader
+{
+	int32 stepIndex;
+	float32 timeStep;
+	int32 velocityIterations;
+	int32 positionIterations;
+	int32 ghostCount;
+	int32 migrationCount;
+};
+
+struct ShardReportHeader
+{
+	int32 stepIndex;
+	int32 transformCount;
+	int32 boundaryCount;
+	int32 migrationCount;
+	float32 stepTime;
+};
+
+// Collision geometry of a single-fixture body.
+struct ShardShape
+{
+	uint8 type;
+	uint8 count;
+	float32 radius;
+	b2Vec2 vertices[b2_maxPolygonVertices];
+	float32 density;
+	float32 friction;
+	float32 restitution;
+};
+
+struct ShardTransform
+{
+	uint32 id;
+	float32 x, y, angle;
+};
+
+struct ShardBodyState
+{
+	uint32 id;
+	uint32 flags;
+	b2Vec2 position;
+	float32 angle;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+};
+
+// A body handed from one shard to another, including everything needed to
+// recreate it on the receiving side.
+struct ShardMigration
+{
+	ShardBodyState state;
+	ShardShape shape;
+	bool bullet;
+};
+
+// Builds ShardShape records from Box2D shapes and back. Circles, edges and
+// polygons can be sent; chains cannot, and return false. Creating a fixture
+// from a record with the wrong vertex count for its type returns NULL.
+bool ShardShapeFromFixture(ShardShape* out, const b2Fixture* fixture);
+b2Fixture* ShardCreateFixture(b2Body* body, const ShardShape& shape);
+void ShardDrawShape(const ShardShape& shape, const b2Transform& xf, const b2Color& color);
+
+// Receives the contents of a shard scene. The coordinator and the workers
+// run the same deterministic builder and keep the parts they care about.
+class ShardSceneSink
+{
+public:
+	virtual ~ShardSceneSink() {}
+	virtual void AddStatic(const b2Shape* shape) = 0;
+	virtual void AddBody(uint32 id, const b2BodyDef& def, const ShardShape& shape) = 0;
+};
+
+// Returns the x extent the shards split between.
+void ShardSceneExtent(int32 scene, int32 scale, float32* minX, float32* maxX);
+void BuildShardScene(int32 scene, int32 scale, ShardSceneSink* sink);
+
+// Growable byte buffer with a read cursor.
+class ShardBuffer
+{
+public:
+	ShardBuffer() : m_readOffset(0) {}
+
+	void Clear()
+	{
+		m_data.clear();
+		m_readOffset = 0;
+	}
+
+	void WriteBytes(const void* data, int32 size)
+	{
+		const uint8* bytes = (const uint8*)data;
+		m_data.insert(m_data.end(), bytes, bytes + size);
+	}
+
+	template <typename T>
+	void Write(const T& value)
+	{
+		WriteBytes(&value, sizeof(T));
+	}
+
+	bool ReadBytes(void* data, int32 size)
+	{
+		if (m_readOffset + size > (int32)m_data.size())
+		{
+			return false;
+		}
+		memcpy(data, m_data.data() + m_readOffset, size);
+		m_readOffset += size;
+		return true;
+	}
+
+	template <typename T>
+	bool Read(T* value)
+	{
+		return ReadBytes(value, sizeof(T));
+	}
+
+	// Seven bits a byte, low bits first, so small values take one byte.
+	void WriteVarint(uint32 value)
+	{
+		while (value >= 0x80)
+		{
+			m_data.push_back((uint8)(value | 0x80));
+			value >>= 7;
+		}
+		m_data.push_back((uint8)value);
+	}
+
+	bool ReadVarint(uint32* value)
+	{
+		uint32 result = 0;
+		for (int32 shift = 0; shift < 35; shift += 7)
+		{
+			if (m_readOffset == (int32)m_data.size())
+			{
+				return false;
+			}
+			uint8 byte = m_data[m_readOffset++];
+			result |= (uint32)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+			{
+				*value = result;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool IsAtEnd() const { return m_readOffset == (int32)m_data.size(); }
+
+	int32 GetSize() const { return (int32)m_data.size(); }
+	const uint8* GetData() const { return m_data.data(); }
+	std::vector<uint8>& GetStorage() { return m_data; }
+	void Rewind() { m_readOffset = 0; }
+
+private:
+	std::vector<uint8> m_data;
+	int32 m_readOffset;
+};
+
+// One end of a coordinator/worker connection. Wraps a connected stream
+// socket and counts the traffic that goes through it.
+class ShardLink
+{
+public:
+	ShardLink() : m_fd(-1), m_bytesSent(0), m_bytesReceived(0) {}
+	explicit ShardLink(int fd) : m_fd(fd), m_bytesSent(0), m_bytesReceived(0) {}
+
+	bool Send(uint32 type, const ShardBuffer& payload);
+	bool Receive(uint32* type, ShardBuffer* payload);
+	void Close();
+
+	bool IsOpen() const { return m_fd >= 0; }
+	int GetDescriptor() const { return m_fd; }
+	uint64_t GetBytesSent() const { return m_bytesSent; }
+	uint64_t GetBytesReceived() const { return m_bytesReceived; }
+
+private:
+	bool WriteAll(const void* data, size_t size);
+	bool ReadAll(void* data, size_t size);
+
+	int m_fd;
+	uint64_t m_bytesSent;
+	uint64_t m_bytesReceived;
+};
+
+// Starts a helper process at the end of a socket: connects a pair of stream
+// sockets and runs this executable again as "<exe> option <fd>", with the
+// child's end as fd. The child is exec'd, not just forked: a fork would copy
+// a process whose job system threads may hold locks that nothing in the
+// child would ever release. Returns the child's pid and puts the parent's
+// end, closed on exec, in *fd; returns -1 where there are no processes.
+int ShardSpawnProcess(const char* option, int* fd);
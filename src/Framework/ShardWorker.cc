@@ -0,0 +1,308 @@
+#include "ShardWorker.h"
+
+ShardWorker::ShardWorker(int fd)
+	: m_link(fd)
+{
+	memset(&m_setup, 0, sizeof(m_setup));
+	m_world = NULL;
+	m_ground = NULL;
+	m_stepIndex = 0;
+}
+
+ShardWorker::~ShardWorker()
+{
+	delete m_world;
+	m_world = NULL;
+	m_link.Close();
+}
+
+void ShardWorker::Run()
+{
+	ShardBuffer payload;
+	uint32 type;
+	while (m_link.Receive(&type, &payload))
+	{
+		bool ok = false;
+		switch (type)
+		{
+		case e_shardSetup:
+			ok = Setup(&payload);
+			break;
+
+		case e_shardStep:
+			ok = Step(&payload);
+			break;
+
+		case e_shardQuit:
+		default:
+			ok = false;
+			break;
+		}
+
+		if (ok == false)
+		{
+			break;
+		}
+	}
+}
+
+void ShardWorker::AddStatic(const b2Shape* shape)
+{
+	// Static geometry is replicated, but only the part near this shard.
+	b2AABB aabb;
+	b2Transform xf;
+	xf.SetIdentity();
+	shape->ComputeAABB(&aabb, xf, 0);
+	float32 margin = 2.0f * m_setup.ghostMargin;
+	if (aabb.upperBound.x < m_setup.minX - margin || aabb.lowerBound.x > m_setup.maxX + margin)
+	{
+		return;
+	}
+	m_ground->CreateFixture(shape, 0.0f);
+}
+
+void ShardWorker::AddBody(uint32 id, const b2BodyDef& def, const ShardShape& shape)
+{
+	if (def.position.x < m_setup.minX || def.position.x >= m_setup.maxX)
+	{
+		return;
+	}
+
+	b2BodyDef bd = def;
+	bd.userData = (void*)(uintptr_t)id;
+	b2Body* body = m_world->CreateBody(&bd);
+	ShardCreateFixture(body, shape);
+	m_bodies[id] = body;
+}
+
+bool ShardWorker::Setup(ShardBuffer* payload)
+{
+	if (payload->Read(&m_setup) == false)
+	{
+		return false;
+	}
+
+	delete m_world;
+	m_bodies.clear();
+	m_ghosts.clear();
+	m_ghostStamps.clear();
+
+	b2Vec2 gravity(0.0f, m_setup.scene == e_shardAddPair ? 0.0f : -10.0f);
+	m_world = new b2World(gravity);
+	b2BodyDef bd;
+	m_ground = m_world->CreateBody(&bd);
+	BuildShardScene(m_setup.scene, m_setup.scale, this);
+	m_stepIndex = 0;
+
+	// Acknowledge with an empty report so the coordinator knows we are ready.
+	ShardReportHeader header;
+	memset(&header, 0, sizeof(header));
+	m_report.Clear();
+	m_report.Write(header);
+	return m_link.Send(e_shardReport, m_report);
+}
+
+void ShardWorker::UpdateGhost(const ShardBodyState& state, const ShardShape* shape)
+{
+	b2Body* ghost = NULL;
+	std::unordered_map<uint32, b2Body*>::iterator it = m_ghosts.find(state.id);
+	if (it != m_ghosts.end())
+	{
+		ghost = it->second;
+	}
+	else if (shape != NULL)
+	{
+		// Ghosts are kinematic: they push our bodies but are driven entirely
+		// by the neighbour that owns them.
+		b2BodyDef bd;
+		bd.type = b2_kinematicBody;
+		bd.position = state.position;
+		bd.angle = state.angle;
+		bd.userData = (void*)(uintptr_t)state.id;
+		ghost = m_world->CreateBody(&bd);
+		ShardCreateFixture(ghost, *shape);
+		m_ghosts[state.id] = ghost;
+	}
+
+	if (ghost == NULL)
+	{
+		return;
+	}
+
+	ghost->SetTransform(state.position, state.angle);
+	ghost->SetLinearVelocity(state.linearVelocity);
+	ghost->SetAngularVelocity(state.angularVelocity);
+	m_ghostStamps[state.id] = m_stepIndex;
+}
+
+void ShardWorker::Adopt(const ShardMigration& migration)
+{
+	std::unordered_map<uint32, b2Body*>::iterator it = m_ghosts.find(migration.state.id);
+	if (it != m_ghosts.end())
+	{
+		m_world->DestroyBody(it->second);
+		m_ghosts.erase(it);
+		m_ghostStamps.erase(migration.state.id);
+	}
+
+	b2BodyDef bd;
+	bd.type = b2_dynamicBody;
+	bd.position = migration.state.position;
+	bd.angle = migration.state.angle;
+	bd.linearVelocity = migration.state.linearVelocity;
+	bd.angularVelocity = migration.state.angularVelocity;
+	bd.bullet = migration.bullet;
+	bd.userData = (void*)(uintptr_t)migration.state.id;
+	b2Body* body = m_world->CreateBody(&bd);
+	ShardCreateFixture(body, migration.shape);
+	m_bodies[migration.state.id] = body;
+}
+
+static void ShardGetState(ShardBodyState* state, uint32 id, uint32 flags, const b2Body* body)
+{
+	state->id = id;
+	state->flags = flags;
+	state->position = body->GetPosition();
+	state->angle = body->GetAngle();
+	state->linearVelocity = body->GetLinearVelocity();
+	state->angularVelocity = body->GetAngularVelocity();
+}
+
+bool ShardWorker::Step(ShardBuffer* payload)
+{
+	ShardStepHeader header;
+	if (payload->Read(&header) == false)
+	{
+		return false;
+	}
+	m_stepIndex = header.stepIndex;
+
+	// Refresh ghosts from the neighbours' last boundary states.
+	for (int32 i = 0; i < header.ghostCount; ++i)
+	{
+		ShardBodyState state;
+		ShardShape shape;
+		if (payload->Read(&state) == false)
+		{
+			return false;
+		}
+		bool hasShape = (state.flags & e_shardHasShape) != 0;
+		if (hasShape && payload->Read(&shape) == false)
+		{
+			return false;
+		}
+		UpdateGhost(state, hasShape ? &shape : NULL);
+	}
+
+	// Ghosts whose owner stopped reporting them have left the margin.
+	for (std::unordered_map<uint32, b2Body*>::iterator it = m_ghosts.begin(); it != m_ghosts.end();)
+	{
+		if (m_ghostStamps[it->first] != m_stepIndex)
+		{
+			m_ghostStamps.erase(it->first);
+			m_world->DestroyBody(it->second);
+			it = m_ghosts.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	for (int32 i = 0; i < header.migrationCount; ++i)
+	{
+		ShardMigration migration;
+		if (payload->Read(&migration) == false)
+		{
+			return false;
+		}
+		Adopt(migration);
+	}
+
+	b2Timer timer;
+	m_world->Step(header.timeStep, header.velocityIterations, header.positionIterations);
+	float32 stepTime = timer.GetMilliseconds();
+
+	// Gather the report: moved transforms, boundary states and migrations.
+	std::vector<ShardTransform> transforms;
+	std::vector<ShardBodyState> boundary;
+	std::vector<ShardMigration> migrations;
+	transforms.reserve(m_bodies.size());
+
+	bool hasLeft = m_setup.shardIndex > 0;
+	bool hasRight = m_setup.shardIndex < m_setup.shardCount - 1;
+	for (std::unordered_map<uint32, b2Body*>::iterator it = m_bodies.begin(); it != m_bodies.end();)
+	{
+		uint32 id = it->first;
+		b2Body* body = it->second;
+		const b2Vec2& p = body->GetPosition();
+
+		if ((hasLeft && p.x < m_setup.minX) || (hasRight && p.x >= m_setup.maxX))
+		{
+			// Bodies only ever get their fixture from a ShardShape, so it
+			// always converts back.
+			ShardMigration migration;
+			ShardGetState(&migration.state, id, 0, body);
+			bool converted = ShardShapeFromFixture(&migration.shape, body->GetFixtureList());
+			b2Assert(converted);
+			B2_NOT_USED(converted);
+			migration.bullet = body->IsBullet();
+			migrations.push_back(migration);
+			m_world->DestroyBody(body);
+			it = m_bodies.erase(it);
+			continue;
+		}
+
+		// Sleeping bodies have not moved since they were last reported.
+		if (body->IsAwake())
+		{
+			ShardTransform xf;
+			xf.id = id;
+			xf.x = p.x;
+			xf.y = p.y;
+			xf.angle = body->GetAngle();
+			transforms.push_back(xf);
+		}
+
+		uint32 flags = 0;
+		if (hasLeft && p.x < m_setup.minX + m_setup.ghostMargin)
+		{
+			flags |= e_shardLeft;
+		}
+		if (hasRight && p.x >= m_setup.maxX - m_setup.ghostMargin)
+		{
+			flags |= e_shardRight;
+		}
+		if (flags != 0)
+		{
+			ShardBodyState state;
+			ShardGetState(&state, id, flags, body);
+			boundary.push_back(state);
+		}
+
+		++it;
+	}
+
+	ShardReportHeader report;
+	report.stepIndex = header.stepIndex;
+	report.transformCount = (int32)transforms.size();
+	report.boundaryCount = (int32)boundary.size();
+	report.migrationCount = (int32)migrations.size();
+	report.stepTime = stepTime;
+
+	m_report.Clear();
+	m_report.Write(report);
+	if (transforms.empty() == false)
+	{
+		m_report.WriteBytes(transforms.data(), (int32)(transforms.size() * sizeof(ShardTransform)));
+	}
+	if (boundary.empty() == false)
+	{
+		m_report.WriteBytes(boundary.data(), (int32)(boundary.size() * sizeof(ShardBodyState)));
+	}
+	if (migrations.empty() == false)
+	{
+		m_report.WriteBytes(migrations.data(), (int32)(migrations.size() * sizeof(ShardMigration)));
+	}
+	return m_link.Send(e_shardReport, m_report);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "ShardProtocol.h"
+#include <unordered_map>
+
+// Runs one spatial shard of a sharded world. A worker owns the bodies whose
+// centers lie inside its x range, mirrors its neighbours' boundary bodies as
+// kinematic ghosts and hands bodies over when they cross a shard boundary.
+// Workers live in their own process and only talk to the coordinator.
+class ShardWorker : public ShardSceneSink
+{
+public:
+	explicit ShardWorker(int fd);
+	~ShardWorker();
+
+	// Serves coordinator requests until the connection closes or a quit
+	// message arrives.
+	void Run();
+
+	void AddStatic(const b2Shape* shape) override;
+	void AddBody(uint32 id, const b2BodyDef& def, const ShardShape& shape) override;
+
+private:
+	bool Setup(ShardBuffer* payload);
+	bool Step(ShardBuffer* payload);
+	void UpdateGhost(const ShardBodyState& state, const ShardShape* shape);
+	void Adopt(const ShardMigration& migration);
+
+	ShardLink m_link;
+	ShardSetup m_setup;
+	b2World* m_world;
+	b2Body* m_ground;
+	std::unordered_map<uint32, b2Body*> m_bodies;
+	std::unordered_map<uint32, b2Body*> m_ghosts;
+	std::unordered_map<uint32, int32> m_ghostStamps;
+	int32 m_stepIndex;
+	ShardBuffer m_report;
+};
@@ -0,0 +1,238 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+// Thin wrapper over the widest float vector the build targets: 8 lanes with
+// AVX2, 4 with SSE2, and a 4-lane plain C++ fallback elsewhere. Comparisons
+// return lane masks (all bits set or clear) for use with SimdSelect.
+// Loads and stores are unaligned.
+
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(SIMD_AVX2)
+
+const int32 k_simdWidth = 8;
+#define SIMD_NAME "AVX2"
+
+struct FloatW
+{
+	FloatW() {}
+	FloatW(__m256 x) : v(x) {}
+	__m256 v;
+};
+
+inline FloatW SimdSet(float32 x) { return _mm256_set1_ps(x); }
+inline FloatW SimdZero() { return _mm256_setzero_ps(); }
+inline FloatW SimdLoad(const float32* p) { return _mm256_loadu_ps(p); }
+inline void SimdStore(float32* p, FloatW a) { _mm256_storeu_ps(p, a.v); }
+inline FloatW operator + (FloatW a, FloatW b) { return _mm256_add_ps(a.v, b.v); }
+inline FloatW operator - (FloatW a, FloatW b) { return _mm256_sub_ps(a.v, b.v); }
+inline FloatW operator * (FloatW a, FloatW b) { return _mm256_mul_ps(a.v, b.v); }
+inline FloatW operator / (FloatW a, FloatW b) { return _mm256_div_ps(a.v, b.v); }
+inline FloatW operator - (FloatW a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline FloatW operator & (FloatW a, FloatW b) { return _mm256_and_ps(a.v, b.v); }
+inline FloatW operator | (FloatW a, FloatW b) { return _mm256_or_ps(a.v, b.v); }
+inline FloatW operator < (FloatW a, FloatW b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline FloatW operator > (FloatW a, FloatW b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline FloatW operator >= (FloatW a, FloatW b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline FloatW operator == (FloatW a, FloatW b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline FloatW SimdMin(FloatW a, FloatW b) { return _mm256_min_ps(a.v, b.v); }
+inline FloatW SimdMax(FloatW a, FloatW b) { return _mm256_max_ps(a.v, b.v); }
+inline FloatW SimdSqrt(FloatW a) { return _mm256_sqrt_ps(a.v); }
+inline FloatW SimdFloor(FloatW a) { return _mm256_floor_ps(a.v); }
+inline bool SimdAnyTrue(FloatW mask) { return _mm256_movemask_ps(mask.v) != 0; }
+
+// mask ? a : b
+inline FloatW SimdSelect(FloatW mask, FloatW a, FloatW b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+#elif defined(SIMD_SSE2)
+
+const int32 k_simdWidth = 4;
+#define SIMD_NAME "SSE2"
+
+struct FloatW
+{
+	FloatW() {}
+	FloatW(__m128 x) : v(x) {}
+	__m128 v;
+};
+
+inline FloatW SimdSet(float32 x) { return _mm_set1_ps(x); }
+inline FloatW SimdZero() { return _mm_setzero_ps(); }
+inline FloatW SimdLoad(const float32* p) { return _mm_loadu_ps(p); }
+inline void SimdStore(float32* p, FloatW a) { _mm_storeu_ps(p, a.v); }
+inline FloatW operator + (FloatW a, FloatW b) { return _mm_add_ps(a.v, b.v); }
+inline FloatW operator - (FloatW a, FloatW b) { return _mm_sub_ps(a.v, b.v); }
+inline FloatW operator * (FloatW a, FloatW b) { return _mm_mul_ps(a.v, b.v); }
+inline FloatW operator / (FloatW a, FloatW b) { return _mm_div_ps(a.v, b.v); }
+inline FloatW operator - (FloatW a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline FloatW operator & (FloatW a, FloatW b) { return _mm_and_ps(a.v, b.v); }
+inline FloatW operator | (FloatW a, FloatW b) { return _mm_or_ps(a.v, b.v); }
+inline FloatW operator < (FloatW a, FloatW b) { return _mm_cmplt_ps(a.v, b.v); }
+inline FloatW operator > (FloatW a, FloatW b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline FloatW operator >= (FloatW a, FloatW b) { return _mm_cmpge_ps(a.v, b.v); }
+inline FloatW operator == (FloatW a, FloatW b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline FloatW SimdMin(FloatW a, FloatW b) { return _mm_min_ps(a.v, b.v); }
+inline FloatW SimdMax(FloatW a, FloatW b) { return _mm_max_ps(a.v, b.v); }
+inline FloatW SimdSqrt(FloatW a) { return _mm_sqrt_ps(a.v); }
+inline bool SimdAnyTrue(FloatW mask) { return _mm_movemask_ps(mask.v) != 0; }
+
+// SSE2 has no round instruction; truncate and step down for negative values.
+inline FloatW SimdFloor(FloatW a)
+{
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+}
+
+inline FloatW SimdSelect(FloatW mask, FloatW a, FloatW b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+
+#else
+
+const int32 k_simdWidth = 4;
+#define SIMD_NAME "scalar"
+
+struct FloatW
+{
+	float32 v[4];
+};
+
+#define SIMD_LANES(expr) FloatW r; for (int32 i = 0; i < 4; ++i) { r.v[i] = (expr); } return r
+
+inline float32 SimdMaskBits(bool b) { uint32 u = b ? 0xFFFFFFFFu : 0u; float32 f; memcpy(&f, &u, 4); return f; }
+inline uint32 SimdBits(float32 f) { uint32 u; memcpy(&u, &f, 4); return u; }
+inline float32 SimdFromBits(uint32 u) { float32 f; memcpy(&f, &u, 4); return f; }
+
+inline FloatW SimdSet(float32 x) { SIMD_LANES(x); }
+inline FloatW SimdZero() { SIMD_LANES(0.0f); }
+inline FloatW SimdLoad(const float32* p) { SIMD_LANES(p[i]); }
+inline void SimdStore(float32* p, FloatW a) { for (int32 i = 0; i < 4; ++i) { p[i] = a.v[i]; } }
+inline FloatW operator + (FloatW a, FloatW b) { SIMD_LANES(a.v[i] + b.v[i]); }
+inline FloatW operator - (FloatW a, FloatW b) { SIMD_LANES(a.v[i] - b.v[i]); }
+inline FloatW operator * (FloatW a, FloatW b) { SIMD_LANES(a.v[i] * b.v[i]); }
+inline FloatW operator / (FloatW a, FloatW b) { SIMD_LANES(a.v[i] / b.v[i]); }
+inline FloatW operator - (FloatW a) { SIMD_LANES(-a.v[i]); }
+inline FloatW operator & (FloatW a, FloatW b) { SIMD_LANES(SimdFromBits(SimdBits(a.v[i]) & SimdBits(b.v[i]))); }
+inline FloatW operator | (FloatW a, FloatW b) { SIMD_LANES(SimdFromBits(SimdBits(a.v[i]) | SimdBits(b.v[i]))); }
+inline FloatW operator < (FloatW a, FloatW b) { SIMD_LANES(SimdMaskBits(a.v[i] < b.v[i])); }
+inline FloatW operator > (FloatW a, FloatW b) { SIMD_LANES(SimdMaskBits(a.v[i] > b.v[i])); }
+inline FloatW operator >= (FloatW a, FloatW b) { SIMD_LANES(SimdMaskBits(a.v[i] >= b.v[i])); }
+inline FloatW operator == (FloatW a, FloatW b) { SIMD_LANES(SimdMaskBits(a.v[i] == b.v[i])); }
+inline FloatW SimdMin(FloatW a, FloatW b) { SIMD_LANES(b2Min(a.v[i], b.v[i])); }
+inline FloatW SimdMax(FloatW a, FloatW b) { SIMD_LANES(b2Max(a.v[i], b.v[i])); }
+inline FloatW SimdSqrt(FloatW a) { SIMD_LANES(sqrtf(a.v[i])); }
+inline FloatW SimdFloor(FloatW a) { SIMD_LANES(floorf(a.v[i])); }
+inline FloatW SimdSelect(FloatW mask, FloatW a, FloatW b) { SIMD_LANES(SimdBits(mask.v[i]) ? a.v[i] : b.v[i]); }
+inline bool SimdAnyTrue(FloatW mask) { return (SimdBits(mask.v[0]) | SimdBits(mask.v[1]) | SimdBits(mask.v[2]) | SimdBits(mask.v[3])) != 0; }
+
+#undef SIMD_LANES
+
+#endif
+
+// Always four lanes whatever k_simdWidth is, for data that naturally comes
+// in fours such as the children of a WideTree node.
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+
+struct Float4
+{
+	Float4() {}
+	Float4(__m128 x) : v(x) {}
+	__m128 v;
+};
+
+inline Float4 Simd4Set(float32 x) { return _mm_set1_ps(x); }
+inline Float4 Simd4Load(const float32* p) { return _mm_loadu_ps(p); }
+inline Float4 operator + (Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator - (Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator * (Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline Float4 operator - (Float4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+inline Float4 operator | (Float4 a, Float4 b) { return _mm_or_ps(a.v, b.v); }
+inline Float4 operator > (Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline Float4 Simd4Min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+inline Float4 Simd4Max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+
+// Bit i is set if lane i of the mask is.
+inline int32 Simd4MaskBits(Float4 mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+struct Float4
+{
+	float32 v[4];
+};
+
+#define SIMD4_LANES(expr) Float4 r; for (int32 i = 0; i < 4; ++i) { r.v[i] = (expr); } return r
+
+inline Float4 Simd4Set(float32 x) { SIMD4_LANES(x); }
+inline Float4 Simd4Load(const float32* p) { SIMD4_LANES(p[i]); }
+inline Float4 operator + (Float4 a, Float4 b) { SIMD4_LANES(a.v[i] + b.v[i]); }
+inline Float4 operator - (Float4 a, Float4 b) { SIMD4_LANES(a.v[i] - b.v[i]); }
+inline Float4 operator * (Float4 a, Float4 b) { SIMD4_LANES(a.v[i] * b.v[i]); }
+inline Float4 operator - (Float4 a) { SIMD4_LANES(-a.v[i]); }
+inline Float4 operator | (Float4 a, Float4 b) { SIMD4_LANES(SimdFromBits(SimdBits(a.v[i]) | SimdBits(b.v[i]))); }
+inline Float4 operator > (Float4 a, Float4 b) { SIMD4_LANES(SimdMaskBits(a.v[i] > b.v[i])); }
+inline Float4 Simd4Min(Float4 a, Float4 b) { SIMD4_LANES(b2Min(a.v[i], b.v[i])); }
+inline Float4 Simd4Max(Float4 a, Float4 b) { SIMD4_LANES(b2Max(a.v[i], b.v[i])); }
+
+inline int32 Simd4MaskBits(Float4 mask)
+{
+	int32 bits = 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		bits |= (SimdBits(mask.v[i]) >> 31) << i;
+	}
+	return bits;
+}
+
+#undef SIMD4_LANES
+
+#endif
+
+// Smallest lane.
+inline float32 SimdReduceMin(FloatW a)
+{
+	float32 lanes[k_simdWidth];
+	SimdStore(lanes, a);
+	float32 result = lanes[0];
+	for (int32 i = 1; i < k_simdWidth; ++i)
+	{
+		result = b2Min(result, lanes[i]);
+	}
+	return result;
+}
+
+// Sine and cosine to within a few ulp of sinf/cosf for the angles a body
+// reaches. The argument is reduced to [-pi/4, pi/4] around the nearest
+// multiple of pi/2 and the quadrant picks the polynomial and the signs.
+inline void SimdSinCos(FloatW x, FloatW* s, FloatW* c)
+{
+	FloatW q = SimdFloor(x * SimdSet(0.636619772f) + SimdSet(0.5f));
+
+	// Cody-Waite: pi/2 split in three parts so r stays accurate.
+	FloatW r = x - q * SimdSet(1.5703125f);
+	r = r - q * SimdSet(4.837512969970703125e-4f);
+	r = r - q * SimdSet(7.54978995489188216e-8f);
+
+	FloatW z = r * r;
+	FloatW sinr = ((SimdSet(-1.9515295891e-4f) * z + SimdSet(8.3321608736e-3f)) * z + SimdSet(-1.6666654611e-1f)) * z * r + r;
+	FloatW cosr = ((SimdSet(2.443315711809948e-5f) * z + SimdSet(-1.388731625493765e-3f)) * z + SimdSet(4.166664568298827e-2f)) * z * z
+		- SimdSet(0.5f) * z + SimdSet(1.0f);
+
+	// Quadrant bits as floats: odd quadrants swap sin and cos, quadrants 2
+	// and 3 negate sin, quadrants 1 and 2 negate cos.
+	FloatW half = q * SimdSet(0.5f);
+	FloatW odd = (q - SimdSet(2.0f) * SimdFloor(half)) > SimdSet(0.5f);
+	FloatW quarter = q * SimdSet(0.25f);
+	FloatW quadrant = q - SimdSet(4.0f) * SimdFloor(quarter);
+	FloatW negateSin = quadrant > SimdSet(1.5f);
+	FloatW negateCos = (quadrant > SimdSet(0.5f)) & (quadrant < SimdSet(2.5f));
+
+	FloatW sinv = SimdSelect(odd, cosr, sinr);
+	FloatW cosv = SimdSelect(odd, sinr, cosr);
+	*s = SimdSelect(negateSin, -sinv, sinv);
+	*c = SimdSelect(negateCos, -cosv, cosv);
+}
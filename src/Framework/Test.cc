@@ -1,4 +1,49 @@
 #include "Test.h"
+#include "WorldChecksum.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Same LCG as the C library's example rand(), but with state of its own so
+// nothing else can advance it.
+static uint32 s_randomState = k_randomSeed;
+
+void SetRandomSeed(uint32 seed)
+{
+	s_randomState = seed;
+}
+
+int32 RandomInt()
+{
+	s_randomState = s_randomState * 1103515245u + 12345u;
+	return (int32)((s_randomState >> 16) & RAND_LIMIT);
+}
+
+const TestEntry* FindTestEntry(const char* name)
+{
+	for (const TestEntry* entry = g_testEntries; entry->createFcn != NULL; ++entry)
+	{
+		if (strcmp(entry->name, name) == 0)
+		{
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+Settings MakeHeadlessSettings(const Settings& settings)
+{
+	Settings runSettings = settings;
+	runSettings.labRewind = 0;
+	runSettings.pause = false;
+	runSettings.singleStep = false;
+	runSettings.drawShapes = false;
+	runSettings.drawJoints = false;
+	runSettings.drawAABBs = false;
+	runSettings.drawContactPoints = false;
+	runSettings.drawCOMs = false;
+	return runSettings;
+}
 
 void DestructionListener::SayGoodbye(b2Joint* joint)
 {
@@ -30,18 +75,24 @@ Test::Test()
 	m_bombSpawning = false;
 
 	m_stepCount = 0;
+	m_checksum = 0;
+	m_worldTeardown = e_teardownInline;
+
+	SetRandomSeed(k_randomSeed);
 
 	b2BodyDef bodyDef;
 	m_groundBody = m_world->CreateBody(&bodyDef);
 
 	memset(&m_maxProfile, 0, sizeof(b2Profile));
 	memset(&m_totalProfile, 0, sizeof(b2Profile));
+	m_profileCount = 0;
+	m_parallelToiActive = false;
 }
 
 Test::~Test()
 {
 	// By deleting the world, we delete the bomb, mouse joint, etc.
-	delete m_world;
+	DestroyWorld(m_world, m_worldTeardown);
 	m_world = NULL;
 }
 
@@ -245,6 +296,59 @@ void Test::LaunchBomb(const b2Vec2& position, const b2Vec2& velocity)
 	m_bomb->CreateFixture(&fd);
 }
 
+static float32 ProfilePercentile(const b2Profile* samples, int32 count, float32 b2Profile::*field, float32 fraction)
+{
+	if (count == 0)
+	{
+		return 0.0f;
+	}
+
+	float32 values[k_profileHistory];
+	for (int32 i = 0; i < count; ++i)
+	{
+		values[i] = samples[i].*field;
+	}
+
+	int32 index = (int32)(fraction * (count - 1));
+	std::nth_element(values, values + index, values + count);
+	return values[index];
+}
+
+void Test::StepWorld(Settings* settings, float32 timeStep, b2Profile* profile)
+{
+	m_world->SetAllowSleeping(settings->enableSleep);
+	m_world->SetWarmStarting(settings->enableWarmStarting);
+	m_world->SetSubStepping(settings->enableSubStepping);
+
+	// The approximate parallel pass replaces the world's own TOI solver.
+	m_parallelToiActive = settings->enableContinuous && settings->enableParallelTOI && timeStep > 0.0f;
+	m_world->SetContinuousPhysics(settings->enableContinuous && m_parallelToiActive == false);
+
+	if (m_parallelToiActive)
+	{
+		m_parallelToi.Begin(m_world);
+	}
+
+	CountedStep(m_world, timeStep, settings->velocityIterations, settings->positionIterations, &m_stepCounters);
+
+	*profile = m_world->GetProfile();
+	if (m_parallelToiActive)
+	{
+		// Counted in the step, but not as solveTOI: it is not the same
+		// solve.
+		m_parallelToi.Solve(m_world);
+		profile->step += m_parallelToi.GetTime();
+		m_stepCounters.Add(m_parallelToi.GetCounters());
+	}
+
+	m_world->DrawDebugData();
+}
+
+uint32 Test::ComputeChecksum() const
+{
+	return ComputeWorldChecksum(m_world);
+}
+
 void Test::Step(Settings* settings)
 {
 	float32 timeStep = settings->hz > 0.0f ? 1.0f / settings->hz : float32(0.0f);
@@ -271,16 +375,17 @@ void Test::Step(Settings* settings)
 	flags += settings->drawCOMs				* b2Draw::e_centerOfMassBit;
 	g_debugDraw.SetFlags(flags);
 
-	m_world->SetAllowSleeping(settings->enableSleep);
-	m_world->SetWarmStarting(settings->enableWarmStarting);
-	m_world->SetContinuousPhysics(settings->enableContinuous);
-	m_world->SetSubStepping(settings->enableSubStepping);
-
 	m_pointCount = 0;
+	m_worldTeardown = (WorldTeardown)settings->worldTeardown;
 
-	m_world->Step(timeStep, settings->velocityIterations, settings->positionIterations);
+	b2Profile p;
+	m_stepCounters.Reset();
+	StepWorld(settings, timeStep, &p);
+	m_totalCounters.Add(m_stepCounters);
+	m_checksum = ComputeChecksum();
+
+	g_jobSystem.SampleStats();
 
-	m_world->DrawDebugData();
 	g_camera.Update();
 	g_debugDraw.Render(g_camera.BuildProjectionViewMatrix(0.0f));
 
@@ -297,17 +402,43 @@ void Test::Step(Settings* settings)
 		g_debugDraw.DrawString(5, m_textLine, "bodies/contacts/joints = %d/%d/%d", bodyCount, contactCount, jointCount);
 		m_textLine += DRAW_STRING_NEW_LINE;
 
+		g_debugDraw.DrawString(5, m_textLine, "step %d checksum = %08x", m_stepCount, m_checksum);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
 		int32 proxyCount = m_world->GetProxyCount();
 		int32 height = m_world->GetTreeHeight();
 		int32 balance = m_world->GetTreeBalance();
 		float32 quality = m_world->GetTreeQuality();
 		g_debugDraw.DrawString(5, m_textLine, "proxies/height/balance/quality = %d/%d/%d/%g", proxyCount, height, balance, quality);
 		m_textLine += DRAW_STRING_NEW_LINE;
+
+		const CollisionCounters& c = m_totalCounters;
+		const char* exact = c.exact ? "" : " (approximate)";
+		g_debugDraw.DrawString(5, m_textLine, "gjk calls/ave iters/max iters = %d/%3.1f/%d%s",
+			c.gjkCalls, c.gjkCalls > 0 ? c.gjkIters / float32(c.gjkCalls) : 0.0f, c.gjkMaxIters, exact);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "toi calls = %d, ave [max] toi time = %.1f [%.1f] us",
+			c.toiCalls, c.toiCalls > 0 ? 1000.0f * c.toiTime / c.toiCalls : 0.0f, 1000.0f * c.toiMaxTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		// The parallel TOI pass cannot count the root finder's iterations.
+		int32 iterCalls = c.toiCalls - c.toiCallsWithoutIters;
+		if (iterCalls > 0)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "toi ave iters/max root iters = %3.1f/%d over %d calls",
+				c.toiIters / float32(iterCalls), c.toiMaxRootIters, iterCalls);
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+		else if (c.toiCalls > 0)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "toi iters: not counted by the parallel TOI pass");
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
 	}
 
 	// Track maximum profile times
 	{
-		const b2Profile& p = m_world->GetProfile();
 		m_maxProfile.step = b2Max(m_maxProfile.step, p.step);
 		m_maxProfile.collide = b2Max(m_maxProfile.collide, p.collide);
 		m_maxProfile.solve = b2Max(m_maxProfile.solve, p.solve);
@@ -325,11 +456,16 @@ void Test::Step(Settings* settings)
 		m_totalProfile.solvePosition += p.solvePosition;
 		m_totalProfile.solveTOI += p.solveTOI;
 		m_totalProfile.broadphase += p.broadphase;
+
+		if (timeStep > 0.0f)
+		{
+			m_profileHistory[m_profileCount % k_profileHistory] = p;
+			++m_profileCount;
+		}
 	}
 
 	if (settings->drawProfile)
 	{
-		const b2Profile& p = m_world->GetProfile();
 
 		b2Profile aveProfile;
 		memset(&aveProfile, 0, sizeof(b2Profile));
@@ -346,22 +482,54 @@ void Test::Step(Settings* settings)
 			aveProfile.broadphase = scale * m_totalProfile.broadphase;
 		}
 
-		g_debugDraw.DrawString(5, m_textLine, "step [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.step, aveProfile.step, m_maxProfile.step);
+		// Percentiles over the most recent steps only.
+		b2Profile p99Profile;
+		int32 historyCount = b2Min(m_profileCount, k_profileHistory);
+		p99Profile.step = ProfilePercentile(m_profileHistory, historyCount, &b2Profile::step, 0.99f);
+		p99Profile.collide = ProfilePercentile(m_profileHistory, historyCount, &b2Profile::collide, 0.99f);
+		p99Profile.solve = ProfilePercentile(m_profileHistory, historyCount, &b2Profile::solve, 0.99f);
+		p99Profile.solveInit = ProfilePercentile(m_profileHistory, historyCount, &b2Profile::solveInit, 0.99f);
+		p99Profile.solveVelocity = ProfilePercentile(m_profileHistory, historyCount, &b2Profile::solveVelocity, 0.99f);
+		p99Profile.solvePosition = ProfilePercentile(m_profileHistory, historyCount, &b2Profile::solvePosition, 0.99f);
+		p99Profile.solveTOI = ProfilePercentile(m_profileHistory, historyCount, &b2Profile::solveTOI, 0.99f);
+		p99Profile.broadphase = ProfilePercentile(m_profileHistory, historyCount, &b2Profile::broadphase, 0.99f);
+
+		g_debugDraw.DrawString(5, m_textLine, "step [ave] (max) {p99} = %5.2f [%6.2f] (%6.2f) {%6.2f}", p.step, aveProfile.step, m_maxProfile.step, p99Profile.step);
 		m_textLine += DRAW_STRING_NEW_LINE;
-		g_debugDraw.DrawString(5, m_textLine, "collide [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.collide, aveProfile.collide, m_maxProfile.collide);
+		g_debugDraw.DrawString(5, m_textLine, "collide [ave] (max) {p99} = %5.2f [%6.2f] (%6.2f) {%6.2f}", p.collide, aveProfile.collide, m_maxProfile.collide, p99Profile.collide);
 		m_textLine += DRAW_STRING_NEW_LINE;
-		g_debugDraw.DrawString(5, m_textLine, "solve [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.solve, aveProfile.solve, m_maxProfile.solve);
+		g_debugDraw.DrawString(5, m_textLine, "solve [ave] (max) {p99} = %5.2f [%6.2f] (%6.2f) {%6.2f}", p.solve, aveProfile.solve, m_maxProfile.solve, p99Profile.solve);
 		m_textLine += DRAW_STRING_NEW_LINE;
-		g_debugDraw.DrawString(5, m_textLine, "solve init [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.solveInit, aveProfile.solveInit, m_maxProfile.solveInit);
+		g_debugDraw.DrawString(5, m_textLine, "solve init [ave] (max) {p99} = %5.2f [%6.2f] (%6.2f) {%6.2f}", p.solveInit, aveProfile.solveInit, m_maxProfile.solveInit, p99Profile.solveInit);
 		m_textLine += DRAW_STRING_NEW_LINE;
-		g_debugDraw.DrawString(5, m_textLine, "solve velocity [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.solveVelocity, aveProfile.solveVelocity, m_maxProfile.solveVelocity);
+		g_debugDraw.DrawString(5, m_textLine, "solve velocity [ave] (max) {p99} = %5.2f [%6.2f] (%6.2f) {%6.2f}", p.solveVelocity, aveProfile.solveVelocity, m_maxProfile.solveVelocity, p99Profile.solveVelocity);
 		m_textLine += DRAW_STRING_NEW_LINE;
-		g_debugDraw.DrawString(5, m_textLine, "solve position [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.solvePosition, aveProfile.solvePosition, m_maxProfile.solvePosition);
+		g_debugDraw.DrawString(5, m_textLine, "solve position [ave] (max) {p99} = %5.2f [%6.2f] (%6.2f) {%6.2f}", p.solvePosition, aveProfile.solvePosition, m_maxProfile.solvePosition, p99Profile.solvePosition);
 		m_textLine += DRAW_STRING_NEW_LINE;
-		g_debugDraw.DrawString(5, m_textLine, "solveTOI [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.solveTOI, aveProfile.solveTOI, m_maxProfile.solveTOI);
+		g_debugDraw.DrawString(5, m_textLine, "solveTOI [ave] (max) {p99} = %5.2f [%6.2f] (%6.2f) {%6.2f}", p.solveTOI, aveProfile.solveTOI, m_maxProfile.solveTOI, p99Profile.solveTOI);
 		m_textLine += DRAW_STRING_NEW_LINE;
-		g_debugDraw.DrawString(5, m_textLine, "broad-phase [ave] (max) = %5.2f [%6.2f] (%6.2f)", p.broadphase, aveProfile.broadphase, m_maxProfile.broadphase);
+		g_debugDraw.DrawString(5, m_textLine, "broad-phase [ave] (max) {p99} = %5.2f [%6.2f] (%6.2f) {%6.2f}", p.broadphase, aveProfile.broadphase, m_maxProfile.broadphase, p99Profile.broadphase);
 		m_textLine += DRAW_STRING_NEW_LINE;
+
+		{
+			char buffer[256];
+			int32 length = snprintf(buffer, sizeof(buffer), "worker busy %%:");
+			for (int32 i = 0; i < g_jobSystem.GetWorkerCount() && length < (int32)sizeof(buffer); ++i)
+			{
+				const JobWorkerStats& stats = g_jobSystem.GetStats(i);
+				length += snprintf(buffer + length, sizeof(buffer) - length, " %d", (int32)(100.0f * stats.utilization + 0.5f));
+			}
+			g_debugDraw.DrawString(5, m_textLine, "%s", buffer);
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+
+		if (m_parallelToiActive)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "approximate TOI candidates/events/rounds = %d/%d/%d, %.3f ms",
+				m_parallelToi.GetCandidateCount(), m_parallelToi.GetEventCount(), m_parallelToi.GetRoundCount(),
+				m_parallelToi.GetTime());
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
 	}
 
 	if (m_mouseJoint)
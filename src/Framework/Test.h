@@ -1,6 +1,10 @@
 #pragma once
 #include "Box2D\Box2D.h"
+#include "CollisionCounters.h"
 #include "DebugDraw.h"
+#include "JobSystem.h"
+#include "ParallelToi.h"
+#include "WorldTeardown.h"
 #include "Input\Input.h"
 
 class Test;
@@ -11,10 +15,20 @@ typedef Test* TestCreateFcn();
 #define	RAND_LIMIT	32767
 #define DRAW_STRING_NEW_LINE 16
 
+/// Seeds the generator behind RandomInt and RandomFloat. Test's constructor
+/// seeds it with k_randomSeed, so a scene is built and run the same way no
+/// matter what ran before it. Main thread only.
+void SetRandomSeed(uint32 seed);
+
+/// Random integer in range [0, RAND_LIMIT]
+int32 RandomInt();
+
+const uint32 k_randomSeed = 1;
+
 /// Random number in range [-1,1]
 inline float32 RandomFloat()
 {
-	float32 r = (float32)(rand() & (RAND_LIMIT));
+	float32 r = (float32)RandomInt();
 	r /= RAND_LIMIT;
 	r = 2.0f * r - 1.0f;
 	return r;
@@ -23,7 +37,7 @@ inline float32 RandomFloat()
 /// Random floating point number in range [lo, hi]
 inline float32 RandomFloat(float32 lo, float32 hi)
 {
-	float32 r = (float32)(rand() & (RAND_LIMIT));
+	float32 r = (float32)RandomInt();
 	r /= RAND_LIMIT;
 	r = (hi - lo) * r + lo;
 	return r;
@@ -37,6 +51,7 @@ struct Settings
 		hz = 60.0f;
 		velocityIterations = 8;
 		positionIterations = 3;
+		workerCount = JobSystem::GetDefaultWorkerCount();
 		drawShapes = true;
 		drawJoints = true;
 		drawAABBs = false;
@@ -51,6 +66,11 @@ struct Settings
 		enableContinuous = true;
 		enableSubStepping = false;
 		enableSleep = true;
+		enableParallelTOI = false;
+		labSolver = 0;
+		labBroadPhase = 0;
+		labRewind = 0;
+		worldTeardown = e_teardownInline;
 		pause = false;
 		singleStep = false;
 	}
@@ -58,6 +78,7 @@ struct Settings
 	float32 hz;
 	int32 velocityIterations;
 	int32 positionIterations;
+	int32 workerCount;
 	bool drawShapes;
 	bool drawJoints;
 	bool drawAABBs;
@@ -72,6 +93,11 @@ struct Settings
 	bool enableContinuous;
 	bool enableSubStepping;
 	bool enableSleep;
+	bool enableParallelTOI;
+	int32 labSolver; // LabWorld::SolverType, used by LabTest scenes
+	int32 labBroadPhase; // LabBroadPhase::Type, taken when a LabTest scene starts
+	int32 labRewind; // steps back through a LabTest scene's saved states, 0 = live
+	int32 worldTeardown; // WorldTeardown, taken every step and used when the test is deleted
 	bool pause;
 	bool singleStep;
 };
@@ -83,6 +109,26 @@ struct TestEntry
 };
 
 extern TestEntry g_testEntries[];
+
+/// The entry of g_testEntries with this name, or NULL.
+const TestEntry* FindTestEntry(const char* name);
+
+/// Copy of settings for a run without a window: never paused or single
+/// stepping, not rewinding a lab scene, and drawing nothing.
+Settings MakeHeadlessSettings(const Settings& settings);
+
+/// Turns g_debugDraw off for a run without a window, and back to how it
+/// was when the scope ends.
+class HeadlessDrawScope
+{
+public:
+	HeadlessDrawScope() : m_enabled(g_debugDraw.IsEnabled()) { g_debugDraw.SetEnabled(false); }
+	~HeadlessDrawScope() { g_debugDraw.SetEnabled(m_enabled); }
+
+private:
+	bool m_enabled;
+};
+
 // This is called when a joint in the world is implicitly destroyed
 // because an attached body is destroyed. This gives us a chance to
 // nullify the mouse joint.
@@ -96,6 +142,7 @@ public:
 };
 
 const int32 k_maxContactPoints = 2048;
+const int32 k_profileHistory = 300;
 
 struct ContactPoint
 {
@@ -145,11 +192,40 @@ public:
 
 	void ShiftOrigin(const b2Vec2& newOrigin);
 
+	// Checksum of the simulated bodies after the last call to Step.
+	uint32 GetChecksum() const { return m_checksum; }
+	int32 GetStepCount() const { return m_stepCount; }
+
+	// Profile of the last step that advanced the world.
+	const b2Profile& GetLastProfile() const { return m_profileHistory[(m_profileCount + k_profileHistory - 1) % k_profileHistory]; }
+
+	b2World* GetWorld() const { return m_world; }
+
+	// The approximate TOI pass, run while Settings::enableParallelTOI is set.
+	const ParallelToi& GetParallelToi() const { return m_parallelToi; }
+
+	// Bodies and contacts of whatever StepWorld simulates.
+	virtual int32 GetBodyCount() const { return m_world->GetBodyCount(); }
+	virtual int32 GetContactCount() const { return m_world->GetContactCount(); }
+
+	// How the destructor gets rid of m_world. In the notify mode the
+	// listener's JointDestroyed calls reach Test's, not the derived test's,
+	// which is gone by then.
+	void SetWorldTeardown(WorldTeardown mode) { m_worldTeardown = mode; }
+
 protected:
 	friend class DestructionListener;
 	friend class BoundaryListener;
 	friend class ContactListener;
 
+	// Steps and draws the physics for one frame. The default steps
+	// m_world; tests that simulate something else override it and
+	// report their own profile.
+	virtual void StepWorld(Settings* settings, float32 timeStep, b2Profile* profile);
+
+	// Hashes the state of whatever StepWorld simulates; see WorldChecksum.
+	virtual uint32 ComputeChecksum() const;
+
 	b2Body* m_groundBody;
 	b2AABB m_worldAABB;
 	ContactPoint m_points[k_maxContactPoints];
@@ -163,7 +239,19 @@ protected:
 	bool m_bombSpawning;
 	b2Vec2 m_mouseWorld;
 	int32 m_stepCount;
+	uint32 m_checksum;
+	WorldTeardown m_worldTeardown;
 
 	b2Profile m_maxProfile;
 	b2Profile m_totalProfile;
+	b2Profile m_profileHistory[k_profileHistory];
+	int32 m_profileCount;
+
+	ParallelToi m_parallelToi;
+	bool m_parallelToiActive;
+
+	// GJK/TOI work of the last step and since the test started (or a
+	// derived test reset it).
+	CollisionCounters m_stepCounters;
+	CollisionCounters m_totalCounters;
 };
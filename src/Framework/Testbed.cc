@@ -4,9 +4,21 @@
 #include "Core/Time/Clock.h"
 #include "IMUI/IMUI.h"
 #include "imgui.h"
+#include <cstdio>
 
 #include "Test.h"
 #include "DebugDraw.h"
+#include "DeterminismCheck.h"
+#include "InputRecording.h"
+#include "LabTest.h"
+#include "LabWorld.h"
+#include "Replication.h"
+#include "SceneReports.h"
+#include "ShardCoordinator.h"
+#include "ShardWorker.h"
+#include "Trajectory.h"
+#include "WorldTeardown.h"
+#include "WorldFile.h"
 
 using namespace Oryol;
 
@@ -19,21 +31,174 @@ public:
 private:
 	void Simulate();
 	void Interface();
+	int32 BeginHeadless(const char* countOption, int32 defaultCount);
 	void Restart();
+	void StartReplay();
+	void PlayTrajectory();
+	void RecordMouse(InputRecording::EventType type, const b2Vec2& p);
+	void RecordKey(InputRecording::EventType type, int32 key);
 
 	bool showMenu = true;
+	bool headless = false;
+	bool recordingInput = false;
 	int32 testIndex = 0;
 	int32 testSelection = 0;
 	int32 testCount = 0;
 	TestEntry* entry;
 	Test* test;
 	Settings settings;
+	InputRecording inputRecording;
+	InputPlayer inputPlayer;
+	TrajectoryWriter trajectoryWriter;
+	TrajectoryReader trajectoryReader;
 
 	TimePoint lastTimePoint;
 };
 OryolMain(Testbed);
 
 AppState::Code Testbed::OnInit() {
+	// Before any mode starts the job system, headless ones included.
+	if (OryolArgs.HasArg("-workers"))
+	{
+		settings.workerCount = OryolArgs.GetInt("-workers");
+	}
+	settings.workerCount = b2Clamp(settings.workerCount, 1, (int32)JobSystem::e_maxWorkers);
+
+	if (OryolArgs.HasArg(k_shardWorkerOption))
+	{
+		// A shard worker started by ShardCoordinator: serves the socket it
+		// was given until the coordinator quits.
+		headless = true;
+		test = NULL;
+		{
+			ShardWorker worker(OryolArgs.GetInt(k_shardWorkerOption));
+			worker.Run();
+		}
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg(k_replicationViewerOption))
+	{
+		// A replication viewer started by ReplicationViewer: decodes the
+		// stream on the socket it was given until the link closes.
+		headless = true;
+		test = NULL;
+		RunReplicationViewer(OryolArgs.GetInt(k_replicationViewerOption));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-shardreport"))
+	{
+		// Headless: bytes and latency per step of the sharded scenes, then quit.
+		RunShardReport(settings, BeginHeadless("-steps", 600));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-checkdeterminism"))
+	{
+		// Headless: no window, one line per test on stdout, then quit.
+		RunDeterminismCheck(settings, BeginHeadless("-steps", 300));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-replicationreport"))
+	{
+		// Headless: bytes per step of the replication stream, then quit.
+		RunReplicationReport(settings, BeginHeadless("-steps", 600));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-labsolverreport"))
+	{
+		// Headless: solve time and stability of each lab solver, then quit.
+		RunLabSolverReport(settings, BeginHeadless("-steps", 900));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-toireport"))
+	{
+		// Headless: cost of the approximate parallel TOI pass, then quit.
+		RunToiReport(settings, BeginHeadless("-steps", 600));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-nearestreport"))
+	{
+		// Headless: per-query times of the snapshot's nearest and overlap
+		// queries against b2World::QueryAABB, then quit.
+		RunNearestQueryReport(settings, BeginHeadless("-steps", 300));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-worldfilereport"))
+	{
+		// Headless: world file load times against building the level the
+		// way b2World::Dump output does, then quit.
+		RunWorldFileReport(settings, BeginHeadless("-runs", 10));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-teardownreport"))
+	{
+		// Headless: how long deleting big tests takes, then quit.
+		RunTeardownReport(settings, BeginHeadless("-steps", 60));
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-writescenario"))
+	{
+		headless = true;
+		MakePyramidScenario(&inputRecording, settings);
+		inputRecording.Save(OryolArgs.GetString("-writescenario").AsCStr());
+		test = NULL;
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-replay") && OryolArgs.HasArg("-headless"))
+	{
+		// Headless: the replay's time per step on stdout, then quit.
+		int32 steps = BeginHeadless("-steps", 0);
+		if (inputRecording.Load(OryolArgs.GetString("-replay").AsCStr()) == false)
+		{
+			printf("could not load %s\n", OryolArgs.GetString("-replay").AsCStr());
+			return AppState::Cleanup;
+		}
+		RunInputReplay(inputRecording, settings, steps, 120);
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-recordtrajectory"))
+	{
+		// Headless: records -test for -steps steps and reports the file size.
+		int32 steps = BeginHeadless("-steps", 3600);
+		const TestEntry* recordEntry = g_testEntries;
+		if (OryolArgs.HasArg("-test"))
+			recordEntry = FindTestEntry(OryolArgs.GetString("-test").AsCStr());
+		if (recordEntry == NULL)
+		{
+			printf("no test named %s\n", OryolArgs.GetString("-test").AsCStr());
+			return AppState::Cleanup;
+		}
+		RunTrajectoryRecording(recordEntry, settings, steps, OryolArgs.GetString("-recordtrajectory").AsCStr());
+		return AppState::Cleanup;
+	}
+
+	if (OryolArgs.HasArg("-playtrajectory") && OryolArgs.HasArg("-headless"))
+	{
+		// Headless: decodes every frame, optionally to -csv, and reports the rate.
+		headless = true;
+		test = NULL;
+		const char* csvPath = NULL;
+		String csv;
+		if (OryolArgs.HasArg("-csv"))
+		{
+			csv = OryolArgs.GetString("-csv");
+			csvPath = csv.AsCStr();
+		}
+		RunTrajectoryExport(OryolArgs.GetString("-playtrajectory").AsCStr(), csvPath);
+		return AppState::Cleanup;
+	}
+
 	Gfx::Setup(GfxSetup::Window(1024, 640, "Box2D Testbed"));
 	Input::Setup();
 	IMUI::Setup();
@@ -43,6 +208,8 @@ AppState::Code Testbed::OnInit() {
 	g_camera.Setup(cam);
 	g_debugDraw.Setup(Gfx::GfxSetup());
 
+	g_jobSystem.Setup(settings.workerCount);
+
 	testCount = 0;
 	while (g_testEntries[testCount].createFcn != NULL)
 	{
@@ -54,6 +221,17 @@ AppState::Code Testbed::OnInit() {
 
 	entry = g_testEntries + testIndex;
 	test = entry->createFcn();
+
+	if (OryolArgs.HasArg("-replay") && inputRecording.Load(OryolArgs.GetString("-replay").AsCStr()))
+	{
+		StartReplay();
+	}
+
+	if (OryolArgs.HasArg("-playtrajectory"))
+	{
+		trajectoryReader.Open(OryolArgs.GetString("-playtrajectory").AsCStr());
+	}
+
 	Gfx::Subscribe([&](const GfxEvent & e) {
 		//Handle resize events
 		if (e.Type == GfxEvent::DisplayModified) {
@@ -120,6 +298,7 @@ AppState::Code Testbed::OnInit() {
 					Restart();
 					break;
 				case Key::Space:
+					RecordKey(InputRecording::e_launchBomb, 0);
 					if (test) test->LaunchBomb();
 					break;
 				case Key::O:
@@ -148,23 +327,28 @@ AppState::Code Testbed::OnInit() {
 					}
 					break;
 				default:
+					RecordKey(InputRecording::e_keyDown, e.KeyCode);
 					if(test) test->Keyboard(e.KeyCode);
 					break;
 				}	
 			}
 			break;
 		case InputEvent::KeyUp:
-			if (!ImGui::GetIO().WantCaptureKeyboard)
+			if (!ImGui::GetIO().WantCaptureKeyboard) {
+				RecordKey(InputRecording::e_keyUp, e.KeyCode);
 				test->KeyboardUp(e.KeyCode);
+			}
 			break;
 		case InputEvent::MouseButtonDown:
 		{
 			auto pos = Input::MousePosition();
 			auto pw = g_camera.ConvertScreenToWorld({ pos.x,g_camera.GetHeight() - pos.y });
 			if (Input::KeyPressed(Key::LeftShift)) {
+				RecordMouse(InputRecording::e_shiftMouseDown, { pw.x,pw.y });
 				test->ShiftMouseDown({ pw.x,pw.y });
 			}
 			else {
+				RecordMouse(InputRecording::e_mouseDown, { pw.x,pw.y });
 				test->MouseDown({ pw.x,pw.y });
 			}
 			break;
@@ -173,6 +357,7 @@ AppState::Code Testbed::OnInit() {
 			if (e.Button == MouseButton::Left && test) {
 				auto pos = Input::MousePosition();
 				auto pw = g_camera.ConvertScreenToWorld({ pos.x,g_camera.GetHeight() - pos.y });
+				RecordMouse(InputRecording::e_mouseUp, { pw.x,pw.y });
 				test->MouseUp({ pw.x,pw.y });
 			}
 			break;
@@ -190,7 +375,10 @@ AppState::Code Testbed::OnInit() {
 		{
 			auto ps = Input::MousePosition();
 			auto pw = g_camera.ConvertScreenToWorld({ ps.x, g_camera.GetHeight()-ps.y });
-			if (test) test->MouseMove({ pw.x,pw.y });
+			if (test) {
+				RecordMouse(InputRecording::e_mouseMove, { pw.x,pw.y });
+				test->MouseMove({ pw.x,pw.y });
+			}
 
 			if (Input::MouseButtonPressed(MouseButton::Right)) {
 				auto movement = e.Movement;
@@ -225,6 +413,12 @@ AppState::Code Testbed::OnRunning() {
 
 AppState::Code Testbed::OnCleanup() {
 	delete test;
+	FlushWorldTeardowns();
+	g_jobSystem.Discard();
+	if (headless)
+	{
+		return App::OnCleanup();
+	}
 	g_debugDraw.Discard();
 	IMUI::Discard();
 	Input::Discard();
@@ -263,13 +457,40 @@ void Testbed::Simulate() {
 	g_camera.Zoom /= 1.1;
 	}
 	*/
-	
-	test->Step(&settings);
 
-	test->DrawTitle(entry->name);
+	if (trajectoryReader.IsOpen())
+	{
+		// Playback draws the file in place of the test, which is not stepped.
+		PlayTrajectory();
+	}
+	else
+	{
+		// Recordings store the stepping settings once, so while one is made
+		// or replayed, changes to them are undone, whether or not the menu
+		// is shown. Rewinding would step states that were never recorded.
+		if (recordingInput || inputPlayer.IsPlaying())
+		{
+			inputRecording.ApplySettings(&settings);
+			settings.labRewind = 0;
+		}
+
+		inputPlayer.Apply(test);
+		int32 stepCount = test->GetStepCount();
+		test->Step(&settings);
+		if (trajectoryWriter.IsRecording() && test->GetStepCount() != stepCount)
+			trajectoryWriter.Record(test->GetWorld());
+
+		test->DrawTitle(entry->name);
+	}
 
 	if (testSelection != testIndex)
 	{
+		// Recordings and replays belong to one test.
+		recordingInput = false;
+		inputPlayer.Stop();
+		trajectoryWriter.End();
+		trajectoryReader.Close();
+
 		testIndex = testSelection;
 		delete test;
 		entry = g_testEntries + testIndex;
@@ -280,12 +501,48 @@ void Testbed::Simulate() {
 	}
 }
 
+void Testbed::PlayTrajectory() {
+	if (!settings.pause || settings.singleStep) {
+		if (!trajectoryReader.Next())
+			trajectoryReader.Seek(0);
+		settings.singleStep = false;
+	}
+
+	g_debugDraw.SetFlags(b2Draw::e_shapeBit);
+	trajectoryReader.Draw(&g_debugDraw);
+
+	g_debugDraw.DrawString(5, DRAW_STRING_NEW_LINE, "Trajectory Playback");
+	g_debugDraw.DrawString(5, 3 * DRAW_STRING_NEW_LINE, "frame %d of %d, %d bodies, recorded at %.0f hz",
+		trajectoryReader.GetFrame() + 1, trajectoryReader.GetFrameCount(), trajectoryReader.GetBodyCount(), trajectoryReader.GetHz());
+
+	g_camera.Update();
+	g_debugDraw.Render(g_camera.BuildProjectionViewMatrix(0.0f));
+}
+
 static bool sTestEntriesGetName(void*, int idx, const char** out_name)
 {
 	*out_name = g_testEntries[idx].name;
 	return true;
 }
 
+static bool sLabSolverGetName(void*, int idx, const char** out_name)
+{
+	*out_name = LabWorld::GetSolverName((LabWorld::SolverType)idx);
+	return true;
+}
+
+static bool sWorldTeardownGetName(void*, int idx, const char** out_name)
+{
+	*out_name = GetWorldTeardownName((WorldTeardown)idx);
+	return true;
+}
+
+static bool sLabBroadPhaseGetName(void*, int idx, const char** out_name)
+{
+	*out_name = LabBroadPhase::GetName((LabBroadPhase::Type)idx);
+	return true;
+}
+
 void Testbed::Interface() {
 	int menuWidth = 200;
 	if (showMenu)
@@ -299,13 +556,8 @@ void Testbed::Interface() {
 
 		ImGui::Text("Test");
 		
-		if (ImGui::Combo("##Test", &testIndex, sTestEntriesGetName, NULL, testCount, testCount))
-		{
-			delete test;
-			entry = g_testEntries + testIndex;
-			test = entry->createFcn();
-			testSelection = testIndex;
-		}
+		// Simulate switches to the selection, with the same reset as the keys.
+		ImGui::Combo("##Test", &testSelection, sTestEntriesGetName, NULL, testCount, testCount);
 
 		ImGui::Separator();
 
@@ -315,13 +567,32 @@ void Testbed::Interface() {
 		ImGui::SliderInt("##Pos Iters", &settings.positionIterations, 0, 50);
 		ImGui::Text("Hertz");
 		ImGui::SliderFloat("##Hertz", &settings.hz, 5.0f, 120.0f, "%.0f hz");
+		ImGui::Text("Workers");
+		if (ImGui::SliderInt("##Workers", &settings.workerCount, 1, JobSystem::e_maxWorkers))
+		{
+			g_jobSystem.Setup(settings.workerCount);
+		}
+		ImGui::Text("World Teardown");
+		ImGui::Combo("##World Teardown", &settings.worldTeardown, sWorldTeardownGetName, NULL, e_teardownCount);
+		ImGui::Text("Lab Solver");
+		ImGui::Combo("##Lab Solver", &settings.labSolver, sLabSolverGetName, NULL, LabWorld::e_solverTypeCount);
+		ImGui::Text("Lab Broad-phase (restart)");
+		ImGui::Combo("##Lab Broad-phase", &settings.labBroadPhase, sLabBroadPhaseGetName, NULL, LabBroadPhase::e_typeCount);
+		ImGui::Text("Lab Rewind");
+		ImGui::SliderInt("##Lab Rewind", &settings.labRewind, 0, LabStateRing::e_defaultCapacity - 1);
 		ImGui::PopItemWidth();
 
 		ImGui::Checkbox("Sleep", &settings.enableSleep);
 		ImGui::Checkbox("Warm Starting", &settings.enableWarmStarting);
 		ImGui::Checkbox("Time of Impact", &settings.enableContinuous);
+		ImGui::Checkbox("Parallel TOI (approximate)", &settings.enableParallelTOI);
 		ImGui::Checkbox("Sub-Stepping", &settings.enableSubStepping);
 
+		if (recordingInput || inputPlayer.IsPlaying())
+		{
+			ImGui::Text("Stepping settings locked");
+		}
+
 		ImGui::Separator();
 
 		ImGui::Checkbox("Shapes", &settings.drawShapes);
@@ -345,6 +616,52 @@ void Testbed::Interface() {
 		if (ImGui::Button("Restart (R)", button_sz))
 			Restart();
 
+		if (ImGui::Button(recordingInput ? "Stop Recording" : "Record Input", button_sz)) {
+			if (recordingInput) {
+				inputRecording.Save(k_inputRecordingPath);
+				recordingInput = false;
+			}
+			else {
+				// From a fresh instance, so the replay starts where the recording did.
+				recordingInput = true;
+				inputPlayer.Stop();
+				Restart();
+			}
+		}
+
+		if (ImGui::Button(inputPlayer.IsPlaying() ? "Stop Replay" : "Replay Input", button_sz)) {
+			if (inputPlayer.IsPlaying())
+				inputPlayer.Stop();
+			else if (inputRecording.Load(k_inputRecordingPath))
+				StartReplay();
+		}
+
+		if (ImGui::Button(trajectoryWriter.IsRecording() ? "Stop Trajectory" : "Record Trajectory", button_sz)) {
+			if (trajectoryWriter.IsRecording())
+				trajectoryWriter.End();
+			else
+				trajectoryWriter.Begin(k_trajectoryPath, test->GetWorld(), settings.hz);
+		}
+
+		if (ImGui::Button(trajectoryReader.IsOpen() ? "Stop Playback" : "Play Trajectory", button_sz)) {
+			if (trajectoryReader.IsOpen()) {
+				trajectoryReader.Close();
+			}
+			else {
+				trajectoryWriter.End();
+				trajectoryReader.Open(k_trajectoryPath);
+			}
+		}
+
+		if (trajectoryReader.IsOpen() && trajectoryReader.GetFrameCount() > 0) {
+			int frame = b2Max(trajectoryReader.GetFrame(), 0);
+			if (ImGui::SliderInt("##Trajectory Frame", &frame, 0, trajectoryReader.GetFrameCount() - 1))
+				trajectoryReader.Seek(frame);
+		}
+
+		if (ImGui::Button("Save World", button_sz))
+			SaveWorldFile(test->GetWorld(), k_worldFilePath);
+
 		if (ImGui::Button("Quit", button_sz))
 			requestQuit();
 
@@ -352,8 +669,46 @@ void Testbed::Interface() {
 		ImGui::End();
 	}
 }
+// Sets up what a run without a window needs and returns the step or run
+// count given by countOption.
+int32 Testbed::BeginHeadless(const char* countOption, int32 defaultCount) {
+	headless = true;
+	test = NULL;
+	g_camera.Setup(CameraSetup(1024, 640));
+	g_jobSystem.Setup(settings.workerCount);
+	return OryolArgs.HasArg(countOption) ? OryolArgs.GetInt(countOption) : defaultCount;
+}
+
 void Testbed::Restart() {
 	delete test;
 	entry = g_testEntries + testIndex;
 	test = entry->createFcn();
+
+	// Both start over with the test; a trajectory cannot, as the bodies change.
+	trajectoryWriter.End();
+	if (recordingInput)
+		inputRecording.Begin(entry->name, settings);
+	if (inputPlayer.IsPlaying())
+		inputPlayer.Begin(&inputRecording);
+}
+
+void Testbed::StartReplay() {
+	const TestEntry* replayEntry = FindTestEntry(inputRecording.GetTestName());
+	if (replayEntry == NULL)
+		return;
+	recordingInput = false;
+	inputRecording.ApplySettings(&settings);
+	testIndex = testSelection = (int32)(replayEntry - g_testEntries);
+	inputPlayer.Begin(&inputRecording);
+	Restart();
+}
+
+void Testbed::RecordMouse(InputRecording::EventType type, const b2Vec2& p) {
+	if (recordingInput && test)
+		inputRecording.AddMouse(test->GetStepCount(), type, p);
+}
+
+void Testbed::RecordKey(InputRecording::EventType type, int32 key) {
+	if (recordingInput && test)
+		inputRecording.AddKey(test->GetStepCount(), type, key);
 }
\ No newline at end of file
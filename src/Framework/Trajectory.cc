@@ -0,0 +1,717 @@
+#include "Trajectory.h"
+#include "Test.h"
+#include "WorldFile.h"
+#include <algorithm>
+#include <cstring>
+
+// "B2TR" and "B2TI"
+static const uint32 k_trajectoryMagic = 0x52543242;
+static const uint32 k_trajectoryIndexMagic = 0x49543242;
+static const uint32 k_trajectoryVersion = 1;
+
+// Half a millimetre and a hundredth of a degree or so, finer than a pixel
+// at any testbed zoom.
+static const float32 k_positionQuantum = 1.0f / 2048.0f;
+static const float32 k_angleQuantum = 1.0f / 8192.0f;
+
+// The top bit of a frame's size word marks keyframes.
+static const uint32 k_keyframeBit = 0x80000000;
+
+// Files stay under 4 GB so offsets fit in 32 bits.
+static const uint32 k_maxTrajectoryBytes = 0xF0000000;
+
+struct TrajectoryHeader
+{
+	uint32 magic;
+	uint32 version;
+	float32 hz;
+	float32 positionQuantum;
+	float32 angleQuantum;
+	int32 bodyCount;
+	int32 keyframeInterval;
+	int32 worldByteCount;
+};
+
+// Follows the keyframe offsets at the end of a closed file.
+struct TrajectoryTrailer
+{
+	uint32 indexOffset;
+	int32 keyframeCount;
+	int32 frameCount;
+	uint32 magic;
+};
+
+static int32 Quantize(float32 value, float32 quantum)
+{
+	float32 q = b2Clamp(value / quantum, -1.0e9f, 1.0e9f);
+	return (int32)floorf(q + 0.5f);
+}
+
+static void WriteVarint(std::vector<uint8>* buffer, uint32 value)
+{
+	while (value >= 0x80)
+	{
+		buffer->push_back((uint8)(value | 0x80));
+		value >>= 7;
+	}
+	buffer->push_back((uint8)value);
+}
+
+static bool ReadVarint(const uint8** p, const uint8* end, uint32* value)
+{
+	uint32 result = 0;
+	for (int32 shift = 0; shift < 35; shift += 7)
+	{
+		if (*p == end)
+		{
+			return false;
+		}
+		uint8 byte = *(*p)++;
+		result |= (uint32)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+		{
+			*value = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Small deltas of either sign take one byte.
+static uint32 ZigZag(int32 value)
+{
+	return ((uint32)value << 1) ^ (uint32)(value >> 31);
+}
+
+static int32 UnZigZag(uint32 value)
+{
+	return (int32)(value >> 1) ^ -(int32)(value & 1);
+}
+
+// Keyframes are the integers in full. Deltas are the number of bodies that
+// moved, then for each the gap in index from the previous one and the
+// three zigzag differences.
+static void EncodeFrame(std::vector<uint8>* buffer, const std::vector<int32>& state, const std::vector<int32>& next, bool keyframe)
+{
+	buffer->resize(0);
+
+	if (keyframe)
+	{
+		buffer->resize(next.size() * sizeof(int32));
+		memcpy(buffer->data(), next.data(), buffer->size());
+		return;
+	}
+
+	int32 bodyCount = (int32)next.size() / 3;
+	uint32 changedCount = 0;
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		const int32* a = &state[3 * i];
+		const int32* b = &next[3 * i];
+		changedCount += (a[0] != b[0] || a[1] != b[1] || a[2] != b[2]) ? 1 : 0;
+	}
+
+	WriteVarint(buffer, changedCount);
+
+	int32 previous = -1;
+	for (int32 i = 0; i < bodyCount; ++i)
+	{
+		const int32* a = &state[3 * i];
+		const int32* b = &next[3 * i];
+		if (a[0] == b[0] && a[1] == b[1] && a[2] == b[2])
+		{
+			continue;
+		}
+
+		WriteVarint(buffer, (uint32)(i - previous - 1));
+		WriteVarint(buffer, ZigZag(b[0] - a[0]));
+		WriteVarint(buffer, ZigZag(b[1] - a[1]));
+		WriteVarint(buffer, ZigZag(b[2] - a[2]));
+		previous = i;
+	}
+}
+
+// Applies a frame to the integers. changed, when given, collects the
+// bodies the frame moved; keyframes move all of them.
+static bool DecodeFrameData(const uint8* data, uint32 size, bool keyframe, std::vector<int32>* state, std::vector<int32>* changed)
+{
+	int32 bodyCount = (int32)state->size() / 3;
+
+	// Keyframe data is not aligned in the file, so it is copied, not cast.
+	if (keyframe)
+	{
+		if (size != state->size() * sizeof(int32))
+		{
+			return false;
+		}
+		memcpy(state->data(), data, size);
+		if (changed != NULL)
+		{
+			changed->resize(bodyCount);
+			for (int32 i = 0; i < bodyCount; ++i)
+			{
+				(*changed)[i] = i;
+			}
+		}
+		return true;
+	}
+
+	const uint8* p = data;
+	const uint8* end = data + size;
+
+	uint32 changedCount;
+	if (ReadVarint(&p, end, &changedCount) == false)
+	{
+		return false;
+	}
+
+	if (changed != NULL)
+	{
+		changed->resize(0);
+	}
+
+	int32 index = -1;
+	for (uint32 i = 0; i < changedCount; ++i)
+	{
+		uint32 gap, dx, dy, da;
+		if (ReadVarint(&p, end, &gap) == false || ReadVarint(&p, end, &dx) == false
+			|| ReadVarint(&p, end, &dy) == false || ReadVarint(&p, end, &da) == false)
+		{
+			return false;
+		}
+
+		index += (int32)gap + 1;
+		if (index >= bodyCount)
+		{
+			return false;
+		}
+
+		int32* s = &(*state)[3 * index];
+		s[0] += UnZigZag(dx);
+		s[1] += UnZigZag(dy);
+		s[2] += UnZigZag(da);
+
+		if (changed != NULL)
+		{
+			changed->push_back(index);
+		}
+	}
+
+	return p == end;
+}
+
+// Bodies in creation order, which is the order of a world file.
+static void GetBodies(b2World* world, std::vector<b2Body*>* bodies)
+{
+	bodies->resize(0);
+	for (b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+	{
+		bodies->push_back(body);
+	}
+	std::reverse(bodies->begin(), bodies->end());
+}
+
+TrajectoryWriter::TrajectoryWriter()
+{
+	m_file = NULL;
+	m_offset = 0;
+	m_frameByteCount = 0;
+	m_frameCount = 0;
+	m_keyframeInterval = e_defaultKeyframeInterval;
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+	End();
+}
+
+bool TrajectoryWriter::Begin(const char* path, b2World* world, float32 hz, int32 keyframeInterval)
+{
+	End();
+
+	std::vector<uint8> worldData;
+	WriteWorldData(world, &worldData);
+
+	m_file = fopen(path, "wb");
+	if (m_file == NULL)
+	{
+		return false;
+	}
+
+	GetBodies(world, &m_bodies);
+	m_state.resize(3 * m_bodies.size());
+	m_next.resize(3 * m_bodies.size());
+	m_keyframes.resize(0);
+	m_frameByteCount = 0;
+	m_frameCount = 0;
+	m_keyframeInterval = b2Max(keyframeInterval, 1);
+
+	TrajectoryHeader header;
+	header.magic = k_trajectoryMagic;
+	header.version = k_trajectoryVersion;
+	header.hz = hz;
+	header.positionQuantum = k_positionQuantum;
+	header.angleQuantum = k_angleQuantum;
+	header.bodyCount = (int32)m_bodies.size();
+	header.keyframeInterval = m_keyframeInterval;
+	header.worldByteCount = (int32)worldData.size();
+
+	fwrite(&header, sizeof(header), 1, m_file);
+	fwrite(worldData.data(), 1, worldData.size(), m_file);
+	m_offset = (uint32)(sizeof(header) + worldData.size());
+
+	return true;
+}
+
+bool TrajectoryWriter::Record(b2World* world)
+{
+	if (m_file == NULL)
+	{
+		return false;
+	}
+
+	if (world->GetBodyCount() != (int32)m_bodies.size() || m_offset > k_maxTrajectoryBytes)
+	{
+		End();
+		return false;
+	}
+
+	// Walked again each step so a destroyed body is never touched.
+	GetBodies(world, &m_bodies);
+	for (size_t i = 0; i < m_bodies.size(); ++i)
+	{
+		const b2Body* body = m_bodies[i];
+		m_next[3 * i + 0] = Quantize(body->GetPosition().x, k_positionQuantum);
+		m_next[3 * i + 1] = Quantize(body->GetPosition().y, k_positionQuantum);
+		m_next[3 * i + 2] = Quantize(body->GetAngle(), k_angleQuantum);
+	}
+
+	WriteFrame(m_frameCount % m_keyframeInterval == 0);
+	m_state.swap(m_next);
+	++m_frameCount;
+	return true;
+}
+
+void TrajectoryWriter::WriteFrame(bool keyframe)
+{
+	EncodeFrame(&m_buffer, m_state, m_next, keyframe);
+
+	if (keyframe)
+	{
+		m_keyframes.push_back(m_offset);
+	}
+
+	uint32 word = (uint32)m_buffer.size() | (keyframe ? k_keyframeBit : 0);
+	fwrite(&word, sizeof(word), 1, m_file);
+	fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+
+	uint32 byteCount = (uint32)(sizeof(word) + m_buffer.size());
+	m_offset += byteCount;
+	m_frameByteCount += byteCount;
+
+	if (keyframe)
+	{
+		fflush(m_file);
+	}
+}
+
+void TrajectoryWriter::End()
+{
+	if (m_file == NULL)
+	{
+		return;
+	}
+
+	TrajectoryTrailer trailer;
+	trailer.indexOffset = m_offset;
+	trailer.keyframeCount = (int32)m_keyframes.size();
+	trailer.frameCount = m_frameCount;
+	trailer.magic = k_trajectoryIndexMagic;
+
+	fwrite(m_keyframes.data(), sizeof(uint32), m_keyframes.size(), m_file);
+	fwrite(&trailer, sizeof(trailer), 1, m_file);
+	fclose(m_file);
+	m_file = NULL;
+}
+
+TrajectoryReader::TrajectoryReader()
+{
+	m_world = NULL;
+	m_framesOffset = 0;
+	m_framesEnd = 0;
+	m_offset = 0;
+	m_hz = 60.0f;
+	m_positionQuantum = k_positionQuantum;
+	m_angleQuantum = k_angleQuantum;
+	m_keyframeInterval = 1;
+	m_frameCount = 0;
+	m_frame = -1;
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+	Close();
+}
+
+void TrajectoryReader::Close()
+{
+	delete m_world;
+	m_world = NULL;
+	m_bodies.resize(0);
+	m_data.resize(0);
+	m_keyframes.resize(0);
+	m_frameCount = 0;
+	m_frame = -1;
+}
+
+bool TrajectoryReader::Open(const char* path)
+{
+	Close();
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	uint8 buffer[64 * 1024];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		m_data.insert(m_data.end(), buffer, buffer + count);
+	}
+	fclose(file);
+
+	TrajectoryHeader header;
+	if (m_data.size() < sizeof(header) || m_data.size() > k_maxTrajectoryBytes + (uint32)sizeof(TrajectoryTrailer))
+	{
+		m_data.resize(0);
+		return false;
+	}
+	memcpy(&header, m_data.data(), sizeof(header));
+
+	if (header.magic != k_trajectoryMagic || header.version != k_trajectoryVersion || header.keyframeInterval < 1
+		|| header.worldByteCount < 0 || sizeof(header) + header.worldByteCount > m_data.size())
+	{
+		m_data.resize(0);
+		return false;
+	}
+
+	m_world = new b2World(b2Vec2_zero);
+	if (LoadWorldData(m_world, m_data.data() + sizeof(header), header.worldByteCount) == false
+		|| m_world->GetBodyCount() != header.bodyCount)
+	{
+		Close();
+		return false;
+	}
+
+	GetBodies(m_world, &m_bodies);
+	m_state.resize(3 * m_bodies.size());
+	m_transforms.resize(m_bodies.size());
+	for (size_t i = 0; i < m_bodies.size(); ++i)
+	{
+		m_transforms[i] = m_bodies[i]->GetTransform();
+	}
+
+	m_hz = header.hz;
+	m_positionQuantum = header.positionQuantum;
+	m_angleQuantum = header.angleQuantum;
+	m_keyframeInterval = header.keyframeInterval;
+	m_framesOffset = (uint32)(sizeof(header) + header.worldByteCount);
+
+	if (IndexFrames() == false)
+	{
+		Close();
+		return false;
+	}
+
+	m_offset = m_framesOffset;
+	m_frame = -1;
+	return true;
+}
+
+bool TrajectoryReader::IndexFrames()
+{
+	uint32 size = (uint32)m_data.size();
+
+	TrajectoryTrailer trailer;
+	if (size >= m_framesOffset + sizeof(trailer))
+	{
+		memcpy(&trailer, m_data.data() + size - sizeof(trailer), sizeof(trailer));
+		uint32 indexBytes = (uint32)trailer.keyframeCount * sizeof(uint32);
+		bool closed = trailer.magic == k_trajectoryIndexMagic && trailer.keyframeCount >= 0 && trailer.frameCount >= 0
+			&& trailer.indexOffset >= m_framesOffset && trailer.indexOffset + indexBytes + sizeof(trailer) == size
+			&& trailer.keyframeCount == (trailer.frameCount + m_keyframeInterval - 1) / m_keyframeInterval;
+		if (closed)
+		{
+			m_keyframes.resize(trailer.keyframeCount);
+			memcpy(m_keyframes.data(), m_data.data() + trailer.indexOffset, indexBytes);
+			m_framesEnd = trailer.indexOffset;
+			m_frameCount = trailer.frameCount;
+			return true;
+		}
+	}
+
+	// Still being written, or cut short: walk the frames, up to the last
+	// whole one.
+	m_keyframes.resize(0);
+	m_frameCount = 0;
+	uint32 offset = m_framesOffset;
+	while (offset + sizeof(uint32) <= size)
+	{
+		uint32 word;
+		memcpy(&word, m_data.data() + offset, sizeof(word));
+		uint32 frameSize = word & ~k_keyframeBit;
+		bool keyframe = (word & k_keyframeBit) != 0;
+		if (frameSize > size - offset - sizeof(uint32) || keyframe != (m_frameCount % m_keyframeInterval == 0))
+		{
+			break;
+		}
+
+		if (keyframe)
+		{
+			m_keyframes.push_back(offset);
+		}
+		offset += (uint32)sizeof(uint32) + frameSize;
+		++m_frameCount;
+	}
+	m_framesEnd = offset;
+	return true;
+}
+
+bool TrajectoryReader::DecodeFrame()
+{
+	if (m_offset + sizeof(uint32) > m_framesEnd)
+	{
+		return false;
+	}
+
+	uint32 word;
+	memcpy(&word, m_data.data() + m_offset, sizeof(word));
+	uint32 frameSize = word & ~k_keyframeBit;
+	bool keyframe = (word & k_keyframeBit) != 0;
+	if (frameSize > m_framesEnd - m_offset - sizeof(uint32))
+	{
+		return false;
+	}
+
+	if (DecodeFrameData(m_data.data() + m_offset + sizeof(uint32), frameSize, keyframe, &m_state, &m_changed) == false)
+	{
+		return false;
+	}
+	m_offset += (uint32)sizeof(uint32) + frameSize;
+
+	for (size_t i = 0; i < m_changed.size(); ++i)
+	{
+		int32 index = m_changed[i];
+		const int32* s = &m_state[3 * index];
+		m_transforms[index].Set(b2Vec2(m_positionQuantum * s[0], m_positionQuantum * s[1]), m_angleQuantum * s[2]);
+	}
+
+	return true;
+}
+
+bool TrajectoryReader::Next()
+{
+	if (m_world == NULL || m_frame + 1 >= m_frameCount)
+	{
+		return false;
+	}
+
+	if (DecodeFrame() == false)
+	{
+		return false;
+	}
+
+	++m_frame;
+	return true;
+}
+
+bool TrajectoryReader::Seek(int32 frame)
+{
+	if (m_world == NULL || frame < 0 || frame >= m_frameCount)
+	{
+		return false;
+	}
+
+	// Decode on from here when the frame is later in the same keyframe run.
+	int32 keyframe = frame / m_keyframeInterval;
+	if (m_frame < 0 || frame < m_frame || m_frame / m_keyframeInterval != keyframe)
+	{
+		m_offset = m_keyframes[keyframe];
+		m_frame = keyframe * m_keyframeInterval - 1;
+	}
+
+	while (m_frame < frame)
+	{
+		if (Next() == false)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TrajectoryReader::Draw(b2Draw* draw) const
+{
+	for (size_t i = 0; i < m_bodies.size(); ++i)
+	{
+		const b2Body* b = m_bodies[i];
+		const b2Transform& xf = m_transforms[i];
+
+		b2Color color;
+		if (b->GetType() == b2_staticBody)
+		{
+			color = b2Color(0.5f, 0.9f, 0.5f);
+		}
+		else if (b->GetType() == b2_kinematicBody)
+		{
+			color = b2Color(0.5f, 0.5f, 0.9f);
+		}
+		else
+		{
+			color = b2Color(0.9f, 0.7f, 0.7f);
+		}
+
+		for (const b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+		{
+			switch (f->GetType())
+			{
+			case b2Shape::e_circle:
+				{
+					const b2CircleShape* circle = (const b2CircleShape*)f->GetShape();
+					b2Vec2 center = b2Mul(xf, circle->m_p);
+					b2Vec2 axis = b2Mul(xf.q, b2Vec2(1.0f, 0.0f));
+					draw->DrawSolidCircle(center, circle->m_radius, axis, color);
+				}
+				break;
+
+			case b2Shape::e_edge:
+				{
+					const b2EdgeShape* edge = (const b2EdgeShape*)f->GetShape();
+					draw->DrawSegment(b2Mul(xf, edge->m_vertex1), b2Mul(xf, edge->m_vertex2), color);
+				}
+				break;
+
+			case b2Shape::e_chain:
+				{
+					const b2ChainShape* chain = (const b2ChainShape*)f->GetShape();
+					b2Vec2 v1 = b2Mul(xf, chain->m_vertices[0]);
+					for (int32 j = 1; j < chain->m_count; ++j)
+					{
+						b2Vec2 v2 = b2Mul(xf, chain->m_vertices[j]);
+						draw->DrawSegment(v1, v2, color);
+						v1 = v2;
+					}
+				}
+				break;
+
+			case b2Shape::e_polygon:
+				{
+					const b2PolygonShape* poly = (const b2PolygonShape*)f->GetShape();
+					b2Vec2 vertices[b2_maxPolygonVertices];
+					for (int32 j = 0; j < poly->m_count; ++j)
+					{
+						vertices[j] = b2Mul(xf, poly->m_vertices[j]);
+					}
+					draw->DrawSolidPolygon(vertices, poly->m_count, color);
+				}
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+}
+
+bool RunTrajectoryExport(const char* path, const char* csvPath)
+{
+	TrajectoryReader reader;
+	if (reader.Open(path) == false)
+	{
+		printf("could not read %s\n", path);
+		return false;
+	}
+
+	b2Timer timer;
+	while (reader.Next())
+	{
+	}
+	float32 decodeTime = timer.GetMilliseconds();
+
+	int32 frameCount = reader.GetFrameCount();
+	int32 bodyCount = reader.GetBodyCount();
+	float32 realTime = reader.GetHz() > 0.0f ? 1000.0f * frameCount / reader.GetHz() : 0.0f;
+	printf("%s: %d frames of %d bodies, decoded in %.1f ms, %.0fx real time\n",
+		path, frameCount, bodyCount, decodeTime, decodeTime > 0.0f ? realTime / decodeTime : 0.0f);
+
+	if (csvPath != NULL)
+	{
+		FILE* file = fopen(csvPath, "w");
+		if (file == NULL)
+		{
+			printf("could not write %s\n", csvPath);
+			return false;
+		}
+
+		timer.Reset();
+		fprintf(file, "frame,body,x,y,angle\n");
+		reader.Seek(0);
+		do
+		{
+			for (int32 i = 0; i < bodyCount; ++i)
+			{
+				const b2Transform& xf = reader.GetTransform(i);
+				fprintf(file, "%d,%d,%.4f,%.4f,%.4f\n", reader.GetFrame(), i, xf.p.x, xf.p.y, xf.q.GetAngle());
+			}
+		}
+		while (reader.Next());
+		fclose(file);
+
+		printf("wrote %s in %.1f ms\n", csvPath, timer.GetMilliseconds());
+	}
+
+	fflush(stdout);
+	return true;
+}
+
+bool RunTrajectoryRecording(const TestEntry* entry, const Settings& settings, int32 stepCount, const char* path)
+{
+	HeadlessDrawScope drawScope;
+
+	Settings runSettings = MakeHeadlessSettings(settings);
+
+	Test* test = entry->createFcn();
+	TrajectoryWriter writer;
+	bool recorded = writer.Begin(path, test->GetWorld(), runSettings.hz);
+
+	int32 step = 0;
+	while (recorded && step < stepCount)
+	{
+		test->Step(&runSettings);
+		recorded = writer.Record(test->GetWorld());
+		step += recorded ? 1 : 0;
+	}
+
+	int32 bodyCount = writer.GetBodyCount();
+	int32 frameCount = writer.GetFrameCount();
+	uint32 frameBytes = writer.GetFrameByteCount();
+	writer.End();
+	delete test;
+
+	// Raw float32 x, y and angle are 12 bytes a body.
+	float32 rawBytes = 12.0f * bodyCount * frameCount;
+	printf("%s: %d frames of %d bodies to %s, %u kB of frames, %.2f bytes/body/frame, %.1fx smaller than raw\n",
+		entry->name, frameCount, bodyCount, path, frameBytes / 1024,
+		frameCount > 0 && bodyCount > 0 ? (float32)frameBytes / (bodyCount * frameCount) : 0.0f,
+		frameBytes > 0 ? rawBytes / frameBytes : 0.0f);
+	if (step < stepCount)
+	{
+		printf("stopped at step %d: the test added or removed bodies\n", step);
+	}
+	fflush(stdout);
+
+	return step == stepCount;
+}
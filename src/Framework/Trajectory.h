@@ -0,0 +1,130 @@
+#pragma once
+#include "Box2D/Box2D.h"
+#include <cstdio>
+#include <vector>
+
+struct Settings;
+struct TestEntry;
+
+// Trajectory files hold the bodies of a world, saved once as a world file
+// for their shapes, then one frame of body transforms per step. Positions
+// and angles are quantized to integers. Every keyframeInterval-th frame is
+// a keyframe with the integers in full; the frames between hold varint
+// deltas from the frame before, for the bodies that moved only, so
+// sleeping and static bodies cost nothing. Encoder and decoder agree on
+// the integers exactly, so deltas never drift.
+//
+// Frames are appended as they are recorded and flushed at every keyframe,
+// so the file can be read while the run goes on. Closing the writer adds
+// an index of keyframes. Seeking to a frame looks its keyframe up in the
+// index and decodes at most keyframeInterval - 1 deltas. Files that were
+// never closed are indexed by scanning them once when opened.
+//
+// The body set is fixed when recording begins. Recording stops at the
+// first step whose body count differs.
+class TrajectoryWriter
+{
+public:
+	enum
+	{
+		e_defaultKeyframeInterval = 60
+	};
+
+	TrajectoryWriter();
+	~TrajectoryWriter();
+
+	bool Begin(const char* path, b2World* world, float32 hz, int32 keyframeInterval = e_defaultKeyframeInterval);
+
+	// Appends the current transforms. Returns false, and ends the file, once
+	// the world has other bodies than when recording began.
+	bool Record(b2World* world);
+
+	// Writes the keyframe index and closes the file.
+	void End();
+
+	bool IsRecording() const { return m_file != NULL; }
+	int32 GetFrameCount() const { return m_frameCount; }
+	int32 GetBodyCount() const { return (int32)m_bodies.size(); }
+
+	// Bytes of frames so far, without the world and the index.
+	uint32 GetFrameByteCount() const { return m_frameByteCount; }
+
+private:
+	void WriteFrame(bool keyframe);
+
+	FILE* m_file;
+	std::vector<b2Body*> m_bodies;
+	std::vector<int32> m_state;
+	std::vector<int32> m_next;
+	std::vector<uint8> m_buffer;
+	std::vector<uint32> m_keyframes;
+	uint32 m_offset;
+	uint32 m_frameByteCount;
+	int32 m_frameCount;
+	int32 m_keyframeInterval;
+};
+
+// Decodes a trajectory file and draws its frames. The bodies are loaded
+// into a world of their own for their shapes; that world is never
+// stepped, and the transforms are drawn without being set on the bodies.
+class TrajectoryReader
+{
+public:
+	TrajectoryReader();
+	~TrajectoryReader();
+
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const { return m_world != NULL; }
+	int32 GetFrameCount() const { return m_frameCount; }
+	int32 GetBodyCount() const { return (int32)m_bodies.size(); }
+	float32 GetHz() const { return m_hz; }
+
+	// The frame last decoded, or -1 before the first.
+	int32 GetFrame() const { return m_frame; }
+
+	// Decodes the frame after the current one. False past the last frame.
+	bool Next();
+
+	// Decodes the given frame from the keyframe at or before it.
+	bool Seek(int32 frame);
+
+	const b2Transform& GetTransform(int32 index) const { return m_transforms[index]; }
+
+	void Draw(b2Draw* draw) const;
+
+private:
+	bool IndexFrames();
+	bool DecodeFrame();
+
+	std::vector<uint8> m_data;
+	b2World* m_world;
+	std::vector<b2Body*> m_bodies;
+	std::vector<int32> m_state;
+	std::vector<int32> m_changed;
+	std::vector<b2Transform> m_transforms;
+	std::vector<uint32> m_keyframes;
+	uint32 m_framesOffset;
+	uint32 m_framesEnd;
+	uint32 m_offset;
+	float32 m_hz;
+	float32 m_positionQuantum;
+	float32 m_angleQuantum;
+	int32 m_keyframeInterval;
+	int32 m_frameCount;
+	int32 m_frame;
+};
+
+// Where the testbed's trajectory buttons write and read.
+const char* const k_trajectoryPath = "testbed.traj";
+
+// Decodes every frame without drawing, then again writing them to csvPath
+// as "frame,body,x,y,angle" lines unless it is NULL, and reports the
+// decode rate against real time on stdout. Returns false if the file
+// could not be read.
+bool RunTrajectoryExport(const char* path, const char* csvPath);
+
+// Steps a fresh instance of the test stepCount times without a window,
+// recording it to path, and reports the file's size on stdout.
+bool RunTrajectoryRecording(const TestEntry* entry, const Settings& settings, int32 stepCount, const char* path);
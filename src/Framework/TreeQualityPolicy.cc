@@ -0,0 +1,159 @@
+#include "TreeQualityPolicy.h"
+#include "JobSystem.h"
+
+static float32 Smooth(float32 average, float32 sample)
+{
+	return average == 0.0f ? sample : 0.95f * average + 0.05f * sample;
+}
+
+TreeRebuildReport::TreeRebuildReport()
+{
+	rebuildCount = 0;
+	background = false;
+	complete = false;
+	areaRatioBefore = 0.0f;
+	areaRatioAfter = 0.0f;
+	heightBefore = 0;
+	heightAfter = 0;
+	queryTimeBefore = 0.0f;
+	queryTimeAfter = 0.0f;
+	updateTimeBefore = 0.0f;
+	updateTimeAfter = 0.0f;
+	buildTime = 0.0f;
+}
+
+TreeQualityPolicy::TreeQualityPolicy()
+{
+	m_reinsertBudget = 0.1f;
+	m_rebuildFactor = 1.5f;
+	m_backgroundRebuild = true;
+	m_rebuildRequested = false;
+
+	m_areaRatio = 0.0f;
+	m_baselineAreaRatio = 0.0f;
+	m_queryTime = 0.0f;
+	m_updateTime = 0.0f;
+	m_queryHits = 0;
+	m_reinsertCount = 0;
+	m_reinsertTime = 0.0f;
+
+	m_rebuilding = false;
+	m_stepsSinceRebuild = 0;
+}
+
+// Queries the fat AABBs of up to e_querySamples proxies spread over the
+// id range, so the cost tracks the tree rather than what moved this step.
+float32 TreeQualityPolicy::MeasureQueryTime(const WideTree* tree)
+{
+	int32 capacity = tree->GetProxyCapacity();
+	int32 stride = b2Max(capacity / e_querySamples, 1);
+
+	b2Timer timer;
+	m_queryHits = 0;
+	for (int32 proxyId = 0; proxyId < capacity; proxyId += stride)
+	{
+		if (tree->IsActive(proxyId))
+		{
+			tree->Query(this, tree->GetFatAABB(proxyId));
+		}
+	}
+	return timer.GetMilliseconds();
+}
+
+void TreeQualityPolicy::StartRebuild(WideTree* tree)
+{
+	m_rebuildRequested = false;
+	m_rebuilding = true;
+
+	m_report.background = m_backgroundRebuild && g_jobSystem.GetWorkerCount() > 1;
+	m_report.complete = false;
+	m_report.areaRatioBefore = m_areaRatio;
+	m_report.heightBefore = tree->GetHeight();
+	m_report.queryTimeBefore = m_queryTime;
+	m_report.updateTimeBefore = m_updateTime;
+
+	m_buildTimer.Reset();
+	if (m_report.background)
+	{
+		tree->BeginRebuild();
+	}
+	else
+	{
+		tree->Rebuild();
+		FinishRebuild(tree);
+	}
+}
+
+void TreeQualityPolicy::FinishRebuild(WideTree* tree)
+{
+	m_rebuilding = false;
+	m_report.buildTime = m_buildTimer.GetMilliseconds();
+	++m_report.rebuildCount;
+
+	m_areaRatio = tree->GetAreaRatio();
+	m_baselineAreaRatio = m_areaRatio;
+	m_report.areaRatioAfter = m_areaRatio;
+	m_report.heightAfter = tree->GetHeight();
+
+	// Start the averages over so the after side does not carry the before.
+	m_queryTime = 0.0f;
+	m_updateTime = 0.0f;
+	m_stepsSinceRebuild = 0;
+}
+
+void TreeQualityPolicy::Update(WideTree* tree, float32 updateTime)
+{
+	m_reinsertCount = 0;
+	m_reinsertTime = 0.0f;
+
+	if (m_rebuilding && tree->FinishRebuild(false))
+	{
+		FinishRebuild(tree);
+	}
+
+	m_queryTime = Smooth(m_queryTime, MeasureQueryTime(tree));
+	m_updateTime = Smooth(m_updateTime, updateTime);
+
+	if (m_report.rebuildCount > 0 && m_report.complete == false && m_rebuilding == false)
+	{
+		++m_stepsSinceRebuild;
+		m_report.queryTimeAfter = m_queryTime;
+		m_report.updateTimeAfter = m_updateTime;
+		m_report.complete = m_stepsSinceRebuild >= e_reportSteps;
+	}
+
+	if (m_rebuilding)
+	{
+		// The nodes are about to be replaced.
+		return;
+	}
+
+	// The baseline is the best ratio since the last rebuild, which
+	// reinsertion may have improved on.
+	m_areaRatio = tree->GetAreaRatio();
+	if (m_baselineAreaRatio == 0.0f || m_areaRatio < m_baselineAreaRatio)
+	{
+		m_baselineAreaRatio = m_areaRatio;
+	}
+
+	if (m_rebuildRequested || m_areaRatio > m_rebuildFactor * m_baselineAreaRatio)
+	{
+		StartRebuild(tree);
+		return;
+	}
+
+	if (m_reinsertBudget > 0.0f)
+	{
+		b2Timer timer;
+		while (timer.GetMilliseconds() < m_reinsertBudget)
+		{
+			int32 count = tree->Reinsert(e_reinsertChunk);
+			m_reinsertCount += count;
+			if (count < e_reinsertChunk || m_reinsertCount >= tree->GetProxyCount())
+			{
+				break;
+			}
+		}
+		m_reinsertTime = timer.GetMilliseconds();
+	}
+}
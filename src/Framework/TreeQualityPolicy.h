@@ -0,0 +1,104 @@
+#pragma once
+#include "WideTree.h"
+
+// Costs on both sides of the last full rebuild. The costs are smoothed
+// over the steps before the rebuild started and the steps after it was
+// swapped in; complete is set once the after side has settled.
+struct TreeRebuildReport
+{
+	TreeRebuildReport();
+
+	int32 rebuildCount;
+	bool background;
+	bool complete;
+
+	float32 areaRatioBefore;
+	float32 areaRatioAfter;
+	int32 heightBefore;
+	int32 heightAfter;
+
+	// Milliseconds for the sampled fat AABB queries.
+	float32 queryTimeBefore;
+	float32 queryTimeAfter;
+
+	// Milliseconds per step, as passed to TreeQualityPolicy::Update.
+	float32 updateTimeBefore;
+	float32 updateTimeAfter;
+
+	// Milliseconds from the start of the rebuild to the swap.
+	float32 buildTime;
+};
+
+// Keeps a WideTree in shape as proxies move. Every step it spends up to a
+// time budget reinserting proxies, and when the area ratio has grown past
+// a factor of what it was after the previous rebuild it rebuilds the tree
+// with the SAH builder, on g_jobSystem if asked to.
+class TreeQualityPolicy
+{
+public:
+	enum
+	{
+		e_querySamples = 256,
+		e_reinsertChunk = 16,
+		e_reportSteps = 60
+	};
+
+	TreeQualityPolicy();
+
+	// Milliseconds per step for reinsertion; zero turns it off.
+	void SetReinsertBudget(float32 milliseconds) { m_reinsertBudget = milliseconds; }
+	float32 GetReinsertBudget() const { return m_reinsertBudget; }
+
+	void SetRebuildFactor(float32 factor) { m_rebuildFactor = factor; }
+	float32 GetRebuildFactor() const { return m_rebuildFactor; }
+
+	// Background rebuilds need at least two workers; with one the rebuild
+	// runs in place.
+	void SetBackgroundRebuild(bool flag) { m_backgroundRebuild = flag; }
+	bool GetBackgroundRebuild() const { return m_backgroundRebuild; }
+
+	// Rebuilds on the next Update regardless of quality.
+	void RequestRebuild() { m_rebuildRequested = true; }
+
+	// Call once per step after the proxies have moved. updateTime is what
+	// the caller spent on moves and pair queries this step, in milliseconds.
+	void Update(WideTree* tree, float32 updateTime);
+
+	float32 GetAreaRatio() const { return m_areaRatio; }
+	float32 GetBaselineAreaRatio() const { return m_baselineAreaRatio; }
+	float32 GetQueryTime() const { return m_queryTime; }
+	int32 GetReinsertCount() const { return m_reinsertCount; }
+	float32 GetReinsertTime() const { return m_reinsertTime; }
+	bool IsRebuilding() const { return m_rebuilding; }
+	const TreeRebuildReport& GetReport() const { return m_report; }
+
+	bool QueryCallback(int32 proxyId)
+	{
+		B2_NOT_USED(proxyId);
+		++m_queryHits;
+		return true;
+	}
+
+private:
+	float32 MeasureQueryTime(const WideTree* tree);
+	void StartRebuild(WideTree* tree);
+	void FinishRebuild(WideTree* tree);
+
+	float32 m_reinsertBudget;
+	float32 m_rebuildFactor;
+	bool m_backgroundRebuild;
+	bool m_rebuildRequested;
+
+	float32 m_areaRatio;
+	float32 m_baselineAreaRatio;
+	float32 m_queryTime;
+	float32 m_updateTime;
+	int32 m_queryHits;
+	int32 m_reinsertCount;
+	float32 m_reinsertTime;
+
+	bool m_rebuilding;
+	b2Timer m_buildTimer;
+	int32 m_stepsSinceRebuild;
+	TreeRebuildReport m_report;
+};
@@ -0,0 +1,936 @@
+#include "WideTree.h"
+#include "JobSystem.h"
+#include <algorithm>
+
+// A rebuild in progress. The build reads only the copied bounds, so it can
+// run while the tree keeps changing.
+struct WideTreeBuild
+{
+	struct Entry
+	{
+		b2AABB aabb;
+		b2Vec2 center;
+		int32 proxyId;
+	};
+
+	enum
+	{
+		e_binCount = 16
+	};
+
+	// Snapshot, indexed by proxy id.
+	std::vector<b2AABB> aabbs;
+	std::vector<bool> active;
+
+	std::vector<Entry> entries;
+
+	// Result. The proxy locations are indexed by proxy id.
+	std::vector<WideTreeNode> nodes;
+	std::vector<int32> proxyNodes;
+	std::vector<int32> proxySlots;
+	int32 root;
+
+	JobCounter counter;
+};
+
+// Splits entries [begin, end) in two with a binned surface area heuristic
+// and returns the start of the second half.
+static int32 SplitEntries(WideTreeBuild* build, int32 begin, int32 end)
+{
+	const int32 binCount = WideTreeBuild::e_binCount;
+	WideTreeBuild::Entry* entries = &build->entries[0];
+
+	b2AABB centers;
+	centers.lowerBound = centers.upperBound = entries[begin].center;
+	for (int32 i = begin + 1; i < end; ++i)
+	{
+		centers.lowerBound = b2Min(centers.lowerBound, entries[i].center);
+		centers.upperBound = b2Max(centers.upperBound, entries[i].center);
+	}
+
+	b2Vec2 extent = centers.upperBound - centers.lowerBound;
+	int32 axis = extent.x >= extent.y ? 0 : 1;
+	float32 low = axis == 0 ? centers.lowerBound.x : centers.lowerBound.y;
+	float32 width = axis == 0 ? extent.x : extent.y;
+	if (width <= 0.0f)
+	{
+		// All centers coincide.
+		return begin + (end - begin) / 2;
+	}
+
+	float32 scale = binCount / width;
+	int32 binCounts[binCount] = {};
+	b2AABB binBounds[binCount];
+	for (int32 i = begin; i < end; ++i)
+	{
+		float32 c = axis == 0 ? entries[i].center.x : entries[i].center.y;
+		int32 bin = b2Min(int32((c - low) * scale), binCount - 1);
+		if (binCounts[bin] == 0)
+		{
+			binBounds[bin] = entries[i].aabb;
+		}
+		else
+		{
+			binBounds[bin].Combine(entries[i].aabb);
+		}
+		++binCounts[bin];
+	}
+
+	// Sweep from the left, then from the right. The cost of the plane before
+	// bin i is the perimeter times the count on each side.
+	float32 leftCosts[binCount];
+	int32 leftCounts[binCount];
+	b2AABB bounds;
+	int32 n = 0;
+	for (int32 i = 0; i < binCount; ++i)
+	{
+		if (binCounts[i] > 0)
+		{
+			if (n == 0)
+			{
+				bounds = binBounds[i];
+			}
+			else
+			{
+				bounds.Combine(binBounds[i]);
+			}
+			n += binCounts[i];
+		}
+		leftCounts[i] = n;
+		leftCosts[i] = n > 0 ? n * bounds.GetPerimeter() : 0.0f;
+	}
+
+	int32 bestBin = 0;
+	float32 bestCost = b2_maxFloat;
+	n = 0;
+	for (int32 i = binCount - 1; i > 0; --i)
+	{
+		if (binCounts[i] > 0)
+		{
+			if (n == 0)
+			{
+				bounds = binBounds[i];
+			}
+			else
+			{
+				bounds.Combine(binBounds[i]);
+			}
+			n += binCounts[i];
+		}
+
+		if (n == 0 || leftCounts[i - 1] == 0)
+		{
+			continue;
+		}
+
+		float32 cost = leftCosts[i - 1] + n * bounds.GetPerimeter();
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestBin = i;
+		}
+	}
+
+	b2Assert(bestBin > 0);
+	WideTreeBuild::Entry* split = std::partition(entries + begin, entries + end, [=](const WideTreeBuild::Entry& entry)
+	{
+		float32 c = axis == 0 ? entry.center.x : entry.center.y;
+		return b2Min(int32((c - low) * scale), binCount - 1) < bestBin;
+	});
+	return int32(split - entries);
+}
+
+// Builds the subtree over entries [begin, end) and returns its node.
+static int32 BuildNode(WideTreeBuild* build, int32 begin, int32 end)
+{
+	int32 index = (int32)build->nodes.size();
+	build->nodes.push_back(WideTreeNode());
+	WideTreeNode* node = &build->nodes[index];
+	for (int32 i = 0; i < 4; ++i)
+	{
+		node->lowerX[i] = b2_maxFloat;
+		node->lowerY[i] = b2_maxFloat;
+		node->upperX[i] = -b2_maxFloat;
+		node->upperY[i] = -b2_maxFloat;
+		node->children[i] = b2_nullNode;
+	}
+	node->parent = b2_nullNode;
+	node->parentSlot = 0;
+	node->next = b2_nullNode;
+
+	if (end - begin <= 4)
+	{
+		node->childCount = end - begin;
+		node->height = 1;
+		for (int32 i = 0; i < node->childCount; ++i)
+		{
+			const WideTreeBuild::Entry& entry = build->entries[begin + i];
+			node->lowerX[i] = entry.aabb.lowerBound.x;
+			node->lowerY[i] = entry.aabb.lowerBound.y;
+			node->upperX[i] = entry.aabb.upperBound.x;
+			node->upperY[i] = entry.aabb.upperBound.y;
+			node->children[i] = (entry.proxyId << 1) | 1;
+			build->proxyNodes[entry.proxyId] = index;
+			build->proxySlots[entry.proxyId] = i;
+		}
+		return index;
+	}
+
+	// Split in two, then split each half again, for up to four children.
+	int32 ranges[5];
+	int32 rangeCount = 0;
+	int32 halves[3] = { begin, SplitEntries(build, begin, end), end };
+	for (int32 h = 0; h < 2; ++h)
+	{
+		ranges[rangeCount++] = halves[h];
+		if (halves[h + 1] - halves[h] > 4)
+		{
+			ranges[rangeCount++] = SplitEntries(build, halves[h], halves[h + 1]);
+		}
+	}
+	ranges[rangeCount] = end;
+
+	int32 height = 0;
+	for (int32 i = 0; i < rangeCount; ++i)
+	{
+		int32 childIndex = BuildNode(build, ranges[i], ranges[i + 1]);
+
+		// The node vector may have grown.
+		WideTreeNode* child = &build->nodes[childIndex];
+		child->parent = index;
+		child->parentSlot = i;
+		height = b2Max(height, child->height);
+
+		float32 lowerX = child->lowerX[0], lowerY = child->lowerY[0];
+		float32 upperX = child->upperX[0], upperY = child->upperY[0];
+		for (int32 j = 1; j < child->childCount; ++j)
+		{
+			lowerX = b2Min(lowerX, child->lowerX[j]);
+			lowerY = b2Min(lowerY, child->lowerY[j]);
+			upperX = b2Max(upperX, child->upperX[j]);
+			upperY = b2Max(upperY, child->upperY[j]);
+		}
+
+		node = &build->nodes[index];
+		node->lowerX[i] = lowerX;
+		node->lowerY[i] = lowerY;
+		node->upperX[i] = upperX;
+		node->upperY[i] = upperY;
+		node->children[i] = childIndex << 1;
+	}
+
+	node = &build->nodes[index];
+	node->childCount = rangeCount;
+	node->height = height + 1;
+	return index;
+}
+
+static void BuildTree(WideTreeBuild* build)
+{
+	build->entries.resize(0);
+	for (int32 i = 0; i < (int32)build->aabbs.size(); ++i)
+	{
+		if (build->active[i])
+		{
+			WideTreeBuild::Entry entry;
+			entry.aabb = build->aabbs[i];
+			entry.center = entry.aabb.GetCenter();
+			entry.proxyId = i;
+			build->entries.push_back(entry);
+		}
+	}
+
+	build->proxyNodes.assign(build->aabbs.size(), b2_nullNode);
+	build->proxySlots.assign(build->aabbs.size(), 0);
+	build->nodes.resize(0);
+	build->nodes.reserve(build->entries.size() / 2 + 1);
+
+	build->root = b2_nullNode;
+	if (build->entries.empty() == false)
+	{
+		build->root = BuildNode(build, 0, (int32)build->entries.size());
+	}
+}
+
+static void BuildTreeJob(void* data, int32 begin, int32 end)
+{
+	B2_NOT_USED(begin);
+	B2_NOT_USED(end);
+	BuildTree((WideTreeBuild*)data);
+}
+
+WideTree::WideTree()
+{
+	m_root = b2_nullNode;
+	m_nodeCount = 0;
+	m_proxyCount = 0;
+	m_freeNode = b2_nullNode;
+	m_freeProxy = b2_nullNode;
+	m_reinsertCursor = 0;
+	m_build = NULL;
+}
+
+WideTree::~WideTree()
+{
+	if (m_build != NULL)
+	{
+		g_jobSystem.Wait(&m_build->counter);
+		delete m_build;
+	}
+}
+
+int32 WideTree::AllocateNode()
+{
+	int32 index;
+	if (m_freeNode != b2_nullNode)
+	{
+		index = m_freeNode;
+		m_freeNode = m_nodes[index].next;
+	}
+	else
+	{
+		index = (int32)m_nodes.size();
+		m_nodes.push_back(WideTreeNode());
+	}
+
+	WideTreeNode* node = &m_nodes[index];
+	for (int32 i = 0; i < 4; ++i)
+	{
+		ClearChild(index, i);
+	}
+	node->childCount = 0;
+	node->parent = b2_nullNode;
+	node->parentSlot = 0;
+	node->height = 1;
+	node->next = b2_nullNode;
+	++m_nodeCount;
+	return index;
+}
+
+void WideTree::FreeNode(int32 index)
+{
+	b2Assert(0 < m_nodeCount);
+	m_nodes[index].height = -1;
+	m_nodes[index].next = m_freeNode;
+	m_freeNode = index;
+	--m_nodeCount;
+}
+
+void WideTree::SetChild(int32 index, int32 slot, int32 child, const b2AABB& aabb)
+{
+	WideTreeNode* node = &m_nodes[index];
+	node->lowerX[slot] = aabb.lowerBound.x;
+	node->lowerY[slot] = aabb.lowerBound.y;
+	node->upperX[slot] = aabb.upperBound.x;
+	node->upperY[slot] = aabb.upperBound.y;
+	node->children[slot] = child;
+
+	if (IsLeaf(child))
+	{
+		WideTreeProxy* proxy = &m_proxies[GetProxyId(child)];
+		proxy->node = index;
+		proxy->slot = slot;
+	}
+	else
+	{
+		WideTreeNode* childNode = &m_nodes[GetNodeIndex(child)];
+		childNode->parent = index;
+		childNode->parentSlot = slot;
+	}
+}
+
+void WideTree::ClearChild(int32 index, int32 slot)
+{
+	WideTreeNode* node = &m_nodes[index];
+	node->lowerX[slot] = b2_maxFloat;
+	node->lowerY[slot] = b2_maxFloat;
+	node->upperX[slot] = -b2_maxFloat;
+	node->upperY[slot] = -b2_maxFloat;
+	node->children[slot] = b2_nullNode;
+}
+
+b2AABB WideTree::GetChildAABB(int32 index, int32 slot) const
+{
+	const WideTreeNode* node = &m_nodes[index];
+	b2AABB aabb;
+	aabb.lowerBound.Set(node->lowerX[slot], node->lowerY[slot]);
+	aabb.upperBound.Set(node->upperX[slot], node->upperY[slot]);
+	return aabb;
+}
+
+b2AABB WideTree::GetNodeAABB(int32 index) const
+{
+	const WideTreeNode* node = &m_nodes[index];
+	b2Assert(node->childCount > 0);
+	b2AABB aabb = GetChildAABB(index, 0);
+	for (int32 i = 1; i < node->childCount; ++i)
+	{
+		aabb.Combine(GetChildAABB(index, i));
+	}
+	return aabb;
+}
+
+int32 WideTree::CreateProxy(const b2AABB& aabb, void* userData)
+{
+	int32 proxyId;
+	if (m_freeProxy != b2_nullNode)
+	{
+		proxyId = m_freeProxy;
+		m_freeProxy = m_proxies[proxyId].next;
+	}
+	else
+	{
+		proxyId = (int32)m_proxies.size();
+		m_proxies.push_back(WideTreeProxy());
+	}
+
+	// Fatten the aabb.
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	WideTreeProxy* proxy = &m_proxies[proxyId];
+	proxy->aabb.lowerBound = aabb.lowerBound - r;
+	proxy->aabb.upperBound = aabb.upperBound + r;
+	proxy->userData = userData;
+	proxy->next = b2_nullNode;
+	++m_proxyCount;
+
+	InsertLeaf(proxyId);
+
+	return proxyId;
+}
+
+void WideTree::DestroyProxy(int32 proxyId)
+{
+	b2Assert(0 <= proxyId && proxyId < (int32)m_proxies.size());
+	b2Assert(m_proxies[proxyId].node != b2_nullNode);
+
+	RemoveLeaf(proxyId);
+
+	WideTreeProxy* proxy = &m_proxies[proxyId];
+	proxy->node = b2_nullNode;
+	proxy->next = m_freeProxy;
+	m_freeProxy = proxyId;
+	--m_proxyCount;
+}
+
+bool WideTree::MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement)
+{
+	b2Assert(0 <= proxyId && proxyId < (int32)m_proxies.size());
+	WideTreeProxy* proxy = &m_proxies[proxyId];
+	b2Assert(proxy->node != b2_nullNode);
+
+	if (proxy->aabb.Contains(aabb))
+	{
+		return false;
+	}
+
+	RemoveLeaf(proxyId);
+
+	// Extend AABB.
+	b2AABB b = aabb;
+	b2Vec2 r(b2_aabbExtension, b2_aabbExtension);
+	b.lowerBound = b.lowerBound - r;
+	b.upperBound = b.upperBound + r;
+
+	// Predict AABB displacement.
+	b2Vec2 d = b2_aabbMultiplier * displacement;
+
+	if (d.x < 0.0f)
+	{
+		b.lowerBound.x += d.x;
+	}
+	else
+	{
+		b.upperBound.x += d.x;
+	}
+
+	if (d.y < 0.0f)
+	{
+		b.lowerBound.y += d.y;
+	}
+	else
+	{
+		b.upperBound.y += d.y;
+	}
+
+	proxy->aabb = b;
+
+	InsertLeaf(proxyId);
+	return true;
+}
+
+bool WideTree::SetFatAABB(int32 proxyId, const b2AABB& fatAABB)
+{
+	b2Assert(0 <= proxyId && proxyId < (int32)m_proxies.size());
+	WideTreeProxy* proxy = &m_proxies[proxyId];
+	b2Assert(proxy->node != b2_nullNode);
+
+	if (proxy->aabb.lowerBound == fatAABB.lowerBound && proxy->aabb.upperBound == fatAABB.upperBound)
+	{
+		return false;
+	}
+
+	proxy->aabb = fatAABB;
+	SetChild(proxy->node, proxy->slot, (proxyId << 1) | 1, fatAABB);
+	Refit(proxy->node);
+	return true;
+}
+
+void WideTree::InsertLeaf(int32 proxyId)
+{
+	int32 leaf = (proxyId << 1) | 1;
+	b2AABB leafAABB = m_proxies[proxyId].aabb;
+
+	if (m_root == b2_nullNode)
+	{
+		m_root = AllocateNode();
+		SetChild(m_root, 0, leaf, leafAABB);
+		m_nodes[m_root].childCount = 1;
+		return;
+	}
+
+	// Go down to a node that holds leaves, each time into the child whose
+	// perimeter grows least.
+	int32 index = m_root;
+	while (m_nodes[index].height > 1)
+	{
+		const WideTreeNode* node = &m_nodes[index];
+		int32 bestSlot = 0;
+		float32 bestCost = b2_maxFloat;
+		float32 bestPerimeter = b2_maxFloat;
+		for (int32 i = 0; i < node->childCount; ++i)
+		{
+			b2AABB childAABB = GetChildAABB(index, i);
+			b2AABB combined;
+			combined.Combine(childAABB, leafAABB);
+			float32 perimeter = childAABB.GetPerimeter();
+			float32 cost = combined.GetPerimeter() - perimeter;
+			if (cost < bestCost || (cost == bestCost && perimeter < bestPerimeter))
+			{
+				bestCost = cost;
+				bestPerimeter = perimeter;
+				bestSlot = i;
+			}
+		}
+
+		index = GetNodeIndex(node->children[bestSlot]);
+	}
+
+	AddChild(index, leaf, leafAABB);
+}
+
+// Adds child to the node at index, splitting the node if it is full. The
+// split adds a sibling to the parent, which may split in turn, so the tree
+// only grows at the root.
+void WideTree::AddChild(int32 index, int32 child, const b2AABB& aabb)
+{
+	WideTreeNode* node = &m_nodes[index];
+	if (node->childCount < 4)
+	{
+		SetChild(index, node->childCount, child, aabb);
+		++node->childCount;
+		Refit(index);
+		return;
+	}
+
+	// Five entries: pick the axis and split point that give the smallest
+	// sum of the two halves' perimeters, keeping at least two per half.
+	int32 entries[5];
+	b2AABB bounds[5];
+	for (int32 i = 0; i < 4; ++i)
+	{
+		entries[i] = node->children[i];
+		bounds[i] = GetChildAABB(index, i);
+	}
+	entries[4] = child;
+	bounds[4] = aabb;
+
+	int32 bestOrder[5];
+	int32 bestSplit = 2;
+	float32 bestCost = b2_maxFloat;
+	for (int32 axis = 0; axis < 2; ++axis)
+	{
+		int32 order[5] = { 0, 1, 2, 3, 4 };
+		float32 centers[5];
+		for (int32 i = 0; i < 5; ++i)
+		{
+			b2Vec2 center = bounds[i].GetCenter();
+			centers[i] = axis == 0 ? center.x : center.y;
+		}
+
+		// Insertion sort by center.
+		for (int32 i = 1; i < 5; ++i)
+		{
+			for (int32 j = i; j > 0 && centers[order[j]] < centers[order[j - 1]]; --j)
+			{
+				b2Swap(order[j], order[j - 1]);
+			}
+		}
+
+		for (int32 split = 2; split <= 3; ++split)
+		{
+			b2AABB lower = bounds[order[0]];
+			for (int32 i = 1; i < split; ++i)
+			{
+				lower.Combine(bounds[order[i]]);
+			}
+
+			b2AABB upper = bounds[order[split]];
+			for (int32 i = split + 1; i < 5; ++i)
+			{
+				upper.Combine(bounds[order[i]]);
+			}
+
+			float32 cost = lower.GetPerimeter() + upper.GetPerimeter();
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = split;
+				for (int32 i = 0; i < 5; ++i)
+				{
+					bestOrder[i] = order[i];
+				}
+			}
+		}
+	}
+
+	int32 sibling = AllocateNode();
+
+	for (int32 i = 0; i < 4; ++i)
+	{
+		ClearChild(index, i);
+	}
+
+	for (int32 i = 0; i < bestSplit; ++i)
+	{
+		SetChild(index, i, entries[bestOrder[i]], bounds[bestOrder[i]]);
+	}
+	m_nodes[index].childCount = bestSplit;
+
+	for (int32 i = bestSplit; i < 5; ++i)
+	{
+		SetChild(sibling, i - bestSplit, entries[bestOrder[i]], bounds[bestOrder[i]]);
+	}
+	m_nodes[sibling].childCount = 5 - bestSplit;
+
+	Refit(sibling);
+	Refit(index);
+
+	int32 parent = m_nodes[index].parent;
+	if (parent == b2_nullNode)
+	{
+		// The root split: grow the tree by one level.
+		m_root = AllocateNode();
+		SetChild(m_root, 0, index << 1, GetNodeAABB(index));
+		SetChild(m_root, 1, sibling << 1, GetNodeAABB(sibling));
+		m_nodes[m_root].childCount = 2;
+		Refit(m_root);
+		return;
+	}
+
+	AddChild(parent, sibling << 1, GetNodeAABB(sibling));
+}
+
+void WideTree::RemoveLeaf(int32 proxyId)
+{
+	RemoveChild(m_proxies[proxyId].node, m_proxies[proxyId].slot);
+}
+
+// Removes a child, moving the last one into its slot. Nodes left empty are
+// removed from their parents, and a root with a single inner child is
+// replaced by it. Nodes are allowed to be underfull; WideTree does not
+// merge them.
+void WideTree::RemoveChild(int32 index, int32 slot)
+{
+	WideTreeNode* node = &m_nodes[index];
+	int32 last = node->childCount - 1;
+	if (slot != last)
+	{
+		SetChild(index, slot, node->children[last], GetChildAABB(index, last));
+	}
+	ClearChild(index, last);
+	--node->childCount;
+
+	if (node->childCount == 0)
+	{
+		int32 parent = node->parent;
+		int32 parentSlot = node->parentSlot;
+		FreeNode(index);
+
+		if (parent == b2_nullNode)
+		{
+			m_root = b2_nullNode;
+		}
+		else
+		{
+			RemoveChild(parent, parentSlot);
+		}
+		return;
+	}
+
+	Refit(index);
+
+	while (m_nodes[m_root].childCount == 1 && IsLeaf(m_nodes[m_root].children[0]) == false)
+	{
+		int32 oldRoot = m_root;
+		m_root = GetNodeIndex(m_nodes[oldRoot].children[0]);
+		m_nodes[m_root].parent = b2_nullNode;
+		FreeNode(oldRoot);
+	}
+}
+
+// Recomputes bounds and heights from index up to the root.
+void WideTree::Refit(int32 index)
+{
+	while (index != b2_nullNode)
+	{
+		WideTreeNode* node = &m_nodes[index];
+
+		int32 height = 0;
+		for (int32 i = 0; i < node->childCount; ++i)
+		{
+			int32 child = node->children[i];
+			if (IsLeaf(child) == false)
+			{
+				height = b2Max(height, m_nodes[GetNodeIndex(child)].height);
+			}
+		}
+		node->height = height + 1;
+
+		int32 parent = node->parent;
+		if (parent != b2_nullNode)
+		{
+			SetChild(parent, node->parentSlot, index << 1, GetNodeAABB(index));
+		}
+		index = parent;
+	}
+}
+
+int32 WideTree::GetHeight() const
+{
+	if (m_root == b2_nullNode)
+	{
+		return 0;
+	}
+
+	return m_nodes[m_root].height;
+}
+
+float32 WideTree::GetAreaRatio() const
+{
+	if (m_root == b2_nullNode)
+	{
+		return 0.0f;
+	}
+
+	float32 rootArea = GetNodeAABB(m_root).GetPerimeter();
+
+	float32 totalArea = 0.0f;
+	for (int32 i = 0; i < (int32)m_nodes.size(); ++i)
+	{
+		if (m_nodes[i].height < 0)
+		{
+			// Free node in pool
+			continue;
+		}
+
+		totalArea += GetNodeAABB(i).GetPerimeter();
+	}
+
+	return totalArea / rootArea;
+}
+
+void WideTree::ValidateNode(int32 index) const
+{
+	const WideTreeNode* node = &m_nodes[index];
+	b2Assert(0 < node->childCount && node->childCount <= 4);
+
+	// Leaves count as height 0. Rebuild can leave leaves at different
+	// depths, but a node never mixes leaves with inner nodes.
+	int32 height = 0;
+	int32 leafCount = 0;
+	for (int32 i = 0; i < 4; ++i)
+	{
+		int32 child = node->children[i];
+		if (i >= node->childCount)
+		{
+			b2Assert(child == b2_nullNode);
+			continue;
+		}
+
+		b2AABB aabb = GetChildAABB(index, i);
+		B2_NOT_USED(aabb);
+		if (IsLeaf(child))
+		{
+			const WideTreeProxy* proxy = &m_proxies[GetProxyId(child)];
+			b2Assert(proxy->node == index && proxy->slot == i);
+			b2Assert(proxy->aabb.lowerBound == aabb.lowerBound && proxy->aabb.upperBound == aabb.upperBound);
+			B2_NOT_USED(proxy);
+			++leafCount;
+			continue;
+		}
+
+		int32 childIndex = GetNodeIndex(child);
+		const WideTreeNode* childNode = &m_nodes[childIndex];
+		b2Assert(childNode->parent == index && childNode->parentSlot == i);
+
+		b2AABB childAABB = GetNodeAABB(childIndex);
+		b2Assert(childAABB.lowerBound == aabb.lowerBound && childAABB.upperBound == aabb.upperBound);
+		B2_NOT_USED(childAABB);
+
+		ValidateNode(childIndex);
+		height = b2Max(height, childNode->height);
+	}
+
+	b2Assert(leafCount == 0 || leafCount == node->childCount);
+	b2Assert(node->height == height + 1);
+	B2_NOT_USED(leafCount);
+	B2_NOT_USED(height);
+}
+
+void WideTree::Validate() const
+{
+	if (m_root == b2_nullNode)
+	{
+		b2Assert(m_proxyCount == 0);
+		return;
+	}
+
+	b2Assert(m_nodes[m_root].parent == b2_nullNode);
+	ValidateNode(m_root);
+
+	int32 freeCount = 0;
+	for (int32 index = m_freeNode; index != b2_nullNode; index = m_nodes[index].next)
+	{
+		++freeCount;
+	}
+	b2Assert(m_nodeCount + freeCount == (int32)m_nodes.size());
+	B2_NOT_USED(freeCount);
+}
+
+void WideTree::TakeSnapshot()
+{
+	m_build = new WideTreeBuild;
+	m_build->aabbs.resize(m_proxies.size());
+	m_build->active.resize(m_proxies.size());
+	for (int32 i = 0; i < (int32)m_proxies.size(); ++i)
+	{
+		m_build->aabbs[i] = m_proxies[i].aabb;
+		m_build->active[i] = m_proxies[i].node != b2_nullNode;
+	}
+}
+
+void WideTree::Rebuild()
+{
+	FinishRebuild(true);
+	TakeSnapshot();
+	BuildTree(m_build);
+	SwapInBuild();
+}
+
+void WideTree::BeginRebuild()
+{
+	if (m_build != NULL)
+	{
+		return;
+	}
+
+	TakeSnapshot();
+	g_jobSystem.Run(&m_build->counter, BuildTreeJob, m_build);
+}
+
+bool WideTree::FinishRebuild(bool wait)
+{
+	if (m_build == NULL)
+	{
+		return true;
+	}
+
+	if (wait == false && m_build->counter.IsDone() == false)
+	{
+		return false;
+	}
+
+	g_jobSystem.Wait(&m_build->counter);
+	SwapInBuild();
+	return true;
+}
+
+// Replaces the nodes with the finished build, then brings the proxies that
+// changed after the snapshot up to date.
+void WideTree::SwapInBuild()
+{
+	WideTreeBuild* build = m_build;
+	m_build = NULL;
+
+	int32 capacity = (int32)m_proxies.size();
+	int32 snapshotCount = (int32)build->aabbs.size();
+	std::vector<bool> active(capacity);
+	for (int32 i = 0; i < capacity; ++i)
+	{
+		active[i] = m_proxies[i].node != b2_nullNode;
+	}
+
+	m_nodes.swap(build->nodes);
+	m_root = build->root;
+	m_nodeCount = (int32)m_nodes.size();
+	m_freeNode = b2_nullNode;
+
+	for (int32 i = 0; i < snapshotCount; ++i)
+	{
+		m_proxies[i].node = build->proxyNodes[i];
+		m_proxies[i].slot = build->proxySlots[i];
+	}
+
+	for (int32 i = 0; i < capacity; ++i)
+	{
+		bool built = i < snapshotCount && build->active[i];
+		if (built && active[i] == false)
+		{
+			// Destroyed.
+			RemoveLeaf(i);
+			m_proxies[i].node = b2_nullNode;
+		}
+		else if (built)
+		{
+			// Moved, or destroyed and created again.
+			const b2AABB& aabb = build->aabbs[i];
+			if (aabb.lowerBound != m_proxies[i].aabb.lowerBound || aabb.upperBound != m_proxies[i].aabb.upperBound)
+			{
+				RemoveLeaf(i);
+				InsertLeaf(i);
+			}
+		}
+		else if (active[i])
+		{
+			// Created.
+			InsertLeaf(i);
+		}
+	}
+
+	delete build;
+}
+
+int32 WideTree::Reinsert(int32 count)
+{
+	int32 capacity = (int32)m_proxies.size();
+	int32 reinserted = 0;
+	for (int32 i = 0; i < capacity && reinserted < count; ++i)
+	{
+		if (m_reinsertCursor >= capacity)
+		{
+			m_reinsertCursor = 0;
+		}
+
+		int32 proxyId = m_reinsertCursor++;
+		if (m_proxies[proxyId].node == b2_nullNode)
+		{
+			continue;
+		}
+
+		RemoveLeaf(proxyId);
+		InsertLeaf(proxyId);
+		++reinserted;
+	}
+
+	return reinserted;
+}
@@ -0,0 +1,294 @@
+#pragma once
+#include "SimdMath.h"
+#include <vector>
+
+// A node of WideTree with up to four children. The child bounds are stored
+// as four arrays so a query tests all children with one Float4 compare.
+// Empty slots hold an inverted box that overlaps nothing.
+struct WideTreeNode
+{
+	float32 lowerX[4];
+	float32 lowerY[4];
+	float32 upperX[4];
+	float32 upperY[4];
+
+	// Node index << 1 for internal children, proxy id << 1 | 1 for leaves.
+	int32 children[4];
+	int32 childCount;
+
+	int32 parent;
+	int32 parentSlot;
+
+	// Distance to the leaves; nodes holding leaves have height 1 and hold
+	// nothing else.
+	int32 height;
+
+	// Free list link.
+	int32 next;
+};
+
+struct WideTreeProxy
+{
+	b2AABB aabb;
+	void* userData;
+
+	// The node and slot holding the proxy, or b2_nullNode when it is free.
+	int32 node;
+	int32 slot;
+	int32 next;
+};
+
+struct WideTreeBuild;
+
+// Drop-in alternative to b2DynamicTree: the same proxy interface and fat
+// AABBs, but a 4-ary bounding volume hierarchy. Four children per node
+// halve the depth of a binary tree, and Query and RayCast test the four
+// child boxes at once. Insertion works like an R-tree: the leaf goes down
+// the path of least perimeter growth, and full nodes split in two. A tree
+// built only by insertion has all its leaves at the same depth; Rebuild's
+// SAH build does not, so leaves may then sit at different depths. Either
+// way a node holds only leaves or only inner nodes.
+class WideTree
+{
+public:
+	WideTree();
+	~WideTree();
+
+	// Proxy ids are stable until the proxy is destroyed.
+	int32 CreateProxy(const b2AABB& aabb, void* userData);
+	void DestroyProxy(int32 proxyId);
+
+	// Same contract as b2DynamicTree::MoveProxy: returns true if the proxy
+	// left its fat AABB and was reinserted.
+	bool MoveProxy(int32 proxyId, const b2AABB& aabb, const b2Vec2& displacement);
+
+	// Gives the proxy exactly this fat AABB, e.g. one saved from GetFatAABB,
+	// and refits the nodes above it without moving the leaf. That is cheaper
+	// than reinserting and fine for boxes that go back a short way, as on
+	// rollback. Returns false if the proxy already had it.
+	bool SetFatAABB(int32 proxyId, const b2AABB& fatAABB);
+
+	// Rebuilds all nodes top-down, splitting with a binned surface area
+	// heuristic (perimeter, in 2D). Proxy ids and fat AABBs are unchanged.
+	void Rebuild();
+
+	// Rebuild on g_jobSystem from a copy of the fat AABBs while the tree
+	// stays usable. FinishRebuild swaps the new nodes in and then reinserts
+	// the proxies created, moved or destroyed since BeginRebuild. It returns
+	// false if wait is false and the build has not finished.
+	void BeginRebuild();
+	bool FinishRebuild(bool wait);
+	bool IsRebuilding() const { return m_build != NULL; }
+
+	// Removes and reinserts up to count proxies, carrying on from where the
+	// previous call stopped, so leaves left in poor places by earlier moves
+	// find better ones. Returns the number reinserted.
+	int32 Reinsert(int32 count);
+
+	void* GetUserData(int32 proxyId) const { return m_proxies[proxyId].userData; }
+	const b2AABB& GetFatAABB(int32 proxyId) const { return m_proxies[proxyId].aabb; }
+
+	// Calls callback->QueryCallback(proxyId) for every proxy whose fat AABB
+	// overlaps aabb, in no particular order. Returning false stops.
+	template <typename T>
+	void Query(T* callback, const b2AABB& aabb) const;
+
+	// Calls callback->RayCastCallback(input, proxyId) like b2DynamicTree.
+	template <typename T>
+	void RayCast(T* callback, const b2RayCastInput& input) const;
+
+	int32 GetHeight() const;
+	int32 GetProxyCount() const { return m_proxyCount; }
+	int32 GetNodeCount() const { return m_nodeCount; }
+
+	// Proxy ids are below the capacity; IsActive tells the live ones.
+	int32 GetProxyCapacity() const { return (int32)m_proxies.size(); }
+	bool IsActive(int32 proxyId) const { return m_proxies[proxyId].node != b2_nullNode; }
+
+	// Sum of the node perimeters over the root perimeter, as
+	// b2DynamicTree::GetAreaRatio.
+	float32 GetAreaRatio() const;
+
+	// Checks links, bounds and heights.
+	void Validate() const;
+
+	static bool IsLeaf(int32 child) { return (child & 1) != 0; }
+	static int32 GetProxyId(int32 child) { return child >> 1; }
+	static int32 GetNodeIndex(int32 child) { return child >> 1; }
+
+private:
+	int32 AllocateNode();
+	void FreeNode(int32 index);
+	void SetChild(int32 index, int32 slot, int32 child, const b2AABB& aabb);
+	void ClearChild(int32 index, int32 slot);
+	b2AABB GetChildAABB(int32 index, int32 slot) const;
+	b2AABB GetNodeAABB(int32 index) const;
+	void InsertLeaf(int32 proxyId);
+	void RemoveLeaf(int32 proxyId);
+	void AddChild(int32 index, int32 child, const b2AABB& aabb);
+	void RemoveChild(int32 index, int32 slot);
+	void Refit(int32 index);
+	void ValidateNode(int32 index) const;
+	void TakeSnapshot();
+	void SwapInBuild();
+
+	std::vector<WideTreeNode> m_nodes;
+	std::vector<WideTreeProxy> m_proxies;
+	int32 m_root;
+	int32 m_nodeCount;
+	int32 m_proxyCount;
+	int32 m_freeNode;
+	int32 m_freeProxy;
+	int32 m_reinsertCursor;
+	WideTreeBuild* m_build;
+};
+
+template <typename T>
+inline void WideTree::Query(T* callback, const b2AABB& aabb) const
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	Float4 queryLowerX = Simd4Set(aabb.lowerBound.x);
+	Float4 queryLowerY = Simd4Set(aabb.lowerBound.y);
+	Float4 queryUpperX = Simd4Set(aabb.upperBound.x);
+	Float4 queryUpperY = Simd4Set(aabb.upperBound.y);
+	Float4 zero = Simd4Set(0.0f);
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(m_root);
+
+	while (stack.GetCount() > 0)
+	{
+		const WideTreeNode* node = &m_nodes[stack.Pop()];
+
+		// b2TestOverlap against all four children.
+		Float4 separated = (Simd4Load(node->lowerX) - queryUpperX > zero) | (Simd4Load(node->lowerY) - queryUpperY > zero);
+		separated = separated | (queryLowerX - Simd4Load(node->upperX) > zero) | (queryLowerY - Simd4Load(node->upperY) > zero);
+		int32 overlaps = ~Simd4MaskBits(separated);
+
+		for (int32 i = 0; i < node->childCount; ++i)
+		{
+			if ((overlaps & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			int32 child = node->children[i];
+			if (IsLeaf(child))
+			{
+				bool proceed = callback->QueryCallback(GetProxyId(child));
+				if (proceed == false)
+				{
+					return;
+				}
+			}
+			else
+			{
+				stack.Push(GetNodeIndex(child));
+			}
+		}
+	}
+}
+
+template <typename T>
+inline void WideTree::RayCast(T* callback, const b2RayCastInput& input) const
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	b2Vec2 p1 = input.p1;
+	b2Vec2 p2 = input.p2;
+	b2Vec2 r = p2 - p1;
+	b2Assert(r.LengthSquared() > 0.0f);
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	float32 maxFraction = input.maxFraction;
+
+	// Build a bounding box for the segment.
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = p1 + maxFraction * (p2 - p1);
+		segmentAABB.lowerBound = b2Min(p1, t);
+		segmentAABB.upperBound = b2Max(p1, t);
+	}
+
+	Float4 zero = Simd4Set(0.0f);
+	Float4 half = Simd4Set(0.5f);
+	Float4 p1x = Simd4Set(p1.x), p1y = Simd4Set(p1.y);
+	Float4 vx = Simd4Set(v.x), vy = Simd4Set(v.y);
+	Float4 absVx = Simd4Set(abs_v.x), absVy = Simd4Set(abs_v.y);
+
+	b2GrowableStack<int32, 256> stack;
+	stack.Push(m_root);
+
+	while (stack.GetCount() > 0)
+	{
+		const WideTreeNode* node = &m_nodes[stack.Pop()];
+
+		Float4 lowerX = Simd4Load(node->lowerX);
+		Float4 lowerY = Simd4Load(node->lowerY);
+		Float4 upperX = Simd4Load(node->upperX);
+		Float4 upperY = Simd4Load(node->upperY);
+
+		Float4 separated = (lowerX - Simd4Set(segmentAABB.upperBound.x) > zero) | (lowerY - Simd4Set(segmentAABB.upperBound.y) > zero);
+		separated = separated | (Simd4Set(segmentAABB.lowerBound.x) - upperX > zero) | (Simd4Set(segmentAABB.lowerBound.y) - upperY > zero);
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		Float4 cx = half * (lowerX + upperX);
+		Float4 cy = half * (lowerY + upperY);
+		Float4 hx = half * (upperX - lowerX);
+		Float4 hy = half * (upperY - lowerY);
+		Float4 d = vx * (p1x - cx) + vy * (p1y - cy);
+		Float4 separation = Simd4Max(d, -d) - (absVx * hx + absVy * hy);
+		separated = separated | (separation > zero);
+
+		int32 overlaps = ~Simd4MaskBits(separated);
+
+		for (int32 i = 0; i < node->childCount; ++i)
+		{
+			if ((overlaps & (1 << i)) == 0)
+			{
+				continue;
+			}
+
+			int32 child = node->children[i];
+			if (IsLeaf(child) == false)
+			{
+				stack.Push(GetNodeIndex(child));
+				continue;
+			}
+
+			b2RayCastInput subInput;
+			subInput.p1 = input.p1;
+			subInput.p2 = input.p2;
+			subInput.maxFraction = maxFraction;
+
+			float32 value = callback->RayCastCallback(subInput, GetProxyId(child));
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (value > 0.0f)
+			{
+				// Update segment bounding box.
+				maxFraction = value;
+				b2Vec2 t = p1 + maxFraction * (p2 - p1);
+				segmentAABB.lowerBound = b2Min(p1, t);
+				segmentAABB.upperBound = b2Max(p1, t);
+			}
+		}
+	}
+}
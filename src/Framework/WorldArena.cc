@@ -0,0 +1,57 @@
+#include "WorldArena.h"
+
+// Keeps the first allocation in a chunk aligned.
+static const int32 k_headerSize = (sizeof(void*) + WorldArena::e_alignment - 1) & ~(WorldArena::e_alignment - 1);
+
+WorldArena::WorldArena()
+{
+	m_chunks = NULL;
+	m_cursor = NULL;
+	m_end = NULL;
+	m_chunkCount = 0;
+	m_byteCount = 0;
+}
+
+WorldArena::~WorldArena()
+{
+	Release();
+}
+
+void* WorldArena::Allocate(int32 size)
+{
+	size = (size + e_alignment - 1) & ~(e_alignment - 1);
+	if (m_cursor == NULL || m_end - m_cursor < size)
+	{
+		// Allocations bigger than a chunk get a chunk of their own.
+		int32 chunkSize = b2Max((int32)e_chunkSize, k_headerSize + size);
+		Chunk* chunk = (Chunk*)b2Alloc(chunkSize);
+		chunk->next = m_chunks;
+		m_chunks = chunk;
+		++m_chunkCount;
+
+		m_cursor = (char*)chunk + k_headerSize;
+		m_end = (char*)chunk + chunkSize;
+	}
+
+	void* p = m_cursor;
+	m_cursor += size;
+	m_byteCount += size;
+	return p;
+}
+
+void WorldArena::Release()
+{
+	Chunk* chunk = m_chunks;
+	while (chunk)
+	{
+		Chunk* next = chunk->next;
+		b2Free(chunk);
+		chunk = next;
+	}
+
+	m_chunks = NULL;
+	m_cursor = NULL;
+	m_end = NULL;
+	m_chunkCount = 0;
+	m_byteCount = 0;
+}
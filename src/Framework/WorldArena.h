@@ -0,0 +1,44 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+// Memory that lives exactly as long as the world that owns it. Allocations
+// are cut one after another from large chunks and are never freed one by
+// one; Release, or the destructor, frees all the chunks at once. Nothing
+// here has its destructor run, so the arena only holds objects that own no
+// memory elsewhere, such as circles, edges and polygons. Only LabWorld
+// uses it; b2World allocates through Box2D's own allocators.
+class WorldArena
+{
+public:
+	enum
+	{
+		e_chunkSize = 64 * 1024,
+		e_alignment = 16
+	};
+
+	WorldArena();
+	~WorldArena();
+
+	void* Allocate(int32 size);
+
+	// Frees every chunk. Everything allocated so far is gone.
+	void Release();
+
+	int32 GetChunkCount() const { return m_chunkCount; }
+	int32 GetByteCount() const { return m_byteCount; }
+
+private:
+	WorldArena(const WorldArena&);
+	WorldArena& operator=(const WorldArena&);
+
+	struct Chunk
+	{
+		Chunk* next;
+	};
+
+	Chunk* m_chunks;
+	char* m_cursor;
+	char* m_end;
+	int32 m_chunkCount;
+	int32 m_byteCount;
+};
@@ -0,0 +1,86 @@
+#include "WorldChecksum.h"
+#include <cstdint>
+#include <cstring>
+
+uint32 ChecksumWords(uint32 hash, const void* data, int32 byteCount)
+{
+	b2Assert(byteCount % 4 == 0);
+	const uint8* bytes = (const uint8*)data;
+	for (int32 i = 0; i < byteCount; i += 4)
+	{
+		uint32 word;
+		memcpy(&word, bytes + i, sizeof(uint32));
+		hash = (hash ^ word) * 16777619u;
+	}
+	return hash;
+}
+
+uint32 ComputeWorldChecksum(const b2World* world)
+{
+	uint32 hash = k_checksumBasis;
+	for (const b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+	{
+		b2Vec2 position = body->GetPosition();
+		b2Vec2 velocity = body->GetLinearVelocity();
+
+		float32 state[6];
+		state[0] = position.x;
+		state[1] = position.y;
+		state[2] = body->GetAngle();
+		state[3] = velocity.x;
+		state[4] = velocity.y;
+		state[5] = body->GetAngularVelocity();
+		hash = ChecksumWords(hash, state, sizeof(state));
+
+		uint32 awake = body->IsAwake();
+		hash = ChecksumWords(hash, &awake, sizeof(uint32));
+	}
+	return hash;
+}
+
+uint32 ComputeFixtureSignature(const b2Body* body)
+{
+	uint32 hash = k_checksumBasis;
+	for (const b2Fixture* f = body->GetFixtureList(); f; f = f->GetNext())
+	{
+		const b2Shape* shape = f->GetShape();
+		uintptr_t address = (uintptr_t)f;
+		uint32 words[4];
+		words[0] = (uint32)address;
+		words[1] = (uint32)((uint64_t)address >> 32);
+		words[2] = (uint32)shape->GetType();
+		memcpy(words + 3, &shape->m_radius, sizeof(float32));
+		hash = ChecksumWords(hash, words, sizeof(words));
+
+		switch (shape->GetType())
+		{
+		case b2Shape::e_circle:
+			hash = ChecksumWords(hash, &((const b2CircleShape*)shape)->m_p, sizeof(b2Vec2));
+			break;
+
+		case b2Shape::e_edge:
+			hash = ChecksumWords(hash, &((const b2EdgeShape*)shape)->m_vertex1, sizeof(b2Vec2));
+			hash = ChecksumWords(hash, &((const b2EdgeShape*)shape)->m_vertex2, sizeof(b2Vec2));
+			break;
+
+		case b2Shape::e_polygon:
+			{
+				const b2PolygonShape* polygon = (const b2PolygonShape*)shape;
+				hash = ChecksumWords(hash, polygon->m_vertices, polygon->m_count * sizeof(b2Vec2));
+			}
+			break;
+
+		case b2Shape::e_chain:
+			{
+				const b2ChainShape* chain = (const b2ChainShape*)shape;
+				hash = ChecksumWords(hash, &chain->m_count, sizeof(int32));
+				hash = ChecksumWords(hash, chain->m_vertices, sizeof(b2Vec2));
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+	return hash;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+// FNV-1a taken a 32-bit word at a time rather than a byte at a time. Floats
+// are hashed by their bits, so a difference in the last ulp shows up.
+const uint32 k_checksumBasis = 2166136261u;
+
+// Folds byteCount bytes, a multiple of four, into hash.
+uint32 ChecksumWords(uint32 hash, const void* data, int32 byteCount);
+
+// Position, angle, velocities and awake flag of every body in body list
+// order. A few nanoseconds a body, so it can run every step.
+uint32 ComputeWorldChecksum(const b2World* world);
+
+// Hashes the addresses and shapes of the body's fixtures. A body made
+// again at a freed address may well get its fixtures at the freed
+// addresses too, so the shapes are what tell it apart.
+uint32 ComputeFixtureSignature(const b2Body* body);
@@ -0,0 +1,946 @@
+#include "WorldFile.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define WORLD_FILE_HAS_MMAP 1
+#else
+#define WORLD_FILE_HAS_MMAP 0
+#endif
+
+// "B2WF"
+static const uint32 k_worldFileMagic = 0x46573242;
+static const uint32 k_worldFileVersion = 1;
+
+struct WorldFileHeader
+{
+	uint32 magic;
+	uint32 version;
+	int32 bodyCount;
+	int32 fixtureCount;
+	int32 vertexCount;
+	int32 jointCount;
+	b2Vec2 gravity;
+};
+
+enum WorldFileBodyFlags
+{
+	e_bodyAllowSleep = 0x01,
+	e_bodyAwake = 0x02,
+	e_bodyFixedRotation = 0x04,
+	e_bodyBullet = 0x08,
+	e_bodyActive = 0x10
+};
+
+// A body's fixtures follow those of the bodies before it.
+struct WorldFileBody
+{
+	int32 type;
+	uint32 flags;
+	b2Vec2 position;
+	float32 angle;
+	b2Vec2 linearVelocity;
+	float32 angularVelocity;
+	float32 linearDamping;
+	float32 angularDamping;
+	float32 gravityScale;
+	int32 fixtureCount;
+};
+
+enum WorldFileFixtureFlags
+{
+	e_fixtureSensor = 0x01,
+
+	// Edge m_hasVertex0 and m_hasVertex3, chain m_hasPrevVertex and m_hasNextVertex.
+	e_fixtureHasVertex0 = 0x02,
+	e_fixtureHasVertex3 = 0x04
+};
+
+// Vertices used per shape type:
+// circle: m_p
+// edge: m_vertex0 to m_vertex3
+// polygon: the vertices, the normals and the centroid
+// chain: the vertices, the previous and the next vertex
+struct WorldFileFixture
+{
+	int32 shapeType;
+	float32 radius;
+	float32 friction;
+	float32 restitution;
+	float32 density;
+	uint16 categoryBits;
+	uint16 maskBits;
+	int16 groupIndex;
+	uint16 flags;
+	int32 firstVertex;
+	int32 vertexCount;
+};
+
+enum WorldFileJointFlags
+{
+	e_jointCollideConnected = 0x01,
+	e_jointEnableLimit = 0x02,
+	e_jointEnableMotor = 0x04
+};
+
+// Joints refer to bodies, and gear joints to earlier joints, by index. The
+// values hold the joint def fields in the order of the Write and Read
+// functions below.
+struct WorldFileJoint
+{
+	int32 type;
+	uint32 flags;
+	int32 bodyA;
+	int32 bodyB;
+	int32 joint1;
+	int32 joint2;
+	float32 values[12];
+};
+
+WorldFileStats::WorldFileStats()
+{
+	bodyCount = 0;
+	fixtureCount = 0;
+	jointCount = 0;
+	byteCount = 0;
+}
+
+// Appends records to a byte buffer in place.
+template <typename T>
+static T* Append(std::vector<uint8>* data, int32 count)
+{
+	size_t offset = data->size();
+	data->resize(offset + count * sizeof(T));
+	return (T*)(data->data() + offset);
+}
+
+static void PutVec2(float32* values, int32 index, const b2Vec2& v)
+{
+	values[index] = v.x;
+	values[index + 1] = v.y;
+}
+
+static b2Vec2 GetVec2(const float32* values, int32 index)
+{
+	return b2Vec2(values[index], values[index + 1]);
+}
+
+// Fills in the record's values and joint flags; false for joints that
+// are not stored.
+static bool WriteJoint(WorldFileJoint* record, b2Joint* joint, const std::unordered_map<const b2Joint*, int32>& jointIndices)
+{
+	float32* v = record->values;
+	switch (joint->GetType())
+	{
+	case e_revoluteJoint:
+		{
+			b2RevoluteJoint* j = (b2RevoluteJoint*)joint;
+			PutVec2(v, 0, j->GetLocalAnchorA());
+			PutVec2(v, 2, j->GetLocalAnchorB());
+			v[4] = j->GetReferenceAngle();
+			v[5] = j->GetLowerLimit();
+			v[6] = j->GetUpperLimit();
+			v[7] = j->GetMotorSpeed();
+			v[8] = j->GetMaxMotorTorque();
+			record->flags |= j->IsLimitEnabled() ? e_jointEnableLimit : 0;
+			record->flags |= j->IsMotorEnabled() ? e_jointEnableMotor : 0;
+		}
+		return true;
+
+	case e_prismaticJoint:
+		{
+			b2PrismaticJoint* j = (b2PrismaticJoint*)joint;
+			PutVec2(v, 0, j->GetLocalAnchorA());
+			PutVec2(v, 2, j->GetLocalAnchorB());
+			PutVec2(v, 4, j->GetLocalAxisA());
+			v[6] = j->GetReferenceAngle();
+			v[7] = j->GetLowerLimit();
+			v[8] = j->GetUpperLimit();
+			v[9] = j->GetMotorSpeed();
+			v[10] = j->GetMaxMotorForce();
+			record->flags |= j->IsLimitEnabled() ? e_jointEnableLimit : 0;
+			record->flags |= j->IsMotorEnabled() ? e_jointEnableMotor : 0;
+		}
+		return true;
+
+	case e_distanceJoint:
+		{
+			b2DistanceJoint* j = (b2DistanceJoint*)joint;
+			PutVec2(v, 0, j->GetLocalAnchorA());
+			PutVec2(v, 2, j->GetLocalAnchorB());
+			v[4] = j->GetLength();
+			v[5] = j->GetFrequency();
+			v[6] = j->GetDampingRatio();
+		}
+		return true;
+
+	case e_pulleyJoint:
+		{
+			// The local anchors are not exposed; going through world space
+			// may cost an ulp.
+			b2PulleyJoint* j = (b2PulleyJoint*)joint;
+			PutVec2(v, 0, j->GetGroundAnchorA());
+			PutVec2(v, 2, j->GetGroundAnchorB());
+			PutVec2(v, 4, j->GetBodyA()->GetLocalPoint(j->GetAnchorA()));
+			PutVec2(v, 6, j->GetBodyB()->GetLocalPoint(j->GetAnchorB()));
+			v[8] = j->GetLengthA();
+			v[9] = j->GetLengthB();
+			v[10] = j->GetRatio();
+		}
+		return true;
+
+	case e_gearJoint:
+		{
+			b2GearJoint* j = (b2GearJoint*)joint;
+			std::unordered_map<const b2Joint*, int32>::const_iterator it1 = jointIndices.find(j->GetJoint1());
+			std::unordered_map<const b2Joint*, int32>::const_iterator it2 = jointIndices.find(j->GetJoint2());
+			if (it1 == jointIndices.end() || it2 == jointIndices.end())
+			{
+				return false;
+			}
+			record->joint1 = it1->second;
+			record->joint2 = it2->second;
+			v[0] = j->GetRatio();
+		}
+		return true;
+
+	case e_wheelJoint:
+		{
+			b2WheelJoint* j = (b2WheelJoint*)joint;
+			PutVec2(v, 0, j->GetLocalAnchorA());
+			PutVec2(v, 2, j->GetLocalAnchorB());
+			PutVec2(v, 4, j->GetLocalAxisA());
+			v[6] = j->GetMotorSpeed();
+			v[7] = j->GetMaxMotorTorque();
+			v[8] = j->GetSpringFrequencyHz();
+			v[9] = j->GetSpringDampingRatio();
+			record->flags |= j->IsMotorEnabled() ? e_jointEnableMotor : 0;
+		}
+		return true;
+
+	case e_weldJoint:
+		{
+			b2WeldJoint* j = (b2WeldJoint*)joint;
+			PutVec2(v, 0, j->GetLocalAnchorA());
+			PutVec2(v, 2, j->GetLocalAnchorB());
+			v[4] = j->GetReferenceAngle();
+			v[5] = j->GetFrequency();
+			v[6] = j->GetDampingRatio();
+		}
+		return true;
+
+	case e_frictionJoint:
+		{
+			b2FrictionJoint* j = (b2FrictionJoint*)joint;
+			PutVec2(v, 0, j->GetLocalAnchorA());
+			PutVec2(v, 2, j->GetLocalAnchorB());
+			v[4] = j->GetMaxForce();
+			v[5] = j->GetMaxTorque();
+		}
+		return true;
+
+	case e_ropeJoint:
+		{
+			b2RopeJoint* j = (b2RopeJoint*)joint;
+			PutVec2(v, 0, j->GetLocalAnchorA());
+			PutVec2(v, 2, j->GetLocalAnchorB());
+			v[4] = j->GetMaxLength();
+		}
+		return true;
+
+	case e_motorJoint:
+		{
+			b2MotorJoint* j = (b2MotorJoint*)joint;
+			PutVec2(v, 0, j->GetLinearOffset());
+			v[2] = j->GetAngularOffset();
+			v[3] = j->GetMaxForce();
+			v[4] = j->GetMaxTorque();
+			v[5] = j->GetCorrectionFactor();
+		}
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+void WriteWorldData(b2World* world, std::vector<uint8>* data)
+{
+	// The lists run newest first.
+	std::vector<b2Body*> bodies;
+	for (b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+	{
+		bodies.push_back(body);
+	}
+	std::reverse(bodies.begin(), bodies.end());
+
+	std::vector<b2Joint*> joints;
+	for (b2Joint* joint = world->GetJointList(); joint; joint = joint->GetNext())
+	{
+		joints.push_back(joint);
+	}
+	std::reverse(joints.begin(), joints.end());
+
+	std::unordered_map<const b2Body*, int32> bodyIndices;
+	bodyIndices.reserve(bodies.size());
+
+	std::vector<b2Fixture*> fixtures;
+	std::vector<int32> fixtureCounts;
+	for (int32 i = 0; i < (int32)bodies.size(); ++i)
+	{
+		bodyIndices[bodies[i]] = i;
+
+		size_t first = fixtures.size();
+		for (b2Fixture* fixture = bodies[i]->GetFixtureList(); fixture; fixture = fixture->GetNext())
+		{
+			fixtures.push_back(fixture);
+		}
+		std::reverse(fixtures.begin() + first, fixtures.end());
+		fixtureCounts.push_back((int32)(fixtures.size() - first));
+	}
+
+	std::vector<b2Vec2> vertices;
+	std::vector<WorldFileFixture> fixtureRecords(fixtures.size());
+	for (int32 i = 0; i < (int32)fixtures.size(); ++i)
+	{
+		const b2Fixture* fixture = fixtures[i];
+		const b2Shape* shape = fixture->GetShape();
+		const b2Filter& filter = fixture->GetFilterData();
+
+		WorldFileFixture* record = &fixtureRecords[i];
+		*record = WorldFileFixture();
+		record->shapeType = shape->GetType();
+		record->radius = shape->m_radius;
+		record->friction = fixture->GetFriction();
+		record->restitution = fixture->GetRestitution();
+		record->density = fixture->GetDensity();
+		record->categoryBits = filter.categoryBits;
+		record->maskBits = filter.maskBits;
+		record->groupIndex = filter.groupIndex;
+		record->flags = fixture->IsSensor() ? e_fixtureSensor : 0;
+		record->firstVertex = (int32)vertices.size();
+
+		switch (shape->GetType())
+		{
+		case b2Shape::e_circle:
+			vertices.push_back(((const b2CircleShape*)shape)->m_p);
+			break;
+
+		case b2Shape::e_edge:
+			{
+				const b2EdgeShape* edge = (const b2EdgeShape*)shape;
+				vertices.push_back(edge->m_vertex0);
+				vertices.push_back(edge->m_vertex1);
+				vertices.push_back(edge->m_vertex2);
+				vertices.push_back(edge->m_vertex3);
+				record->flags |= edge->m_hasVertex0 ? e_fixtureHasVertex0 : 0;
+				record->flags |= edge->m_hasVertex3 ? e_fixtureHasVertex3 : 0;
+			}
+			break;
+
+		case b2Shape::e_polygon:
+			{
+				const b2PolygonShape* polygon = (const b2PolygonShape*)shape;
+				vertices.insert(vertices.end(), polygon->m_vertices, polygon->m_vertices + polygon->m_count);
+				vertices.insert(vertices.end(), polygon->m_normals, polygon->m_normals + polygon->m_count);
+				vertices.push_back(polygon->m_centroid);
+			}
+			break;
+
+		case b2Shape::e_chain:
+			{
+				const b2ChainShape* chain = (const b2ChainShape*)shape;
+				vertices.insert(vertices.end(), chain->m_vertices, chain->m_vertices + chain->m_count);
+				vertices.push_back(chain->m_prevVertex);
+				vertices.push_back(chain->m_nextVertex);
+				record->flags |= chain->m_hasPrevVertex ? e_fixtureHasVertex0 : 0;
+				record->flags |= chain->m_hasNextVertex ? e_fixtureHasVertex3 : 0;
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		record->vertexCount = (int32)vertices.size() - record->firstVertex;
+	}
+
+	std::unordered_map<const b2Joint*, int32> jointIndices;
+	std::vector<WorldFileJoint> jointRecords;
+	for (int32 i = 0; i < (int32)joints.size(); ++i)
+	{
+		b2Joint* joint = joints[i];
+
+		WorldFileJoint record = WorldFileJoint();
+		record.type = joint->GetType();
+		record.flags = joint->GetCollideConnected() ? e_jointCollideConnected : 0;
+		record.bodyA = bodyIndices[joint->GetBodyA()];
+		record.bodyB = bodyIndices[joint->GetBodyB()];
+		if (WriteJoint(&record, joint, jointIndices))
+		{
+			jointIndices[joint] = (int32)jointRecords.size();
+			jointRecords.push_back(record);
+		}
+	}
+
+	data->resize(0);
+
+	WorldFileHeader* header = Append<WorldFileHeader>(data, 1);
+	header->magic = k_worldFileMagic;
+	header->version = k_worldFileVersion;
+	header->bodyCount = (int32)bodies.size();
+	header->fixtureCount = (int32)fixtures.size();
+	header->vertexCount = (int32)vertices.size();
+	header->jointCount = (int32)jointRecords.size();
+	header->gravity = world->GetGravity();
+
+	WorldFileBody* bodyRecords = Append<WorldFileBody>(data, (int32)bodies.size());
+	for (int32 i = 0; i < (int32)bodies.size(); ++i)
+	{
+		const b2Body* body = bodies[i];
+		WorldFileBody* record = bodyRecords + i;
+		*record = WorldFileBody();
+		record->type = body->GetType();
+		record->flags |= body->IsSleepingAllowed() ? e_bodyAllowSleep : 0;
+		record->flags |= body->IsAwake() ? e_bodyAwake : 0;
+		record->flags |= body->IsFixedRotation() ? e_bodyFixedRotation : 0;
+		record->flags |= body->IsBullet() ? e_bodyBullet : 0;
+		record->flags |= body->IsActive() ? e_bodyActive : 0;
+		record->position = body->GetPosition();
+		record->angle = body->GetAngle();
+		record->linearVelocity = body->GetLinearVelocity();
+		record->angularVelocity = body->GetAngularVelocity();
+		record->linearDamping = body->GetLinearDamping();
+		record->angularDamping = body->GetAngularDamping();
+		record->gravityScale = body->GetGravityScale();
+		record->fixtureCount = fixtureCounts[i];
+	}
+
+	// Append may move the buffer, so records are copied in whole.
+	if (fixtureRecords.empty() == false)
+	{
+		memcpy(Append<WorldFileFixture>(data, (int32)fixtureRecords.size()), fixtureRecords.data(), fixtureRecords.size() * sizeof(WorldFileFixture));
+	}
+	if (vertices.empty() == false)
+	{
+		memcpy(Append<b2Vec2>(data, (int32)vertices.size()), vertices.data(), vertices.size() * sizeof(b2Vec2));
+	}
+	if (jointRecords.empty() == false)
+	{
+		memcpy(Append<WorldFileJoint>(data, (int32)jointRecords.size()), jointRecords.data(), jointRecords.size() * sizeof(WorldFileJoint));
+	}
+}
+
+bool SaveWorldFile(b2World* world, const char* path, WorldFileStats* stats)
+{
+	std::vector<uint8> data;
+	WriteWorldData(world, &data);
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+	written = fclose(file) == 0 && written;
+
+	if (stats != NULL)
+	{
+		const WorldFileHeader* header = (const WorldFileHeader*)data.data();
+		stats->bodyCount = header->bodyCount;
+		stats->fixtureCount = header->fixtureCount;
+		stats->jointCount = header->jointCount;
+		stats->byteCount = (int32)data.size();
+	}
+
+	return written;
+}
+
+static b2Joint* ReadJoint(b2World* world, const WorldFileJoint* record, b2Body** bodies, b2Joint** joints)
+{
+	const float32* v = record->values;
+	bool enableLimit = (record->flags & e_jointEnableLimit) != 0;
+	bool enableMotor = (record->flags & e_jointEnableMotor) != 0;
+
+	b2RevoluteJointDef revolute;
+	b2PrismaticJointDef prismatic;
+	b2DistanceJointDef distance;
+	b2PulleyJointDef pulley;
+	b2GearJointDef gear;
+	b2WheelJointDef wheel;
+	b2WeldJointDef weld;
+	b2FrictionJointDef friction;
+	b2RopeJointDef rope;
+	b2MotorJointDef motor;
+
+	b2JointDef* def = NULL;
+	switch (record->type)
+	{
+	case e_revoluteJoint:
+		revolute.localAnchorA = GetVec2(v, 0);
+		revolute.localAnchorB = GetVec2(v, 2);
+		revolute.referenceAngle = v[4];
+		revolute.lowerAngle = v[5];
+		revolute.upperAngle = v[6];
+		revolute.motorSpeed = v[7];
+		revolute.maxMotorTorque = v[8];
+		revolute.enableLimit = enableLimit;
+		revolute.enableMotor = enableMotor;
+		def = &revolute;
+		break;
+
+	case e_prismaticJoint:
+		prismatic.localAnchorA = GetVec2(v, 0);
+		prismatic.localAnchorB = GetVec2(v, 2);
+		prismatic.localAxisA = GetVec2(v, 4);
+		prismatic.referenceAngle = v[6];
+		prismatic.lowerTranslation = v[7];
+		prismatic.upperTranslation = v[8];
+		prismatic.motorSpeed = v[9];
+		prismatic.maxMotorForce = v[10];
+		prismatic.enableLimit = enableLimit;
+		prismatic.enableMotor = enableMotor;
+		def = &prismatic;
+		break;
+
+	case e_distanceJoint:
+		distance.localAnchorA = GetVec2(v, 0);
+		distance.localAnchorB = GetVec2(v, 2);
+		distance.length = v[4];
+		distance.frequencyHz = v[5];
+		distance.dampingRatio = v[6];
+		def = &distance;
+		break;
+
+	case e_pulleyJoint:
+		pulley.groundAnchorA = GetVec2(v, 0);
+		pulley.groundAnchorB = GetVec2(v, 2);
+		pulley.localAnchorA = GetVec2(v, 4);
+		pulley.localAnchorB = GetVec2(v, 6);
+		pulley.lengthA = v[8];
+		pulley.lengthB = v[9];
+		pulley.ratio = v[10];
+		def = &pulley;
+		break;
+
+	case e_gearJoint:
+		gear.joint1 = joints[record->joint1];
+		gear.joint2 = joints[record->joint2];
+		gear.ratio = v[0];
+		def = &gear;
+		break;
+
+	case e_wheelJoint:
+		wheel.localAnchorA = GetVec2(v, 0);
+		wheel.localAnchorB = GetVec2(v, 2);
+		wheel.localAxisA = GetVec2(v, 4);
+		wheel.motorSpeed = v[6];
+		wheel.maxMotorTorque = v[7];
+		wheel.frequencyHz = v[8];
+		wheel.dampingRatio = v[9];
+		wheel.enableMotor = enableMotor;
+		def = &wheel;
+		break;
+
+	case e_weldJoint:
+		weld.localAnchorA = GetVec2(v, 0);
+		weld.localAnchorB = GetVec2(v, 2);
+		weld.referenceAngle = v[4];
+		weld.frequencyHz = v[5];
+		weld.dampingRatio = v[6];
+		def = &weld;
+		break;
+
+	case e_frictionJoint:
+		friction.localAnchorA = GetVec2(v, 0);
+		friction.localAnchorB = GetVec2(v, 2);
+		friction.maxForce = v[4];
+		friction.maxTorque = v[5];
+		def = &friction;
+		break;
+
+	case e_ropeJoint:
+		rope.localAnchorA = GetVec2(v, 0);
+		rope.localAnchorB = GetVec2(v, 2);
+		rope.maxLength = v[4];
+		def = &rope;
+		break;
+
+	case e_motorJoint:
+		motor.linearOffset = GetVec2(v, 0);
+		motor.angularOffset = v[2];
+		motor.maxForce = v[3];
+		motor.maxTorque = v[4];
+		motor.correctionFactor = v[5];
+		def = &motor;
+		break;
+
+	default:
+		return NULL;
+	}
+
+	def->bodyA = bodies[record->bodyA];
+	def->bodyB = bodies[record->bodyB];
+	def->collideConnected = (record->flags & e_jointCollideConnected) != 0;
+	return world->CreateJoint(def);
+}
+
+// Whether a count of records of the given size can be in a file of size bytes.
+static bool IsCountInRange(int32 count, size_t recordSize, int32 size)
+{
+	return 0 <= count && (size_t)count <= (size_t)size / recordSize;
+}
+
+// The vertices a fixture record of each shape type must have; see
+// WorldFileFixture.
+static bool IsFixtureValid(const WorldFileFixture* record, int32 vertexCount)
+{
+	if (record->firstVertex < 0 || record->vertexCount < 0 || record->firstVertex > vertexCount - record->vertexCount)
+	{
+		return false;
+	}
+
+	switch (record->shapeType)
+	{
+	case b2Shape::e_circle:
+		return record->vertexCount == 1;
+
+	case b2Shape::e_edge:
+		return record->vertexCount == 4;
+
+	case b2Shape::e_polygon:
+		{
+			int32 count = (record->vertexCount - 1) / 2;
+			return record->vertexCount == 2 * count + 1 && 3 <= count && count <= b2_maxPolygonVertices;
+		}
+
+	case b2Shape::e_chain:
+		return record->vertexCount >= 4;
+
+	default:
+		return false;
+	}
+}
+
+static bool IsJointTypeStored(int32 type)
+{
+	switch (type)
+	{
+	case e_revoluteJoint:
+	case e_prismaticJoint:
+	case e_distanceJoint:
+	case e_pulleyJoint:
+	case e_gearJoint:
+	case e_wheelJoint:
+	case e_weldJoint:
+	case e_frictionJoint:
+	case e_ropeJoint:
+	case e_motorJoint:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+// Checks every index and count in the records, so that loading cannot
+// read outside the data or hand Box2D a def it would assert on.
+static bool IsWorldDataValid(const WorldFileHeader* header, const WorldFileBody* bodyRecords,
+	const WorldFileFixture* fixtureRecords, const WorldFileJoint* jointRecords)
+{
+	int64_t fixtureCount = 0;
+	for (int32 i = 0; i < header->bodyCount; ++i)
+	{
+		const WorldFileBody* record = bodyRecords + i;
+		if (record->type < b2_staticBody || record->type > b2_dynamicBody || record->fixtureCount < 0)
+		{
+			return false;
+		}
+		fixtureCount += record->fixtureCount;
+	}
+
+	if (fixtureCount != header->fixtureCount)
+	{
+		return false;
+	}
+
+	for (int32 i = 0; i < header->fixtureCount; ++i)
+	{
+		if (IsFixtureValid(fixtureRecords + i, header->vertexCount) == false)
+		{
+			return false;
+		}
+	}
+
+	for (int32 i = 0; i < header->jointCount; ++i)
+	{
+		const WorldFileJoint* record = jointRecords + i;
+		if (IsJointTypeStored(record->type) == false)
+		{
+			return false;
+		}
+
+		if (record->bodyA < 0 || record->bodyA >= header->bodyCount || record->bodyB < 0 || record->bodyB >= header->bodyCount)
+		{
+			return false;
+		}
+
+		// Gears join earlier revolute or prismatic joints.
+		if (record->type == e_gearJoint)
+		{
+			int32 joints[2] = { record->joint1, record->joint2 };
+			for (int32 j = 0; j < 2; ++j)
+			{
+				if (joints[j] < 0 || joints[j] >= i)
+				{
+					return false;
+				}
+
+				int32 type = jointRecords[joints[j]].type;
+				if (type != e_revoluteJoint && type != e_prismaticJoint)
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+bool LoadWorldData(b2World* world, const void* data, int32 size, WorldFileStats* stats)
+{
+	if (size < (int32)sizeof(WorldFileHeader))
+	{
+		return false;
+	}
+
+	const WorldFileHeader* header = (const WorldFileHeader*)data;
+	if (header->magic != k_worldFileMagic || header->version != k_worldFileVersion)
+	{
+		return false;
+	}
+
+	// Each count is bounded by the size first, so the sum cannot overflow.
+	if (IsCountInRange(header->bodyCount, sizeof(WorldFileBody), size) == false
+		|| IsCountInRange(header->fixtureCount, sizeof(WorldFileFixture), size) == false
+		|| IsCountInRange(header->vertexCount, sizeof(b2Vec2), size) == false
+		|| IsCountInRange(header->jointCount, sizeof(WorldFileJoint), size) == false)
+	{
+		return false;
+	}
+
+	size_t expected = sizeof(WorldFileHeader) + (size_t)header->bodyCount * sizeof(WorldFileBody)
+		+ (size_t)header->fixtureCount * sizeof(WorldFileFixture) + (size_t)header->vertexCount * sizeof(b2Vec2)
+		+ (size_t)header->jointCount * sizeof(WorldFileJoint);
+	if ((size_t)size != expected)
+	{
+		return false;
+	}
+
+	const WorldFileBody* bodyRecords = (const WorldFileBody*)(header + 1);
+	const WorldFileFixture* fixtureRecords = (const WorldFileFixture*)(bodyRecords + header->bodyCount);
+	const b2Vec2* vertices = (const b2Vec2*)(fixtureRecords + header->fixtureCount);
+	const WorldFileJoint* jointRecords = (const WorldFileJoint*)(vertices + header->vertexCount);
+
+	if (IsWorldDataValid(header, bodyRecords, fixtureRecords, jointRecords) == false)
+	{
+		return false;
+	}
+
+	world->SetGravity(header->gravity);
+
+	// One allocation for all the body and joint pointers.
+	int32 pointerCount = header->bodyCount + header->jointCount;
+	b2Body** bodies = (b2Body**)b2Alloc(b2Max(pointerCount, 1) * sizeof(void*));
+	b2Joint** joints = (b2Joint**)(bodies + header->bodyCount);
+
+	// The shapes are filled in from the records, never through Set, and
+	// CreateFixture copies them.
+	b2CircleShape circle;
+	b2EdgeShape edge;
+	b2PolygonShape polygon;
+	b2ChainShape chain;
+
+	const WorldFileFixture* fixtureRecord = fixtureRecords;
+	for (int32 i = 0; i < header->bodyCount; ++i)
+	{
+		const WorldFileBody* record = bodyRecords + i;
+
+		b2BodyDef bd;
+		bd.type = (b2BodyType)record->type;
+		bd.position = record->position;
+		bd.angle = record->angle;
+		bd.linearVelocity = record->linearVelocity;
+		bd.angularVelocity = record->angularVelocity;
+		bd.linearDamping = record->linearDamping;
+		bd.angularDamping = record->angularDamping;
+		bd.gravityScale = record->gravityScale;
+		bd.allowSleep = (record->flags & e_bodyAllowSleep) != 0;
+		bd.awake = (record->flags & e_bodyAwake) != 0;
+		bd.fixedRotation = (record->flags & e_bodyFixedRotation) != 0;
+		bd.bullet = (record->flags & e_bodyBullet) != 0;
+		bd.active = (record->flags & e_bodyActive) != 0;
+		b2Body* body = world->CreateBody(&bd);
+		bodies[i] = body;
+
+		// CreateFixture recomputes the mass after every fixture with
+		// density; creating them all massless and computing it once gives
+		// the same mass at a fraction of the cost for compound bodies.
+		bool hasMass = false;
+		for (int32 j = 0; j < record->fixtureCount; ++j, ++fixtureRecord)
+		{
+			const b2Vec2* v = vertices + fixtureRecord->firstVertex;
+			bool hasVertex0 = (fixtureRecord->flags & e_fixtureHasVertex0) != 0;
+			bool hasVertex3 = (fixtureRecord->flags & e_fixtureHasVertex3) != 0;
+
+			b2Shape* shape = NULL;
+			switch (fixtureRecord->shapeType)
+			{
+			case b2Shape::e_circle:
+				circle.m_p = v[0];
+				shape = &circle;
+				break;
+
+			case b2Shape::e_edge:
+				edge.m_vertex0 = v[0];
+				edge.m_vertex1 = v[1];
+				edge.m_vertex2 = v[2];
+				edge.m_vertex3 = v[3];
+				edge.m_hasVertex0 = hasVertex0;
+				edge.m_hasVertex3 = hasVertex3;
+				shape = &edge;
+				break;
+
+			case b2Shape::e_polygon:
+				{
+					int32 count = (fixtureRecord->vertexCount - 1) / 2;
+					polygon.m_count = count;
+					memcpy(polygon.m_vertices, v, count * sizeof(b2Vec2));
+					memcpy(polygon.m_normals, v + count, count * sizeof(b2Vec2));
+					polygon.m_centroid = v[2 * count];
+					shape = &polygon;
+				}
+				break;
+
+			case b2Shape::e_chain:
+				// Points into the file; CreateFixture clones the vertices.
+				chain.m_vertices = (b2Vec2*)v;
+				chain.m_count = fixtureRecord->vertexCount - 2;
+				chain.m_prevVertex = v[chain.m_count];
+				chain.m_nextVertex = v[chain.m_count + 1];
+				chain.m_hasPrevVertex = hasVertex0;
+				chain.m_hasNextVertex = hasVertex3;
+				shape = &chain;
+				break;
+
+			default:
+				continue;
+			}
+			shape->m_radius = fixtureRecord->radius;
+
+			b2FixtureDef fd;
+			fd.shape = shape;
+			fd.friction = fixtureRecord->friction;
+			fd.restitution = fixtureRecord->restitution;
+			fd.density = 0.0f;
+			fd.isSensor = (fixtureRecord->flags & e_fixtureSensor) != 0;
+			fd.filter.categoryBits = fixtureRecord->categoryBits;
+			fd.filter.maskBits = fixtureRecord->maskBits;
+			fd.filter.groupIndex = fixtureRecord->groupIndex;
+			b2Fixture* fixture = body->CreateFixture(&fd);
+
+			if (fixtureRecord->density > 0.0f)
+			{
+				fixture->SetDensity(fixtureRecord->density);
+				hasMass = true;
+			}
+		}
+
+		if (hasMass)
+		{
+			body->ResetMassData();
+		}
+	}
+
+	// The chain must not free the file's vertices.
+	chain.m_vertices = NULL;
+	chain.m_count = 0;
+
+	// Validation leaves ReadJoint only types it knows.
+	for (int32 i = 0; i < header->jointCount; ++i)
+	{
+		joints[i] = ReadJoint(world, jointRecords + i, bodies, joints);
+		b2Assert(joints[i] != NULL);
+	}
+
+	b2Free(bodies);
+
+	if (stats != NULL)
+	{
+		stats->bodyCount = header->bodyCount;
+		stats->fixtureCount = header->fixtureCount;
+		stats->jointCount = header->jointCount;
+		stats->byteCount = size;
+	}
+
+	return true;
+}
+
+bool LoadWorldFile(b2World* world, const char* path, WorldFileStats* stats)
+{
+#if WORLD_FILE_HAS_MMAP
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	size_t size = (size_t)info.st_size;
+	void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+
+	// The records are read front to back once.
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	bool loaded = LoadWorldData(world, data, (int32)size, stats);
+	munmap(data, size);
+	return loaded;
+#else
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	std::vector<uint8> data;
+	uint8 buffer[64 * 1024];
+	size_t count;
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		data.insert(data.end(), buffer, buffer + count);
+	}
+	fclose(file);
+
+	return LoadWorldData(world, data.data(), (int32)data.size(), stats);
+#endif
+}
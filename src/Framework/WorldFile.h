@@ -0,0 +1,41 @@
+#pragma once
+#include "Box2D/Box2D.h"
+#include <vector>
+
+// Binary world files: a header and then flat arrays of fixed-size records
+// for bodies, fixtures, shape vertices and joints. Everything is 4-byte
+// aligned, in host byte order, so the loader reads the records in place from
+// the mapped file instead of parsing them. Polygons keep their normals and
+// centroid and chains their final vertices, so loading never runs
+// b2PolygonShape::Set or CreateLoop.
+//
+// Bodies, fixtures and joints are written in creation order, so a loaded
+// world has the same lists, proxy ids and step results as the one saved,
+// up to the contacts, which are found again on the first step. Not stored:
+// user data, mass data set by hand, mouse joints (as b2World::Dump) and
+// the world's flags.
+
+// Where the testbed's Save World button writes the current test's world.
+const char* const k_worldFilePath = "testbed.b2w";
+
+struct WorldFileStats
+{
+	WorldFileStats();
+
+	int32 bodyCount;
+	int32 fixtureCount;
+	int32 jointCount;
+	int32 byteCount;
+};
+
+void WriteWorldData(b2World* world, std::vector<uint8>* data);
+bool SaveWorldFile(b2World* world, const char* path, WorldFileStats* stats = NULL);
+
+// Adds the file's bodies and joints to the world and sets its gravity.
+// Returns false without touching the world if the data is not a world file
+// of this version, or if any count, index, shape vertex count or body or
+// joint type in it is out of range.
+bool LoadWorldData(b2World* world, const void* data, int32 size, WorldFileStats* stats = NULL);
+
+// Maps the file where the platform can and reads it otherwise.
+bool LoadWorldFile(b2World* world, const char* path, WorldFileStats* stats = NULL);
@@ -0,0 +1,957 @@
+#include "WorldSnapshot.h"
+#include <algorithm>
+
+WorldSnapshot::WorldSnapshot()
+{
+	m_version = 0;
+	m_stepIndex = 0;
+	m_buildTime = 0.0f;
+	m_root = b2_nullNode;
+	m_layoutVersion = 0;
+	m_cost = 0.0f;
+	m_buildCost = 0.0f;
+	m_changedCount = 0;
+	m_rebuilt = false;
+}
+
+// Refitting keeps the split of the last build. Once the node bounds have
+// grown by this factor, a fresh median split costs less than the queries
+// lose to the loose tree.
+static const float32 k_maxRefitGrowth = 1.5f;
+
+void WorldSnapshot::Build(const b2World* world, uint32 version, int32 stepIndex)
+{
+	b2Timer timer;
+
+	m_version = version;
+	m_stepIndex = stepIndex;
+	Collect(world);
+	BuildTree();
+	m_layoutVersion = version;
+	m_changedCount = (int32)m_proxies.size();
+
+	m_buildTime = timer.GetMilliseconds();
+}
+
+void WorldSnapshot::Collect(const b2World* world)
+{
+	m_walkProxies.clear();
+	m_circles.clear();
+	m_edges.clear();
+	m_polygons.clear();
+
+	for (const b2Body* body = world->GetBodyList(); body; body = body->GetNext())
+	{
+		if (body->IsActive() == false)
+		{
+			continue;
+		}
+
+		const b2Transform& xf = body->GetTransform();
+		for (const b2Fixture* fixture = body->GetFixtureList(); fixture; fixture = fixture->GetNext())
+		{
+			const b2Shape* shape = fixture->GetShape();
+
+			SnapshotProxy proxy;
+			proxy.xf = xf;
+			proxy.fixture = fixture;
+			proxy.fixtureUserData = fixture->GetUserData();
+			proxy.bodyUserData = body->GetUserData();
+			proxy.filter = fixture->GetFilterData();
+			proxy.bodyType = body->GetType();
+			proxy.isSensor = fixture->IsSensor();
+
+			int32 childCount = shape->GetChildCount();
+			for (int32 child = 0; child < childCount; ++child)
+			{
+				proxy.childIndex = child;
+				switch (shape->GetType())
+				{
+				case b2Shape::e_circle:
+					proxy.shapeType = b2Shape::e_circle;
+					proxy.shapeIndex = (int32)m_circles.size();
+					m_circles.push_back(*(const b2CircleShape*)shape);
+					break;
+
+				case b2Shape::e_edge:
+					proxy.shapeType = b2Shape::e_edge;
+					proxy.shapeIndex = (int32)m_edges.size();
+					m_edges.push_back(*(const b2EdgeShape*)shape);
+					break;
+
+				case b2Shape::e_polygon:
+					proxy.shapeType = b2Shape::e_polygon;
+					proxy.shapeIndex = (int32)m_polygons.size();
+					m_polygons.push_back(*(const b2PolygonShape*)shape);
+					break;
+
+				case b2Shape::e_chain:
+					{
+						// Chains keep their vertices on the heap, so copy each
+						// child out as an edge instead of sharing the buffer.
+						b2EdgeShape edge;
+						((const b2ChainShape*)shape)->GetChildEdge(&edge, child);
+						proxy.shapeType = b2Shape::e_edge;
+						proxy.shapeIndex = (int32)m_edges.size();
+						m_edges.push_back(edge);
+					}
+					break;
+
+				default:
+					continue;
+				}
+
+				// Tight bounds: the snapshot never moves, so it needs no fattening.
+				GetShape(proxy)->ComputeAABB(&proxy.aabb, xf, 0);
+				m_walkProxies.push_back(proxy);
+			}
+		}
+	}
+}
+
+static bool SameTransform(const b2Transform& a, const b2Transform& b)
+{
+	return a.p == b.p && a.q.s == b.q.s && a.q.c == b.q.c;
+}
+
+// Whether child childIndex of the world's shape still matches the copy.
+// Fixtures are known by address, and the block allocator hands a destroyed
+// fixture's memory to the next one created, so the geometry is compared
+// rather than trusted.
+static bool SameGeometry(const b2Shape* shape, int32 childIndex, const b2Shape* copy)
+{
+	if (shape->m_radius != copy->m_radius)
+	{
+		return false;
+	}
+
+	switch (shape->GetType())
+	{
+	case b2Shape::e_circle:
+		return copy->GetType() == b2Shape::e_circle
+			&& ((const b2CircleShape*)shape)->m_p == ((const b2CircleShape*)copy)->m_p;
+
+	case b2Shape::e_edge:
+		{
+			if (copy->GetType() != b2Shape::e_edge)
+			{
+				return false;
+			}
+			const b2EdgeShape* a = (const b2EdgeShape*)shape;
+			const b2EdgeShape* b = (const b2EdgeShape*)copy;
+			return a->m_vertex1 == b->m_vertex1 && a->m_vertex2 == b->m_vertex2;
+		}
+
+	case b2Shape::e_polygon:
+		{
+			if (copy->GetType() != b2Shape::e_polygon)
+			{
+				return false;
+			}
+			const b2PolygonShape* a = (const b2PolygonShape*)shape;
+			const b2PolygonShape* b = (const b2PolygonShape*)copy;
+			if (a->m_count != b->m_count)
+			{
+				return false;
+			}
+			for (int32 i = 0; i < a->m_count; ++i)
+			{
+				if (a->m_vertices[i] != b->m_vertices[i])
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	case b2Shape::e_chain:
+		{
+			if (copy->GetType() != b2Shape::e_edge)
+			{
+				return false;
+			}
+			b2EdgeShape edge;
+			((const b2ChainShape*)shape)->GetChildEdge(&edge, childIndex);
+			const b2EdgeShape* b = (const b2EdgeShape*)copy;
+			return edge.m_vertex1 == b->m_vertex1 && edge.m_vertex2 == b->m_vertex2;
+		}
+
+	default:
+		return false;
+	}
+}
+
+void WorldSnapshot::Update(const b2World* world, uint32 version, int32 stepIndex, const WorldSnapshot* previous)
+{
+	if (previous == NULL)
+	{
+		Build(world, version, stepIndex);
+		return;
+	}
+
+	b2Timer timer;
+
+	m_version = version;
+	m_stepIndex = stepIndex;
+
+	// A buffer from the pool usually still has the layout it had a publish
+	// or two ago; only when the layout moved on since is it copied over.
+	if (previous != this && m_layoutVersion != previous->m_layoutVersion)
+	{
+		m_proxies = previous->m_proxies;
+		m_nodes = previous->m_nodes;
+		m_circles = previous->m_circles;
+		m_edges = previous->m_edges;
+		m_polygons = previous->m_polygons;
+		m_root = previous->m_root;
+		m_slots = previous->m_slots;
+		m_leaves = previous->m_leaves;
+		m_layoutVersion = previous->m_layoutVersion;
+		m_cost = previous->m_cost;
+		m_buildCost = previous->m_buildCost;
+	}
+
+	m_dirty.assign(m_nodes.size(), 0);
+	m_changedCount = 0;
+
+	int32 walkCount = (int32)m_slots.size();
+	int32 walk = 0;
+	bool sameLayout = true;
+	for (const b2Body* body = world->GetBodyList(); body && sameLayout; body = body->GetNext())
+	{
+		if (body->IsActive() == false)
+		{
+			continue;
+		}
+
+		const b2Transform& xf = body->GetTransform();
+		for (const b2Fixture* fixture = body->GetFixtureList(); fixture && sameLayout; fixture = fixture->GetNext())
+		{
+			const b2Shape* shape = fixture->GetShape();
+			int32 childCount = shape->GetChildCount();
+			for (int32 child = 0; child < childCount; ++child)
+			{
+				if (walk == walkCount)
+				{
+					sameLayout = false;
+					break;
+				}
+
+				int32 slot = m_slots[walk++];
+				SnapshotProxy& proxy = m_proxies[slot];
+				if (proxy.fixture != fixture || proxy.childIndex != child || SameGeometry(shape, child, GetShape(proxy)) == false)
+				{
+					sameLayout = false;
+					break;
+				}
+
+				// Cheap to copy and not worth tracking.
+				proxy.fixtureUserData = fixture->GetUserData();
+				proxy.bodyUserData = body->GetUserData();
+				proxy.filter = fixture->GetFilterData();
+				proxy.bodyType = body->GetType();
+				proxy.isSensor = fixture->IsSensor();
+
+				if (SameTransform(proxy.xf, xf) == false)
+				{
+					proxy.xf = xf;
+					GetShape(proxy)->ComputeAABB(&proxy.aabb, xf, 0);
+					m_dirty[m_leaves[slot]] = 1;
+					++m_changedCount;
+				}
+			}
+		}
+	}
+
+	if (sameLayout == false || walk != walkCount)
+	{
+		Collect(world);
+		BuildTree();
+		m_layoutVersion = version;
+		m_changedCount = (int32)m_proxies.size();
+	}
+	else
+	{
+		Refit();
+		m_rebuilt = false;
+
+		if (m_cost > k_maxRefitGrowth * m_buildCost)
+		{
+			// Back to world walk order, which BuildTree starts from.
+			m_walkProxies.resize(walkCount);
+			for (int32 i = 0; i < walkCount; ++i)
+			{
+				m_walkProxies[i] = m_proxies[m_slots[i]];
+			}
+			BuildTree();
+			m_layoutVersion = version;
+		}
+	}
+
+	m_buildTime = timer.GetMilliseconds();
+}
+
+void WorldSnapshot::Refit()
+{
+	// Children come after their parent, so a backwards pass sees both
+	// children of a node before the node itself.
+	for (int32 i = (int32)m_nodes.size() - 1; i >= 0; --i)
+	{
+		Node& node = m_nodes[i];
+		b2AABB aabb;
+		if (node.child1 == b2_nullNode)
+		{
+			if (m_dirty[i] == 0)
+			{
+				continue;
+			}
+
+			aabb = m_proxies[node.start].aabb;
+			for (int32 j = node.start + 1; j < node.start + node.count; ++j)
+			{
+				aabb.Combine(m_proxies[j].aabb);
+			}
+		}
+		else
+		{
+			if (m_dirty[node.child1] == 0 && m_dirty[node.child2] == 0)
+			{
+				continue;
+			}
+
+			m_dirty[i] = 1;
+			aabb.Combine(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+		}
+
+		m_cost += aabb.GetPerimeter() - node.aabb.GetPerimeter();
+		node.aabb = aabb;
+	}
+}
+
+struct SnapshotCenterLess
+{
+	SnapshotCenterLess(const SnapshotProxy* proxies, int32 axis) : proxies(proxies), axis(axis) {}
+
+	bool operator()(int32 a, int32 b) const
+	{
+		// Comparing sums avoids the multiply in GetCenter.
+		const b2AABB& aabbA = proxies[a].aabb;
+		const b2AABB& aabbB = proxies[b].aabb;
+		if (axis == 0)
+		{
+			return aabbA.lowerBound.x + aabbA.upperBound.x < aabbB.lowerBound.x + aabbB.upperBound.x;
+		}
+		return aabbA.lowerBound.y + aabbA.upperBound.y < aabbB.lowerBound.y + aabbB.upperBound.y;
+	}
+
+	const SnapshotProxy* proxies;
+	int32 axis;
+};
+
+void WorldSnapshot::BuildTree()
+{
+	int32 proxyCount = (int32)m_walkProxies.size();
+	m_buildOrder.resize(proxyCount);
+	for (int32 i = 0; i < proxyCount; ++i)
+	{
+		m_buildOrder[i] = i;
+	}
+
+	m_nodes.clear();
+	m_nodes.reserve(2 * proxyCount / e_leafSize + 1);
+	m_leaves.resize(proxyCount);
+	m_cost = 0.0f;
+	m_root = proxyCount == 0 ? b2_nullNode : BuildNode(0, proxyCount);
+	m_buildCost = m_cost;
+
+	// Leaves hold ranges of m_proxies, so the proxies go in tree order.
+	m_proxies.resize(proxyCount);
+	m_slots.resize(proxyCount);
+	for (int32 i = 0; i < proxyCount; ++i)
+	{
+		int32 walk = m_buildOrder[i];
+		m_proxies[i] = m_walkProxies[walk];
+		m_slots[walk] = i;
+	}
+
+	m_rebuilt = true;
+}
+
+int32 WorldSnapshot::BuildNode(int32 start, int32 count)
+{
+	int32 index = (int32)m_nodes.size();
+	m_nodes.push_back(Node());
+
+	const SnapshotProxy* proxies = m_walkProxies.data();
+	b2AABB aabb = proxies[m_buildOrder[start]].aabb;
+	b2Vec2 lowerCenter = aabb.GetCenter();
+	b2Vec2 upperCenter = lowerCenter;
+	for (int32 i = start + 1; i < start + count; ++i)
+	{
+		const b2AABB& proxyAABB = proxies[m_buildOrder[i]].aabb;
+		aabb.Combine(proxyAABB);
+		b2Vec2 c = proxyAABB.GetCenter();
+		lowerCenter = b2Min(lowerCenter, c);
+		upperCenter = b2Max(upperCenter, c);
+	}
+	m_cost += aabb.GetPerimeter();
+
+	if (count <= e_leafSize)
+	{
+		Node& leaf = m_nodes[index];
+		leaf.aabb = aabb;
+		leaf.child1 = b2_nullNode;
+		leaf.child2 = b2_nullNode;
+		leaf.start = start;
+		leaf.count = count;
+		for (int32 i = start; i < start + count; ++i)
+		{
+			m_leaves[i] = index;
+		}
+		return index;
+	}
+
+	// Median split along the longest axis of the proxy centers. Updates
+	// refit rather than rebuild, but a rebuild still needs to be quick.
+	b2Vec2 extent = upperCenter - lowerCenter;
+	int32 axis = extent.x >= extent.y ? 0 : 1;
+	int32 half = count / 2;
+	std::nth_element(m_buildOrder.begin() + start, m_buildOrder.begin() + start + half,
+		m_buildOrder.begin() + start + count, SnapshotCenterLess(proxies, axis));
+
+	int32 child1 = BuildNode(start, half);
+	int32 child2 = BuildNode(start + half, count - half);
+
+	Node& node = m_nodes[index];
+	node.aabb = aabb;
+	node.child1 = child1;
+	node.child2 = child2;
+	node.start = start;
+	node.count = count;
+	return index;
+}
+
+const b2Shape* WorldSnapshot::GetShape(const SnapshotProxy& proxy) const
+{
+	switch (proxy.shapeType)
+	{
+	case b2Shape::e_circle:
+		return &m_circles[proxy.shapeIndex];
+
+	case b2Shape::e_edge:
+		return &m_edges[proxy.shapeIndex];
+
+	case b2Shape::e_polygon:
+		return &m_polygons[proxy.shapeIndex];
+
+	default:
+		b2Assert(false);
+		return NULL;
+	}
+}
+
+bool WorldSnapshot::TestPoint(const SnapshotProxy& proxy, const b2Vec2& p) const
+{
+	return GetShape(proxy)->TestPoint(proxy.xf, p);
+}
+
+// Median splits keep the depth near log2(n / e_leafSize).
+#define SNAPSHOT_STACK_SIZE 64
+
+void WorldSnapshot::QueryAABB(SnapshotQueryCallback* callback, const b2AABB& aabb) const
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	int32 stack[SNAPSHOT_STACK_SIZE];
+	int32 count = 0;
+	stack[count++] = m_root;
+
+	while (count > 0)
+	{
+		const Node& node = m_nodes[stack[--count]];
+		if (b2TestOverlap(node.aabb, aabb) == false)
+		{
+			continue;
+		}
+
+		if (node.child1 == b2_nullNode)
+		{
+			for (int32 i = node.start; i < node.start + node.count; ++i)
+			{
+				const SnapshotProxy& proxy = m_proxies[i];
+				if (b2TestOverlap(proxy.aabb, aabb) && callback->ReportProxy(proxy) == false)
+				{
+					return;
+				}
+			}
+		}
+		else
+		{
+			b2Assert(count + 2 <= SNAPSHOT_STACK_SIZE);
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		}
+	}
+}
+
+void WorldSnapshot::RayCast(SnapshotRayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	b2Vec2 r = point2 - point1;
+	if (r.LengthSquared() <= 0.0f)
+	{
+		return;
+	}
+	r.Normalize();
+
+	// v is perpendicular to the segment.
+	b2Vec2 v = b2Cross(1.0f, r);
+	b2Vec2 abs_v = b2Abs(v);
+
+	b2RayCastInput input;
+	input.p1 = point1;
+	input.p2 = point2;
+	input.maxFraction = 1.0f;
+
+	float32 maxFraction = 1.0f;
+	b2AABB segmentAABB;
+	{
+		b2Vec2 t = point1 + maxFraction * (point2 - point1);
+		segmentAABB.lowerBound = b2Min(point1, t);
+		segmentAABB.upperBound = b2Max(point1, t);
+	}
+
+	int32 stack[SNAPSHOT_STACK_SIZE];
+	int32 count = 0;
+	stack[count++] = m_root;
+
+	while (count > 0)
+	{
+		const Node& node = m_nodes[stack[--count]];
+		if (b2TestOverlap(node.aabb, segmentAABB) == false)
+		{
+			continue;
+		}
+
+		// Separating axis for segment (Gino, p80).
+		// |dot(v, p1 - c)| > dot(|v|, h)
+		b2Vec2 c = node.aabb.GetCenter();
+		b2Vec2 h = node.aabb.GetExtents();
+		float32 separation = b2Abs(b2Dot(v, point1 - c)) - b2Dot(abs_v, h);
+		if (separation > 0.0f)
+		{
+			continue;
+		}
+
+		if (node.child1 != b2_nullNode)
+		{
+			b2Assert(count + 2 <= SNAPSHOT_STACK_SIZE);
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+			continue;
+		}
+
+		for (int32 i = node.start; i < node.start + node.count; ++i)
+		{
+			const SnapshotProxy& proxy = m_proxies[i];
+			if (b2TestOverlap(proxy.aabb, segmentAABB) == false)
+			{
+				continue;
+			}
+
+			input.maxFraction = maxFraction;
+
+			b2RayCastOutput output;
+			if (GetShape(proxy)->RayCast(&output, input, proxy.xf, 0) == false)
+			{
+				continue;
+			}
+
+			float32 fraction = output.fraction;
+			b2Vec2 point = (1.0f - fraction) * point1 + fraction * point2;
+			float32 value = callback->ReportProxy(proxy, point, output.normal, fraction);
+
+			if (value == 0.0f)
+			{
+				// The client has terminated the ray cast.
+				return;
+			}
+
+			if (0.0f < value && value < maxFraction)
+			{
+				// Update segment bounding box.
+				maxFraction = value;
+				b2Vec2 t = point1 + maxFraction * (point2 - point1);
+				segmentAABB.lowerBound = b2Min(point1, t);
+				segmentAABB.upperBound = b2Max(point1, t);
+			}
+		}
+	}
+}
+
+// Squared distance from the point to the box, zero inside.
+static float32 DistanceSquared(const b2AABB& aabb, const b2Vec2& p)
+{
+	b2Vec2 d = b2Max(b2Max(aabb.lowerBound - p, p - aabb.upperBound), b2Vec2_zero);
+	return b2Dot(d, d);
+}
+
+// Min-heap of nodes by their distance bound. Like b2GrowableStack it keeps
+// the usual case inline and only allocates for unusually wide searches.
+class SnapshotNodeQueue
+{
+public:
+	struct Entry
+	{
+		float32 distanceSquared;
+		int32 node;
+	};
+
+	SnapshotNodeQueue()
+	{
+		m_entries = m_array;
+		m_count = 0;
+		m_capacity = e_inlineCount;
+	}
+
+	~SnapshotNodeQueue()
+	{
+		if (m_entries != m_array)
+		{
+			b2Free(m_entries);
+		}
+	}
+
+	void Push(float32 distanceSquared, int32 node)
+	{
+		if (m_count == m_capacity)
+		{
+			Entry* old = m_entries;
+			m_capacity *= 2;
+			m_entries = (Entry*)b2Alloc(m_capacity * sizeof(Entry));
+			memcpy(m_entries, old, m_count * sizeof(Entry));
+			if (old != m_array)
+			{
+				b2Free(old);
+			}
+		}
+
+		m_entries[m_count].distanceSquared = distanceSquared;
+		m_entries[m_count].node = node;
+		++m_count;
+		std::push_heap(m_entries, m_entries + m_count, Greater);
+	}
+
+	Entry Pop()
+	{
+		std::pop_heap(m_entries, m_entries + m_count, Greater);
+		--m_count;
+		return m_entries[m_count];
+	}
+
+	int32 GetCount() const { return m_count; }
+
+private:
+	enum
+	{
+		e_inlineCount = 128
+	};
+
+	static bool Greater(const Entry& a, const Entry& b)
+	{
+		return a.distanceSquared > b.distanceSquared;
+	}
+
+	Entry* m_entries;
+	Entry m_array[e_inlineCount];
+	int32 m_count;
+	int32 m_capacity;
+};
+
+int32 WorldSnapshot::QueryNearest(SnapshotNearestHit* hits, int32 count, const b2Vec2& point, float32 maxDistance) const
+{
+	if (m_root == b2_nullNode || count <= 0)
+	{
+		return 0;
+	}
+
+	// The query point as a zero radius circle, so b2Distance does the work.
+	b2CircleShape pointShape;
+	pointShape.m_p = point;
+	pointShape.m_radius = 0.0f;
+
+	b2DistanceInput input;
+	input.proxyA.Set(&pointShape, 0);
+	input.transformA.SetIdentity();
+	input.useRadii = true;
+
+	// Nothing farther than this can make the list.
+	float32 bound = maxDistance;
+	int32 hitCount = 0;
+
+	SnapshotNodeQueue queue;
+	queue.Push(DistanceSquared(m_nodes[m_root].aabb, point), m_root);
+
+	while (queue.GetCount() > 0)
+	{
+		SnapshotNodeQueue::Entry entry = queue.Pop();
+
+		// Nodes come out nearest first, so the rest are no closer.
+		if (entry.distanceSquared > bound * bound)
+		{
+			break;
+		}
+
+		const Node& node = m_nodes[entry.node];
+		if (node.child1 != b2_nullNode)
+		{
+			float32 distanceSquared1 = DistanceSquared(m_nodes[node.child1].aabb, point);
+			if (distanceSquared1 <= bound * bound)
+			{
+				queue.Push(distanceSquared1, node.child1);
+			}
+
+			float32 distanceSquared2 = DistanceSquared(m_nodes[node.child2].aabb, point);
+			if (distanceSquared2 <= bound * bound)
+			{
+				queue.Push(distanceSquared2, node.child2);
+			}
+			continue;
+		}
+
+		for (int32 i = node.start; i < node.start + node.count; ++i)
+		{
+			const SnapshotProxy& proxy = m_proxies[i];
+
+			// The tight AABB includes the radius, so it bounds the distance.
+			if (DistanceSquared(proxy.aabb, point) > bound * bound)
+			{
+				continue;
+			}
+
+			input.proxyB.Set(GetShape(proxy), 0);
+			input.transformB = proxy.xf;
+
+			b2SimplexCache cache;
+			cache.count = 0;
+			b2DistanceOutput output;
+			b2Distance(&output, &cache, &input);
+
+			if (output.distance > bound || (hitCount == count && output.distance >= bound))
+			{
+				continue;
+			}
+
+			// Insertion into the sorted list, dropping the farthest when full.
+			int32 index = hitCount < count ? hitCount : count - 1;
+			while (index > 0 && hits[index - 1].distance > output.distance)
+			{
+				hits[index] = hits[index - 1];
+				--index;
+			}
+			hits[index].proxy = &proxy;
+			hits[index].point = output.pointB;
+			hits[index].distance = output.distance;
+
+			if (hitCount < count)
+			{
+				++hitCount;
+			}
+
+			if (hitCount == count)
+			{
+				bound = b2Min(bound, hits[count - 1].distance);
+			}
+		}
+	}
+
+	return hitCount;
+}
+
+void WorldSnapshot::QueryShape(SnapshotQueryCallback* callback, const b2Shape* shape, int32 childIndex, const b2Transform& xf) const
+{
+	if (m_root == b2_nullNode)
+	{
+		return;
+	}
+
+	b2AABB aabb;
+	shape->ComputeAABB(&aabb, xf, childIndex);
+
+	// b2TestOverlap rebuilds both proxies per call; the query side is the
+	// same for every candidate, so it is set up once.
+	b2DistanceInput input;
+	input.proxyA.Set(shape, childIndex);
+	input.transformA = xf;
+	input.useRadii = true;
+
+	int32 stack[SNAPSHOT_STACK_SIZE];
+	int32 count = 0;
+	stack[count++] = m_root;
+
+	while (count > 0)
+	{
+		const Node& node = m_nodes[stack[--count]];
+		if (b2TestOverlap(node.aabb, aabb) == false)
+		{
+			continue;
+		}
+
+		if (node.child1 != b2_nullNode)
+		{
+			b2Assert(count + 2 <= SNAPSHOT_STACK_SIZE);
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+			continue;
+		}
+
+		for (int32 i = node.start; i < node.start + node.count; ++i)
+		{
+			const SnapshotProxy& proxy = m_proxies[i];
+			if (b2TestOverlap(proxy.aabb, aabb) == false)
+			{
+				continue;
+			}
+
+			input.proxyB.Set(GetShape(proxy), 0);
+			input.transformB = proxy.xf;
+
+			b2SimplexCache cache;
+			cache.count = 0;
+			b2DistanceOutput output;
+			b2Distance(&output, &cache, &input);
+
+			// Same tolerance as b2TestOverlap.
+			if (output.distance < 10.0f * b2_epsilon && callback->ReportProxy(proxy) == false)
+			{
+				return;
+			}
+		}
+	}
+}
+
+SnapshotHandle::SnapshotHandle()
+{
+	m_snapshot = NULL;
+	m_readers = NULL;
+}
+
+SnapshotHandle::SnapshotHandle(const WorldSnapshot* snapshot, std::atomic<int32>* readers)
+{
+	// The publisher has already counted this reader.
+	m_snapshot = snapshot;
+	m_readers = readers;
+}
+
+SnapshotHandle::SnapshotHandle(const SnapshotHandle& other)
+{
+	m_snapshot = other.m_snapshot;
+	m_readers = other.m_readers;
+	if (m_readers != NULL)
+	{
+		// The other handle keeps the snapshot alive, so nothing to order.
+		m_readers->fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+SnapshotHandle::~SnapshotHandle()
+{
+	Release();
+}
+
+SnapshotHandle& SnapshotHandle::operator=(const SnapshotHandle& other)
+{
+	if (other.m_readers != NULL)
+	{
+		other.m_readers->fetch_add(1, std::memory_order_relaxed);
+	}
+	Release();
+	m_snapshot = other.m_snapshot;
+	m_readers = other.m_readers;
+	return *this;
+}
+
+void SnapshotHandle::Release()
+{
+	if (m_readers != NULL)
+	{
+		// Pairs with the acquire load in Publish: every query made through
+		// this handle happens before the snapshot is rebuilt.
+		m_readers->fetch_sub(1, std::memory_order_release);
+	}
+	m_snapshot = NULL;
+	m_readers = NULL;
+}
+
+SnapshotPublisher::SnapshotPublisher()
+{
+	m_current = NULL;
+	m_version = 0;
+}
+
+SnapshotPublisher::~SnapshotPublisher()
+{
+	for (size_t i = 0; i < m_pool.size(); ++i)
+	{
+		b2Assert(m_pool[i]->readers.load(std::memory_order_acquire) == 0);
+		delete m_pool[i];
+	}
+}
+
+void SnapshotPublisher::Publish(const b2World* world, int32 stepIndex)
+{
+	// A pooled snapshot that is not current and has no readers cannot be
+	// acquired again, because Acquire only hands out the current one, so it
+	// is safe to rebuild in place.
+	PooledSnapshot* target = NULL;
+	for (size_t i = 0; i < m_pool.size(); ++i)
+	{
+		if (m_pool[i] != m_current && m_pool[i]->readers.load(std::memory_order_acquire) == 0)
+		{
+			target = m_pool[i];
+			break;
+		}
+	}
+
+	if (target == NULL)
+	{
+		target = new PooledSnapshot;
+		m_pool.push_back(target);
+	}
+
+	// Only this thread writes m_version and m_current, so reading them
+	// unlocked is fine. The current snapshot is only read by the update.
+	uint32 version = m_version + 1;
+	target->snapshot.Update(world, version, stepIndex, m_current != NULL ? &m_current->snapshot : NULL);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_current = target;
+	m_version = version;
+}
+
+SnapshotHandle SnapshotPublisher::Acquire() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_current == NULL)
+	{
+		return SnapshotHandle();
+	}
+
+	// Counted under the lock: Publish never rebuilds the current snapshot,
+	// and it can only stop being current under this same lock.
+	m_current->readers.fetch_add(1, std::memory_order_relaxed);
+	return SnapshotHandle(&m_current->snapshot, &m_current->readers);
+}
+
+uint32 SnapshotPublisher::GetVersion() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_version;
+}
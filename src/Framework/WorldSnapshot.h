@@ -0,0 +1,220 @@
+#pragma once
+#include "Box2D/Box2D.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// One fixture child as it was when the snapshot was taken. The fixture
+// pointer is an identity only: queries never dereference it, because the
+// world may destroy the fixture while the snapshot is still in use.
+struct SnapshotProxy
+{
+	b2AABB aabb;
+	b2Transform xf;
+	const b2Fixture* fixture;
+	void* fixtureUserData;
+	void* bodyUserData;
+	b2Filter filter;
+	int32 childIndex;
+	int32 shapeIndex;
+	b2Shape::Type shapeType;
+	b2BodyType bodyType;
+	bool isSensor;
+};
+
+// A proxy found by WorldSnapshot::QueryNearest. The point is the closest
+// point on the shape's surface, or near the query point when inside.
+struct SnapshotNearestHit
+{
+	const SnapshotProxy* proxy;
+	b2Vec2 point;
+	float32 distance;
+};
+
+// Called for every proxy whose AABB overlaps the query box.
+// Return false to terminate the query.
+class SnapshotQueryCallback
+{
+public:
+	virtual ~SnapshotQueryCallback() {}
+	virtual bool ReportProxy(const SnapshotProxy& proxy) = 0;
+};
+
+// Called for every proxy hit by the ray. The return value has the same
+// meaning as in b2RayCastCallback: -1 to filter, 0 to terminate, fraction
+// to clip the ray, 1 to continue.
+class SnapshotRayCastCallback
+{
+public:
+	virtual ~SnapshotRayCastCallback() {}
+	virtual float32 ReportProxy(const SnapshotProxy& proxy, const b2Vec2& point, const b2Vec2& normal, float32 fraction) = 0;
+};
+
+// Read-only copy of a world's fixture geometry with its own AABB tree.
+// A published snapshot is never modified, so any number of threads can
+// query it while b2World::Step runs on the next frame.
+class WorldSnapshot
+{
+public:
+	WorldSnapshot();
+
+	// Rebuilds this snapshot from the world. Reuses existing storage.
+	void Build(const b2World* world, uint32 version, int32 stepIndex);
+
+	// Brings this snapshot up to date from the world, starting from the
+	// previous snapshot of the same world. When the world has the same
+	// fixtures in the same order as before, proxies keep their places in
+	// the tree: only the ones whose body moved are recomputed and the tree
+	// is refit from their leaves up, and shapes are not copied again. The
+	// tree is rebuilt once refitting has grown its bounds too much. Any
+	// other change falls back to Build. The previous snapshot is only read.
+	void Update(const b2World* world, uint32 version, int32 stepIndex, const WorldSnapshot* previous);
+
+	void QueryAABB(SnapshotQueryCallback* callback, const b2AABB& aabb) const;
+	void RayCast(SnapshotRayCastCallback* callback, const b2Vec2& point1, const b2Vec2& point2) const;
+
+	// Up to count proxies nearest to the point, closest first, by distance
+	// to the shape including its radius, which is zero inside it. Nodes are
+	// visited nearest first and skipped once they are farther than the
+	// count-th hit so far. Proxies farther than maxDistance are left out.
+	// Returns the number of hits written.
+	int32 QueryNearest(SnapshotNearestHit* hits, int32 count, const b2Vec2& point, float32 maxDistance = b2_maxFloat) const;
+
+	// Reports every proxy that overlaps child childIndex of the shape at xf,
+	// using b2TestOverlap's tolerance, not just its AABB.
+	void QueryShape(SnapshotQueryCallback* callback, const b2Shape* shape, int32 childIndex, const b2Transform& xf) const;
+
+	// Shape of a proxy in its body's frame; chain children are stored as edges.
+	const b2Shape* GetShape(const SnapshotProxy& proxy) const;
+	bool TestPoint(const SnapshotProxy& proxy, const b2Vec2& p) const;
+
+	uint32 GetVersion() const { return m_version; }
+	int32 GetStepIndex() const { return m_stepIndex; }
+	int32 GetProxyCount() const { return (int32)m_proxies.size(); }
+	const SnapshotProxy& GetProxy(int32 index) const { return m_proxies[index]; }
+	float32 GetBuildTime() const { return m_buildTime; }
+
+	// Proxies recomputed by the last Build or Update, and whether it built
+	// the tree from scratch rather than refitting it.
+	int32 GetChangedCount() const { return m_changedCount; }
+	bool WasRebuilt() const { return m_rebuilt; }
+
+	// Leaves store a range of m_proxies; internal nodes store two children.
+	struct Node
+	{
+		b2AABB aabb;
+		int32 child1;
+		int32 child2;
+		int32 start;
+		int32 count;
+	};
+
+	// The tree, for traversals that live outside this class such as the
+	// batched queries. The root is b2_nullNode when there are no proxies.
+	int32 GetRoot() const { return m_root; }
+	const Node& GetNode(int32 index) const { return m_nodes[index]; }
+
+private:
+	enum
+	{
+		e_leafSize = 4
+	};
+
+	void Collect(const b2World* world);
+	void BuildTree();
+	int32 BuildNode(int32 start, int32 count);
+	void Refit();
+
+	uint32 m_version;
+	int32 m_stepIndex;
+	float32 m_buildTime;
+	std::vector<SnapshotProxy> m_proxies;
+	std::vector<Node> m_nodes;
+	std::vector<b2CircleShape> m_circles;
+	std::vector<b2EdgeShape> m_edges;
+	std::vector<b2PolygonShape> m_polygons;
+	int32 m_root;
+
+	// The layout: where each fixture child of the world walk sits in
+	// m_proxies, and the leaf holding each proxy. Snapshots with the same
+	// layout version have the same layout, shapes and tree topology.
+	std::vector<int32> m_slots;
+	std::vector<int32> m_leaves;
+	uint32 m_layoutVersion;
+
+	// Sum of the node perimeters, now and when the tree was built.
+	float32 m_cost;
+	float32 m_buildCost;
+
+	std::vector<SnapshotProxy> m_walkProxies;
+	std::vector<int32> m_buildOrder;
+	std::vector<uint8> m_dirty;
+	int32 m_changedCount;
+	bool m_rebuilt;
+};
+
+// A reader's hold on a published snapshot. The publisher does not rebuild a
+// snapshot while any handle refers to it. Handles are cheap to copy and are
+// released when destroyed; a default handle refers to nothing.
+class SnapshotHandle
+{
+public:
+	SnapshotHandle();
+	SnapshotHandle(const SnapshotHandle& other);
+	~SnapshotHandle();
+
+	SnapshotHandle& operator=(const SnapshotHandle& other);
+
+	const WorldSnapshot* Get() const { return m_snapshot; }
+	const WorldSnapshot* operator->() const { return m_snapshot; }
+	const WorldSnapshot& operator*() const { return *m_snapshot; }
+
+private:
+	friend class SnapshotPublisher;
+
+	SnapshotHandle(const WorldSnapshot* snapshot, std::atomic<int32>* readers);
+	void Release();
+
+	const WorldSnapshot* m_snapshot;
+	std::atomic<int32>* m_readers;
+};
+
+// Publishes snapshots from the stepping thread to query threads. Snapshots
+// are recycled from a small pool: a buffer is rebuilt only once no reader
+// holds it any more, so steady-state publishing does not allocate. Each
+// publish updates the free buffer from the current snapshot, so a world
+// that is mostly asleep costs little more than a walk of its fixtures.
+class SnapshotPublisher
+{
+public:
+	SnapshotPublisher();
+	~SnapshotPublisher();
+
+	// Builds a snapshot of the world and makes it current. Call from the
+	// thread that steps the world, between steps.
+	void Publish(const b2World* world, int32 stepIndex);
+
+	// Returns the latest snapshot, or an empty handle before the first
+	// publish. The snapshot stays valid for as long as the handle is held.
+	SnapshotHandle Acquire() const;
+
+	uint32 GetVersion() const;
+	int32 GetPoolSize() const { return (int32)m_pool.size(); }
+
+private:
+	// Readers count the handles to a snapshot. Handles are released with
+	// release order and the publisher reads the count with acquire order,
+	// so a reader's last query happens before the buffer is rebuilt.
+	struct PooledSnapshot
+	{
+		PooledSnapshot() : readers(0) {}
+
+		WorldSnapshot snapshot;
+		std::atomic<int32> readers;
+	};
+
+	std::vector<PooledSnapshot*> m_pool;
+	PooledSnapshot* m_current;
+	mutable std::mutex m_mutex;
+	uint32 m_version;
+};
@@ -0,0 +1,187 @@
+#include "WorldTeardown.h"
+#include "Test.h"
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const char* const k_teardownNames[e_teardownCount] =
+{
+	"Inline",
+	"Deferred",
+	"Notify"
+};
+
+const char* GetWorldTeardownName(WorldTeardown mode)
+{
+	return k_teardownNames[mode];
+}
+
+// Deletes queued worlds on a thread of its own. The thread runs while
+// there are worlds to delete and until the next flush.
+class WorldReaper
+{
+public:
+	WorldReaper()
+	{
+		m_running = false;
+		m_quit = false;
+		m_time = 0.0f;
+	}
+
+	~WorldReaper()
+	{
+		Flush();
+	}
+
+	void Push(b2World* world)
+	{
+		if (m_running == false)
+		{
+			m_quit = false;
+			m_thread = std::thread(&WorldReaper::Main, this);
+			m_running = true;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_worlds.push_back(world);
+		}
+		m_wake.notify_one();
+	}
+
+	float32 Flush()
+	{
+		if (m_running)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_quit = true;
+			}
+			m_wake.notify_one();
+			m_thread.join();
+			m_running = false;
+		}
+
+		float32 time = m_time;
+		m_time = 0.0f;
+		return time;
+	}
+
+private:
+	void Main()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			while (m_worlds.empty() && m_quit == false)
+			{
+				m_wake.wait(lock);
+			}
+
+			// Quitting waits for the queue to drain.
+			if (m_worlds.empty())
+			{
+				return;
+			}
+
+			b2World* world = m_worlds.back();
+			m_worlds.pop_back();
+			lock.unlock();
+
+			b2Timer timer;
+			delete world;
+			float32 time = timer.GetMilliseconds();
+
+			lock.lock();
+			m_time += time;
+		}
+	}
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::vector<b2World*> m_worlds;
+	bool m_running;
+	bool m_quit;
+	float32 m_time;
+};
+
+static WorldReaper s_reaper;
+
+void DestroyWorld(b2World* world, WorldTeardown mode)
+{
+	switch (mode)
+	{
+	case e_teardownDeferred:
+		s_reaper.Push(world);
+		break;
+
+	case e_teardownNotify:
+		{
+			// DestroyBody says goodbye to the body's joints and then its fixtures.
+			b2Body* body = world->GetBodyList();
+			while (body)
+			{
+				b2Body* next = body->GetNext();
+				world->DestroyBody(body);
+				body = next;
+			}
+			delete world;
+		}
+		break;
+
+	default:
+		delete world;
+		break;
+	}
+}
+
+float32 FlushWorldTeardowns()
+{
+	return s_reaper.Flush();
+}
+
+static const char* const k_teardownScenes[] = { "Tiles", "Lab Tiles", "Add Pair Stress Test", "Kinematic Crowd", "World File Loading" };
+static const int32 k_teardownSceneCount = 5;
+
+void RunTeardownReport(const Settings& settings, int32 stepCount)
+{
+	HeadlessDrawScope drawScope;
+
+	Settings runSettings = MakeHeadlessSettings(settings);
+
+	printf("scene                  bodies contacts  mode      delete ms  background ms\n");
+
+	for (int32 i = 0; i < k_teardownSceneCount; ++i)
+	{
+		const TestEntry* entry = FindTestEntry(k_teardownScenes[i]);
+		if (entry == NULL)
+		{
+			continue;
+		}
+
+		for (int32 mode = 0; mode < e_teardownCount; ++mode)
+		{
+			Test* test = entry->createFcn();
+			for (int32 j = 0; j < stepCount; ++j)
+			{
+				test->Step(&runSettings);
+			}
+
+			int32 bodyCount = test->GetBodyCount();
+			int32 contactCount = test->GetContactCount();
+			test->SetWorldTeardown((WorldTeardown)mode);
+
+			b2Timer timer;
+			delete test;
+			float32 time = timer.GetMilliseconds();
+			float32 background = FlushWorldTeardowns();
+
+			printf("%-22s %6d %8d  %-8s %10.3f %14.3f\n", entry->name, bodyCount, contactCount,
+				k_teardownNames[mode], time, background);
+			fflush(stdout);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "Box2D/Box2D.h"
+
+struct Settings;
+
+// How a test's b2World is destroyed.
+//
+// Destroying a b2World in O(1) is out of scope here. Box2D is an outside
+// dependency, not a vendored copy, so its block allocator and b2Alloc
+// cannot be routed into an arena. ~b2World still visits every fixture and
+// then frees its allocators block by block. What there is:
+// - WorldArena, used by LabWorld alone. Deleting a LabWorld frees the
+//   arena's chunks without visiting any fixture.
+// - The deferred mode, which moves ~b2World off the caller's thread but
+//   does not make it any cheaper.
+// - The notify mode. ~b2World never calls the destruction listener, so
+//   this mode destroys the bodies one at a time first and the listener
+//   hears about every joint and fixture. It makes teardown slower.
+enum WorldTeardown
+{
+	e_teardownInline,
+	e_teardownDeferred,
+	e_teardownNotify,
+	e_teardownCount
+};
+
+const char* GetWorldTeardownName(WorldTeardown mode);
+
+// In the deferred mode the world is queued for a background thread and
+// must not be used again, not even through pointers into it.
+void DestroyWorld(b2World* world, WorldTeardown mode);
+
+// Waits until the deferred worlds are destroyed and stops the background
+// thread, which starts again for the next one. Returns the milliseconds
+// the thread spent destroying worlds since the last call.
+float32 FlushWorldTeardowns();
+
+// Builds Tiles, Lab Tiles, Add Pair Stress Test, Kinematic Crowd and World
+// File Loading without a window, steps each stepCount steps, and prints on
+// stdout how long deleting the test takes in each mode.
+void RunTeardownReport(const Settings& settings, int32 stepCount);
@@ -0,0 +1,164 @@
+#ifndef BATCH_DISTANCE_BENCHMARK_H
+#define BATCH_DISTANCE_BENCHMARK_H
+
+#include "../Framework/BatchDistance.h"
+#include "../Framework/SimdMath.h"
+
+/// DistanceTest as a throughput benchmark: random pairs of circles, boxes
+/// and ConvexHull-style polygons at random poses go through b2Distance one
+/// by one, through the SIMD batch on one thread and through the batch split
+/// across the job system. Mismatches count pairs where the SIMD outputs
+/// differ from b2Distance's in any bit.
+class BatchDistanceBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_shapeCount = 256,
+		e_pairCount = 16384
+	};
+
+	BatchDistanceBenchmark()
+	{
+		b2Vec2 lowerBound(-8.0f, -8.0f);
+		b2Vec2 upperBound(8.0f, 8.0f);
+
+		for (int32 i = 0; i < e_shapeCount; ++i)
+		{
+			m_circles[i].m_radius = RandomFloat(0.25f, 2.0f);
+			m_boxes[i].SetAsBox(RandomFloat(0.1f, 4.0f), RandomFloat(0.1f, 4.0f));
+
+			b2Vec2 points[b2_maxPolygonVertices];
+			for (int32 j = 0; j < b2_maxPolygonVertices; ++j)
+			{
+				b2Vec2 v(10.0f * RandomFloat(), 10.0f * RandomFloat());
+				points[j] = b2Clamp(v, lowerBound, upperBound);
+			}
+			m_polygons[i].Set(points, b2_maxPolygonVertices);
+		}
+
+		for (int32 i = 0; i < e_pairCount; ++i)
+		{
+			m_proxiesA[i].Set(GetRandomShape(), 0);
+			m_proxiesB[i].Set(GetRandomShape(), 0);
+			m_transformsA[i].Set(b2Vec2(RandomFloat(-20.0f, 20.0f), RandomFloat(-20.0f, 20.0f)), RandomFloat(-b2_pi, b2_pi));
+			m_transformsB[i].Set(b2Vec2(RandomFloat(-20.0f, 20.0f), RandomFloat(-20.0f, 20.0f)), RandomFloat(-b2_pi, b2_pi));
+		}
+
+		m_batch.proxiesA = m_proxiesA;
+		m_batch.proxiesB = m_proxiesB;
+		m_batch.transformsA = m_transformsA;
+		m_batch.transformsB = m_transformsB;
+		m_batch.count = e_pairCount;
+		m_batch.useRadii = true;
+
+		m_scalarTime = 0.0f;
+		m_wideTime = 0.0f;
+		m_parallelTime = 0.0f;
+		m_mismatchCount = 0;
+		m_rounds = 0;
+	}
+
+	const b2Shape* GetRandomShape()
+	{
+		int32 index = RandomInt() % e_shapeCount;
+		switch (RandomInt() % 3)
+		{
+		case 0:
+			return m_circles + index;
+
+		case 1:
+			return m_boxes + index;
+
+		default:
+			return m_polygons + index;
+		}
+	}
+
+	float32 Smooth(float32 average, float32 sample) const
+	{
+		return m_rounds == 0 ? sample : 0.95f * average + 0.05f * sample;
+	}
+
+	void RunRound()
+	{
+		float32 scale = 1.0e6f / e_pairCount;
+
+		{
+			b2Timer timer;
+			ComputeDistancesScalar(m_scalarOutputs, m_batch, 0, e_pairCount);
+			m_scalarTime = Smooth(m_scalarTime, scale * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			ComputeDistancesWide(m_wideOutputs, m_batch, 0, e_pairCount);
+			m_wideTime = Smooth(m_wideTime, scale * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			ComputeDistances(m_wideOutputs, m_batch);
+			m_parallelTime = Smooth(m_parallelTime, scale * timer.GetMilliseconds());
+		}
+
+		if (m_rounds == 0)
+		{
+			for (int32 i = 0; i < e_pairCount; ++i)
+			{
+				const b2DistanceOutput& output1 = m_scalarOutputs[i];
+				const b2DistanceOutput& output2 = m_wideOutputs[i];
+				bool same = output1.distance == output2.distance && output1.iterations == output2.iterations;
+				same = same && output1.pointA.x == output2.pointA.x && output1.pointA.y == output2.pointA.y;
+				same = same && output1.pointB.x == output2.pointB.x && output1.pointB.y == output2.pointB.y;
+				m_mismatchCount += same == false;
+			}
+		}
+
+		++m_rounds;
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+
+		Test::Step(settings);
+
+		if (advance)
+		{
+			RunRound();
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "pairs = %d, mismatches = %d, workers = %d", e_pairCount, m_mismatchCount, g_jobSystem.GetWorkerCount());
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "b2Distance = %5.1f ns, %s = %5.1f ns, %s parallel = %5.1f ns per pair",
+			m_scalarTime, SIMD_NAME, m_wideTime, SIMD_NAME, m_parallelTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new BatchDistanceBenchmark;
+	}
+
+	b2CircleShape m_circles[e_shapeCount];
+	b2PolygonShape m_boxes[e_shapeCount];
+	b2PolygonShape m_polygons[e_shapeCount];
+
+	b2DistanceProxy m_proxiesA[e_pairCount];
+	b2DistanceProxy m_proxiesB[e_pairCount];
+	b2Transform m_transformsA[e_pairCount];
+	b2Transform m_transformsB[e_pairCount];
+	b2DistanceOutput m_scalarOutputs[e_pairCount];
+	b2DistanceOutput m_wideOutputs[e_pairCount];
+	DistanceBatch m_batch;
+
+	float32 m_scalarTime;
+	float32 m_wideTime;
+	float32 m_parallelTime;
+	int32 m_mismatchCount;
+	int32 m_rounds;
+};
+
+#endif
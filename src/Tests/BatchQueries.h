@@ -0,0 +1,312 @@
+#ifndef BATCH_QUERIES_H
+#define BATCH_QUERIES_H
+
+#include "../Framework/BatchQuery.h"
+#include "../Framework/JobSystem.h"
+#include <vector>
+
+/// The RayCast test's three modes as a batch benchmark. A fan of rays and a
+/// grid of boxes query a snapshot of a settling pile, once with a filtering
+/// callback per query, once as packets on one thread and once as packets
+/// across the job system. The triangles are in their own category that the
+/// queries mask out, the way RayCast filters polygon 0. Mismatches count
+/// queries whose results differ from the callback path. Press 'm' to change
+/// the ray mode.
+class BatchQueries : public Test
+{
+public:
+	enum
+	{
+		e_rayCount = 4096,
+		e_maxHits = 3,
+		e_boxCount = 1024,
+		e_maxResults = 4,
+		e_drawRayStride = 64,
+		e_columnCount = 30,
+		e_rowCount = 20
+	};
+
+	enum
+	{
+		e_triangleCategory = 0x0002
+	};
+
+	BatchQueries()
+	{
+		{
+			b2BodyDef bd;
+			b2Body* ground = m_world->CreateBody(&bd);
+
+			b2EdgeShape shape;
+			shape.Set(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+			ground->CreateFixture(&shape, 0.0f);
+
+			b2Vec2 vs[4];
+			vs[0].Set(-40.0f, 20.0f);
+			vs[1].Set(-30.0f, 5.0f);
+			vs[2].Set(-25.0f, 0.0f);
+			vs[3].Set(-20.0f, 0.0f);
+			b2ChainShape chain;
+			chain.CreateChain(vs, 4);
+			ground->CreateFixture(&chain, 0.0f);
+		}
+
+		{
+			b2PolygonShape box;
+			box.SetAsBox(0.4f, 0.4f);
+
+			b2PolygonShape triangle;
+			b2Vec2 vertices[3];
+			vertices[0].Set(-0.5f, 0.0f);
+			vertices[1].Set(0.5f, 0.0f);
+			vertices[2].Set(0.0f, 0.8f);
+			triangle.Set(vertices, 3);
+
+			b2CircleShape circle;
+			circle.m_radius = 0.4f;
+
+			for (int32 i = 0; i < e_rowCount; ++i)
+			{
+				for (int32 j = 0; j < e_columnCount; ++j)
+				{
+					b2BodyDef bd;
+					bd.type = b2_dynamicBody;
+					bd.position.Set(-21.75f + 1.5f * j + 0.1f * (i & 1), 2.0f + 1.5f * i);
+					b2Body* body = m_world->CreateBody(&bd);
+
+					b2FixtureDef fd;
+					fd.density = 1.0f;
+					fd.friction = 0.3f;
+					switch ((i + j) % 3)
+					{
+					case 0:
+						fd.shape = &box;
+						break;
+					case 1:
+						fd.shape = &triangle;
+						fd.filter.categoryBits = e_triangleCategory;
+						break;
+					default:
+						fd.shape = &circle;
+						break;
+					}
+					body->CreateFixture(&fd);
+				}
+			}
+		}
+
+		m_points1.resize(e_rayCount);
+		m_points2.resize(e_rayCount);
+		m_rayHits[0].resize(e_rayCount * e_maxHits);
+		m_rayHits[1].resize(e_rayCount * e_maxHits);
+		m_rayCounts[0].resize(e_rayCount);
+		m_rayCounts[1].resize(e_rayCount);
+
+		m_aabbs.resize(e_boxCount);
+		m_boxResults[0].resize(e_boxCount * e_maxResults);
+		m_boxResults[1].resize(e_boxCount * e_maxResults);
+		m_boxCounts[0].resize(e_boxCount);
+		m_boxCounts[1].resize(e_boxCount);
+
+		m_rayBatch.points1 = m_points1.data();
+		m_rayBatch.points2 = m_points2.data();
+		m_rayBatch.filter.maskBits = 0xFFFF & ~e_triangleCategory;
+		m_rayBatch.count = e_rayCount;
+		m_rayBatch.mode = e_rayClosest;
+		m_rayBatch.maxHits = e_maxHits;
+
+		m_aabbBatch.aabbs = m_aabbs.data();
+		m_aabbBatch.filter.maskBits = 0xFFFF & ~e_triangleCategory;
+		m_aabbBatch.count = e_boxCount;
+		m_aabbBatch.maxResults = e_maxResults;
+
+		memset(m_rayTimes, 0, sizeof(m_rayTimes));
+		memset(m_boxTimes, 0, sizeof(m_boxTimes));
+		m_rayMismatches = 0;
+		m_boxMismatches = 0;
+		m_rounds = 0;
+	}
+
+	void Keyboard(Oryol::Key::Code key)
+	{
+		switch (key)
+		{
+		case Oryol::Key::M:
+			m_rayBatch.mode = (RayBatchMode)((m_rayBatch.mode + 1) % 3);
+			m_rounds = 0;
+			break;
+		}
+	}
+
+	float32 Smooth(float32 average, float32 sample) const
+	{
+		return m_rounds == 0 ? sample : 0.95f * average + 0.05f * sample;
+	}
+
+	// A fan from a point that orbits above the pile, so neighbouring rays
+	// are coherent, and a grid of boxes over the pile.
+	void SetupQueries()
+	{
+		float32 orbit = 0.01f * m_stepCount;
+		b2Vec2 origin(20.0f * sinf(orbit), 35.0f);
+		for (int32 i = 0; i < e_rayCount; ++i)
+		{
+			float32 angle = -b2_pi * (i + 0.5f) / e_rayCount;
+			m_points1[i] = origin;
+			m_points2[i] = origin + 60.0f * b2Vec2(cosf(angle), sinf(angle));
+		}
+
+		for (int32 i = 0; i < e_boxCount; ++i)
+		{
+			b2Vec2 center(-24.0f + 1.5f * (i % 32) + 2.0f * sinf(orbit), 0.5f + 1.0f * (i / 32));
+			m_aabbs[i].lowerBound = center - b2Vec2(0.5f, 0.5f);
+			m_aabbs[i].upperBound = center + b2Vec2(0.5f, 0.5f);
+		}
+	}
+
+	void RunRound()
+	{
+		m_snapshot.Build(m_world, 0, m_stepCount);
+		SetupQueries();
+
+		float32 rayScale = 1.0e6f / e_rayCount;
+		float32 boxScale = 1.0e6f / e_boxCount;
+
+		{
+			b2Timer timer;
+			RayCastScalar(m_rayHits[0].data(), m_rayCounts[0].data(), m_snapshot, m_rayBatch, 0, e_rayCount);
+			m_rayTimes[0] = Smooth(m_rayTimes[0], rayScale * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			RayCastPackets(m_rayHits[1].data(), m_rayCounts[1].data(), m_snapshot, m_rayBatch, 0, e_rayCount);
+			m_rayTimes[1] = Smooth(m_rayTimes[1], rayScale * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			RayCastBatch(m_rayHits[1].data(), m_rayCounts[1].data(), m_snapshot, m_rayBatch);
+			m_rayTimes[2] = Smooth(m_rayTimes[2], rayScale * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			QueryAABBScalar(m_boxResults[0].data(), m_boxCounts[0].data(), m_snapshot, m_aabbBatch, 0, e_boxCount);
+			m_boxTimes[0] = Smooth(m_boxTimes[0], boxScale * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			QueryAABBPackets(m_boxResults[1].data(), m_boxCounts[1].data(), m_snapshot, m_aabbBatch, 0, e_boxCount);
+			m_boxTimes[1] = Smooth(m_boxTimes[1], boxScale * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			QueryAABBBatch(m_boxResults[1].data(), m_boxCounts[1].data(), m_snapshot, m_aabbBatch);
+			m_boxTimes[2] = Smooth(m_boxTimes[2], boxScale * timer.GetMilliseconds());
+		}
+
+		// The hits of any and multiple rays depend on the traversal order,
+		// so only their counts have to agree.
+		m_rayMismatches = 0;
+		for (int32 i = 0; i < e_rayCount; ++i)
+		{
+			bool same = m_rayCounts[0][i] == m_rayCounts[1][i];
+			if (same && m_rayCounts[0][i] > 0 && m_rayBatch.mode == e_rayClosest)
+			{
+				same = m_rayHits[0][i].fraction == m_rayHits[1][i].fraction;
+			}
+			m_rayMismatches += same == false;
+		}
+
+		m_boxMismatches = 0;
+		for (int32 i = 0; i < e_boxCount; ++i)
+		{
+			m_boxMismatches += m_boxCounts[0][i] != m_boxCounts[1][i];
+		}
+
+		++m_rounds;
+	}
+
+	void DrawRays()
+	{
+		int32 stride = m_rayBatch.mode == e_rayMultiple ? e_maxHits : 1;
+		for (int32 i = 0; i < e_rayCount; i += e_drawRayStride)
+		{
+			b2Vec2 p1 = m_points1[i];
+			int32 hitCount = m_rayCounts[1][i];
+			if (hitCount == 0)
+			{
+				g_debugDraw.DrawSegment(p1, m_points2[i], b2Color(0.8f, 0.8f, 0.8f));
+				continue;
+			}
+
+			for (int32 j = 0; j < hitCount; ++j)
+			{
+				const RayBatchHit& hit = m_rayHits[1][i * stride + j];
+				g_debugDraw.DrawPoint(hit.point, 5.0f, b2Color(0.4f, 0.9f, 0.4f));
+				g_debugDraw.DrawSegment(p1, hit.point, b2Color(0.8f, 0.8f, 0.8f));
+				g_debugDraw.DrawSegment(hit.point, hit.point + 0.5f * hit.normal, b2Color(0.9f, 0.9f, 0.4f));
+			}
+		}
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+
+		Test::Step(settings);
+
+		if (advance || m_rounds == 0)
+		{
+			RunRound();
+		}
+
+		DrawRays();
+
+		const char* modeNames[3] = {"closest", "any", "multiple"};
+		g_debugDraw.DrawString(5, m_textLine, "Press m to change the ray mode: %s", modeNames[m_rayBatch.mode]);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "proxies = %d, workers = %d, ray mismatches = %d, box mismatches = %d",
+			m_snapshot.GetProxyCount(), g_jobSystem.GetWorkerCount(), m_rayMismatches, m_boxMismatches);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "%d rays: callback = %5.1f ns, packets = %5.1f ns, parallel = %5.1f ns per ray",
+			e_rayCount, m_rayTimes[0], m_rayTimes[1], m_rayTimes[2]);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "%d boxes: callback = %5.1f ns, packets = %5.1f ns, parallel = %5.1f ns per box",
+			e_boxCount, m_boxTimes[0], m_boxTimes[1], m_boxTimes[2]);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new BatchQueries;
+	}
+
+	WorldSnapshot m_snapshot;
+
+	std::vector<b2Vec2> m_points1;
+	std::vector<b2Vec2> m_points2;
+	std::vector<RayBatchHit> m_rayHits[2];
+	std::vector<int32> m_rayCounts[2];
+	RayBatch m_rayBatch;
+
+	std::vector<b2AABB> m_aabbs;
+	std::vector<const SnapshotProxy*> m_boxResults[2];
+	std::vector<int32> m_boxCounts[2];
+	AABBBatch m_aabbBatch;
+
+	// Callback, packets, parallel packets.
+	float32 m_rayTimes[3];
+	float32 m_boxTimes[3];
+	int32 m_rayMismatches;
+	int32 m_boxMismatches;
+	int32 m_rounds;
+};
+
+#endif
@@ -76,44 +76,39 @@ public:
 		m_bullet->SetLinearVelocity(b2Vec2(0.0f, -50.0f));
 		m_bullet->SetAngularVelocity(0.0f);
 
-		extern int32 b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
-		extern int32 b2_toiCalls, b2_toiIters, b2_toiMaxIters;
-		extern int32 b2_toiRootIters, b2_toiMaxRootIters;
-
-		b2_gjkCalls = 0;
-		b2_gjkIters = 0;
-		b2_gjkMaxIters = 0;
-
-		b2_toiCalls = 0;
-		b2_toiIters = 0;
-		b2_toiMaxIters = 0;
-		b2_toiRootIters = 0;
-		b2_toiMaxRootIters = 0;
+		m_totalCounters.Reset();
 	}
 
 	void Step(Settings* settings)
 	{
 		Test::Step(settings);
 
-		extern int32 b2_gjkCalls, b2_gjkIters, b2_gjkMaxIters;
-		extern int32 b2_toiCalls, b2_toiIters;
-		extern int32 b2_toiRootIters, b2_toiMaxRootIters;
+		const CollisionCounters& c = m_totalCounters;
 
-		if (b2_gjkCalls > 0)
+		if (c.gjkCalls > 0)
 		{
 			g_debugDraw.DrawString(5, m_textLine, "gjk calls = %d, ave gjk iters = %3.1f, max gjk iters = %d",
-				b2_gjkCalls, b2_gjkIters / float32(b2_gjkCalls), b2_gjkMaxIters);
+				c.gjkCalls, c.gjkIters / float32(c.gjkCalls), c.gjkMaxIters);
 			m_textLine += DRAW_STRING_NEW_LINE;
 		}
 
-		if (b2_toiCalls > 0)
+		// Calls from the parallel TOI pass come without iteration counts, so
+		// the averages are over the world solver's calls only.
+		int32 iterCalls = c.toiCalls - c.toiCallsWithoutIters;
+		if (iterCalls > 0)
 		{
 			g_debugDraw.DrawString(5, m_textLine, "toi calls = %d, ave toi iters = %3.1f, max toi iters = %d",
-				b2_toiCalls, b2_toiIters / float32(b2_toiCalls), b2_toiMaxRootIters);
+				iterCalls, c.toiIters / float32(iterCalls), c.toiMaxRootIters);
 			m_textLine += DRAW_STRING_NEW_LINE;
 
 			g_debugDraw.DrawString(5, m_textLine, "ave toi root iters = %3.1f, max toi root iters = %d",
-				b2_toiRootIters / float32(b2_toiCalls), b2_toiMaxRootIters);
+				c.toiRootIters / float32(iterCalls), c.toiMaxRootIters);
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+
+		if (c.toiCallsWithoutIters > 0)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "parallel toi calls = %d (iterations not counted)", c.toiCallsWithoutIters);
 			m_textLine += DRAW_STRING_NEW_LINE;
 		}
 
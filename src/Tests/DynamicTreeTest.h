@@ -19,6 +19,10 @@
 #ifndef DYNAMIC_TREE_TEST_H
 #define DYNAMIC_TREE_TEST_H
 
+#include "../Framework/WideTree.h"
+
+/// Every actor is in both a b2DynamicTree and a WideTree; press W to switch
+/// the tree that Query and RayCast use. Both are checked against brute force.
 class DynamicTreeTest : public Test
 {
 public:
@@ -33,13 +37,14 @@ public:
 		m_worldExtent = 15.0f;
 		m_proxyExtent = 0.5f;
 
-		srand(888);
+		SetRandomSeed(888);
 
 		for (int32 i = 0; i < e_actorCount; ++i)
 		{
 			Actor* actor = m_actors + i;
 			GetRandomAABB(&actor->aabb);
 			actor->proxyId = m_tree.CreateProxy(actor->aabb, actor);
+			actor->wideProxyId = m_wideTree.CreateProxy(actor->aabb, actor);
 		}
 
 		m_stepCount = 0;
@@ -55,6 +60,7 @@ public:
 		m_rayCastInput.maxFraction = 1.0f;
 
 		m_automated = false;
+		m_useWideTree = false;
 	}
 
 	static Test* Create()
@@ -130,6 +136,10 @@ public:
 			int32 height = m_tree.GetHeight();
 			g_debugDraw.DrawString(5, m_textLine, "dynamic tree height = %d", height);
 			m_textLine += DRAW_STRING_NEW_LINE;
+
+			g_debugDraw.DrawString(5, m_textLine, "wide tree height = %d, querying the %s tree (W to switch)",
+				m_wideTree.GetHeight(), m_useWideTree ? "wide" : "dynamic");
+			m_textLine += DRAW_STRING_NEW_LINE;
 		}
 
 		++m_stepCount;
@@ -154,19 +164,23 @@ public:
 		case Oryol::Key::M:
 			MoveProxy();
 			break;
+
+		case Oryol::Key::W:
+			m_useWideTree = !m_useWideTree;
+			break;
 		}
 	}
 
 	bool QueryCallback(int32 proxyId)
 	{
-		Actor* actor = (Actor*)m_tree.GetUserData(proxyId);
+		Actor* actor = GetActor(proxyId);
 		actor->overlap = b2TestOverlap(m_queryAABB, actor->aabb);
 		return true;
 	}
 
 	float32 RayCastCallback(const b2RayCastInput& input, int32 proxyId)
 	{
-		Actor* actor = (Actor*)m_tree.GetUserData(proxyId);
+		Actor* actor = GetActor(proxyId);
 
 		b2RayCastOutput output;
 		bool hit = actor->aabb.RayCast(&output, input);
@@ -190,8 +204,14 @@ private:
 		float32 fraction;
 		bool overlap;
 		int32 proxyId;
+		int32 wideProxyId;
 	};
 
+	Actor* GetActor(int32 proxyId) const
+	{
+		return (Actor*)(m_useWideTree ? m_wideTree.GetUserData(proxyId) : m_tree.GetUserData(proxyId));
+	}
+
 	void GetRandomAABB(b2AABB* aabb)
 	{
 		b2Vec2 w; w.Set(2.0f * m_proxyExtent, 2.0f * m_proxyExtent);
@@ -225,12 +245,13 @@ private:
 	{
 		for (int32 i = 0; i < e_actorCount; ++i)
 		{
-			int32 j = rand() % e_actorCount;
+			int32 j = RandomInt() % e_actorCount;
 			Actor* actor = m_actors + j;
 			if (actor->proxyId == b2_nullNode)
 			{
 				GetRandomAABB(&actor->aabb);
 				actor->proxyId = m_tree.CreateProxy(actor->aabb, actor);
+				actor->wideProxyId = m_wideTree.CreateProxy(actor->aabb, actor);
 				return;
 			}
 		}
@@ -240,12 +261,14 @@ private:
 	{
 		for (int32 i = 0; i < e_actorCount; ++i)
 		{
-			int32 j = rand() % e_actorCount;
+			int32 j = RandomInt() % e_actorCount;
 			Actor* actor = m_actors + j;
 			if (actor->proxyId != b2_nullNode)
 			{
 				m_tree.DestroyProxy(actor->proxyId);
+				m_wideTree.DestroyProxy(actor->wideProxyId);
 				actor->proxyId = b2_nullNode;
+				actor->wideProxyId = b2_nullNode;
 				return;
 			}
 		}
@@ -255,7 +278,7 @@ private:
 	{
 		for (int32 i = 0; i < e_actorCount; ++i)
 		{
-			int32 j = rand() % e_actorCount;
+			int32 j = RandomInt() % e_actorCount;
 			Actor* actor = m_actors + j;
 			if (actor->proxyId == b2_nullNode)
 			{
@@ -266,13 +289,14 @@ private:
 			MoveAABB(&actor->aabb);
 			b2Vec2 displacement = actor->aabb.GetCenter() - aabb0.GetCenter();
 			m_tree.MoveProxy(actor->proxyId, actor->aabb, displacement);
+			m_wideTree.MoveProxy(actor->wideProxyId, actor->aabb, displacement);
 			return;
 		}
 	}
 
 	void Action()
 	{
-		int32 choice = rand() % 20;
+		int32 choice = RandomInt() % 20;
 
 		switch (choice)
 		{
@@ -291,7 +315,14 @@ private:
 
 	void Query()
 	{
-		m_tree.Query(this, m_queryAABB);
+		if (m_useWideTree)
+		{
+			m_wideTree.Query(this, m_queryAABB);
+		}
+		else
+		{
+			m_tree.Query(this, m_queryAABB);
+		}
 
 		for (int32 i = 0; i < e_actorCount; ++i)
 		{
@@ -313,7 +344,14 @@ private:
 		b2RayCastInput input = m_rayCastInput;
 
 		// Ray cast against the dynamic tree.
-		m_tree.RayCast(this, input);
+		if (m_useWideTree)
+		{
+			m_wideTree.RayCast(this, input);
+		}
+		else
+		{
+			m_tree.RayCast(this, input);
+		}
 
 		// Brute force ray cast.
 		Actor* bruteActor = NULL;
@@ -345,6 +383,7 @@ private:
 	float32 m_proxyExtent;
 
 	b2DynamicTree m_tree;
+	WideTree m_wideTree;
 	b2AABB m_queryAABB;
 	b2RayCastInput m_rayCastInput;
 	b2RayCastOutput m_rayCastOutput;
@@ -352,6 +391,7 @@ private:
 	Actor m_actors[e_actorCount];
 	int32 m_stepCount;
 	bool m_automated;
+	bool m_useWideTree;
 };
 
 #endif
@@ -0,0 +1,141 @@
+#ifndef JOB_SYSTEM_BENCHMARK_H
+#define JOB_SYSTEM_BENCHMARK_H
+
+#include "../Framework/JobSystem.h"
+
+/// Measures the job system's scheduling overhead at the granularity the
+/// physics code uses: empty jobs, parallel-for batches of 10 to 50 us tasks
+/// and dependency chains. One round runs per step; the numbers are smoothed.
+/// Change the worker count in the UI (or with -workers) to compare.
+class JobSystemBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_emptyJobCount = 256,
+		e_chainLength = 32,
+		e_taskSizeCount = 3
+	};
+
+	JobSystemBenchmark()
+	{
+		m_emptyJobTime = 0.0f;
+		m_chainLinkTime = 0.0f;
+		for (int32 i = 0; i < e_taskSizeCount; ++i)
+		{
+			m_efficiency[i] = 0.0f;
+			m_overhead[i] = 0.0f;
+		}
+		m_rounds = 0;
+	}
+
+	static void EmptyJob(void* data, int32 begin, int32 end)
+	{
+		B2_NOT_USED(data);
+		B2_NOT_USED(begin);
+		B2_NOT_USED(end);
+	}
+
+	static void Spin(float32 microseconds)
+	{
+		b2Timer timer;
+		while (1000.0f * timer.GetMilliseconds() < microseconds)
+		{
+		}
+	}
+
+	float32 Smooth(float32 average, float32 sample) const
+	{
+		return m_rounds == 0 ? sample : 0.95f * average + 0.05f * sample;
+	}
+
+	void RunRound()
+	{
+		// Empty jobs: pure push, pop/steal and counter cost.
+		{
+			b2Timer timer;
+			JobCounter counter;
+			for (int32 i = 0; i < e_emptyJobCount; ++i)
+			{
+				g_jobSystem.Run(&counter, &JobSystemBenchmark::EmptyJob, NULL);
+			}
+			g_jobSystem.Wait(&counter);
+			float32 perJob = 1000.0f * timer.GetMilliseconds() / e_emptyJobCount;
+			m_emptyJobTime = Smooth(m_emptyJobTime, perJob);
+		}
+
+		// Parallel-for over spinning tasks. Efficiency compares the wall time
+		// against perfect division of the work over the workers.
+		static const float32 taskSizes[e_taskSizeCount] = { 10.0f, 25.0f, 50.0f };
+		int32 workerCount = g_jobSystem.GetWorkerCount();
+		int32 taskCount = 4 * workerCount;
+		for (int32 i = 0; i < e_taskSizeCount; ++i)
+		{
+			float32 taskSize = taskSizes[i];
+			b2Timer timer;
+			g_jobSystem.ParallelFor(taskCount, 1, [taskSize](int32 begin, int32 end)
+			{
+				for (int32 j = begin; j < end; ++j)
+				{
+					Spin(taskSize);
+				}
+			});
+			float32 wall = 1000.0f * timer.GetMilliseconds();
+			float32 ideal = taskSize * taskCount / workerCount;
+			m_efficiency[i] = Smooth(m_efficiency[i], ideal / wall);
+			m_overhead[i] = Smooth(m_overhead[i], (wall - ideal) / (taskCount / (float32)workerCount));
+		}
+
+		// Dependency chain: every link waits for the previous one, so this is
+		// the latency of a continuation hand-off.
+		{
+			JobCounter counters[e_chainLength];
+			b2Timer timer;
+			g_jobSystem.Run(counters + 0, &JobSystemBenchmark::EmptyJob, NULL);
+			for (int32 i = 1; i < e_chainLength; ++i)
+			{
+				g_jobSystem.RunAfter(counters + i - 1, counters + i, &JobSystemBenchmark::EmptyJob, NULL);
+			}
+			g_jobSystem.Wait(counters + e_chainLength - 1);
+			float32 perLink = 1000.0f * timer.GetMilliseconds() / e_chainLength;
+			m_chainLinkTime = Smooth(m_chainLinkTime, perLink);
+		}
+
+		++m_rounds;
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+
+		Test::Step(settings);
+
+		if (advance)
+		{
+			RunRound();
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "workers = %d, rounds = %d", g_jobSystem.GetWorkerCount(), m_rounds);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "empty job = %5.2f us, continuation hand-off = %5.2f us", m_emptyJobTime, m_chainLinkTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "parallel-for efficiency (overhead per task) 10us = %3.0f%% (%4.1f us), 25us = %3.0f%% (%4.1f us), 50us = %3.0f%% (%4.1f us)",
+			100.0f * m_efficiency[0], m_overhead[0], 100.0f * m_efficiency[1], m_overhead[1], 100.0f * m_efficiency[2], m_overhead[2]);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new JobSystemBenchmark;
+	}
+
+	float32 m_emptyJobTime;
+	float32 m_chainLinkTime;
+	float32 m_efficiency[e_taskSizeCount];
+	float32 m_overhead[e_taskSizeCount];
+	int32 m_rounds;
+};
+
+#endif
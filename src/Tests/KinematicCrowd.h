@@ -0,0 +1,259 @@
+#ifndef KINEMATIC_CROWD_H
+#define KINEMATIC_CROWD_H
+
+#include "../Framework/BodyStateView.h"
+
+/// A grid of kinematic boxes circling in place, stirring balls that fall
+/// through it. Every step the boxes' poses go to the world as one packed
+/// array through BodyStateView::ApplyKinematicTargets, and the view is
+/// refreshed after the step. The balls' mean speed is then read both from
+/// the view's arrays and by walking the body list, as a renderer would.
+/// Press 'm' to drive the boxes with a call per body instead, and 't' to
+/// place them at their poses rather than move them there by velocity.
+class KinematicCrowd : public Test
+{
+public:
+	enum
+	{
+		e_columnCount = 50,
+		e_rowCount = 40,
+		e_crowdCount = e_columnCount * e_rowCount,
+		e_ballCount = 400
+	};
+
+	KinematicCrowd()
+	{
+		{
+			b2BodyDef bd;
+			b2Body* ground = m_world->CreateBody(&bd);
+
+			b2Vec2 vs[4];
+			vs[0].Set(-30.0f, 60.0f);
+			vs[1].Set(-30.0f, 0.0f);
+			vs[2].Set(30.0f, 0.0f);
+			vs[3].Set(30.0f, 60.0f);
+			b2ChainShape chain;
+			chain.CreateChain(vs, 4);
+			ground->CreateFixture(&chain, 0.0f);
+		}
+
+		{
+			b2PolygonShape box;
+			box.SetAsBox(0.25f, 0.25f);
+
+			for (int32 i = 0; i < e_rowCount; ++i)
+			{
+				for (int32 j = 0; j < e_columnCount; ++j)
+				{
+					int32 index = i * e_columnCount + j;
+					m_centers[index].Set(-24.5f + 1.0f * j, 5.0f + 1.0f * i);
+					m_phases[index] = 0.37f * j + 0.61f * i;
+					m_rates[index] = (i + j) % 2 == 0 ? 2.0f : -2.0f;
+
+					b2BodyDef bd;
+					bd.type = b2_kinematicBody;
+					bd.position = GetPosition(index, 0.0f);
+					bd.angle = GetAngle(index, 0.0f);
+					m_crowd[index] = m_world->CreateBody(&bd);
+					m_crowd[index]->CreateFixture(&box, 0.0f);
+				}
+			}
+		}
+
+		{
+			b2CircleShape circle;
+			circle.m_radius = 0.2f;
+
+			for (int32 i = 0; i < e_ballCount; ++i)
+			{
+				b2BodyDef bd;
+				bd.type = b2_dynamicBody;
+				bd.position.Set(RandomFloat(-25.0f, 25.0f), RandomFloat(48.0f, 58.0f));
+				b2Body* body = m_world->CreateBody(&bd);
+				body->CreateFixture(&circle, 1.0f);
+			}
+		}
+
+		m_view.Refresh(m_world);
+		for (int32 i = 0; i < e_crowdCount; ++i)
+		{
+			m_slots[i] = m_view.GetIndex(m_crowd[i]);
+		}
+
+		m_perBody = false;
+		m_teleport = false;
+		m_driveTime = 0.0f;
+		m_viewReadTime = 0.0f;
+		m_walkReadTime = 0.0f;
+		m_viewSpeed = 0.0f;
+		m_walkSpeed = 0.0f;
+	}
+
+	b2Vec2 GetPosition(int32 index, float32 time) const
+	{
+		float32 angle = m_rates[index] * time + m_phases[index];
+		return m_centers[index] + 0.3f * b2Vec2(cosf(angle), sinf(angle));
+	}
+
+	float32 GetAngle(int32 index, float32 time) const
+	{
+		return m_rates[index] * time + m_phases[index];
+	}
+
+	b2Vec2 GetVelocity(int32 index, float32 time) const
+	{
+		float32 angle = m_rates[index] * time + m_phases[index];
+		return 0.3f * m_rates[index] * b2Vec2(-sinf(angle), cosf(angle));
+	}
+
+	void Keyboard(Oryol::Key::Code key)
+	{
+		switch (key)
+		{
+		case Oryol::Key::M:
+			m_perBody = !m_perBody;
+			break;
+
+		case Oryol::Key::T:
+			m_teleport = !m_teleport;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	// Sends every box its pose for the end of the coming step.
+	void DriveCrowd(float32 timeStep)
+	{
+		float32 time = (m_stepCount + 1) * timeStep;
+
+		b2Timer timer;
+		if (m_perBody)
+		{
+			float32 inv_dt = 1.0f / timeStep;
+			for (int32 i = 0; i < e_crowdCount; ++i)
+			{
+				b2Body* body = m_crowd[i];
+				b2Vec2 position = GetPosition(i, time);
+				float32 angle = GetAngle(i, time);
+				if (m_teleport)
+				{
+					body->SetTransform(position, angle);
+					body->SetLinearVelocity(GetVelocity(i, time));
+					body->SetAngularVelocity(m_rates[i]);
+				}
+				else
+				{
+					b2Vec2 center = position + b2Mul(b2Rot(angle), body->GetLocalCenter());
+					body->SetLinearVelocity(inv_dt * (center - body->GetWorldCenter()));
+					body->SetAngularVelocity(inv_dt * (angle - body->GetAngle()));
+				}
+			}
+		}
+		else
+		{
+			for (int32 i = 0; i < e_crowdCount; ++i)
+			{
+				KinematicTarget& target = m_targets[i];
+				target.index = m_slots[i];
+				target.position = GetPosition(i, time);
+				target.angle = GetAngle(i, time);
+				target.linearVelocity = GetVelocity(i, time);
+				target.angularVelocity = m_rates[i];
+			}
+			m_view.ApplyKinematicTargets(m_targets, e_crowdCount, m_teleport ? 0.0f : timeStep);
+		}
+		m_driveTime = timer.GetMilliseconds();
+	}
+
+	// The mean speed of the awake dynamic bodies, read both ways.
+	void ReadBalls()
+	{
+		b2Timer timer;
+		float32 viewSum = 0.0f;
+		int32 viewCount = 0;
+		{
+			const uint8* flags = m_view.GetFlags();
+			const b2Vec2* velocities = m_view.GetLinearVelocities();
+			int32 capacity = m_view.GetCapacity();
+			uint8 mask = BodyStateView::e_awake | BodyStateView::e_dynamic;
+			for (int32 i = 0; i < capacity; ++i)
+			{
+				if ((flags[i] & mask) == mask)
+				{
+					viewSum += velocities[i].Length();
+					++viewCount;
+				}
+			}
+		}
+		m_viewReadTime = timer.GetMilliseconds();
+
+		timer.Reset();
+		float32 walkSum = 0.0f;
+		int32 walkCount = 0;
+		for (b2Body* body = m_world->GetBodyList(); body; body = body->GetNext())
+		{
+			if (body->GetType() == b2_dynamicBody && body->IsAwake())
+			{
+				walkSum += body->GetLinearVelocity().Length();
+				++walkCount;
+			}
+		}
+		m_walkReadTime = timer.GetMilliseconds();
+
+		b2Assert(viewCount == walkCount);
+		m_viewSpeed = viewCount > 0 ? viewSum / viewCount : 0.0f;
+		m_walkSpeed = walkCount > 0 ? walkSum / walkCount : 0.0f;
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+		float32 timeStep = settings->hz > 0.0f ? 1.0f / settings->hz : float32(0.0f);
+		if (advance && timeStep > 0.0f)
+		{
+			DriveCrowd(timeStep);
+		}
+
+		Test::Step(settings);
+
+		m_view.Refresh(m_world);
+		ReadBalls();
+
+		g_debugDraw.DrawString(5, m_textLine, "Keys: (m) per-body calls [%s], (t) teleport [%s]",
+			m_perBody ? "on" : "off", m_teleport ? "on" : "off");
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "drive %d boxes = %5.3f ms, refresh %d bodies = %5.3f ms",
+			(int32)e_crowdCount, m_driveTime, m_view.GetBodyCount(), m_view.GetRefreshTime());
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "ball mean speed: view = %5.2f m/s in %5.3f ms, body list = %5.2f m/s in %5.3f ms",
+			m_viewSpeed, m_viewReadTime, m_walkSpeed, m_walkReadTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new KinematicCrowd;
+	}
+
+	b2Body* m_crowd[e_crowdCount];
+	b2Vec2 m_centers[e_crowdCount];
+	float32 m_phases[e_crowdCount];
+	float32 m_rates[e_crowdCount];
+	int32 m_slots[e_crowdCount];
+	KinematicTarget m_targets[e_crowdCount];
+
+	BodyStateView m_view;
+	bool m_perBody;
+	bool m_teleport;
+	float32 m_driveTime;
+	float32 m_viewReadTime;
+	float32 m_walkReadTime;
+	float32 m_viewSpeed;
+	float32 m_walkSpeed;
+};
+
+#endif
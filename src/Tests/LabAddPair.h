@@ -0,0 +1,59 @@
+#ifndef LAB_ADD_PAIR_H
+#define LAB_ADD_PAIR_H
+
+#include "../Framework/LabTest.h"
+
+/// Add Pair Stress Test scaled up ten times in a LabWorld. Most of the
+/// circles never touch, so per-body integration and sleep checks are a
+/// large part of the solve time.
+class LabAddPair : public LabTest
+{
+public:
+	enum
+	{
+		e_count = 4000
+	};
+
+	LabAddPair()
+	{
+		m_lab->SetGravity(b2Vec2(0.0f, 0.0f));
+
+		{
+			b2CircleShape shape;
+			shape.m_p.SetZero();
+			shape.m_radius = 0.1f;
+
+			float minX = -15.0f;
+			float maxX = 0.0f;
+			float minY = 0.0f;
+			float maxY = 8.0f;
+
+			for (int32 i = 0; i < e_count; ++i)
+			{
+				b2BodyDef bd;
+				bd.type = b2_dynamicBody;
+				bd.position = b2Vec2(RandomFloat(minX, maxX), RandomFloat(minY, maxY));
+				int32 body = m_lab->CreateBody(&bd);
+				m_lab->CreateFixture(body, &shape, 0.01f);
+			}
+		}
+
+		{
+			b2PolygonShape shape;
+			shape.SetAsBox(1.5f, 1.5f);
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(-60.0f, 4.0f);
+			bd.linearVelocity.Set(150.0f, 0.0f);
+			int32 body = m_lab->CreateBody(&bd);
+			m_lab->CreateFixture(body, &shape, 1.0f);
+		}
+	}
+
+	static Test* Create()
+	{
+		return new LabAddPair;
+	}
+};
+
+#endif
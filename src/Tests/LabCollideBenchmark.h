@@ -0,0 +1,138 @@
+#ifndef LAB_COLLIDE_BENCHMARK_H
+#define LAB_COLLIDE_BENCHMARK_H
+
+#include "../Framework/LabCollide.h"
+
+/// PolyCollision as a benchmark: the same box pairs go through
+/// b2CollidePolygons and the lab world's box-box kernel every step. Half
+/// the pairs are resting on each other like boxes in a stack, the rest are
+/// at random poses. Mismatches count pairs whose manifolds differ in point
+/// count, type or feature ids.
+class LabCollideBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_pairCount = 4096,
+		e_repeatCount = 8
+	};
+
+	LabCollideBenchmark()
+	{
+		for (int32 i = 0; i < e_pairCount; ++i)
+		{
+			m_boxesA[i].SetAsBox(RandomFloat(0.1f, 2.0f), RandomFloat(0.1f, 2.0f));
+			m_boxesB[i].SetAsBox(RandomFloat(0.1f, 2.0f), RandomFloat(0.1f, 2.0f));
+
+			if (i & 1)
+			{
+				m_transformsA[i].Set(b2Vec2(RandomFloat(), RandomFloat()), 0.0f);
+				m_transformsB[i].Set(m_transformsA[i].p + b2Vec2(RandomFloat(-0.5f, 0.5f), RandomFloat(0.5f, 3.0f)), RandomFloat(-0.05f, 0.05f));
+			}
+			else
+			{
+				m_transformsA[i].Set(b2Vec2(RandomFloat(), RandomFloat()), RandomFloat(-b2_pi, b2_pi));
+				m_transformsB[i].Set(b2Vec2(RandomFloat(-2.0f, 2.0f), RandomFloat(-2.0f, 2.0f)), RandomFloat(-b2_pi, b2_pi));
+			}
+		}
+
+		m_polygonTime = 0.0f;
+		m_boxTime = 0.0f;
+		m_touchingCount = 0;
+		m_mismatchCount = 0;
+		m_rounds = 0;
+	}
+
+	float32 Smooth(float32 average, float32 sample) const
+	{
+		return m_rounds == 0 ? sample : 0.95f * average + 0.05f * sample;
+	}
+
+	void RunRound()
+	{
+		b2Manifold manifold;
+		float32 scale = 1.0e6f / (e_pairCount * e_repeatCount);
+
+		{
+			b2Timer timer;
+			for (int32 j = 0; j < e_repeatCount; ++j)
+			{
+				for (int32 i = 0; i < e_pairCount; ++i)
+				{
+					b2CollidePolygons(&manifold, m_boxesA + i, m_transformsA[i], m_boxesB + i, m_transformsB[i]);
+				}
+			}
+			m_polygonTime = Smooth(m_polygonTime, scale * timer.GetMilliseconds());
+		}
+
+		{
+			LabCollideFcn* collide = LabGetCollideFcn(e_labBox, e_labBox);
+			b2Timer timer;
+			for (int32 j = 0; j < e_repeatCount; ++j)
+			{
+				for (int32 i = 0; i < e_pairCount; ++i)
+				{
+					collide(&manifold, m_boxesA + i, m_transformsA[i], m_boxesB + i, m_transformsB[i]);
+				}
+			}
+			m_boxTime = Smooth(m_boxTime, scale * timer.GetMilliseconds());
+		}
+
+		if (m_rounds == 0)
+		{
+			for (int32 i = 0; i < e_pairCount; ++i)
+			{
+				b2Manifold manifold1, manifold2;
+				b2CollidePolygons(&manifold1, m_boxesA + i, m_transformsA[i], m_boxesB + i, m_transformsB[i]);
+				LabCollideBoxes(&manifold2, m_boxesA + i, m_transformsA[i], m_boxesB + i, m_transformsB[i]);
+
+				bool same = manifold1.pointCount == manifold2.pointCount;
+				same = same && (manifold1.pointCount == 0 || manifold1.type == manifold2.type);
+				for (int32 j = 0; same && j < manifold1.pointCount; ++j)
+				{
+					same = manifold1.points[j].id.key == manifold2.points[j].id.key;
+				}
+
+				m_touchingCount += manifold1.pointCount > 0;
+				m_mismatchCount += same == false;
+			}
+		}
+
+		++m_rounds;
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+
+		Test::Step(settings);
+
+		if (advance)
+		{
+			RunRound();
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "pairs = %d, touching = %d, mismatches = %d", e_pairCount, m_touchingCount, m_mismatchCount);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "b2CollidePolygons = %5.1f ns, box kernel = %5.1f ns per pair", m_polygonTime, m_boxTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new LabCollideBenchmark;
+	}
+
+	b2PolygonShape m_boxesA[e_pairCount];
+	b2PolygonShape m_boxesB[e_pairCount];
+	b2Transform m_transformsA[e_pairCount];
+	b2Transform m_transformsB[e_pairCount];
+	float32 m_polygonTime;
+	float32 m_boxTime;
+	int32 m_touchingCount;
+	int32 m_mismatchCount;
+	int32 m_rounds;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef LAB_CONFINED_H
+#define LAB_CONFINED_H
+
+#include "../Framework/LabTest.h"
+
+/// A much larger Confined in a LabWorld: a grid of circles with random
+/// velocities bouncing around a box without gravity. Every body stays
+/// awake, so the integration loops run over all of them each step.
+class LabConfined : public LabTest
+{
+public:
+	enum
+	{
+		e_columnCount = 70,
+		e_rowCount = 70
+	};
+
+	LabConfined()
+	{
+		m_lab->SetGravity(b2Vec2(0.0f, 0.0f));
+
+		{
+			b2BodyDef bd;
+			int32 ground = m_lab->CreateBody(&bd);
+
+			b2PolygonShape shape;
+
+			// Floor
+			shape.SetAsBox(41.0f, 1.0f, b2Vec2(0.0f, -1.0f), 0.0f);
+			m_lab->CreateFixture(ground, &shape, 0.0f);
+
+			// Left wall
+			shape.SetAsBox(1.0f, 41.0f, b2Vec2(-41.0f, 40.0f), 0.0f);
+			m_lab->CreateFixture(ground, &shape, 0.0f);
+
+			// Right wall
+			shape.SetAsBox(1.0f, 41.0f, b2Vec2(41.0f, 40.0f), 0.0f);
+			m_lab->CreateFixture(ground, &shape, 0.0f);
+
+			// Roof
+			shape.SetAsBox(41.0f, 1.0f, b2Vec2(0.0f, 81.0f), 0.0f);
+			m_lab->CreateFixture(ground, &shape, 0.0f);
+		}
+
+		float32 radius = 0.5f;
+		b2CircleShape shape;
+		shape.m_p.SetZero();
+		shape.m_radius = radius;
+
+		b2FixtureDef fd;
+		fd.shape = &shape;
+		fd.density = 1.0f;
+		fd.friction = 0.1f;
+
+		for (int32 j = 0; j < e_columnCount; ++j)
+		{
+			for (int i = 0; i < e_rowCount; ++i)
+			{
+				b2BodyDef bd;
+				bd.type = b2_dynamicBody;
+				bd.position.Set(-40.0f + (2.1f * j + 1.0f + 0.01f * i) * radius, (2.0f * i + 1.0f) * radius + 5.0f);
+				bd.linearVelocity.Set(RandomFloat(-5.0f, 5.0f), RandomFloat(-5.0f, 5.0f));
+				int32 body = m_lab->CreateBody(&bd);
+				m_lab->CreateFixture(body, &fd);
+			}
+		}
+	}
+
+	static Test* Create()
+	{
+		return new LabConfined;
+	}
+};
+
+#endif
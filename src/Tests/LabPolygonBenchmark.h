@@ -0,0 +1,153 @@
+#ifndef LAB_POLYGON_BENCHMARK_H
+#define LAB_POLYGON_BENCHMARK_H
+
+#include "../Framework/LabCollide.h"
+#include "../Framework/SimdMath.h"
+
+/// Random convex polygons, generated like ConvexHull does, collided with
+/// b2CollidePolygons and with the lab world's SIMD version every step.
+/// Mismatches count pairs whose manifolds are not exactly the same, so
+/// anything but zero is a bug.
+class LabPolygonBenchmark : public Test
+{
+public:
+	enum
+	{
+		e_pairCount = 4096,
+		e_repeatCount = 8
+	};
+
+	LabPolygonBenchmark()
+	{
+		for (int32 i = 0; i < e_pairCount; ++i)
+		{
+			GeneratePolygon(m_polygonsA + i);
+			GeneratePolygon(m_polygonsB + i);
+
+			// Offsets of up to a polygon's size, so about half the pairs touch.
+			m_transformsA[i].Set(b2Vec2(RandomFloat(), RandomFloat()), RandomFloat(-b2_pi, b2_pi));
+			m_transformsB[i].Set(m_transformsA[i].p + b2Vec2(RandomFloat(-10.0f, 10.0f), RandomFloat(-10.0f, 10.0f)), RandomFloat(-b2_pi, b2_pi));
+		}
+
+		m_scalarTime = 0.0f;
+		m_wideTime = 0.0f;
+		m_touchingCount = 0;
+		m_mismatchCount = 0;
+		m_rounds = 0;
+	}
+
+	static void GeneratePolygon(b2PolygonShape* polygon)
+	{
+		b2Vec2 lowerBound(-8.0f, -8.0f);
+		b2Vec2 upperBound(8.0f, 8.0f);
+
+		b2Vec2 points[b2_maxPolygonVertices];
+		for (int32 i = 0; i < b2_maxPolygonVertices; ++i)
+		{
+			b2Vec2 v(10.0f * RandomFloat(), 10.0f * RandomFloat());
+			points[i] = b2Clamp(v, lowerBound, upperBound);
+		}
+
+		polygon->Set(points, b2_maxPolygonVertices);
+	}
+
+	float32 Smooth(float32 average, float32 sample) const
+	{
+		return m_rounds == 0 ? sample : 0.95f * average + 0.05f * sample;
+	}
+
+	void RunRound()
+	{
+		b2Manifold manifold;
+		float32 scale = 1.0e6f / (e_pairCount * e_repeatCount);
+
+		{
+			b2Timer timer;
+			for (int32 j = 0; j < e_repeatCount; ++j)
+			{
+				for (int32 i = 0; i < e_pairCount; ++i)
+				{
+					b2CollidePolygons(&manifold, m_polygonsA + i, m_transformsA[i], m_polygonsB + i, m_transformsB[i]);
+				}
+			}
+			m_scalarTime = Smooth(m_scalarTime, scale * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			for (int32 j = 0; j < e_repeatCount; ++j)
+			{
+				for (int32 i = 0; i < e_pairCount; ++i)
+				{
+					LabCollidePolygons(&manifold, m_polygonsA + i, m_transformsA[i], m_polygonsB + i, m_transformsB[i]);
+				}
+			}
+			m_wideTime = Smooth(m_wideTime, scale * timer.GetMilliseconds());
+		}
+
+		if (m_rounds == 0)
+		{
+			for (int32 i = 0; i < e_pairCount; ++i)
+			{
+				b2Manifold manifold1, manifold2;
+				b2CollidePolygons(&manifold1, m_polygonsA + i, m_transformsA[i], m_polygonsB + i, m_transformsB[i]);
+				LabCollidePolygons(&manifold2, m_polygonsA + i, m_transformsA[i], m_polygonsB + i, m_transformsB[i]);
+
+				bool same = manifold1.pointCount == manifold2.pointCount;
+				if (same && manifold1.pointCount > 0)
+				{
+					same = manifold1.type == manifold2.type;
+					same = same && manifold1.localNormal.x == manifold2.localNormal.x && manifold1.localNormal.y == manifold2.localNormal.y;
+					same = same && manifold1.localPoint.x == manifold2.localPoint.x && manifold1.localPoint.y == manifold2.localPoint.y;
+				}
+				for (int32 j = 0; same && j < manifold1.pointCount; ++j)
+				{
+					const b2ManifoldPoint& point1 = manifold1.points[j];
+					const b2ManifoldPoint& point2 = manifold2.points[j];
+					same = point1.id.key == point2.id.key;
+					same = same && point1.localPoint.x == point2.localPoint.x && point1.localPoint.y == point2.localPoint.y;
+				}
+
+				m_touchingCount += manifold1.pointCount > 0;
+				m_mismatchCount += same == false;
+			}
+		}
+
+		++m_rounds;
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+
+		Test::Step(settings);
+
+		if (advance)
+		{
+			RunRound();
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "pairs = %d, touching = %d, mismatches = %d", e_pairCount, m_touchingCount, m_mismatchCount);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "b2CollidePolygons = %5.1f ns, %s = %5.1f ns per pair", m_scalarTime, SIMD_NAME, m_wideTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new LabPolygonBenchmark;
+	}
+
+	b2PolygonShape m_polygonsA[e_pairCount];
+	b2PolygonShape m_polygonsB[e_pairCount];
+	b2Transform m_transformsA[e_pairCount];
+	b2Transform m_transformsB[e_pairCount];
+	float32 m_scalarTime;
+	float32 m_wideTime;
+	int32 m_touchingCount;
+	int32 m_mismatchCount;
+	int32 m_rounds;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef LAB_PYRAMID_H
+#define LAB_PYRAMID_H
+
+#include "../Framework/LabTest.h"
+#include <vector>
+
+/// Pyramid scaled up for the lab solvers. Switch "Lab Solver" to compare
+/// the scalar and wide contact solvers; drift is the largest distance any
+/// box has moved since the stack settled, so it shows stability loss.
+class LabPyramid : public LabTest
+{
+public:
+	enum
+	{
+		e_count = 40,
+		e_settleSteps = 300
+	};
+
+	LabPyramid()
+	{
+		{
+			b2BodyDef bd;
+			int32 ground = m_lab->CreateBody(&bd);
+
+			// LabWorld is polygon heavy; a box avoids the edge-polygon manifold.
+			b2PolygonShape shape;
+			shape.SetAsBox(40.0f, 1.0f, b2Vec2(0.0f, -1.0f), 0.0f);
+			m_lab->CreateFixture(ground, &shape, 0.0f);
+		}
+
+		{
+			float32 a = 0.5f;
+			b2PolygonShape shape;
+			shape.SetAsBox(a, a);
+
+			b2Vec2 x(-0.5625f * e_count, 0.75f);
+			b2Vec2 y;
+			b2Vec2 deltaX(0.5625f, 1.25f);
+			b2Vec2 deltaY(1.125f, 0.0f);
+
+			for (int32 i = 0; i < e_count; ++i)
+			{
+				y = x;
+
+				for (int32 j = i; j < e_count; ++j)
+				{
+					b2BodyDef bd;
+					bd.type = b2_dynamicBody;
+					bd.position = y;
+					int32 body = m_lab->CreateBody(&bd);
+					m_lab->CreateFixture(body, &shape, 5.0f);
+
+					y += deltaY;
+				}
+
+				x += deltaX;
+			}
+		}
+
+		m_maxDrift = 0.0f;
+	}
+
+	void Step(Settings* settings)
+	{
+		Test::Step(settings);
+
+		int32 bodyCount = m_lab->GetBodyCount();
+		if (m_stepCount == e_settleSteps)
+		{
+			m_settled.resize(bodyCount);
+			for (int32 i = 0; i < bodyCount; ++i)
+			{
+				m_settled[i] = m_lab->GetTransform(i).p;
+			}
+		}
+		else if (m_stepCount > e_settleSteps)
+		{
+			for (int32 i = 0; i < bodyCount; ++i)
+			{
+				m_maxDrift = b2Max(m_maxDrift, b2Distance(m_lab->GetTransform(i).p, m_settled[i]));
+			}
+		}
+
+		b2Vec2 top = m_lab->GetTransform(bodyCount - 1).p;
+		g_debugDraw.DrawString(5, m_textLine, "%s: top box y = %.3f, max drift = %.4f",
+			LabWorld::GetSolverName(m_lab->GetSolverType()), top.y, m_maxDrift);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new LabPyramid;
+	}
+
+	std::vector<b2Vec2> m_settled;
+	float32 m_maxDrift;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef LAB_ROLLBACK_H
+#define LAB_ROLLBACK_H
+
+#include "../Framework/LabTest.h"
+
+/// Rollback as a networked game would do it. After every step the scene
+/// saves the live state, restores the one saved e_rollbackSteps steps ago
+/// and steps forward again to now; the resimulated state must equal the
+/// live one byte for byte, and mismatches count the steps where it did not.
+/// A few thousand boxes and circles pile into a bin so contacts keep being
+/// made and lost, and bodies fall asleep, between the two states.
+class LabRollback : public LabTest
+{
+public:
+	enum
+	{
+		e_columnCount = 50,
+		e_rowCount = 50,
+		e_rollbackSteps = 8
+	};
+
+	LabRollback()
+	{
+		{
+			b2BodyDef bd;
+			int32 ground = m_lab->CreateBody(&bd);
+
+			b2PolygonShape shape;
+			shape.SetAsBox(41.0f, 1.0f, b2Vec2(0.0f, -1.0f), 0.0f);
+			m_lab->CreateFixture(ground, &shape, 0.0f);
+
+			shape.SetAsBox(1.0f, 60.0f, b2Vec2(-41.0f, 59.0f), 0.0f);
+			m_lab->CreateFixture(ground, &shape, 0.0f);
+
+			shape.SetAsBox(1.0f, 60.0f, b2Vec2(41.0f, 59.0f), 0.0f);
+			m_lab->CreateFixture(ground, &shape, 0.0f);
+		}
+
+		b2PolygonShape box;
+		box.SetAsBox(0.4f, 0.4f);
+
+		b2CircleShape circle;
+		circle.m_radius = 0.45f;
+
+		for (int32 j = 0; j < e_columnCount; ++j)
+		{
+			for (int32 i = 0; i < e_rowCount; ++i)
+			{
+				b2BodyDef bd;
+				bd.type = b2_dynamicBody;
+				bd.position.Set(-38.0f + 1.5f * j + 0.1f * (i % 3), 2.0f + 1.1f * i);
+				int32 body = m_lab->CreateBody(&bd);
+
+				if ((i + j) % 2 == 0)
+				{
+					m_lab->CreateFixture(body, &box, 1.0f);
+				}
+				else
+				{
+					m_lab->CreateFixture(body, &circle, 1.0f);
+				}
+			}
+		}
+
+		m_saveTime = 0.0f;
+		m_restoreTime = 0.0f;
+		m_resimTime = 0.0f;
+		m_rollbackCount = 0;
+		m_mismatchCount = 0;
+	}
+
+	float32 Smooth(float32 average, float32 sample) const
+	{
+		return m_rollbackCount == 0 ? sample : 0.95f * average + 0.05f * sample;
+	}
+
+	void Rollback(Settings* settings, float32 timeStep)
+	{
+		{
+			b2Timer timer;
+			m_lab->SaveState(&m_live);
+			m_saveTime = Smooth(m_saveTime, 1.0e3f * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			bool restored = m_lab->RestoreState(m_states.Get(e_rollbackSteps));
+			if (restored == false)
+			{
+				// Bodies or fixtures were added since; the world is untouched.
+				m_states.Clear();
+				return;
+			}
+			m_restoreTime = Smooth(m_restoreTime, 1.0e3f * timer.GetMilliseconds());
+		}
+
+		{
+			b2Timer timer;
+			for (int32 i = 0; i < e_rollbackSteps; ++i)
+			{
+				m_lab->Step(timeStep, settings->velocityIterations, settings->positionIterations);
+			}
+			m_resimTime = Smooth(m_resimTime, timer.GetMilliseconds());
+		}
+
+		m_lab->SaveState(&m_resimulated);
+		if (m_resimulated.IsEqual(m_live) == false)
+		{
+			++m_mismatchCount;
+
+			// Carry on from the live state so one mismatch is not counted forever.
+			bool restored = m_lab->RestoreState(m_live);
+			b2Assert(restored);
+			B2_NOT_USED(restored);
+		}
+
+		++m_rollbackCount;
+	}
+
+	void Step(Settings* settings)
+	{
+		float32 timeStep = settings->hz > 0.0f ? 1.0f / settings->hz : float32(0.0f);
+		bool advance = settings->pause == 0 || settings->singleStep;
+
+		Test::Step(settings);
+
+		// The saved states are only a straight run of steps while live.
+		bool live = settings->labRewind == 0 && m_rewind == 0;
+		if (advance && live && timeStep > 0.0f && m_states.GetCount() > e_rollbackSteps)
+		{
+			Rollback(settings, timeStep);
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "rollback %d steps: save = %5.1f us, restore = %5.1f us, resimulate = %5.2f ms",
+			e_rollbackSteps, m_saveTime, m_restoreTime, m_resimTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "state = %d kB (%d bodies, %d contacts), rollbacks = %d, mismatches = %d",
+			m_live.GetSize() / 1024, m_live.GetBodyCount(), m_live.GetContactCount(), m_rollbackCount, m_mismatchCount);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new LabRollback;
+	}
+
+	LabWorldState m_live;
+	LabWorldState m_resimulated;
+	float32 m_saveTime;
+	float32 m_restoreTime;
+	float32 m_resimTime;
+	int32 m_rollbackCount;
+	int32 m_mismatchCount;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef LAB_TILES_H
+#define LAB_TILES_H
+
+#include "../Framework/LabTest.h"
+
+/// Tiles scaled up in a LabWorld: 4000 static ground tiles and a pyramid of
+/// boxes dropped onto them. Press S to cycle how the broad-phase splits its
+/// proxies into trees. With a single tree every moved box is reinserted
+/// among the static tiles; split, the awake boxes have a tree to themselves.
+class LabTiles : public LabTest
+{
+public:
+	enum
+	{
+		e_count = 30,
+		e_columnCount = 400,
+		e_rowCount = 10
+	};
+
+	LabTiles()
+	{
+		m_fixtureCount = 0;
+
+		{
+			float32 a = 0.5f;
+			b2BodyDef bd;
+			bd.position.y = -a;
+			int32 ground = m_lab->CreateBody(&bd);
+
+			b2Vec2 position;
+			position.y = 0.0f;
+			for (int32 j = 0; j < e_rowCount; ++j)
+			{
+				position.x = -e_columnCount * a;
+				for (int32 i = 0; i < e_columnCount; ++i)
+				{
+					b2PolygonShape shape;
+					shape.SetAsBox(a, a, position, 0.0f);
+					m_lab->CreateFixture(ground, &shape, 0.0f);
+					++m_fixtureCount;
+					position.x += 2.0f * a;
+				}
+				position.y -= 2.0f * a;
+			}
+		}
+
+		{
+			float32 a = 0.5f;
+			b2PolygonShape shape;
+			shape.SetAsBox(a, a);
+
+			// Dropped from a height so the boxes leave their fat AABBs and look
+			// for pairs every few steps until they land.
+			b2Vec2 x(-0.5625f * e_count, 10.75f);
+			b2Vec2 y;
+			b2Vec2 deltaX(0.5625f, 1.25f);
+			b2Vec2 deltaY(1.125f, 0.0f);
+
+			for (int32 i = 0; i < e_count; ++i)
+			{
+				y = x;
+
+				for (int32 j = i; j < e_count; ++j)
+				{
+					b2BodyDef bd;
+					bd.type = b2_dynamicBody;
+					bd.position = y;
+					int32 body = m_lab->CreateBody(&bd);
+					m_lab->CreateFixture(body, &shape, 5.0f);
+					++m_fixtureCount;
+					y += deltaY;
+				}
+
+				x += deltaX;
+			}
+		}
+
+		m_broadPhaseTime = 0.0f;
+	}
+
+	void Step(Settings* settings)
+	{
+		Test::Step(settings);
+
+		if (settings->pause == 0 || settings->singleStep)
+		{
+			float32 sample = m_lab->GetProfile().broadphase;
+			m_broadPhaseTime = m_broadPhaseTime == 0.0f ? sample : 0.95f * m_broadPhaseTime + 0.05f * sample;
+		}
+
+		const LabTreeBroadPhase* broadPhase = m_lab->GetTreeBroadPhase();
+		if (broadPhase == NULL)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "%s: broad-phase %5.3f ms, fixture count = %d (tree splits need the Tree broad-phase)",
+				LabBroadPhase::GetName(m_lab->GetBroadPhaseType()), m_broadPhaseTime, m_fixtureCount);
+			m_textLine += DRAW_STRING_NEW_LINE;
+			return;
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "%s (S to switch): broad-phase %5.3f ms, fixture count = %d",
+			LabTreeBroadPhase::GetSplitModeName(broadPhase->GetSplitMode()), m_broadPhaseTime, m_fixtureCount);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		const char* names[e_labProxyTypeCount] = { "static", "awake", "sleeping" };
+		for (int32 i = 0; i < e_labProxyTypeCount; ++i)
+		{
+			const WideTree& tree = broadPhase->GetTree((LabProxyType)i);
+			g_debugDraw.DrawString(5, m_textLine, "%s proxies: tree height = %d, tree proxies = %d, area ratio = %.1f",
+				names[i], tree.GetHeight(), tree.GetProxyCount(), tree.GetAreaRatio());
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+	}
+
+	void Keyboard(Oryol::Key::Code key)
+	{
+		switch (key)
+		{
+		case Oryol::Key::S:
+			{
+				const LabTreeBroadPhase* broadPhase = m_lab->GetTreeBroadPhase();
+				if (broadPhase != NULL)
+				{
+					LabTreeBroadPhase::SplitMode mode = broadPhase->GetSplitMode();
+					m_lab->SetBroadPhaseSplit(LabTreeBroadPhase::SplitMode((mode + 1) % LabTreeBroadPhase::e_splitModeCount));
+					m_broadPhaseTime = 0.0f;
+				}
+			}
+			break;
+		}
+	}
+
+	static Test* Create()
+	{
+		return new LabTiles;
+	}
+
+	int32 m_fixtureCount;
+	float32 m_broadPhaseTime;
+};
+
+#endif
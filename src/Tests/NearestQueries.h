@@ -0,0 +1,346 @@
+#ifndef NEAREST_QUERIES_H
+#define NEAREST_QUERIES_H
+
+#include "../Framework/WorldSnapshot.h"
+#include <algorithm>
+
+/// DynamicTreeTest scaled up to a field of small static fixtures, with the
+/// two queries the world lacks. Every step a set of points asks for their
+/// nearest fixtures and a box at each point asks what it overlaps, once
+/// through the snapshot's QueryNearest and QueryShape and once the usual
+/// way: b2World::QueryAABB over a box that doubles until it holds enough
+/// fixtures, then b2Distance or b2TestOverlap on each. Mismatches count
+/// queries whose answers differ. The hits for the mouse are drawn.
+class NearestQueries : public Test
+{
+public:
+	enum
+	{
+		e_fixtureCount = 2048,
+		e_queryCount = 256,
+		e_nearestCount = 8
+	};
+
+	// Collects fixtures within a distance of a point, for the fallback path.
+	struct NearestCallback : public b2QueryCallback
+	{
+		bool ReportFixture(b2Fixture* fixture) override
+		{
+			b2DistanceInput input;
+			input.proxyA.Set(&pointShape, 0);
+			input.proxyB.Set(fixture->GetShape(), 0);
+			input.transformA.SetIdentity();
+			input.transformB = fixture->GetBody()->GetTransform();
+			input.useRadii = true;
+
+			b2SimplexCache cache;
+			cache.count = 0;
+			b2DistanceOutput output;
+			b2Distance(&output, &cache, &input);
+
+			// Farther fixtures may be missing from the box, so they are dropped.
+			if (output.distance <= radius && count < e_maxCandidates)
+			{
+				distances[count++] = output.distance;
+			}
+			return true;
+		}
+
+		enum
+		{
+			e_maxCandidates = 512
+		};
+
+		b2CircleShape pointShape;
+		float32 radius;
+		float32 distances[e_maxCandidates];
+		int32 count;
+	};
+
+	struct OverlapCallback : public b2QueryCallback
+	{
+		bool ReportFixture(b2Fixture* fixture) override
+		{
+			count += b2TestOverlap(shape, 0, fixture->GetShape(), 0, xf, fixture->GetBody()->GetTransform());
+			return true;
+		}
+
+		const b2Shape* shape;
+		b2Transform xf;
+		int32 count;
+	};
+
+	struct OverlapCount : public SnapshotQueryCallback
+	{
+		bool ReportProxy(const SnapshotProxy& proxy) override
+		{
+			B2_NOT_USED(proxy);
+			++count;
+			return true;
+		}
+
+		int32 count;
+	};
+
+	NearestQueries()
+	{
+		m_worldExtent = 60.0f;
+		m_proxyExtent = 0.5f;
+
+		SetRandomSeed(888);
+
+		b2PolygonShape triangle;
+		b2Vec2 vertices[3];
+		vertices[0].Set(-0.5f, 0.0f);
+		vertices[1].Set(0.5f, 0.0f);
+		vertices[2].Set(0.0f, 0.8f);
+		triangle.Set(vertices, 3);
+
+		for (int32 i = 0; i < e_fixtureCount; ++i)
+		{
+			b2BodyDef bd;
+			bd.position.Set(RandomFloat(-m_worldExtent, m_worldExtent), RandomFloat(0.0f, 2.0f * m_worldExtent));
+			bd.angle = RandomFloat(-b2_pi, b2_pi);
+			b2Body* body = m_world->CreateBody(&bd);
+
+			switch (i % 3)
+			{
+			case 0:
+				{
+					b2PolygonShape box;
+					box.SetAsBox(RandomFloat(0.1f, m_proxyExtent), RandomFloat(0.1f, m_proxyExtent));
+					body->CreateFixture(&box, 0.0f);
+				}
+				break;
+
+			case 1:
+				body->CreateFixture(&triangle, 0.0f);
+				break;
+
+			default:
+				{
+					b2CircleShape circle;
+					circle.m_radius = RandomFloat(0.1f, m_proxyExtent);
+					body->CreateFixture(&circle, 0.0f);
+				}
+				break;
+			}
+		}
+
+		// The fixtures never move, so one snapshot serves every step.
+		m_snapshot.Build(m_world, 0, 0);
+
+		m_queryBox.SetAsBox(2.0f, 1.0f);
+
+		m_nearestTime = 0.0f;
+		m_nearestFallbackTime = 0.0f;
+		m_overlapTime = 0.0f;
+		m_overlapFallbackTime = 0.0f;
+		m_mismatchCount = 0;
+		m_nearestTotal = 0.0f;
+		m_nearestFallbackTotal = 0.0f;
+		m_overlapTotal = 0.0f;
+		m_overlapFallbackTotal = 0.0f;
+		m_mismatchTotal = 0;
+		m_rounds = 0;
+	}
+
+	float32 Smooth(float32 average, float32 sample) const
+	{
+		return m_rounds == 0 ? sample : 0.95f * average + 0.05f * sample;
+	}
+
+	// The fallback kNN: grow a box around the point until the fixtures it
+	// proves to be within its half width number at least count.
+	int32 QueryNearestFallback(float32* distances, int32 count, const b2Vec2& point)
+	{
+		NearestCallback callback;
+		callback.pointShape.m_p = point;
+		callback.pointShape.m_radius = 0.0f;
+
+		for (float32 radius = 1.0f; ; radius *= 2.0f)
+		{
+			callback.radius = radius;
+			callback.count = 0;
+
+			b2AABB aabb;
+			aabb.lowerBound = point - b2Vec2(radius, radius);
+			aabb.upperBound = point + b2Vec2(radius, radius);
+			m_world->QueryAABB(&callback, aabb);
+
+			if (callback.count >= count || radius > 4.0f * m_worldExtent)
+			{
+				break;
+			}
+		}
+
+		std::sort(callback.distances, callback.distances + callback.count);
+		int32 hitCount = b2Min(count, callback.count);
+		for (int32 i = 0; i < hitCount; ++i)
+		{
+			distances[i] = callback.distances[i];
+		}
+		return hitCount;
+	}
+
+	void RunRound()
+	{
+		for (int32 i = 0; i < e_queryCount; ++i)
+		{
+			m_points[i].Set(RandomFloat(-m_worldExtent, m_worldExtent), RandomFloat(0.0f, 2.0f * m_worldExtent));
+		}
+
+		float32 scale = 1.0e3f / e_queryCount;
+
+		{
+			b2Timer timer;
+			for (int32 i = 0; i < e_queryCount; ++i)
+			{
+				m_nearestCounts[i] = m_snapshot.QueryNearest(m_nearestHits[i], e_nearestCount, m_points[i]);
+			}
+			float32 time = scale * timer.GetMilliseconds();
+			m_nearestTime = Smooth(m_nearestTime, time);
+			m_nearestTotal += time;
+		}
+
+		{
+			b2Timer timer;
+			for (int32 i = 0; i < e_queryCount; ++i)
+			{
+				m_fallbackCounts[i] = QueryNearestFallback(m_fallbackDistances[i], e_nearestCount, m_points[i]);
+			}
+			float32 time = scale * timer.GetMilliseconds();
+			m_nearestFallbackTime = Smooth(m_nearestFallbackTime, time);
+			m_nearestFallbackTotal += time;
+		}
+
+		{
+			b2Timer timer;
+			for (int32 i = 0; i < e_queryCount; ++i)
+			{
+				OverlapCount callback;
+				callback.count = 0;
+				m_snapshot.QueryShape(&callback, &m_queryBox, 0, b2Transform(m_points[i], b2Rot(0.5f)));
+				m_overlapCounts[i] = callback.count;
+			}
+			float32 time = scale * timer.GetMilliseconds();
+			m_overlapTime = Smooth(m_overlapTime, time);
+			m_overlapTotal += time;
+		}
+
+		{
+			b2Timer timer;
+			for (int32 i = 0; i < e_queryCount; ++i)
+			{
+				OverlapCallback callback;
+				callback.shape = &m_queryBox;
+				callback.xf.Set(m_points[i], 0.5f);
+				callback.count = 0;
+
+				b2AABB aabb;
+				m_queryBox.ComputeAABB(&aabb, callback.xf, 0);
+				m_world->QueryAABB(&callback, aabb);
+				m_overlapFallbackCounts[i] = callback.count;
+			}
+			float32 time = scale * timer.GetMilliseconds();
+			m_overlapFallbackTime = Smooth(m_overlapFallbackTime, time);
+			m_overlapFallbackTotal += time;
+		}
+
+		m_mismatchCount = 0;
+		for (int32 i = 0; i < e_queryCount; ++i)
+		{
+			bool same = m_nearestCounts[i] == m_fallbackCounts[i] && m_overlapCounts[i] == m_overlapFallbackCounts[i];
+			for (int32 j = 0; same && j < m_nearestCounts[i]; ++j)
+			{
+				same = m_nearestHits[i][j].distance == m_fallbackDistances[i][j];
+			}
+			m_mismatchCount += same == false;
+		}
+		m_mismatchTotal += m_mismatchCount;
+
+		++m_rounds;
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+
+		Test::Step(settings);
+
+		if (advance || m_rounds == 0)
+		{
+			RunRound();
+		}
+
+		// The mouse's nearest fixtures and the query box around it.
+		{
+			SnapshotNearestHit hits[e_nearestCount];
+			int32 hitCount = m_snapshot.QueryNearest(hits, e_nearestCount, m_mouseWorld);
+			for (int32 i = 0; i < hitCount; ++i)
+			{
+				g_debugDraw.DrawSegment(m_mouseWorld, hits[i].point, b2Color(0.4f, 0.9f, 0.4f));
+				g_debugDraw.DrawPoint(hits[i].point, 5.0f, b2Color(0.4f, 0.9f, 0.4f));
+			}
+
+			b2Transform xf(m_mouseWorld, b2Rot(0.5f));
+			OverlapCount callback;
+			callback.count = 0;
+			m_snapshot.QueryShape(&callback, &m_queryBox, 0, xf);
+
+			b2Vec2 vs[b2_maxPolygonVertices];
+			for (int32 i = 0; i < m_queryBox.m_count; ++i)
+			{
+				vs[i] = b2Mul(xf, m_queryBox.m_vertices[i]);
+			}
+			b2Color color = callback.count > 0 ? b2Color(0.9f, 0.3f, 0.3f) : b2Color(0.8f, 0.8f, 0.8f);
+			g_debugDraw.DrawPolygon(vs, m_queryBox.m_count, color);
+
+			g_debugDraw.DrawString(5, m_textLine, "fixtures = %d, mouse box overlaps = %d, mismatches = %d",
+				m_snapshot.GetProxyCount(), callback.count, m_mismatchCount);
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "%d nearest: QueryNearest = %5.2f us, growing QueryAABB = %5.2f us per query",
+			e_nearestCount, m_nearestTime, m_nearestFallbackTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "box overlap: QueryShape = %5.2f us, QueryAABB + b2TestOverlap = %5.2f us per query",
+			m_overlapTime, m_overlapFallbackTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new NearestQueries;
+	}
+
+	float32 m_worldExtent;
+	float32 m_proxyExtent;
+	WorldSnapshot m_snapshot;
+	b2PolygonShape m_queryBox;
+
+	b2Vec2 m_points[e_queryCount];
+	SnapshotNearestHit m_nearestHits[e_queryCount][e_nearestCount];
+	int32 m_nearestCounts[e_queryCount];
+	float32 m_fallbackDistances[e_queryCount][e_nearestCount];
+	int32 m_fallbackCounts[e_queryCount];
+	int32 m_overlapCounts[e_queryCount];
+	int32 m_overlapFallbackCounts[e_queryCount];
+
+	float32 m_nearestTime;
+	float32 m_nearestFallbackTime;
+	float32 m_overlapTime;
+	float32 m_overlapFallbackTime;
+	int32 m_mismatchCount;
+
+	// Sums over all rounds, for RunNearestQueryReport.
+	float32 m_nearestTotal;
+	float32 m_nearestFallbackTotal;
+	float32 m_overlapTotal;
+	float32 m_overlapFallbackTotal;
+	int32 m_mismatchTotal;
+	int32 m_rounds;
+};
+
+#endif
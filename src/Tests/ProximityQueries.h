@@ -0,0 +1,172 @@
+#ifndef PROXIMITY_QUERIES_H
+#define PROXIMITY_QUERIES_H
+
+#include "../Framework/ProximityQuery.h"
+
+/// Persistent distance queries, the kind game code keeps for sensors and
+/// line of sight: every body bouncing around the box is tracked against
+/// every probe shape on the grid by a ProximityQuery. Warm-started GJK
+/// needs about one iteration per query; a cold start is run alongside to
+/// show the difference. Press M to stop measuring the cold start and time
+/// the warm queries alone.
+class ProximityQueries : public Test
+{
+public:
+	enum
+	{
+		e_bodyCount = 40,
+		e_probeColumns = 10,
+		e_probeRows = 5,
+		e_probeCount = e_probeColumns * e_probeRows,
+		e_queryCount = e_bodyCount * e_probeCount
+	};
+
+	ProximityQueries()
+	{
+		m_world->SetGravity(b2Vec2(0.0f, 0.0f));
+
+		{
+			b2BodyDef bd;
+			b2Body* ground = m_world->CreateBody(&bd);
+
+			b2EdgeShape shape;
+			shape.Set(b2Vec2(-25.0f, 0.0f), b2Vec2(25.0f, 0.0f));
+			ground->CreateFixture(&shape, 0.0f);
+			shape.Set(b2Vec2(-25.0f, 30.0f), b2Vec2(25.0f, 30.0f));
+			ground->CreateFixture(&shape, 0.0f);
+			shape.Set(b2Vec2(-25.0f, 0.0f), b2Vec2(-25.0f, 30.0f));
+			ground->CreateFixture(&shape, 0.0f);
+			shape.Set(b2Vec2(25.0f, 0.0f), b2Vec2(25.0f, 30.0f));
+			ground->CreateFixture(&shape, 0.0f);
+		}
+
+		b2Fixture* fixtures[e_bodyCount];
+		for (int32 i = 0; i < e_bodyCount; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(RandomFloat(-22.0f, 22.0f), RandomFloat(3.0f, 27.0f));
+			bd.angle = RandomFloat(-b2_pi, b2_pi);
+			bd.linearVelocity.Set(RandomFloat(-5.0f, 5.0f), RandomFloat(-5.0f, 5.0f));
+			bd.angularVelocity = RandomFloat(-1.0f, 1.0f);
+			b2Body* body = m_world->CreateBody(&bd);
+
+			b2FixtureDef fd;
+			fd.density = 1.0f;
+			fd.restitution = 1.0f;
+			fd.friction = 0.0f;
+
+			if (i & 1)
+			{
+				b2CircleShape shape;
+				shape.m_radius = RandomFloat(0.3f, 0.8f);
+				fd.shape = &shape;
+				fixtures[i] = body->CreateFixture(&fd);
+			}
+			else
+			{
+				b2PolygonShape shape;
+				shape.SetAsBox(RandomFloat(0.2f, 1.0f), RandomFloat(0.2f, 1.0f));
+				fd.shape = &shape;
+				fixtures[i] = body->CreateFixture(&fd);
+			}
+		}
+
+		for (int32 i = 0; i < e_probeCount; ++i)
+		{
+			int32 column = i % e_probeColumns;
+			int32 row = i / e_probeColumns;
+			m_probeTransforms[i].Set(b2Vec2(-20.0f + 40.0f * column / (e_probeColumns - 1), 5.0f + 20.0f * row / (e_probeRows - 1)), 0.25f * b2_pi);
+			m_probes[i].SetAsBox(0.25f, 0.25f);
+		}
+
+		for (int32 i = 0; i < e_bodyCount; ++i)
+		{
+			for (int32 j = 0; j < e_probeCount; ++j)
+			{
+				m_queries[i * e_probeCount + j].Set(fixtures[i], 0, m_probes + j, 0);
+			}
+		}
+
+		m_measureSavings = true;
+		m_queryTime = 0.0f;
+	}
+
+	void Keyboard(Oryol::Key::Code key)
+	{
+		switch (key)
+		{
+		case Oryol::Key::M:
+			m_measureSavings = !m_measureSavings;
+			break;
+		}
+	}
+
+	void Step(Settings* settings)
+	{
+		Test::Step(settings);
+
+		b2Timer timer;
+		int32 warmIterations = 0;
+		int32 savedIterations = 0;
+		for (int32 i = 0; i < e_queryCount; ++i)
+		{
+			ProximityQuery* query = m_queries + i;
+			int32 saved = query->GetSavedIterations();
+			query->SetMeasureSavings(m_measureSavings);
+			query->Update(m_probeTransforms[i % e_probeCount]);
+			warmIterations += query->GetIterations();
+			savedIterations += query->GetSavedIterations() - saved;
+		}
+		m_queryTime = 0.95f * m_queryTime + 0.05f * timer.GetMilliseconds();
+
+		b2Color probeColor(0.5f, 0.5f, 0.9f);
+		for (int32 i = 0; i < e_probeCount; ++i)
+		{
+			b2Vec2 vertices[b2_maxPolygonVertices];
+			for (int32 j = 0; j < m_probes[i].m_count; ++j)
+			{
+				vertices[j] = b2Mul(m_probeTransforms[i], m_probes[i].m_vertices[j]);
+			}
+			g_debugDraw.DrawPolygon(vertices, m_probes[i].m_count, probeColor);
+		}
+
+		// Probes that something has come close to.
+		b2Color nearColor(0.9f, 0.9f, 0.3f);
+		for (int32 i = 0; i < e_queryCount; ++i)
+		{
+			const b2DistanceOutput& output = m_queries[i].GetOutput();
+			if (output.distance < 2.0f)
+			{
+				g_debugDraw.DrawSegment(output.pointA, output.pointB, nearColor);
+			}
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "Press M to toggle measuring the cold start");
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "queries = %d, GJK iterations per query = %4.2f, time = %5.3f ms",
+			e_queryCount, (float32)warmIterations / e_queryCount, m_queryTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		if (m_measureSavings)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "iterations saved by warm starting = %d (cold = %4.2f per query)",
+				savedIterations, (float32)(warmIterations + savedIterations) / e_queryCount);
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+	}
+
+	static Test* Create()
+	{
+		return new ProximityQueries;
+	}
+
+	ProximityQuery m_queries[e_queryCount];
+	b2PolygonShape m_probes[e_probeCount];
+	b2Transform m_probeTransforms[e_probeCount];
+	bool m_measureSavings;
+	float32 m_queryTime;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "../Framework/Test.h"
+#include "../Framework/SceneReports.h"
+#include "NearestQueries.h"
+#include "WorldFileLoading.h"
+#include <cstdio>
+
+void RunNearestQueryReport(const Settings& settings, int32 stepCount)
+{
+	if (stepCount <= 0)
+	{
+		return;
+	}
+
+	HeadlessDrawScope drawScope;
+
+	Settings runSettings = MakeHeadlessSettings(settings);
+
+	// Each step runs one round of e_queryCount queries of each kind.
+	NearestQueries* test = new NearestQueries;
+	for (int32 i = 0; i < stepCount; ++i)
+	{
+		test->Step(&runSettings);
+	}
+
+	float32 rounds = (float32)test->m_rounds;
+	printf("fixtures = %d, rounds = %d, queries per round = %d\n",
+		test->m_snapshot.GetProxyCount(), test->m_rounds, (int32)NearestQueries::e_queryCount);
+	printf("%d nearest:   QueryNearest %8.3f us, growing QueryAABB %8.3f us per query\n",
+		(int32)NearestQueries::e_nearestCount, test->m_nearestTotal / rounds, test->m_nearestFallbackTotal / rounds);
+	printf("box overlap: QueryShape   %8.3f us, QueryAABB + b2TestOverlap %8.3f us per query\n",
+		test->m_overlapTotal / rounds, test->m_overlapFallbackTotal / rounds);
+	printf("mismatched queries = %d\n", test->m_mismatchTotal);
+	fflush(stdout);
+	delete test;
+}
+
+void RunWorldFileReport(const Settings& settings, int32 runCount)
+{
+	B2_NOT_USED(settings);
+	if (runCount <= 0)
+	{
+		return;
+	}
+
+	HeadlessDrawScope drawScope;
+
+	// The scene times everything in its constructor.
+	printf("run  bodies fixtures joints    kB   dump ms  write ms   load ms  file ms  matches\n");
+	float32 totals[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	int32 matchCount = 0;
+	for (int32 i = 0; i < runCount; ++i)
+	{
+		WorldFileLoading* test = new WorldFileLoading;
+		const WorldFileStats& stats = test->m_stats;
+		printf("%3d %7d %8d %6d %5d %9.2f %9.2f %9.2f %8.2f  %s\n", i, stats.bodyCount, stats.fixtureCount,
+			stats.jointCount, stats.byteCount / 1024, test->m_buildTime, test->m_writeTime, test->m_loadTime,
+			test->m_fileLoadTime, test->m_matches ? "yes" : "NO");
+		fflush(stdout);
+
+		totals[0] += test->m_buildTime;
+		totals[1] += test->m_writeTime;
+		totals[2] += test->m_loadTime;
+		totals[3] += test->m_fileLoadTime;
+		matchCount += test->m_matches;
+		delete test;
+	}
+
+	printf("ave%40.2f %9.2f %9.2f %8.2f  %d/%d\n", totals[0] / runCount, totals[1] / runCount,
+		totals[2] / runCount, totals[3] / runCount, matchCount, runCount);
+	fflush(stdout);
+}
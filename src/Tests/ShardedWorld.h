@@ -0,0 +1,130 @@
+#ifndef SHARDED_WORLD_H
+#define SHARDED_WORLD_H
+
+#include "../Framework/ShardCoordinator.h"
+
+/// Runs a scaled-up Tiles or AddPair scene split across worker processes.
+/// Each colored strip is simulated by its own process; bodies near a strip
+/// boundary are mirrored into the neighbour as kinematic ghosts and bodies
+/// crossing a boundary migrate. The local world only holds static geometry.
+class ShardedWorld : public Test
+{
+public:
+	ShardedWorld()
+	{
+		m_scene = e_shardTiles;
+		m_scale = 2;
+		m_shardCount = 4;
+		Restart();
+	}
+
+	~ShardedWorld()
+	{
+		m_coordinator.Stop();
+	}
+
+	void Restart()
+	{
+		m_coordinator.Stop();
+
+		m_world->DestroyBody(m_groundBody);
+		b2BodyDef bd;
+		m_groundBody = m_world->CreateBody(&bd);
+
+		b2Timer timer;
+		m_started = m_coordinator.Start(m_scene, m_scale, m_shardCount, m_groundBody);
+		m_startTime = timer.GetMilliseconds();
+	}
+
+	void Keyboard(Oryol::Key::Code key)
+	{
+		switch (key)
+		{
+		case Oryol::Key::N1:
+			m_scene = e_shardTiles;
+			Restart();
+			break;
+
+		case Oryol::Key::N2:
+			m_scene = e_shardAddPair;
+			Restart();
+			break;
+
+		case Oryol::Key::N3:
+			m_shardCount = b2Max(m_shardCount - 1, 1);
+			Restart();
+			break;
+
+		case Oryol::Key::N4:
+			m_shardCount = b2Min(m_shardCount + 1, (int32)ShardCoordinator::e_maxShards);
+			Restart();
+			break;
+
+		case Oryol::Key::N5:
+			m_scale = b2Max(m_scale - 1, 1);
+			Restart();
+			break;
+
+		case Oryol::Key::N6:
+			m_scale = b2Min(m_scale + 1, 16);
+			Restart();
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+		float32 timeStep = settings->hz > 0.0f ? 1.0f / settings->hz : float32(0.0f);
+
+		Test::Step(settings);
+
+		g_debugDraw.DrawString(5, m_textLine, "1/2 = tiles/add pair scene, 3/4 = fewer/more shards, 5/6 = smaller/larger scene");
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		if (m_started == false)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "Sharding needs local sockets and processes (Linux/macOS).");
+			m_textLine += DRAW_STRING_NEW_LINE;
+			return;
+		}
+
+		if (advance && timeStep > 0.0f)
+		{
+			m_coordinator.Step(timeStep, settings->velocityIterations, settings->positionIterations);
+		}
+
+		m_coordinator.Draw();
+
+		g_debugDraw.DrawString(5, m_textLine, "shards = %d, bodies = %d, scale = %d, start = %.1f ms",
+			m_coordinator.GetShardCount(), m_coordinator.GetBodyCount(), m_scale, m_startTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "bytes/step [ave] = %d [%.0f], ghosts = %d, migrations = %d",
+			m_coordinator.GetBytesLastStep(), m_coordinator.GetAverageBytes(),
+			m_coordinator.GetGhostCountLastStep(), m_coordinator.GetMigrationCountLastStep());
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "step latency [ave] (max) = %5.2f [%5.2f] (%5.2f) ms, slowest worker = %5.2f ms",
+			m_coordinator.GetLatencyLastStep(), m_coordinator.GetAverageLatency(),
+			m_coordinator.GetMaxLatency(), m_coordinator.GetWorkerTimeLastStep());
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new ShardedWorld;
+	}
+
+	ShardCoordinator m_coordinator;
+	int32 m_scene;
+	int32 m_scale;
+	int32 m_shardCount;
+	bool m_started;
+	float32 m_startTime;
+};
+
+#endif
@@ -0,0 +1,392 @@
+#ifndef SNAPSHOT_QUERIES_H
+#define SNAPSHOT_QUERIES_H
+
+#include "../Framework/WorldSnapshot.h"
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+/// Query threads cast rays and run AABB queries against published world
+/// snapshots while the main thread steps the world. Press 'm' to run the
+/// same batch inline on the main thread instead, to compare frame cost.
+class SnapshotQueries : public Test
+{
+public:
+	enum
+	{
+		e_threadCount = 3,
+		e_rayCount = 200,
+		e_boxCount = 50,
+		e_drawRayCount = 40,
+		e_columnCount = 20,
+		e_rowCount = 20
+	};
+
+	struct ClosestHit : public SnapshotRayCastCallback
+	{
+		ClosestHit()
+		{
+			hit = false;
+		}
+
+		float32 ReportProxy(const SnapshotProxy& proxy, const b2Vec2& p, const b2Vec2& n, float32 fraction) override
+		{
+			B2_NOT_USED(proxy);
+			B2_NOT_USED(n);
+			hit = true;
+			point = p;
+			return fraction;
+		}
+
+		bool hit;
+		b2Vec2 point;
+	};
+
+	struct OverlapCount : public SnapshotQueryCallback
+	{
+		OverlapCount()
+		{
+			count = 0;
+		}
+
+		bool ReportProxy(const SnapshotProxy& proxy) override
+		{
+			B2_NOT_USED(proxy);
+			++count;
+			return true;
+		}
+
+		int32 count;
+	};
+
+	struct DrawRay
+	{
+		b2Vec2 p1;
+		b2Vec2 p2;
+		bool hit;
+	};
+
+	struct WorkerStats
+	{
+		float32 lastLatency;
+		float32 maxLatency;
+		float32 totalLatency;
+		int32 batchCount;
+		uint32 lag;
+	};
+
+	SnapshotQueries()
+	{
+		{
+			b2BodyDef bd;
+			b2Body* ground = m_world->CreateBody(&bd);
+
+			b2EdgeShape shape;
+			shape.Set(b2Vec2(-40.0f, 0.0f), b2Vec2(40.0f, 0.0f));
+			ground->CreateFixture(&shape, 0.0f);
+
+			b2Vec2 vs[5];
+			vs[0].Set(-40.0f, 0.0f);
+			vs[1].Set(-40.0f, 20.0f);
+			vs[2].Set(-30.0f, 5.0f);
+			vs[3].Set(-20.0f, 0.0f);
+			vs[4].Set(-10.0f, 0.0f);
+			b2ChainShape chain;
+			chain.CreateChain(vs, 5);
+			ground->CreateFixture(&chain, 0.0f);
+
+			for (int32 i = 0; i < 5; ++i)
+			{
+				vs[i].x = -vs[i].x;
+			}
+			b2ChainShape mirror;
+			mirror.CreateChain(vs, 5);
+			ground->CreateFixture(&mirror, 0.0f);
+		}
+
+		{
+			b2PolygonShape box;
+			box.SetAsBox(0.4f, 0.4f);
+
+			b2PolygonShape triangle;
+			b2Vec2 vertices[3];
+			vertices[0].Set(-0.5f, 0.0f);
+			vertices[1].Set(0.5f, 0.0f);
+			vertices[2].Set(0.0f, 0.8f);
+			triangle.Set(vertices, 3);
+
+			b2CircleShape circle;
+			circle.m_radius = 0.4f;
+
+			for (int32 i = 0; i < e_rowCount; ++i)
+			{
+				for (int32 j = 0; j < e_columnCount; ++j)
+				{
+					b2BodyDef bd;
+					bd.type = b2_dynamicBody;
+					bd.position.Set(-14.25f + 1.5f * j + 0.1f * (i & 1), 2.0f + 1.5f * i);
+					b2Body* body = m_world->CreateBody(&bd);
+
+					b2FixtureDef fd;
+					fd.density = 1.0f;
+					fd.friction = 0.3f;
+					switch ((i + j) % 3)
+					{
+					case 0:
+						fd.shape = &box;
+						break;
+					case 1:
+						fd.shape = &triangle;
+						break;
+					default:
+						fd.shape = &circle;
+						break;
+					}
+					body->CreateFixture(&fd);
+				}
+			}
+		}
+
+		m_inline = false;
+		m_quit = false;
+		m_published = 0;
+		m_publishTime = 0.0f;
+		m_inlineTime = 0.0f;
+		m_queryCount = 0;
+		m_queryRate = 0.0f;
+		m_rateQueries = 0;
+		memset(m_stats, 0, sizeof(m_stats));
+		m_drawRayCount = 0;
+
+		m_publisher.Publish(m_world, m_stepCount);
+		m_published = m_publisher.GetVersion();
+
+		for (int32 i = 0; i < e_threadCount; ++i)
+		{
+			m_threads[i] = std::thread(&SnapshotQueries::QueryLoop, this, i);
+		}
+	}
+
+	~SnapshotQueries()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_condition.notify_all();
+
+		for (int32 i = 0; i < e_threadCount; ++i)
+		{
+			m_threads[i].join();
+		}
+	}
+
+	// Runs one batch of queries. Rays fan out from a point that orbits with
+	// the snapshot's step index so the drawn rays sweep the pile.
+	int32 RunBatch(const WorldSnapshot& snapshot, uint32* seed, DrawRay* drawRays)
+	{
+		float32 orbit = 0.01f * snapshot.GetStepIndex();
+		b2Vec2 origin(20.0f * sinf(orbit), 35.0f);
+
+		for (int32 i = 0; i < e_rayCount; ++i)
+		{
+			float32 angle = -b2_pi * (i + 0.5f) / e_rayCount;
+			b2Vec2 p2 = origin + 60.0f * b2Vec2(cosf(angle), sinf(angle));
+
+			ClosestHit callback;
+			snapshot.RayCast(&callback, origin, p2);
+
+			if (drawRays != NULL && i % (e_rayCount / e_drawRayCount) == 0)
+			{
+				DrawRay& ray = drawRays[i / (e_rayCount / e_drawRayCount)];
+				ray.p1 = origin;
+				ray.p2 = callback.hit ? callback.point : p2;
+				ray.hit = callback.hit;
+			}
+		}
+
+		for (int32 i = 0; i < e_boxCount; ++i)
+		{
+			// Local generator: RandomInt is for the main thread only.
+			*seed = 1664525u * *seed + 1013904223u;
+			float32 x = -20.0f + 40.0f * ((*seed >> 8) & 0xffff) / 65535.0f;
+			float32 y = 30.0f * ((*seed >> 24) & 0xff) / 255.0f;
+
+			b2AABB aabb;
+			aabb.lowerBound.Set(x - 1.0f, y - 1.0f);
+			aabb.upperBound.Set(x + 1.0f, y + 1.0f);
+
+			OverlapCount callback;
+			snapshot.QueryAABB(&callback, aabb);
+		}
+
+		return e_rayCount + e_boxCount;
+	}
+
+	void QueryLoop(int32 index)
+	{
+		uint32 seed = 12345u + 7919u * index;
+		uint32 seen = 0;
+		DrawRay drawRays[e_drawRayCount];
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				while (m_quit == false && m_published == seen)
+				{
+					m_condition.wait(lock);
+				}
+				if (m_quit)
+				{
+					return;
+				}
+			}
+
+			// Holding the handle keeps the snapshot from being rebuilt even if
+			// several newer versions are published while this batch runs.
+			SnapshotHandle snapshot = m_publisher.Acquire();
+			seen = snapshot->GetVersion();
+
+			b2Timer timer;
+			int32 count = RunBatch(*snapshot, &seed, index == 0 ? drawRays : NULL);
+			float32 latency = timer.GetMilliseconds();
+			m_queryCount += count;
+
+			std::lock_guard<std::mutex> lock(m_statsMutex);
+			WorkerStats& stats = m_stats[index];
+			stats.lastLatency = latency;
+			stats.maxLatency = b2Max(stats.maxLatency, latency);
+			stats.totalLatency += latency;
+			++stats.batchCount;
+			stats.lag = m_publisher.GetVersion() - seen;
+			if (index == 0)
+			{
+				memcpy(m_drawRays, drawRays, sizeof(drawRays));
+				m_drawRayCount = e_drawRayCount;
+			}
+		}
+	}
+
+	void Keyboard(Oryol::Key::Code key)
+	{
+		switch (key)
+		{
+		case Oryol::Key::M:
+			m_inline = !m_inline;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	void Step(Settings* settings)
+	{
+		bool advance = settings->pause == 0 || settings->singleStep;
+
+		Test::Step(settings);
+
+		if (advance)
+		{
+			b2Timer timer;
+			m_publisher.Publish(m_world, m_stepCount);
+			m_publishTime = timer.GetMilliseconds();
+
+			if (m_inline)
+			{
+				// Same work as one query thread, serialized behind the step.
+				SnapshotHandle snapshot = m_publisher.Acquire();
+				uint32 seed = 4242u;
+				b2Timer inlineTimer;
+				m_queryCount += RunBatch(*snapshot, &seed, NULL);
+				m_inlineTime = inlineTimer.GetMilliseconds();
+			}
+			else
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_published = m_publisher.GetVersion();
+				}
+				m_condition.notify_all();
+				m_inlineTime = 0.0f;
+			}
+		}
+
+		float32 elapsed = m_rateTimer.GetMilliseconds();
+		if (elapsed > 1000.0f)
+		{
+			int64_t queries = m_queryCount;
+			m_queryRate = 1000.0f * (queries - m_rateQueries) / elapsed;
+			m_rateQueries = queries;
+			m_rateTimer.Reset();
+		}
+
+		WorkerStats stats[e_threadCount];
+		{
+			std::lock_guard<std::mutex> lock(m_statsMutex);
+			memcpy(stats, m_stats, sizeof(stats));
+			for (int32 i = 0; i < m_drawRayCount; ++i)
+			{
+				const DrawRay& ray = m_drawRays[i];
+				if (ray.hit)
+				{
+					g_debugDraw.DrawPoint(ray.p2, 4.0f, b2Color(0.4f, 0.9f, 0.4f));
+					g_debugDraw.DrawSegment(ray.p1, ray.p2, b2Color(0.8f, 0.8f, 0.8f));
+				}
+				else
+				{
+					g_debugDraw.DrawSegment(ray.p1, ray.p2, b2Color(0.5f, 0.5f, 0.5f));
+				}
+			}
+		}
+
+		g_debugDraw.DrawString(5, m_textLine, "Press 'm' to toggle concurrent/inline queries (now %s)", m_inline ? "inline" : "concurrent");
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		SnapshotHandle snapshot = m_publisher.Acquire();
+		g_debugDraw.DrawString(5, m_textLine, "snapshot v%u: proxies = %d (%d changed, %s), build = %5.2f ms, publish = %5.2f ms, pool = %d",
+			snapshot->GetVersion(), snapshot->GetProxyCount(), snapshot->GetChangedCount(), snapshot->WasRebuilt() ? "rebuilt" : "refit",
+			snapshot->GetBuildTime(), m_publishTime, m_publisher.GetPoolSize());
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "queries/s = %.0f, inline queries on main thread = %5.2f ms", m_queryRate, m_inlineTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		for (int32 i = 0; i < e_threadCount; ++i)
+		{
+			const WorkerStats& s = stats[i];
+			float32 average = s.batchCount > 0 ? s.totalLatency / s.batchCount : 0.0f;
+			g_debugDraw.DrawString(5, m_textLine, "thread %d: batch latency [ave] (max) = %5.2f [%5.2f] (%5.2f) ms, versions behind = %u",
+				i, s.lastLatency, average, s.maxLatency, s.lag);
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+	}
+
+	static Test* Create()
+	{
+		return new SnapshotQueries;
+	}
+
+	SnapshotPublisher m_publisher;
+	std::thread m_threads[e_threadCount];
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	uint32 m_published;
+	bool m_quit;
+	bool m_inline;
+
+	std::mutex m_statsMutex;
+	WorkerStats m_stats[e_threadCount];
+	DrawRay m_drawRays[e_drawRayCount];
+	int32 m_drawRayCount;
+
+	std::atomic<int64_t> m_queryCount;
+	int64_t m_rateQueries;
+	float32 m_queryRate;
+	b2Timer m_rateTimer;
+	float32 m_publishTime;
+	float32 m_inlineTime;
+};
+
+#endif
@@ -20,6 +20,8 @@
 #include "AddPair.h"
 #include "ApplyForce.h"
 #include "BasicSliderCrank.h"
+#include "BatchDistanceBenchmark.h"
+#include "BatchQueries.h"
 #include "BodyTypes.h"
 #include "Breakable.h"
 #include "Bridge.h"
@@ -44,14 +46,25 @@
 #include "Gears.h"
 #include "HeavyOnLight.h"
 #include "HeavyOnLightTwo.h"
+#include "JobSystemBenchmark.h"
+#include "KinematicCrowd.h"
+#include "LabAddPair.h"
+#include "LabCollideBenchmark.h"
+#include "LabConfined.h"
+#include "LabPolygonBenchmark.h"
+#include "LabPyramid.h"
+#include "LabRollback.h"
+#include "LabTiles.h"
 #include "Mobile.h"
 #include "MobileBalanced.h"
 #include "MotorJoint.h"
+#include "NearestQueries.h"
 #include "OneSidedPlatform.h"
 #include "Pinball.h"
 #include "PolyCollision.h"
 #include "PolyShapes.h"
 #include "Prismatic.h"
+#include "ProximityQueries.h"
 #include "Pulleys.h"
 #include "Pyramid.h"
 #include "RayCast.h"
@@ -59,7 +72,9 @@
 #include "RopeJoint.h"
 #include "SensorTest.h"
 #include "ShapeEditing.h"
+#include "ShardedWorld.h"
 #include "SliderCrank.h"
+#include "SnapshotQueries.h"
 #include "SphereStack.h"
 #include "TheoJansen.h"
 #include "Tiles.h"
@@ -69,6 +84,7 @@
 #include "VaryingRestitution.h"
 #include "VerticalStack.h"
 #include "Web.h"
+#include "WorldFileLoading.h"
 
 TestEntry g_testEntries[] =
 {
@@ -124,5 +140,21 @@ TestEntry g_testEntries[] =
 	{"Sensor Test", SensorTest::Create},
 	{"Varying Friction", VaryingFriction::Create},
 	{"Add Pair Stress Test", AddPair::Create},
+	{"Sharded World", ShardedWorld::Create},
+	{"Snapshot Queries", SnapshotQueries::Create},
+	{"Job System Benchmark", JobSystemBenchmark::Create},
+	{"Lab Pyramid", LabPyramid::Create},
+	{"Lab Add Pair", LabAddPair::Create},
+	{"Lab Confined", LabConfined::Create},
+	{"Lab Collide Benchmark", LabCollideBenchmark::Create},
+	{"Lab Polygon Benchmark", LabPolygonBenchmark::Create},
+	{"Lab Tiles", LabTiles::Create},
+	{"Lab Rollback", LabRollback::Create},
+	{"Batch Distance Benchmark", BatchDistanceBenchmark::Create},
+	{"Batch Queries", BatchQueries::Create},
+	{"Proximity Queries", ProximityQueries::Create},
+	{"Nearest Queries", NearestQueries::Create},
+	{"World File Loading", WorldFileLoading::Create},
+	{"Kinematic Crowd", KinematicCrowd::Create},
 	{NULL, NULL}
 };
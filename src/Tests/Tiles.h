@@ -19,8 +19,15 @@
 #ifndef TILES_H
 #define TILES_H
 
+#include "../Framework/TreeQualityPolicy.h"
+#include <vector>
+
 /// This stress tests the dynamic tree broad-phase. This also shows that tile
 /// based collision is _not_ smooth due to Box2D not knowing about adjacency.
+/// The fixture AABBs are mirrored into a b2DynamicTree and a WideTree, which
+/// get the same moves and pair queries each step so the two can be compared.
+/// A TreeQualityPolicy looks after the WideTree: press T to force a rebuild,
+/// B to toggle background rebuilds and I to toggle incremental reinsertion.
 class Tiles : public Test
 {
 public:
@@ -118,6 +125,86 @@ public:
 		}
 
 		m_createTime = timer.GetMilliseconds();
+
+		for (b2Body* b = m_world->GetBodyList(); b; b = b->GetNext())
+		{
+			for (b2Fixture* f = b->GetFixtureList(); f; f = f->GetNext())
+			{
+				MirrorProxy proxy;
+				proxy.fixture = f;
+				proxy.aabb = f->GetAABB(0);
+				proxy.treeProxyId = m_mirrorTree.CreateProxy(proxy.aabb, f);
+				proxy.wideProxyId = m_wideTree.CreateProxy(proxy.aabb, f);
+				m_mirrorProxies.push_back(proxy);
+			}
+		}
+
+		m_treeTime = 0.0f;
+		m_wideTime = 0.0f;
+		m_treePairCount = 0;
+		m_widePairCount = 0;
+	}
+
+	bool QueryCallback(int32 proxyId)
+	{
+		B2_NOT_USED(proxyId);
+		++m_queryCount;
+		return true;
+	}
+
+	// Moves the proxies of awake bodies in both mirror trees and queries the
+	// fat AABB of every proxy that was reinserted, as b2BroadPhase::UpdatePairs
+	// does. The query count includes each proxy finding itself.
+	void UpdateMirrorTrees()
+	{
+		m_moved.resize(0);
+		for (int32 i = 0; i < int32(m_mirrorProxies.size()); ++i)
+		{
+			MirrorProxy* proxy = &m_mirrorProxies[i];
+			if (proxy->fixture->GetBody()->IsAwake() == false)
+			{
+				continue;
+			}
+
+			b2AABB aabb = proxy->fixture->GetAABB(0);
+			proxy->displacement = aabb.GetCenter() - proxy->aabb.GetCenter();
+			proxy->aabb = aabb;
+			m_moved.push_back(i);
+		}
+
+		b2Timer timer;
+		m_queryCount = 0;
+		for (int32 i = 0; i < int32(m_moved.size()); ++i)
+		{
+			MirrorProxy* proxy = &m_mirrorProxies[m_moved[i]];
+			if (m_mirrorTree.MoveProxy(proxy->treeProxyId, proxy->aabb, proxy->displacement))
+			{
+				m_mirrorTree.Query(this, m_mirrorTree.GetFatAABB(proxy->treeProxyId));
+			}
+		}
+		m_treeTime = Smooth(m_treeTime, timer.GetMilliseconds());
+		m_treePairCount = m_queryCount;
+
+		timer.Reset();
+		m_queryCount = 0;
+		for (int32 i = 0; i < int32(m_moved.size()); ++i)
+		{
+			MirrorProxy* proxy = &m_mirrorProxies[m_moved[i]];
+			if (m_wideTree.MoveProxy(proxy->wideProxyId, proxy->aabb, proxy->displacement))
+			{
+				m_wideTree.Query(this, m_wideTree.GetFatAABB(proxy->wideProxyId));
+			}
+		}
+		float32 wideTime = timer.GetMilliseconds();
+		m_wideTime = Smooth(m_wideTime, wideTime);
+		m_widePairCount = m_queryCount;
+
+		m_policy.Update(&m_wideTree, wideTime);
+	}
+
+	static float32 Smooth(float32 average, float32 sample)
+	{
+		return average == 0.0f ? sample : 0.95f * average + 0.05f * sample;
 	}
 
 	void Step(Settings* settings)
@@ -132,16 +219,64 @@ public:
 
 		Test::Step(settings);
 
+		if (settings->pause == 0 || settings->singleStep)
+		{
+			UpdateMirrorTrees();
+		}
+
 		g_debugDraw.DrawString(5, m_textLine, "create time = %6.2f ms, fixture count = %d",
 			m_createTime, m_fixtureCount);
 		m_textLine += DRAW_STRING_NEW_LINE;
 
-		//b2DynamicTree* tree = &m_world->m_contactManager.m_broadPhase.m_tree;
+		g_debugDraw.DrawString(5, m_textLine, "mirror b2DynamicTree: %5.3f ms, height = %d, queried = %d",
+			m_treeTime, m_mirrorTree.GetHeight(), m_treePairCount);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "mirror WideTree: %5.3f ms, height = %d, queried = %d",
+			m_wideTime, m_wideTree.GetHeight(), m_widePairCount);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "area ratio = %4.1f (best %4.1f, rebuild at x%3.1f), reinserted %d in %5.3f ms%s",
+			m_policy.GetAreaRatio(), m_policy.GetBaselineAreaRatio(), m_policy.GetRebuildFactor(),
+			m_policy.GetReinsertCount(), m_policy.GetReinsertTime(), m_policy.GetReinsertBudget() > 0.0f ? "" : " (off)");
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		const TreeRebuildReport& report = m_policy.GetReport();
+		if (m_policy.IsRebuilding())
+		{
+			g_debugDraw.DrawString(5, m_textLine, "rebuilding in the background");
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+		else if (report.rebuildCount > 0)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "rebuild %d (%s, %5.2f ms)%s: area ratio %4.1f -> %4.1f, height %d -> %d",
+				report.rebuildCount, report.background ? "background" : "in place", report.buildTime,
+				report.complete ? "" : " settling", report.areaRatioBefore, report.areaRatioAfter,
+				report.heightBefore, report.heightAfter);
+			m_textLine += DRAW_STRING_NEW_LINE;
+
+			g_debugDraw.DrawString(5, m_textLine, "  sampled queries %5.3f -> %5.3f ms, pair update %5.3f -> %5.3f ms",
+				report.queryTimeBefore, report.queryTimeAfter, report.updateTimeBefore, report.updateTimeAfter);
+			m_textLine += DRAW_STRING_NEW_LINE;
+		}
+	}
+
+	void Keyboard(Oryol::Key::Code key)
+	{
+		switch (key)
+		{
+		case Oryol::Key::T:
+			m_policy.RequestRebuild();
+			break;
+
+		case Oryol::Key::B:
+			m_policy.SetBackgroundRebuild(!m_policy.GetBackgroundRebuild());
+			break;
 
-		//if (m_stepCount == 400)
-		//{
-		//	tree->RebuildBottomUp();
-		//}
+		case Oryol::Key::I:
+			m_policy.SetReinsertBudget(m_policy.GetReinsertBudget() > 0.0f ? 0.0f : 0.1f);
+			break;
+		}
 	}
 
 	static Test* Create()
@@ -149,8 +284,28 @@ public:
 		return new Tiles;
 	}
 
+	struct MirrorProxy
+	{
+		b2Fixture* fixture;
+		b2AABB aabb;
+		b2Vec2 displacement;
+		int32 treeProxyId;
+		int32 wideProxyId;
+	};
+
 	int32 m_fixtureCount;
 	float32 m_createTime;
+
+	std::vector<MirrorProxy> m_mirrorProxies;
+	std::vector<int32> m_moved;
+	b2DynamicTree m_mirrorTree;
+	WideTree m_wideTree;
+	TreeQualityPolicy m_policy;
+	int32 m_queryCount;
+	float32 m_treeTime;
+	float32 m_wideTime;
+	int32 m_treePairCount;
+	int32 m_widePairCount;
 };
 
 #endif
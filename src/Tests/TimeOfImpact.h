@@ -63,13 +63,15 @@ public:
 
 		b2TOIOutput output;
 
-		b2TimeOfImpact(&output, &input);
+		{
+			CollisionCounterScope scope(&m_totalCounters);
+			b2TimeOfImpact(&output, &input);
+		}
 
 		g_debugDraw.DrawString(5, m_textLine, "toi = %g", output.t);
 		m_textLine += DRAW_STRING_NEW_LINE;
 
-		extern int32 b2_toiMaxIters, b2_toiMaxRootIters;
-		g_debugDraw.DrawString(5, m_textLine, "max toi iters = %d, max root iters = %d", b2_toiMaxIters, b2_toiMaxRootIters);
+		g_debugDraw.DrawString(5, m_textLine, "max toi iters = %d, max root iters = %d", m_totalCounters.toiMaxIters, m_totalCounters.toiMaxRootIters);
 		m_textLine += DRAW_STRING_NEW_LINE;
 
 		b2Vec2 vertices[b2_maxPolygonVertices];
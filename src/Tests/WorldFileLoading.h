@@ -0,0 +1,287 @@
+#ifndef WORLD_FILE_LOADING_H
+#define WORLD_FILE_LOADING_H
+
+#include "../Framework/WorldFile.h"
+#include "../Framework/WorldChecksum.h"
+
+/// Loading a large level from a binary world file against building it the
+/// way b2World::Dump output does: a polygon Set and a CreateFixture per
+/// fixture, so hulls are computed and masses reset one fixture at a time.
+/// The level is a field of static rocky outcrops, hanging chains of links
+/// and compound debris. It is built once in a scratch world, saved, loaded
+/// back from memory into another world and checked against the built one,
+/// then loaded from the file into the shown world. Press 'l' to reload
+/// the world last written by the Save World button.
+class WorldFileLoading : public Test
+{
+public:
+	enum
+	{
+		e_outcropCount = 160,
+		e_rockCount = 250,
+		e_rockVertexCount = 8,
+		e_chainCount = 80,
+		e_linkCount = 20,
+		e_debrisCount = 400
+	};
+
+	WorldFileLoading()
+	{
+		// The random rocks are made up front so only the world building is timed.
+		m_rockPoints.resize(e_outcropCount * e_rockCount * e_rockVertexCount);
+		for (size_t i = 0; i < m_rockPoints.size(); i += e_rockVertexCount)
+		{
+			b2Vec2 center(RandomFloat(-4.0f, 4.0f), RandomFloat(-1.0f, 1.0f));
+			for (int32 j = 0; j < e_rockVertexCount; ++j)
+			{
+				float32 angle = 2.0f * b2_pi * j / e_rockVertexCount;
+				float32 radius = RandomFloat(0.2f, 0.35f);
+				m_rockPoints[i + j] = center + radius * b2Vec2(cosf(angle), sinf(angle));
+			}
+		}
+
+		b2World* built = new b2World(m_world->GetGravity());
+		{
+			b2Timer timer;
+			Build(built);
+			m_buildTime = timer.GetMilliseconds();
+		}
+
+		std::vector<uint8> data;
+		{
+			b2Timer timer;
+			WriteWorldData(built, &data);
+			m_writeTime = timer.GetMilliseconds();
+		}
+
+		b2World* loaded = new b2World(b2Vec2_zero);
+		{
+			b2Timer timer;
+			LoadWorldData(loaded, data.data(), (int32)data.size(), &m_stats);
+			m_loadTime = timer.GetMilliseconds();
+		}
+
+		m_matches = ComputeWorldChecksum(built) == ComputeWorldChecksum(loaded)
+			&& ComputeMassChecksum(built) == ComputeMassChecksum(loaded)
+			&& built->GetProxyCount() == loaded->GetProxyCount()
+			&& built->GetJointCount() == loaded->GetJointCount();
+
+		// The shown world comes through a file, mapped where possible.
+		const char* path = "world_file_loading.b2w";
+		m_fileLoadTime = 0.0f;
+		m_fileLoaded = false;
+		if (SaveWorldFile(built, path))
+		{
+			b2Timer timer;
+			m_fileLoaded = LoadWorldFile(m_world, path);
+			m_fileLoadTime = timer.GetMilliseconds();
+			remove(path);
+		}
+
+		if (m_fileLoaded == false)
+		{
+			LoadWorldData(m_world, data.data(), (int32)data.size());
+		}
+
+		delete loaded;
+		delete built;
+
+		m_reloaded = false;
+	}
+
+	void Build(b2World* world)
+	{
+		int32 point = 0;
+		for (int32 i = 0; i < e_outcropCount; ++i)
+		{
+			b2BodyDef bd;
+			bd.position.Set(-200.0f + 10.0f * (i % 40), -5.0f - 10.0f * (i / 40));
+			b2Body* outcrop = world->CreateBody(&bd);
+
+			for (int32 j = 0; j < e_rockCount; ++j)
+			{
+				b2PolygonShape shape;
+				shape.Set(&m_rockPoints[point], e_rockVertexCount);
+				outcrop->CreateFixture(&shape, 0.0f);
+				point += e_rockVertexCount;
+			}
+		}
+
+		b2BodyDef groundDef;
+		b2Body* ground = world->CreateBody(&groundDef);
+		{
+			b2EdgeShape shape;
+			shape.Set(b2Vec2(-210.0f, 0.0f), b2Vec2(210.0f, 0.0f));
+			ground->CreateFixture(&shape, 0.0f);
+
+			b2Vec2 vs[5];
+			vs[0].Set(-210.0f, 60.0f);
+			vs[1].Set(-210.0f, 0.0f);
+			vs[2].Set(0.0f, -2.0f);
+			vs[3].Set(210.0f, 0.0f);
+			vs[4].Set(210.0f, 60.0f);
+			b2ChainShape chain;
+			chain.CreateChain(vs, 5);
+			ground->CreateFixture(&chain, 0.0f);
+		}
+
+		b2PolygonShape link;
+		link.SetAsBox(0.1f, 0.4f);
+
+		for (int32 i = 0; i < e_chainCount; ++i)
+		{
+			float32 x = -198.0f + 5.0f * i;
+
+			b2Body* prevBody = ground;
+			for (int32 j = 0; j < e_linkCount; ++j)
+			{
+				b2BodyDef bd;
+				bd.type = b2_dynamicBody;
+				bd.position.Set(x, 39.6f - 0.8f * j);
+				b2Body* body = world->CreateBody(&bd);
+				body->CreateFixture(&link, 2.0f);
+
+				b2RevoluteJointDef jd;
+				jd.Initialize(prevBody, body, b2Vec2(x, 40.0f - 0.8f * j));
+				world->CreateJoint(&jd);
+
+				prevBody = body;
+			}
+
+			// A weight on a rope below every chain.
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(x, 38.0f - 0.8f * e_linkCount);
+			b2Body* weight = world->CreateBody(&bd);
+
+			b2CircleShape circle;
+			circle.m_radius = 0.5f;
+			weight->CreateFixture(&circle, 5.0f);
+
+			b2RopeJointDef rjd;
+			rjd.bodyA = prevBody;
+			rjd.bodyB = weight;
+			rjd.localAnchorA.Set(0.0f, -0.4f);
+			rjd.maxLength = 1.5f;
+			world->CreateJoint(&rjd);
+		}
+
+		for (int32 i = 0; i < e_debrisCount; ++i)
+		{
+			b2BodyDef bd;
+			bd.type = b2_dynamicBody;
+			bd.position.Set(-195.0f + 0.97f * i, 2.0f + 1.5f * (i % 5));
+			bd.angle = 0.1f * i;
+			b2Body* body = world->CreateBody(&bd);
+
+			// Compound, so the Dump way resets the mass once per piece.
+			for (int32 j = 0; j < 4; ++j)
+			{
+				b2PolygonShape shape;
+				float32 angle = 0.5f * b2_pi * j;
+				shape.SetAsBox(0.3f, 0.1f, 0.2f * b2Vec2(cosf(angle), sinf(angle)), angle);
+				body->CreateFixture(&shape, 1.0f);
+			}
+
+			if (i % 50 == 0)
+			{
+				b2PrismaticJointDef pjd;
+				pjd.Initialize(ground, body, bd.position, b2Vec2(0.0f, 1.0f));
+				pjd.lowerTranslation = -1.0f;
+				pjd.upperTranslation = 1.0f;
+				pjd.enableLimit = true;
+				world->CreateJoint(&pjd);
+			}
+		}
+	}
+
+	// The mass properties the loader computes differently from building.
+	static uint32 ComputeMassChecksum(const b2World* world)
+	{
+		uint32 hash = k_checksumBasis;
+		for (const b2Body* b = world->GetBodyList(); b; b = b->GetNext())
+		{
+			float32 mass[4];
+			mass[0] = b->GetMass();
+			mass[1] = b->GetInertia();
+			mass[2] = b->GetLocalCenter().x;
+			mass[3] = b->GetLocalCenter().y;
+			hash = ChecksumWords(hash, mass, sizeof(mass));
+		}
+		return hash;
+	}
+
+	void Keyboard(Oryol::Key::Code key)
+	{
+		switch (key)
+		{
+		case Oryol::Key::L:
+			{
+				// m_groundBody stays for the mouse joint.
+				b2Body* body = m_world->GetBodyList();
+				while (body)
+				{
+					b2Body* next = body->GetNext();
+					if (body != m_groundBody)
+					{
+						m_world->DestroyBody(body);
+					}
+					body = next;
+				}
+
+				b2Timer timer;
+				m_reloaded = LoadWorldFile(m_world, k_worldFilePath, &m_reloadStats);
+				m_fileLoadTime = timer.GetMilliseconds();
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	void Step(Settings* settings)
+	{
+		Test::Step(settings);
+
+		g_debugDraw.DrawString(5, m_textLine, "%d bodies, %d fixtures, %d joints, %d kB",
+			m_stats.bodyCount, m_stats.fixtureCount, m_stats.jointCount, m_stats.byteCount / 1024);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "build = %6.1f ms, write = %5.1f ms, load = %5.1f ms, load from file = %5.1f ms",
+			m_buildTime, m_writeTime, m_loadTime, m_fileLoadTime);
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		g_debugDraw.DrawString(5, m_textLine, "loaded world %s the built one", m_matches ? "matches" : "DIFFERS FROM");
+		m_textLine += DRAW_STRING_NEW_LINE;
+
+		if (m_reloaded)
+		{
+			g_debugDraw.DrawString(5, m_textLine, "reloaded %s: %d bodies, %d fixtures, %d joints", k_worldFilePath,
+				m_reloadStats.bodyCount, m_reloadStats.fixtureCount, m_reloadStats.jointCount);
+		}
+		else
+		{
+			g_debugDraw.DrawString(5, m_textLine, "Press 'l' to load %s, written by Save World", k_worldFilePath);
+		}
+		m_textLine += DRAW_STRING_NEW_LINE;
+	}
+
+	static Test* Create()
+	{
+		return new WorldFileLoading;
+	}
+
+	std::vector<b2Vec2> m_rockPoints;
+	WorldFileStats m_stats;
+	WorldFileStats m_reloadStats;
+	float32 m_buildTime;
+	float32 m_writeTime;
+	float32 m_loadTime;
+	float32 m_fileLoadTime;
+	bool m_matches;
+	bool m_fileLoaded;
+	bool m_reloaded;
+};
+
+#endif